@@ -0,0 +1,78 @@
+// Frame time of CpuSplatRasterizer on the synthetic cloud at 720p, from one
+// thread up to every hardware thread. Each multithreaded frame is checked
+// against the single-threaded one: the per-tile sort makes the output
+// independent of how work was split, so they must match exactly.
+//
+// Usage: cpu_splat_rasterizer_bench [iterations] [splatCount]
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "Camera.h"
+#include "CpuSplatRasterizer.h"
+#include "SplatCloud.h"
+
+namespace {
+
+constexpr VkExtent2D kExtent{1280, 720};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int iterations = std::max(argc > 1 ? std::atoi(argv[1]) : 5, 1);
+  const size_t splatCount =
+      argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1'000'000;
+
+  try {
+    const SplatCloud cloud = makeSyntheticSplatCloud(splatCount);
+    Camera camera;
+    camera.distance = 6.0f;
+
+    std::vector<size_t> threadCounts;
+    const size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 1; threads < hardware; threads *= 2) {
+      threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(hardware);
+
+    fmt::print("{} splats at {}x{}, {} blend kernel\n", cloud.count,
+               kExtent.width, kExtent.height, CpuSplatRasterizer::isa());
+    ImageData reference;
+    double single = 0.0;
+    bool ok = true;
+    for (const size_t threads : threadCounts) {
+      CpuSplatRasterizer rasterizer(threads);
+      ImageData image;
+      double best = 1e30;
+      for (int i = 0; i < iterations; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        image = rasterizer.render(cloud, camera, kExtent);
+        const auto end = std::chrono::steady_clock::now();
+        best =
+            std::min(best, std::chrono::duration<double>(end - start).count());
+      }
+
+      bool match = true;
+      if (reference.pixels.empty()) {
+        reference = std::move(image);
+        single = best;
+      } else {
+        match = image.pixels == reference.pixels;
+      }
+      ok &= match;
+      fmt::print("{:>3} threads  {:8.2f} ms  {:5.2f}x  {} tile instances  {}\n",
+                 threads, best * 1e3, single / best,
+                 rasterizer.lastInstanceCount(), match ? "ok" : "MISMATCH");
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::exception& e) {
+    fmt::print(stderr, "{}\n", e.what());
+    return EXIT_FAILURE;
+  }
+}
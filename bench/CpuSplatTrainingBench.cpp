@@ -0,0 +1,297 @@
+// Training throughput of DifferentiableSplatRasterizer, from one thread up to
+// every hardware thread.
+//
+// First checks backward() against central differences of forward() on a
+// small degree-3 cloud, for every attribute. Then fits a perturbed copy of
+// the synthetic cloud to renders of the original from a ring of views with
+// L1 loss and Adam, and reports forward + backward iterations per second
+// and the loss reached for each thread count.
+//
+// Usage: cpu_splat_training_bench [iterations] [splatCount]
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <numbers>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Camera.h"
+#include "DifferentiableSplatRasterizer.h"
+#include "SplatCloud.h"
+
+namespace {
+
+constexpr VkExtent2D kCheckExtent{96, 64};
+constexpr VkExtent2D kTrainExtent{320, 240};
+constexpr int kViews = 8;
+
+// The synthetic cloud with every SH band filled in with small random
+// coefficients.
+SplatCloud makeDegree3Cloud(size_t count, uint32_t seed) {
+  const SplatCloud base = makeSyntheticSplatCloud(count, seed);
+  SplatCloud cloud;
+  cloud.resize(count, SplatCloud::kMaxShDegree);
+  cloud.positions = base.positions;
+  cloud.scales = base.scales;
+  cloud.rotations = base.rotations;
+  cloud.opacities = base.opacities;
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> gauss(0.0f, 0.1f);
+  const size_t coeffs = cloud.shCoefficients();
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t k = 0; k < coeffs; ++k) {
+      for (size_t c = 0; c < 3; ++c) {
+        cloud.sh[((i * coeffs) + k) * 3 + c] =
+            k == 0 ? base.sh[(i * 3) + c] : gauss(rng);
+      }
+    }
+  }
+  return cloud;
+}
+
+// Compares analytic gradients of the loss sum(weights * image) with central
+// differences for a sample of each attribute's parameters. Returns false if
+// any attribute's median relative error is off.
+bool checkGradients() {
+  SplatCloud cloud = makeDegree3Cloud(300, 7);
+  Camera camera;
+  camera.distance = 4.0f;
+  camera.yaw = 0.3f;
+  camera.pitch = -0.2f;
+  const auto view = DifferentiableSplatRasterizer::viewOf(camera, kCheckExtent);
+  DifferentiableSplatRasterizer rasterizer(1);
+
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::vector<float> weights(size_t{kCheckExtent.width} *
+                             kCheckExtent.height * 4);
+  for (float& w : weights) {
+    w = unit(rng);
+  }
+  const auto loss = [&]() {
+    const ImageData image = rasterizer.forward(cloud, view);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const auto* pixels = reinterpret_cast<const float*>(image.pixels.data());
+    double sum = 0.0;
+    for (size_t i = 0; i < weights.size(); ++i) {
+      sum += double{weights[i]} * pixels[i];
+    }
+    return sum;
+  };
+
+  (void)loss();
+  SplatGradients gradients;
+  rasterizer.backward(weights, gradients);
+
+  struct Attribute {
+    std::string_view name;
+    std::vector<float>& values;
+    const std::vector<float>& gradient;
+    float step;
+  };
+  const std::vector<Attribute> attributes = {
+      {"positions", cloud.positions, gradients.positions, 1e-3f},
+      {"scales", cloud.scales, gradients.scales, 1e-4f},
+      {"rotations", cloud.rotations, gradients.rotations, 1e-3f},
+      {"opacities", cloud.opacities, gradients.opacities, 1e-3f},
+      {"sh", cloud.sh, gradients.sh, 1e-3f},
+  };
+  bool ok = true;
+  for (const Attribute& attribute : attributes) {
+    std::vector<double> errors;
+    for (size_t i = 0; i < attribute.values.size() && errors.size() < 200;
+         i += 7) {
+      if (std::abs(attribute.gradient[i]) < 1e-3f) {
+        continue;
+      }
+      const float original = attribute.values[i];
+      attribute.values[i] = original + attribute.step;
+      const double plus = loss();
+      attribute.values[i] = original - attribute.step;
+      const double minus = loss();
+      attribute.values[i] = original;
+      const double numeric = (plus - minus) / (2.0 * attribute.step);
+      const double analytic = attribute.gradient[i];
+      errors.push_back(std::abs(numeric - analytic) /
+                       std::max(std::abs(numeric), std::abs(analytic)));
+    }
+    if (errors.empty()) {
+      continue;
+    }
+    std::sort(errors.begin(), errors.end());
+    const double median = errors[errors.size() / 2];
+    const bool good = median < 0.05;
+    ok &= good;
+    fmt::print("  {:<10} {:4} samples  median relative error {:.4f}  {}\n",
+               attribute.name, errors.size(), median, good ? "ok" : "BAD");
+  }
+  return ok;
+}
+
+// Adam over every attribute of a cloud, with the activated attributes
+// projected back into range after each step.
+class Adam {
+ public:
+  explicit Adam(SplatCloud& cloud) {
+    for (size_t i = 0; i < kAttributes; ++i) {
+      first_[i].assign(values(cloud, i).size(), 0.0f);
+      second_[i].assign(first_[i].size(), 0.0f);
+    }
+  }
+
+  void step(SplatCloud& cloud, SplatGradients& gradients) {
+    constexpr std::array<float, kAttributes> kRates = {2e-3f, 1e-3f, 2e-3f,
+                                                       2e-2f, 5e-3f};
+    constexpr float kBeta1 = 0.9f;
+    constexpr float kBeta2 = 0.999f;
+    ++steps_;
+    const auto t = static_cast<float>(steps_);
+    const float correction1 = 1.0f - std::pow(kBeta1, t);
+    const float correction2 = 1.0f - std::pow(kBeta2, t);
+    const std::array<std::vector<float>*, kAttributes> grads = {
+        &gradients.positions, &gradients.scales, &gradients.rotations,
+        &gradients.opacities, &gradients.sh};
+    for (size_t a = 0; a < kAttributes; ++a) {
+      std::vector<float>& value = values(cloud, a);
+      for (size_t i = 0; i < value.size(); ++i) {
+        const float g = (*grads[a])[i];
+        float& m = first_[a][i];
+        float& v = second_[a][i];
+        m = kBeta1 * m + (1.0f - kBeta1) * g;
+        v = kBeta2 * v + (1.0f - kBeta2) * g * g;
+        value[i] -= kRates[a] * (m / correction1) /
+                    (std::sqrt(v / correction2) + 1e-8f);
+      }
+    }
+    for (float& s : cloud.scales) {
+      s = std::max(s, 1e-4f);
+    }
+    for (float& o : cloud.opacities) {
+      o = std::clamp(o, 0.005f, 1.0f);
+    }
+    for (size_t i = 0; i < cloud.count; ++i) {
+      float* q = &cloud.rotations[i * 4];
+      const float norm =
+          std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+      for (size_t c = 0; c < 4; ++c) {
+        q[c] = norm > 0.0f ? q[c] / norm : (c == 0 ? 1.0f : 0.0f);
+      }
+    }
+  }
+
+ private:
+  static constexpr size_t kAttributes = 5;
+
+  static std::vector<float>& values(SplatCloud& cloud, size_t attribute) {
+    const std::array<std::vector<float>*, kAttributes> all = {
+        &cloud.positions, &cloud.scales, &cloud.rotations, &cloud.opacities,
+        &cloud.sh};
+    return *all[attribute];
+  }
+
+  std::array<std::vector<float>, kAttributes> first_;
+  std::array<std::vector<float>, kAttributes> second_;
+  size_t steps_ = 0;
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int iterations = std::max(argc > 1 ? std::atoi(argv[1]) : 200, 1);
+  const size_t splatCount =
+      argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20'000;
+
+  try {
+    fmt::print("gradient check against central differences\n");
+    const bool gradientsOk = checkGradients();
+
+    // Targets: the synthetic cloud from a ring of views.
+    const SplatCloud reference = makeSyntheticSplatCloud(splatCount);
+    std::vector<DifferentiableSplatRasterizer::View> views;
+    std::vector<ImageData> targets;
+    {
+      DifferentiableSplatRasterizer rasterizer;
+      for (int v = 0; v < kViews; ++v) {
+        Camera camera;
+        camera.distance = 5.0f;
+        camera.yaw = 2.0f * std::numbers::pi_v<float> *
+                     static_cast<float>(v) / static_cast<float>(kViews);
+        camera.pitch = v % 2 == 0 ? 0.3f : -0.3f;
+        views.push_back(
+            DifferentiableSplatRasterizer::viewOf(camera, kTrainExtent));
+        targets.push_back(rasterizer.forward(reference, views.back()));
+      }
+    }
+
+    // The start: positions jittered, sizes off, colours all grey.
+    SplatCloud initial = reference;
+    std::mt19937 rng(11);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    for (float& p : initial.positions) {
+      p += 0.02f * gauss(rng);
+    }
+    for (float& s : initial.scales) {
+      s *= std::exp(0.3f * gauss(rng));
+    }
+    std::fill(initial.sh.begin(), initial.sh.end(), 0.0f);
+
+    std::vector<size_t> threadCounts;
+    const size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 1; threads < hardware; threads *= 2) {
+      threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(hardware);
+
+    fmt::print("fitting {} splats to {} views at {}x{}, {} iterations\n",
+               splatCount, kViews, kTrainExtent.width, kTrainExtent.height,
+               iterations);
+    double single = 0.0;
+    for (const size_t threads : threadCounts) {
+      DifferentiableSplatRasterizer rasterizer(threads);
+      SplatCloud cloud = initial;
+      Adam adam(cloud);
+      SplatGradients gradients;
+      std::vector<float> imageGradient;
+      double firstLoss = 0.0;
+      double lastLoss = 0.0;
+      double seconds = 0.0;
+      for (int i = 0; i < iterations; ++i) {
+        const size_t v = static_cast<size_t>(i) % views.size();
+        const auto start = std::chrono::steady_clock::now();
+        const ImageData image = rasterizer.forward(cloud, views[v]);
+        const double loss = DifferentiableSplatRasterizer::l1Loss(
+            image, targets[v], imageGradient);
+        rasterizer.backward(imageGradient, gradients);
+        const auto end = std::chrono::steady_clock::now();
+        seconds += std::chrono::duration<double>(end - start).count();
+        adam.step(cloud, gradients);
+        // Averaged over the first and last pass through the views.
+        const int window = std::min(iterations, kViews);
+        if (i < window) {
+          firstLoss += loss / window;
+        }
+        if (i >= iterations - window) {
+          lastLoss += loss / window;
+        }
+      }
+      const double rate = iterations / seconds;
+      if (single == 0.0) {
+        single = rate;
+      }
+      fmt::print(
+          "{:>3} threads  {:7.1f} it/s  {:5.2f}x  L1 {:.4f} -> {:.4f}\n",
+          threads, rate, rate / single, firstLoss, lastLoss);
+    }
+    return gradientsOk ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::exception& e) {
+    fmt::print(stderr, "{}\n", e.what());
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,263 @@
+// Throughput of GpuRadixSort on random 32-bit keys and 64-bit tile|depth
+// style keys, 1M to 10M pairs, on a headless device. Every sort is checked
+// against the input: keys ascending, and each value still paired with its
+// key.
+//
+// Usage: gpu_radix_sort_bench [iterations] [workgroupSize] [itemsPerThread]
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <vector>
+
+#include "FrameProfiler.h"
+#include "GpuAllocator.h"
+#include "GpuRadixSort.h"
+#include "Renderer.h"
+#include "VulkanErrors.h"
+#include "VulkanHandles.h"
+
+namespace {
+
+constexpr uint32_t kMaxCount = 10'000'000;
+
+// Host-visible mirror of the sorter's keys and values.
+struct Staging {
+  Buffer buffer;
+  GpuAllocation memory;
+  VkDeviceSize valuesOffset = 0;
+};
+
+class Bench {
+ public:
+  Bench(const Renderer::Context& ctx, int iterations)
+      : ctx_(ctx), iterations_(iterations) {
+    pool_ = CommandPool(
+        ctx.device,
+        VkCommandPoolCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            .queueFamilyIndex = ctx.queueFamily,
+        });
+    const VkCommandBufferAllocateInfo ai{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = pool_.get(),
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VK_CHECK(vkAllocateCommandBuffers(ctx.device, &ai, &cmd_));
+
+    queries_ = QueryPool(ctx.device,
+                         VkQueryPoolCreateInfo{
+                             .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                             .queryType = VK_QUERY_TYPE_TIMESTAMP,
+                             .queryCount = 2,
+                         });
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(ctx.physicalDevice, &props);
+    nsPerTick_ = props.limits.timestampPeriod;
+  }
+
+  // Sorts `count` random pairs `iterations_` times and prints the best
+  // throughput. Returns false if any result is wrong.
+  bool run(const GpuRadixSort& sorter, const Staging& staging,
+           uint32_t count, uint32_t keyBits) {
+    const uint32_t keyWords = sorter.keyWords();
+    std::vector<uint32_t> keys(size_t{count} * keyWords);
+    std::mt19937 rng(count);
+    std::generate(keys.begin(), keys.end(), [&]() { return rng(); });
+    auto* mapped = staging.memory.mapped();
+    std::memcpy(mapped, keys.data(), keys.size() * sizeof(uint32_t));
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto* values = reinterpret_cast<uint32_t*>(mapped + staging.valuesOffset);
+    for (uint32_t i = 0; i < count; ++i) {
+      values[i] = i;
+    }
+
+    const VkDeviceSize keyBytes = VkDeviceSize{count} * keyWords * 4;
+    const VkDeviceSize valueBytes = VkDeviceSize{count} * 4;
+    double best = 1e30;
+    for (int it = 0; it < iterations_; ++it) {
+      const bool last = it + 1 == iterations_;
+      begin();
+      copy(staging.buffer.get(), 0, sorter.keys().buffer, 0, keyBytes);
+      copy(staging.buffer.get(), staging.valuesOffset, sorter.values().buffer,
+           0, valueBytes);
+      vkCmdResetQueryPool(cmd_, queries_.get(), 0, 2);
+      vkCmdWriteTimestamp(cmd_, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                          queries_.get(), 0);
+      sorter.record(cmd_, count, keyBits, VK_PIPELINE_STAGE_TRANSFER_BIT);
+      vkCmdWriteTimestamp(cmd_, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                          queries_.get(), 1);
+      if (last) {
+        copy(sorter.keys().buffer, 0, staging.buffer.get(), 0, keyBytes);
+        copy(sorter.values().buffer, 0, staging.buffer.get(),
+             staging.valuesOffset, valueBytes);
+        const VkMemoryBarrier toHost{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        };
+        vkCmdPipelineBarrier(cmd_, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &toHost, 0,
+                             nullptr, 0, nullptr);
+      }
+      submitAndWait();
+
+      std::array<uint64_t, 2> ticks{};
+      VK_CHECK(vkGetQueryPoolResults(
+          ctx_.device, queries_.get(), 0, 2, sizeof(ticks), ticks.data(),
+          sizeof(uint64_t),
+          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+      best = std::min(best, static_cast<double>(ticks[1] - ticks[0]) *
+                                nsPerTick_ * 1e-9);
+    }
+
+    const bool ok = verify(keys, mapped, values, count, keyWords, keyBits);
+    fmt::print("{:>9} pairs  {:>2}-bit keys  {:8.2f} ms  {:8.1f} Mkeys/s  {}\n",
+               count, keyBits, best * 1e3,
+               static_cast<double>(count) / best / 1e6,
+               ok ? "ok" : "MISMATCH");
+    return ok;
+  }
+
+ private:
+  void begin() {
+    VK_CHECK(vkResetCommandBuffer(cmd_, 0));
+    const VkCommandBufferBeginInfo bi{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    VK_CHECK(vkBeginCommandBuffer(cmd_, &bi));
+  }
+
+  void copy(VkBuffer src, VkDeviceSize srcOffset, VkBuffer dst,
+            VkDeviceSize dstOffset, VkDeviceSize size) {
+    const VkBufferCopy region{
+        .srcOffset = srcOffset, .dstOffset = dstOffset, .size = size};
+    vkCmdCopyBuffer(cmd_, src, dst, 1, &region);
+  }
+
+  void submitAndWait() {
+    VK_CHECK(vkEndCommandBuffer(cmd_));
+    const VkSubmitInfo si{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmd_,
+    };
+    VK_CHECK(vkQueueSubmit(ctx_.graphicsQueue, 1, &si, VK_NULL_HANDLE));
+    VK_CHECK(vkQueueWaitIdle(ctx_.graphicsQueue));
+  }
+
+  static uint64_t keyAt(const uint32_t* keys, size_t i, uint32_t keyWords,
+                        uint32_t keyBits) {
+    uint64_t key = keys[i * keyWords];
+    if (keyWords == 2) {
+      key |= uint64_t{keys[i * keyWords + 1]} << 32;
+    }
+    return keyBits < 64 ? key & ((uint64_t{1} << keyBits) - 1) : key;
+  }
+
+  static bool verify(const std::vector<uint32_t>& input,
+                     const uint8_t* sortedKeys, const uint32_t* sortedValues,
+                     uint32_t count, uint32_t keyWords, uint32_t keyBits) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const auto* keys = reinterpret_cast<const uint32_t*>(sortedKeys);
+    std::vector<bool> seen(count, false);
+    for (uint32_t i = 0; i < count; ++i) {
+      const uint32_t value = sortedValues[i];
+      if (value >= count || seen[value]) {
+        return false;
+      }
+      seen[value] = true;
+      for (uint32_t w = 0; w < keyWords; ++w) {
+        if (keys[size_t{i} * keyWords + w] !=
+            input[size_t{value} * keyWords + w]) {
+          return false;
+        }
+      }
+      if (i > 0 && keyAt(keys, i - 1, keyWords, keyBits) >
+                       keyAt(keys, i, keyWords, keyBits)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const Renderer::Context& ctx_;
+  int iterations_;
+  CommandPool pool_;
+  VkCommandBuffer cmd_ = VK_NULL_HANDLE;
+  QueryPool queries_;
+  double nsPerTick_ = 1.0;
+};
+
+Staging createStaging(const Renderer::Context& ctx, uint32_t keyWords) {
+  Staging staging;
+  staging.valuesOffset = VkDeviceSize{kMaxCount} * keyWords * 4;
+  staging.buffer = Buffer(
+      ctx.device,
+      VkBufferCreateInfo{
+          .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+          .size = staging.valuesOffset + VkDeviceSize{kMaxCount} * 4,
+          .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      });
+  // Cached, as the results are read back on the CPU.
+  staging.memory = ctx.allocator->allocate(
+      staging.buffer.get(),
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+  return staging;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int iterations = std::max(argc > 1 ? std::atoi(argv[1]) : 5, 1);
+  GpuRadixSort::Options options;
+  if (argc > 2) {
+    options.workgroupSize = static_cast<uint32_t>(std::atoi(argv[2]));
+  }
+  if (argc > 3) {
+    options.itemsPerThread = static_cast<uint32_t>(std::atoi(argv[3]));
+  }
+
+  try {
+    const Renderer renderer(Renderer::HeadlessConfig{});
+    const Renderer::Context ctx = renderer.getContext();
+    if (!GpuRadixSort::isSupported(ctx.physicalDevice)) {
+      fmt::print(stderr, "This device has no subgroup ballots in compute\n");
+      return EXIT_FAILURE;
+    }
+    if (!ctx.profiler->gpuTimingSupported()) {
+      fmt::print(stderr, "This queue has no timestamps\n");
+      return EXIT_FAILURE;
+    }
+
+    Bench bench(ctx, iterations);
+    bool ok = true;
+    for (const uint32_t keyWords : {1u, 2u}) {
+      const GpuRadixSort sorter(ctx, kMaxCount, keyWords, options);
+      const Staging staging = createStaging(ctx, keyWords);
+      fmt::print("{}-word keys, {} invocations x {} items per workgroup\n",
+                 keyWords, sorter.options().workgroupSize,
+                 sorter.options().itemsPerThread);
+      for (const uint32_t count :
+           {1'000'000u, 2'000'000u, 5'000'000u, kMaxCount}) {
+        ok &= bench.run(sorter, staging, count, 32 * keyWords);
+      }
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::exception& e) {
+    fmt::print(stderr, "{}\n", e.what());
+    return EXIT_FAILURE;
+  }
+}
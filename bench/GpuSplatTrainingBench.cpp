@@ -0,0 +1,186 @@
+// Training throughput of GpuSplatTrainer on a headless device.
+//
+// First renders the synthetic cloud through the trainer with every learning
+// rate at zero and compares the image with DifferentiableSplatRasterizer's.
+// Then fits a perturbed copy of the cloud to CPU renders of the original
+// from a ring of views, as cpu_splat_training_bench does, and reports
+// iterations per second and the loss over the first and last pass through
+// the views. With a densify interval, the timed loop also densifies and
+// prunes the cloud that often, and the time includes it.
+//
+// Usage: gpu_splat_training_bench [iterations] [splatCount] [ssimWeight]
+//                                 [densifyInterval]
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <numbers>
+#include <random>
+#include <vector>
+
+#include "Camera.h"
+#include "DifferentiableSplatRasterizer.h"
+#include "GpuSplatTrainer.h"
+#include "Renderer.h"
+#include "SplatCloud.h"
+
+namespace {
+
+constexpr VkExtent2D kTrainExtent{640, 480};
+constexpr int kViews = 8;
+
+// Largest and mean absolute difference between two RGBA32F images.
+struct ImageDifference {
+  double max = 0.0;
+  double mean = 0.0;
+};
+
+ImageDifference compare(const ImageData& a, const ImageData& b) {
+  std::vector<float> x(a.pixels.size() / sizeof(float));
+  std::vector<float> y(x.size());
+  std::memcpy(x.data(), a.pixels.data(), a.pixels.size());
+  std::memcpy(y.data(), b.pixels.data(), std::min(a.pixels.size(),
+                                                  b.pixels.size()));
+  ImageDifference difference;
+  for (size_t i = 0; i < x.size(); ++i) {
+    const double d = std::abs(double{x[i]} - double{y[i]});
+    difference.max = std::max(difference.max, d);
+    difference.mean += d;
+  }
+  difference.mean /= static_cast<double>(std::max<size_t>(x.size(), 1));
+  return difference;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int iterations = std::max(argc > 1 ? std::atoi(argv[1]) : 1000, 1);
+  const size_t splatCount =
+      argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100'000;
+  const float ssimWeight =
+      argc > 3 ? static_cast<float>(std::atof(argv[3])) : 0.2f;
+  const int densifyInterval = argc > 4 ? std::atoi(argv[4]) : 0;
+
+  try {
+    const Renderer renderer(Renderer::HeadlessConfig{});
+    const Renderer::Context ctx = renderer.getContext();
+    if (!GpuSplatTrainer::isSupported(ctx.physicalDevice)) {
+      fmt::print(stderr,
+                 "This device has no subgroup arithmetic in compute\n");
+      return EXIT_FAILURE;
+    }
+
+    // Targets: the synthetic cloud from a ring of views.
+    const SplatCloud reference = makeSyntheticSplatCloud(splatCount);
+    std::vector<DifferentiableSplatRasterizer::View> views;
+    std::vector<ImageData> targets;
+    {
+      DifferentiableSplatRasterizer rasterizer;
+      for (int v = 0; v < kViews; ++v) {
+        Camera camera;
+        camera.distance = 5.0f;
+        camera.yaw = 2.0f * std::numbers::pi_v<float> *
+                     static_cast<float>(v) / static_cast<float>(kViews);
+        camera.pitch = v % 2 == 0 ? 0.3f : -0.3f;
+        views.push_back(
+            DifferentiableSplatRasterizer::viewOf(camera, kTrainExtent));
+        targets.push_back(rasterizer.forward(reference, views.back()));
+      }
+    }
+
+    // The forward pass alone: nothing moves at zero rates.
+    bool ok = true;
+    {
+      GpuSplatTrainer::Options options;
+      options.rates = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+      options.ssimWeight = ssimWeight;
+      GpuSplatTrainer trainer(ctx, reference, options);
+      trainer.step(trainer.addView(views[0], targets[0]));
+      const ImageDifference difference =
+          compare(trainer.downloadImage(), targets[0]);
+      ok = difference.max < 1e-2;
+      fmt::print(
+          "forward against the CPU: max {:.5f}  mean {:.6f}  loss {:.6f}  "
+          "{}\n",
+          difference.max, difference.mean, trainer.stats().loss,
+          ok ? "ok" : "MISMATCH");
+    }
+
+    // The start: positions jittered, sizes off, colours all grey.
+    SplatCloud initial = reference;
+    std::mt19937 rng(11);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    for (float& p : initial.positions) {
+      p += 0.02f * gauss(rng);
+    }
+    for (float& s : initial.scales) {
+      s *= std::exp(0.3f * gauss(rng));
+    }
+    std::fill(initial.sh.begin(), initial.sh.end(), 0.0f);
+
+    GpuSplatTrainer::Options options;
+    options.rates.position = 2e-3f;
+    options.ssimWeight = ssimWeight;
+    GpuSplatTrainer trainer(ctx, initial, options);
+    for (int v = 0; v < kViews; ++v) {
+      (void)trainer.addView(views[static_cast<size_t>(v)],
+                            targets[static_cast<size_t>(v)]);
+    }
+
+    fmt::print(
+        "fitting {} splats to {} views at {}x{}, {} iterations, SSIM weight "
+        "{}\n",
+        splatCount, kViews, kTrainExtent.width, kTrainExtent.height,
+        iterations, ssimWeight);
+    // Stats lag the queue, so the windows are averaged from the iterations
+    // finished so far after each step.
+    const int window = std::min(iterations, kViews);
+    double firstLoss = 0.0;
+    for (int i = 0; i < window; ++i) {
+      trainer.step(static_cast<uint32_t>(i % kViews));
+      trainer.finish();
+      firstLoss += trainer.stats().loss / window;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    GpuSplatTrainer::DensifyResult densified;
+    for (int i = window; i < iterations; ++i) {
+      if (densifyInterval > 0 && i % densifyInterval == 0) {
+        const GpuSplatTrainer::DensifyResult result = trainer.densify({});
+        densified.cloned += result.cloned;
+        densified.split += result.split;
+        densified.pruned += result.pruned;
+      }
+      trainer.step(static_cast<uint32_t>(i % kViews));
+    }
+    trainer.finish();
+    const auto end = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    double lastLoss = 0.0;
+    for (int i = 0; i < window; ++i) {
+      trainer.step(static_cast<uint32_t>(i % kViews));
+      trainer.finish();
+      lastLoss += trainer.stats().loss / window;
+    }
+
+    const GpuSplatTrainer::Stats& stats = trainer.stats();
+    fmt::print("{:7.1f} it/s  loss {:.4f} -> {:.4f}  L1 {:.4f}  SSIM {:.4f}  "
+               "{} instances of {}\n",
+               seconds > 0.0 ? (iterations - window) / seconds : 0.0,
+               firstLoss, lastLoss, stats.l1, stats.ssim, stats.instances,
+               trainer.instanceCapacity());
+    if (densifyInterval > 0) {
+      fmt::print("densified: {} cloned, {} split, {} pruned -> {} splats\n",
+                 densified.cloned, densified.split, densified.pruned,
+                 trainer.splatCount());
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::exception& e) {
+    fmt::print(stderr, "{}\n", e.what());
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,95 @@
+// Micro-benchmark of the RGB(A) expansion kernels in PixelConvert against the
+// scalar per-channel loop ImageLayer originally used.
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "PixelConvert.h"
+
+namespace {
+
+template <typename T>
+void expandReference(const T* ptr, T* pix, size_t npixels, size_t nchans,
+                     T opaque) {
+  for (size_t i = 0; i < npixels; ++i) {
+    for (std::size_t j = 0; j < 4u; ++j) {
+      if (j < nchans) {
+        (*pix++) = *ptr++;
+      } else {
+        (*pix++) = (j == 3u) ? opaque : 0;
+      }
+    }
+  }
+}
+
+template <typename Fn>
+double bestSeconds(int iterations, const Fn& fn) {
+  double best = 1e30;
+  for (int i = 0; i < iterations; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+  }
+  return best;
+}
+
+template <typename T, typename Kernel>
+bool runCase(int width, int height, size_t nchans, T opaque,
+             const Kernel& kernel, int iterations) {
+  const size_t npixels = static_cast<size_t>(width) * height;
+  std::vector<T> src(npixels * nchans);
+  std::mt19937 rng(1234);
+  std::generate(src.begin(), src.end(), [&]() { return static_cast<T>(rng()); });
+
+  std::vector<T> expected(npixels * 4);
+  std::vector<T> actual(npixels * 4);
+
+  const double scalar = bestSeconds(iterations, [&]() {
+    expandReference(src.data(), expected.data(), npixels, nchans, opaque);
+  });
+  const double simd = bestSeconds(iterations, [&]() {
+    kernel(src.data(), actual.data(), npixels, nchans, opaque);
+  });
+
+  const bool match = expected == actual;
+  const double mpix = static_cast<double>(npixels) / 1e6;
+  fmt::print("{:>4}x{:<4} {:>2}-bit {}->4  scalar {:8.2f} Mpix/s  {:>6} "
+             "{:8.2f} Mpix/s  x{:5.2f}  {}\n",
+             width, height, sizeof(T) * 8, nchans, mpix / scalar,
+             pixelConvertIsa(), mpix / simd, scalar / simd,
+             match ? "ok" : "MISMATCH");
+  return match;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+
+  struct Size {
+    int width;
+    int height;
+  };
+  // Dataset PNG views and the large JPEG test image.
+  const std::vector<Size> sizes = {{1001, 1001}, {2580, 1935}};
+
+  bool ok = true;
+  for (const auto& size : sizes) {
+    for (size_t nchans = 1; nchans <= 3; ++nchans) {
+      ok &= runCase<uint8_t>(size.width, size.height, nchans, 0xff,
+                             expandToRgba8, iterations);
+    }
+    for (size_t nchans = 1; nchans <= 3; ++nchans) {
+      ok &= runCase<uint16_t>(size.width, size.height, nchans, 0xffff,
+                              expandToRgba16, iterations);
+    }
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,259 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+using Vec4 = std::array<float, 4>;
+
+// BC7's 4-bit interpolation weights, out of 64.
+constexpr std::array<int, 16> kBc7Weights = {0,  4,  9,  13, 17, 21, 26, 30,
+                                             34, 38, 43, 47, 51, 55, 60, 64};
+
+struct Line {
+  Vec4 start{};
+  Vec4 end{};
+};
+
+// The extent of the block's colours along their principal axis, over the
+// first `channels` channels. Power iteration on the covariance finds the
+// axis; a flat block collapses to its mean.
+Line fitLine(std::span<const uint8_t, 64> texels, size_t channels) {
+  Vec4 mean{};
+  for (size_t i = 0; i < 16; ++i) {
+    for (size_t c = 0; c < channels; ++c) {
+      mean[c] += static_cast<float>(texels[4 * i + c]);
+    }
+  }
+  for (float& m : mean) {
+    m /= 16.0f;
+  }
+
+  std::array<Vec4, 4> covariance{};
+  for (size_t i = 0; i < 16; ++i) {
+    for (size_t a = 0; a < channels; ++a) {
+      const float da = static_cast<float>(texels[4 * i + a]) - mean[a];
+      for (size_t b = 0; b < channels; ++b) {
+        covariance[a][b] +=
+            da * (static_cast<float>(texels[4 * i + b]) - mean[b]);
+      }
+    }
+  }
+
+  // Start from the row of the widest channel: never orthogonal to the axis.
+  size_t widest = 0;
+  for (size_t c = 1; c < channels; ++c) {
+    if (covariance[c][c] > covariance[widest][widest]) {
+      widest = c;
+    }
+  }
+  Vec4 axis = covariance[widest];
+  for (int iteration = 0; iteration < 8; ++iteration) {
+    Vec4 next{};
+    float largest = 0.0f;
+    for (size_t a = 0; a < channels; ++a) {
+      for (size_t b = 0; b < channels; ++b) {
+        next[a] += covariance[a][b] * axis[b];
+      }
+      largest = std::max(largest, std::abs(next[a]));
+    }
+    if (largest == 0.0f) {
+      return {mean, mean};
+    }
+    for (float& v : next) {
+      v /= largest;
+    }
+    axis = next;
+  }
+  float length = 0.0f;
+  for (const float v : axis) {
+    length += v * v;
+  }
+  length = std::sqrt(length);
+  for (float& v : axis) {
+    v /= length;
+  }
+
+  float lo = 0.0f;
+  float hi = 0.0f;
+  for (size_t i = 0; i < 16; ++i) {
+    float t = 0.0f;
+    for (size_t c = 0; c < channels; ++c) {
+      t += (static_cast<float>(texels[4 * i + c]) - mean[c]) * axis[c];
+    }
+    lo = std::min(lo, t);
+    hi = std::max(hi, t);
+  }
+  Line line;
+  for (size_t c = 0; c < channels; ++c) {
+    line.start[c] = std::clamp(mean[c] + lo * axis[c], 0.0f, 255.0f);
+    line.end[c] = std::clamp(mean[c] + hi * axis[c], 0.0f, 255.0f);
+  }
+  return line;
+}
+
+// Index of the palette entry closest to texel `i`.
+template <size_t N>
+uint32_t nearest(std::span<const uint8_t, 64> texels, size_t i,
+                 const std::array<std::array<int, 4>, N>& palette,
+                 size_t channels) {
+  uint32_t best = 0;
+  int bestError = INT32_MAX;
+  for (size_t k = 0; k < N; ++k) {
+    int error = 0;
+    for (size_t c = 0; c < channels; ++c) {
+      const int d = int{texels[4 * i + c]} - palette[k][c];
+      error += d * d;
+    }
+    if (error < bestError) {
+      bestError = error;
+      best = static_cast<uint32_t>(k);
+    }
+  }
+  return best;
+}
+
+uint16_t packRgb565(const Vec4& color) {
+  const auto quantize = [](float value, int levels) {
+    return static_cast<uint16_t>(
+        std::lround(value * static_cast<float>(levels) / 255.0f));
+  };
+  return static_cast<uint16_t>(quantize(color[0], 31) << 11 |
+                               quantize(color[1], 63) << 5 |
+                               quantize(color[2], 31));
+}
+
+std::array<int, 4> unpackRgb565(uint16_t packed) {
+  const int r = packed >> 11;
+  const int g = (packed >> 5) & 0x3f;
+  const int b = packed & 0x1f;
+  return {r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2, 255};
+}
+
+// A BC7 mode 6 endpoint: 7 bits per channel and a p-bit shared by all four
+// as their least significant bit.
+struct Bc7Endpoint {
+  std::array<uint8_t, 4> bits{};
+  uint8_t pBit = 0;
+
+  [[nodiscard]] int channel(size_t c) const { return bits[c] << 1 | pBit; }
+};
+
+Bc7Endpoint quantizeBc7(const Vec4& color) {
+  Bc7Endpoint best;
+  float bestError = INFINITY;
+  for (uint8_t pBit = 0; pBit < 2; ++pBit) {
+    Bc7Endpoint candidate{.pBit = pBit};
+    float error = 0.0f;
+    for (size_t c = 0; c < 4; ++c) {
+      const long q = std::lround((color[c] - pBit) / 2.0f);
+      candidate.bits[c] = static_cast<uint8_t>(std::clamp(q, 0L, 127L));
+      const float d = static_cast<float>(candidate.channel(c)) - color[c];
+      error += d * d;
+    }
+    if (error < bestError) {
+      bestError = error;
+      best = candidate;
+    }
+  }
+  return best;
+}
+
+// Appends little-endian bit fields to a block, least significant bit first.
+class BitWriter {
+ public:
+  explicit BitWriter(std::span<uint8_t, kBc7BlockBytes> block)
+      : block_(block) {
+    std::fill(block_.begin(), block_.end(), uint8_t{0});
+  }
+
+  void put(uint32_t value, int bits) {
+    for (int i = 0; i < bits; ++i, ++position_) {
+      block_[position_ / 8] |=
+          static_cast<uint8_t>(((value >> i) & 1u) << (position_ % 8));
+    }
+  }
+
+ private:
+  std::span<uint8_t, kBc7BlockBytes> block_;
+  size_t position_ = 0;
+};
+
+}  // namespace
+
+void encodeBc1Block(std::span<const uint8_t, 64> texels,
+                    std::span<uint8_t, kBc1BlockBytes> block) {
+  const Line line = fitLine(texels, 3);
+  uint16_t color0 = packRgb565(line.end);
+  uint16_t color1 = packRgb565(line.start);
+  // color0 > color1 selects the opaque four-colour mode.
+  if (color0 < color1) {
+    std::swap(color0, color1);
+  }
+
+  uint32_t indices = 0;
+  // Equal endpoints: index 0 is exactly the colour in either mode.
+  if (color0 != color1) {
+    const std::array<int, 4> p0 = unpackRgb565(color0);
+    const std::array<int, 4> p1 = unpackRgb565(color1);
+    std::array<std::array<int, 4>, 4> palette{{p0, p1, {}, {}}};
+    for (size_t c = 0; c < 3; ++c) {
+      palette[2][c] = (2 * p0[c] + p1[c]) / 3;
+      palette[3][c] = (p0[c] + 2 * p1[c]) / 3;
+    }
+    for (size_t i = 0; i < 16; ++i) {
+      indices |= nearest(texels, i, palette, 3) << (2 * i);
+    }
+  }
+
+  block[0] = static_cast<uint8_t>(color0);
+  block[1] = static_cast<uint8_t>(color0 >> 8);
+  block[2] = static_cast<uint8_t>(color1);
+  block[3] = static_cast<uint8_t>(color1 >> 8);
+  for (size_t i = 0; i < 4; ++i) {
+    block[4 + i] = static_cast<uint8_t>(indices >> (8 * i));
+  }
+}
+
+void encodeBc7Block(std::span<const uint8_t, 64> texels,
+                    std::span<uint8_t, kBc7BlockBytes> block) {
+  const Line line = fitLine(texels, 4);
+  Bc7Endpoint e0 = quantizeBc7(line.start);
+  Bc7Endpoint e1 = quantizeBc7(line.end);
+
+  std::array<std::array<int, 4>, 16> palette{};
+  for (size_t k = 0; k < 16; ++k) {
+    for (size_t c = 0; c < 4; ++c) {
+      palette[k][c] = ((64 - kBc7Weights[k]) * e0.channel(c) +
+                       kBc7Weights[k] * e1.channel(c) + 32) >>
+                      6;
+    }
+  }
+  std::array<uint32_t, 16> indices{};
+  for (size_t i = 0; i < 16; ++i) {
+    indices[i] = nearest(texels, i, palette, 4);
+  }
+  // The first index is stored without its top bit, which must be clear.
+  if ((indices[0] & 8u) != 0) {
+    std::swap(e0, e1);
+    for (uint32_t& index : indices) {
+      index = 15 - index;
+    }
+  }
+
+  BitWriter writer(block);
+  writer.put(1u << 6, 7);  // mode 6
+  for (size_t c = 0; c < 4; ++c) {
+    writer.put(e0.bits[c], 7);
+    writer.put(e1.bits[c], 7);
+  }
+  writer.put(e0.pBit, 1);
+  writer.put(e1.pBit, 1);
+  writer.put(indices[0], 3);
+  for (size_t i = 1; i < 16; ++i) {
+    writer.put(indices[i], 4);
+  }
+}
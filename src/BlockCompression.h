@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// Encoders for single 4x4 blocks of 8-bit RGBA texels, given row-major.
+// Both fit a line through the block's colours (its principal axis) and
+// snap every texel to the nearest of the palette the endpoints span.
+//
+// BC1 (VK_FORMAT_BC1_RGB_UNORM_BLOCK): two RGB565 endpoints and four
+// colours, 8 bytes per block. Alpha is dropped.
+//
+// BC7 (VK_FORMAT_BC7_UNORM_BLOCK): mode 6 only, i.e. one RGBA subset with
+// 7-bit endpoints plus a p-bit each and sixteen colours, 16 bytes per block.
+// The other modes' partitions would encode edges better but multiply the
+// search; mode 6 alone is what fast encoders default to for photographs.
+inline constexpr size_t kBc1BlockBytes = 8;
+inline constexpr size_t kBc7BlockBytes = 16;
+
+void encodeBc1Block(std::span<const uint8_t, 64> texels,
+                    std::span<uint8_t, kBc1BlockBytes> block);
+void encodeBc7Block(std::span<const uint8_t, 64> texels,
+                    std::span<uint8_t, kBc7BlockBytes> block);
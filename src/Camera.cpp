@@ -0,0 +1,85 @@
+#include "Camera.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+
+// Just short of straight up or down, where the view basis degenerates.
+constexpr float kMaxPitch = 1.55f;
+
+}  // namespace
+
+void Camera::orbit(float deltaYaw, float deltaPitch) {
+  yaw += deltaYaw;
+  pitch = std::clamp(pitch + deltaPitch, -kMaxPitch, kMaxPitch);
+}
+
+void Camera::zoom(float factor) {
+  distance = std::max(distance * factor, 1e-3f);
+}
+
+Vec3 Camera::forward() const {
+  // Yaw turns about worldUp; positive pitch tilts the view towards it.
+  const Vec3 up = normalize(worldUp);
+  const Vec3 reference =
+      std::abs(up.z) < 0.99f ? Vec3{0.0f, 0.0f, 1.0f} : Vec3{1.0f, 0.0f, 0.0f};
+  const Vec3 ahead = normalize(reference - up * dot(reference, up));
+  const Vec3 side = cross(up, ahead);
+
+  const Vec3 horizontal = (ahead * std::cos(yaw)) + (side * std::sin(yaw));
+  return (horizontal * std::cos(pitch)) + (up * std::sin(pitch));
+}
+
+Vec3 Camera::position() const {
+  return target - (forward() * distance);
+}
+
+Mat4 Camera::view() const {
+  const Vec3 eye = position();
+  const Vec3 f = forward();
+  const Vec3 right = normalize(cross(f, worldUp));
+  const Vec3 down = cross(f, right);
+
+  Mat4 view;
+  const std::array<Vec3, 3> rows = {right, down, f};
+  for (int r = 0; r < 3; ++r) {
+    const Vec3 axis = rows[static_cast<size_t>(r)];
+    view(r, 0) = axis.x;
+    view(r, 1) = axis.y;
+    view(r, 2) = axis.z;
+    view(r, 3) = -dot(axis, eye);
+  }
+  return view;
+}
+
+float Camera::focalLength(VkExtent2D extent) const {
+  return 0.5f * static_cast<float>(extent.height) / std::tan(0.5f * fovY);
+}
+
+std::array<Plane, 5> Camera::frustum(VkExtent2D extent, float nearPlane,
+                                     float marginPixels) const {
+  // Camera-space planes moved into world space: for a camera-space normal
+  // n, dot(n, R p + t) = dot(R^T n, p) + dot(n, t).
+  const Mat4 v = view();
+  const float focal = focalLength(extent);
+  const float tanX =
+      (0.5f * static_cast<float>(extent.width) + marginPixels) / focal;
+  const float tanY =
+      (0.5f * static_cast<float>(extent.height) + marginPixels) / focal;
+  const Vec3 translation{v(0, 3), v(1, 3), v(2, 3)};
+  const auto toWorld = [&](Vec3 n, float offset) {
+    return Plane{
+        .normal = (v.row3(0) * n.x) + (v.row3(1) * n.y) + (v.row3(2) * n.z),
+        .offset = offset + dot(n, translation),
+    };
+  };
+  return {
+      toWorld({0.0f, 0.0f, -1.0f}, nearPlane),
+      toWorld({1.0f, 0.0f, -tanX}, 0.0f),
+      toWorld({-1.0f, 0.0f, -tanX}, 0.0f),
+      toWorld({0.0f, 1.0f, -tanY}, 0.0f),
+      toWorld({0.0f, -1.0f, -tanY}, 0.0f),
+  };
+}
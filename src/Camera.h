@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+
+#include "Math.h"
+
+// Pinhole camera orbiting a target point. Camera space follows the 3DGS and
+// COLMAP convention: +x right, +y down, +z forward, which maps straight onto
+// Vulkan's y-down clip space.
+class Camera {
+ public:
+  Vec3 target;
+  float distance = 5.0f;
+  // Radians. Zero yaw and pitch look down +z.
+  float yaw = 0.0f;
+  float pitch = 0.0f;
+  float fovY = 0.8f;
+  Vec3 worldUp{0.0f, 1.0f, 0.0f};
+
+  void orbit(float deltaYaw, float deltaPitch);
+  // Scales the distance by `factor`, e.g. 0.9 to move 10% closer.
+  void zoom(float factor);
+
+  [[nodiscard]] Vec3 position() const;
+  [[nodiscard]] Vec3 forward() const;
+  // World to camera space.
+  [[nodiscard]] Mat4 view() const;
+  // Focal length in pixels for an image of `extent`. Pixels are square, so
+  // it applies to both axes.
+  [[nodiscard]] float focalLength(VkExtent2D extent) const;
+  // World-space planes around what the camera sees at `extent`: the near
+  // plane at `nearPlane`, then the four sides, pushed out by `marginPixels`.
+  // Points outside the view are on the positive side of at least one.
+  [[nodiscard]] std::array<Plane, 5> frustum(VkExtent2D extent,
+                                             float nearPlane,
+                                             float marginPixels) const;
+};
@@ -0,0 +1,802 @@
+#include "CameraDataset.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "DiskCache.h"
+#include "ImageIO.h"
+#include "MappedFile.h"
+
+namespace {
+
+static_assert(std::endian::native == std::endian::little,
+              "COLMAP and cache loading assume a little-endian host");
+
+constexpr CacheFormat kCacheFormat{.magic = {'S', 'S', 'C', 'D'}, .version = 2};
+
+constexpr std::array<std::string_view, 2> kTransformsNames = {
+    "transforms.json", "transforms_train.json"};
+
+// Leads the cache payload.
+struct CacheHeader {
+  uint32_t frameCount = 0;
+  uint32_t pointCount = 0;
+  uint64_t pathBytes = 0;
+};
+static_assert(sizeof(CacheHeader) == 16);
+
+// One per frame; the image paths follow the points as one UTF-8 blob.
+struct CachedFrame {
+  std::array<float, 16> view;
+  float focalX;
+  float focalY;
+  float centerX;
+  float centerY;
+  uint32_t width;
+  uint32_t height;
+  uint32_t pathOffset;
+  uint32_t pathLength;
+};
+static_assert(sizeof(CachedFrame) == 96);
+
+// ---------------------------------------------------------------------------
+// COLMAP binary model.
+
+// Bounds-checked little-endian reads from a mapped file.
+class BinaryReader {
+ public:
+  BinaryReader(std::span<const uint8_t> bytes,
+               const std::filesystem::path& path)
+      : bytes_(bytes), path_(path) {}
+
+  template <typename T>
+  T read() {
+    T value{};
+    std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+    return value;
+  }
+
+  std::string readString() {
+    const auto* begin = bytes_.data() + offset_;
+    const auto* end = std::find(begin, bytes_.data() + bytes_.size(), '\0');
+    if (end == bytes_.data() + bytes_.size()) {
+      truncated();
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    std::string text(reinterpret_cast<const char*>(begin),
+                     static_cast<size_t>(end - begin));
+    offset_ += text.size() + 1;
+    return text;
+  }
+
+  // Skips `count` records of `recordSize` bytes; checked before
+  // multiplying, so a corrupt count cannot wrap around.
+  void skip(uint64_t count, size_t recordSize) {
+    const size_t remaining = bytes_.size() - offset_;
+    if (count > remaining / recordSize) {
+      truncated();
+    }
+    offset_ += static_cast<size_t>(count) * recordSize;
+  }
+
+ private:
+  std::span<const uint8_t> take(size_t size) {
+    if (size > bytes_.size() - offset_) {
+      truncated();
+    }
+    const std::span<const uint8_t> result = bytes_.subspan(offset_, size);
+    offset_ += size;
+    return result;
+  }
+
+  [[noreturn]] void truncated() const {
+    throw std::runtime_error(
+        fmt::format("Truncated COLMAP file: {}", path_.string()));
+  }
+
+  std::span<const uint8_t> bytes_;
+  const std::filesystem::path& path_;
+  size_t offset_ = 0;
+};
+
+// Parameters of COLMAP's camera models, by model id, and whether they lead
+// with separate x and y focal lengths (fx fy cx cy ...) or one (f cx cy
+// ...). Anything past the principal point is distortion.
+struct CameraModel {
+  uint32_t params;
+  bool twoFocals;
+};
+constexpr std::array<CameraModel, 11> kCameraModels{{
+    {3, false},   // SIMPLE_PINHOLE
+    {4, true},    // PINHOLE
+    {4, false},   // SIMPLE_RADIAL
+    {5, false},   // RADIAL
+    {8, true},    // OPENCV
+    {8, true},    // OPENCV_FISHEYE
+    {12, true},   // FULL_OPENCV
+    {5, true},    // FOV
+    {4, false},   // SIMPLE_RADIAL_FISHEYE
+    {5, false},   // RADIAL_FISHEYE
+    {12, true},   // THIN_PRISM_FISHEYE
+}};
+
+struct ColmapCamera {
+  uint32_t id = 0;
+  VkExtent2D extent{};
+  float focalX = 0.0f;
+  float focalY = 0.0f;
+  float centerX = 0.0f;
+  float centerY = 0.0f;
+};
+
+struct ColmapPaths {
+  std::filesystem::path cameras;
+  std::filesystem::path images;
+  std::filesystem::path points;  // may not exist
+  std::filesystem::path imageDirectory;
+};
+
+// The directory holding cameras.bin and images.bin: `source` itself,
+// source/sparse/0 or source/sparse.
+std::optional<std::filesystem::path> colmapModelDirectory(
+    const std::filesystem::path& source) {
+  for (const std::filesystem::path& candidate :
+       {source, source / "sparse" / "0", source / "sparse"}) {
+    if (std::filesystem::is_regular_file(candidate / "cameras.bin") &&
+        std::filesystem::is_regular_file(candidate / "images.bin")) {
+      return candidate;
+    }
+  }
+  return std::nullopt;
+}
+
+ColmapPaths colmapPaths(const std::filesystem::path& model) {
+  ColmapPaths paths{
+      .cameras = model / "cameras.bin",
+      .images = model / "images.bin",
+      .points = model / "points3D.bin",
+  };
+  // COLMAP keeps the images in images/ beside sparse/; the closest one up
+  // the tree wins.
+  paths.imageDirectory = model.parent_path();
+  for (std::filesystem::path dir = model; !dir.empty();
+       dir = dir.parent_path()) {
+    if (std::filesystem::is_directory(dir / "images")) {
+      paths.imageDirectory = dir / "images";
+      break;
+    }
+    if (dir == dir.parent_path()) {
+      break;
+    }
+  }
+  return paths;
+}
+
+std::vector<ColmapCamera> readColmapCameras(
+    const std::filesystem::path& path, std::span<const uint8_t> bytes) {
+  BinaryReader reader(bytes, path);
+  const auto count = reader.read<uint64_t>();
+  std::vector<ColmapCamera> cameras;
+  for (uint64_t i = 0; i < count; ++i) {
+    ColmapCamera camera;
+    camera.id = reader.read<uint32_t>();
+    const auto modelId = reader.read<int32_t>();
+    if (modelId < 0 || static_cast<size_t>(modelId) >= kCameraModels.size()) {
+      throw std::runtime_error(fmt::format(
+          "Unknown COLMAP camera model {} in {}", modelId, path.string()));
+    }
+    const CameraModel model = kCameraModels[static_cast<size_t>(modelId)];
+    camera.extent = {static_cast<uint32_t>(reader.read<uint64_t>()),
+                     static_cast<uint32_t>(reader.read<uint64_t>())};
+    std::array<double, 12> params{};
+    for (uint32_t p = 0; p < model.params; ++p) {
+      params[p] = reader.read<double>();
+    }
+    const size_t center = model.twoFocals ? 2 : 1;
+    camera.focalX = static_cast<float>(params[0]);
+    camera.focalY = static_cast<float>(params[model.twoFocals ? 1 : 0]);
+    camera.centerX = static_cast<float>(params[center]);
+    camera.centerY = static_cast<float>(params[center + 1]);
+    cameras.push_back(camera);
+  }
+  return cameras;
+}
+
+std::vector<CameraDataset::Frame> readColmapImages(
+    const ColmapPaths& paths, std::span<const uint8_t> bytes,
+    const std::vector<ColmapCamera>& cameras) {
+  BinaryReader reader(bytes, paths.images);
+  const auto count = reader.read<uint64_t>();
+  std::vector<CameraDataset::Frame> frames;
+  for (uint64_t i = 0; i < count; ++i) {
+    (void)reader.read<uint32_t>();  // image id
+    std::array<double, 4> q{};      // w x y z, world to camera
+    for (double& c : q) {
+      c = reader.read<double>();
+    }
+    std::array<double, 3> t{};
+    for (double& c : t) {
+      c = reader.read<double>();
+    }
+    const auto cameraId = reader.read<uint32_t>();
+    const std::string name = reader.readString();
+    // x, y and a point id per 2D point.
+    reader.skip(reader.read<uint64_t>(), 24);
+
+    const auto camera =
+        std::find_if(cameras.begin(), cameras.end(),
+                     [&](const ColmapCamera& c) { return c.id == cameraId; });
+    if (camera == cameras.end()) {
+      throw std::runtime_error(
+          fmt::format("COLMAP image {} refers to missing camera {}", name,
+                      cameraId));
+    }
+
+    const double norm =
+        std::sqrt((q[0] * q[0]) + (q[1] * q[1]) + (q[2] * q[2]) +
+                  (q[3] * q[3]));
+    const double w = q[0] / norm;
+    const double x = q[1] / norm;
+    const double y = q[2] / norm;
+    const double z = q[3] / norm;
+    const std::array<std::array<double, 3>, 3> r{{
+        {1 - (2 * ((y * y) + (z * z))), 2 * ((x * y) - (w * z)),
+         2 * ((x * z) + (w * y))},
+        {2 * ((x * y) + (w * z)), 1 - (2 * ((x * x) + (z * z))),
+         2 * ((y * z) - (w * x))},
+        {2 * ((x * z) - (w * y)), 2 * ((y * z) + (w * x)),
+         1 - (2 * ((x * x) + (y * y)))},
+    }};
+    // COLMAP's camera axes are already +x right, +y down, +z forward.
+    CameraDataset::Frame frame{
+        .image = paths.imageDirectory / name,
+        .view =
+            {
+                .focalX = camera->focalX,
+                .focalY = camera->focalY,
+                .extent = camera->extent,
+            },
+        .centerX = camera->centerX,
+        .centerY = camera->centerY,
+    };
+    for (int row = 0; row < 3; ++row) {
+      for (int column = 0; column < 3; ++column) {
+        frame.view.view(row, column) = static_cast<float>(
+            r[static_cast<size_t>(row)][static_cast<size_t>(column)]);
+      }
+      frame.view.view(row, 3) = static_cast<float>(t[static_cast<size_t>(row)]);
+    }
+    frames.push_back(std::move(frame));
+  }
+  return frames;
+}
+
+void readColmapPoints(const std::filesystem::path& path,
+                      std::span<const uint8_t> bytes, CameraDataset& dataset) {
+  BinaryReader reader(bytes, path);
+  const auto count = reader.read<uint64_t>();
+  dataset.pointPositions.reserve(static_cast<size_t>(count) * 3);
+  dataset.pointColors.reserve(static_cast<size_t>(count) * 3);
+  for (uint64_t i = 0; i < count; ++i) {
+    (void)reader.read<uint64_t>();  // point id
+    for (int c = 0; c < 3; ++c) {
+      dataset.pointPositions.push_back(
+          static_cast<float>(reader.read<double>()));
+    }
+    for (int c = 0; c < 3; ++c) {
+      dataset.pointColors.push_back(reader.read<uint8_t>());
+    }
+    (void)reader.read<double>();  // reprojection error
+    // Image id and 2D point index per track element.
+    reader.skip(reader.read<uint64_t>(), 8);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// transforms.json.
+
+// Just enough JSON for transforms files.
+struct JsonValue {
+  enum class Type : uint8_t { kNull, kBool, kNumber, kString, kArray, kObject };
+
+  Type type = Type::kNull;
+  bool boolean = false;
+  double number = 0.0;
+  std::string string;
+  std::vector<JsonValue> array;
+  std::vector<std::pair<std::string, JsonValue>> object;
+
+  [[nodiscard]] const JsonValue* find(std::string_view key) const {
+    for (const auto& [name, value] : object) {
+      if (name == key) {
+        return &value;
+      }
+    }
+    return nullptr;
+  }
+
+  [[nodiscard]] std::optional<double> numberAt(std::string_view key) const {
+    const JsonValue* value = find(key);
+    if (value == nullptr || value->type != Type::kNumber) {
+      return std::nullopt;
+    }
+    return value->number;
+  }
+};
+
+class JsonParser {
+ public:
+  JsonParser(std::string_view text, const std::filesystem::path& path)
+      : text_(text), path_(path) {}
+
+  JsonValue parseDocument() {
+    JsonValue value = parseValue();
+    skipSpace();
+    if (pos_ != text_.size()) {
+      fail("trailing characters");
+    }
+    return value;
+  }
+
+ private:
+  JsonValue parseValue() {
+    skipSpace();
+    if (pos_ >= text_.size()) {
+      fail("unexpected end");
+    }
+    JsonValue value;
+    const char c = text_[pos_];
+    if (c == '{') {
+      value.type = JsonValue::Type::kObject;
+      ++pos_;
+      if (!consume('}')) {
+        do {
+          skipSpace();
+          std::string key = parseString();
+          expect(':');
+          value.object.emplace_back(std::move(key), parseValue());
+        } while (consume(','));
+        expect('}');
+      }
+    } else if (c == '[') {
+      value.type = JsonValue::Type::kArray;
+      ++pos_;
+      if (!consume(']')) {
+        do {
+          value.array.push_back(parseValue());
+        } while (consume(','));
+        expect(']');
+      }
+    } else if (c == '"') {
+      value.type = JsonValue::Type::kString;
+      value.string = parseString();
+    } else if (matchWord("true") || matchWord("false")) {
+      value.type = JsonValue::Type::kBool;
+      value.boolean = c == 't';
+    } else if (matchWord("null")) {
+      value.type = JsonValue::Type::kNull;
+    } else {
+      value.type = JsonValue::Type::kNumber;
+      const char* begin = text_.data() + pos_;
+      const char* end = text_.data() + text_.size();
+      // from_chars takes no leading '+', and neither does JSON.
+      const auto [next, ec] = std::from_chars(begin, end, value.number);
+      if (ec != std::errc()) {
+        fail("expected a value");
+      }
+      pos_ += static_cast<size_t>(next - begin);
+    }
+    return value;
+  }
+
+  std::string parseString() {
+    expect('"');
+    std::string result;
+    while (true) {
+      if (pos_ >= text_.size()) {
+        fail("unterminated string");
+      }
+      const char c = text_[pos_++];
+      if (c == '"') {
+        return result;
+      }
+      if (c != '\\') {
+        result.push_back(c);
+        continue;
+      }
+      if (pos_ >= text_.size()) {
+        fail("unterminated string");
+      }
+      const char escape = text_[pos_++];
+      switch (escape) {
+        case 'b':
+          result.push_back('\b');
+          break;
+        case 'f':
+          result.push_back('\f');
+          break;
+        case 'n':
+          result.push_back('\n');
+          break;
+        case 'r':
+          result.push_back('\r');
+          break;
+        case 't':
+          result.push_back('\t');
+          break;
+        case 'u':
+          appendCodePoint(result);
+          break;
+        default:  // '"', '\\', '/'
+          result.push_back(escape);
+          break;
+      }
+    }
+  }
+
+  // \uXXXX as UTF-8. Surrogate pairs are not combined; file paths rarely
+  // need them.
+  void appendCodePoint(std::string& out) {
+    uint32_t code = 0;
+    const char* begin = text_.data() + pos_;
+    const auto [next, ec] =
+        std::from_chars(begin, begin + std::min<size_t>(4, text_.size() - pos_),
+                        code, 16);
+    if (ec != std::errc() || next != begin + 4) {
+      fail("bad \\u escape");
+    }
+    pos_ += 4;
+    if (code < 0x80) {
+      out.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+      out.push_back(static_cast<char>(0xc0 | (code >> 6)));
+      out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    } else {
+      out.push_back(static_cast<char>(0xe0 | (code >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    }
+  }
+
+  void skipSpace() {
+    while (pos_ < text_.size() &&
+           (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\n' ||
+            text_[pos_] == '\r')) {
+      ++pos_;
+    }
+  }
+
+  bool consume(char c) {
+    skipSpace();
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  void expect(char c) {
+    if (!consume(c)) {
+      fail(fmt::format("expected '{}'", c));
+    }
+  }
+
+  bool matchWord(std::string_view word) {
+    if (text_.substr(pos_, word.size()) == word) {
+      pos_ += word.size();
+      return true;
+    }
+    return false;
+  }
+
+  [[noreturn]] void fail(std::string_view what) const {
+    throw std::runtime_error(fmt::format("Bad JSON in {} at byte {}: {}",
+                                         path_.string(), pos_, what));
+  }
+
+  std::string_view text_;
+  const std::filesystem::path& path_;
+  size_t pos_ = 0;
+};
+
+std::optional<std::filesystem::path> transformsFile(
+    const std::filesystem::path& source) {
+  if (std::filesystem::is_regular_file(source) &&
+      source.extension() == ".json") {
+    return source;
+  }
+  if (std::filesystem::is_directory(source)) {
+    for (const std::string_view name : kTransformsNames) {
+      if (std::filesystem::is_regular_file(source / name)) {
+        return source / name;
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+std::vector<CameraDataset::Frame> readTransforms(
+    const std::filesystem::path& path, std::span<const uint8_t> bytes) {
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  const std::string_view text(reinterpret_cast<const char*>(bytes.data()),
+                              bytes.size());
+  const JsonValue root = JsonParser(text, path).parseDocument();
+  const JsonValue* frameList = root.find("frames");
+  if (frameList == nullptr || frameList->type != JsonValue::Type::kArray) {
+    throw std::runtime_error(
+        fmt::format("No \"frames\" array in {}", path.string()));
+  }
+
+  std::vector<CameraDataset::Frame> frames;
+  for (const JsonValue& entry : frameList->array) {
+    const JsonValue* filePath = entry.find("file_path");
+    const JsonValue* matrix = entry.find("transform_matrix");
+    if (filePath == nullptr || filePath->type != JsonValue::Type::kString ||
+        matrix == nullptr || matrix->array.size() < 3) {
+      throw std::runtime_error(fmt::format(
+          "Frame {} in {} needs a file_path and a transform_matrix",
+          frames.size(), path.string()));
+    }
+    // The NeRF synthetic scenes leave the extension off.
+    std::filesystem::path image =
+        (path.parent_path() / filePath->string).lexically_normal();
+    if (!image.has_extension() && !std::filesystem::exists(image)) {
+      image += ".png";
+    }
+
+    // Per-frame intrinsics override the file's; without a size the image
+    // header supplies it.
+    const auto value = [&](std::string_view key) {
+      const std::optional<double> own = entry.numberAt(key);
+      return own ? own : root.numberAt(key);
+    };
+    VkExtent2D extent{};
+    const std::optional<double> width = value("w");
+    const std::optional<double> height = value("h");
+    if (width && height) {
+      extent = {static_cast<uint32_t>(*width),
+                static_cast<uint32_t>(*height)};
+    } else {
+      const ImageReader reader(image);
+      extent = {static_cast<uint32_t>(reader.width()),
+                static_cast<uint32_t>(reader.height())};
+    }
+    const double w = extent.width;
+    const double h = extent.height;
+    std::optional<double> focalX = value("fl_x");
+    std::optional<double> focalY = value("fl_y");
+    if (const std::optional<double> angleX = value("camera_angle_x");
+        !focalX && angleX) {
+      focalX = 0.5 * w / std::tan(0.5 * *angleX);
+    }
+    if (const std::optional<double> angleY = value("camera_angle_y");
+        !focalY && angleY) {
+      focalY = 0.5 * h / std::tan(0.5 * *angleY);
+    }
+    if (!focalX && !focalY) {
+      throw std::runtime_error(fmt::format(
+          "Frame {} in {} has no focal length or camera angle", frames.size(),
+          path.string()));
+    }
+
+    CameraDataset::Frame frame{
+        .image = std::move(image),
+        .view =
+            {
+                .focalX = static_cast<float>(focalX.value_or(*focalY)),
+                .focalY = static_cast<float>(focalY.value_or(*focalX)),
+                .extent = extent,
+            },
+        .centerX = static_cast<float>(value("cx").value_or(0.5 * w)),
+        .centerY = static_cast<float>(value("cy").value_or(0.5 * h)),
+    };
+
+    // Camera to world with OpenGL axes (+y up, +z back). Flipping y and z
+    // gives this repo's camera axes; the view is then the inverse,
+    // [R^T | -R^T c].
+    const auto element = [&](size_t row, size_t column) {
+      const JsonValue& rowValue = matrix->array[row];
+      if (rowValue.array.size() < 4) {
+        throw std::runtime_error(fmt::format(
+            "Frame {} in {} has a malformed transform_matrix", frames.size(),
+            path.string()));
+      }
+      return rowValue.array[column].number;
+    };
+    const std::array<double, 3> sign = {1.0, -1.0, -1.0};
+    for (size_t axis = 0; axis < 3; ++axis) {
+      double translation = 0.0;
+      for (size_t c = 0; c < 3; ++c) {
+        const double rotated = sign[axis] * element(c, axis);
+        frame.view.view(static_cast<int>(axis), static_cast<int>(c)) =
+            static_cast<float>(rotated);
+        translation -= rotated * element(c, 3);
+      }
+      frame.view.view(static_cast<int>(axis), 3) =
+          static_cast<float>(translation);
+    }
+    frames.push_back(std::move(frame));
+  }
+  return frames;
+}
+
+// ---------------------------------------------------------------------------
+// Cache.
+
+std::optional<CameraDataset> readCache(const std::filesystem::path& cacheDir,
+                                       uint64_t key) {
+  const std::optional<std::vector<uint8_t>> payload =
+      readCacheFile(cacheDir, kCacheFormat, key);
+  if (!payload) {
+    return std::nullopt;
+  }
+  CachePayloadReader reader(*payload);
+  CacheHeader header;
+  if (!reader.read(header) ||
+      payload->size() != sizeof(header) +
+                              (header.frameCount * sizeof(CachedFrame)) +
+                              (uint64_t{header.pointCount} * 3 *
+                               (sizeof(float) + sizeof(uint8_t))) +
+                              header.pathBytes) {
+    return std::nullopt;
+  }
+
+  std::vector<CachedFrame> cached(header.frameCount);
+  CameraDataset dataset;
+  dataset.pointPositions.resize(size_t{header.pointCount} * 3);
+  dataset.pointColors.resize(size_t{header.pointCount} * 3);
+  std::string paths(header.pathBytes, '\0');
+  if (!reader.read(cached) || !reader.read(dataset.pointPositions) ||
+      !reader.read(dataset.pointColors) ||
+      !reader.read(std::as_writable_bytes(std::span(paths)))) {
+    return std::nullopt;
+  }
+
+  dataset.frames.reserve(cached.size());
+  for (const CachedFrame& c : cached) {
+    if (uint64_t{c.pathOffset} + c.pathLength > paths.size()) {
+      return std::nullopt;
+    }
+    CameraDataset::Frame& frame = dataset.frames.emplace_back();
+    frame.image = std::filesystem::path(
+        std::u8string_view(
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            reinterpret_cast<const char8_t*>(paths.data() + c.pathOffset),
+            c.pathLength));
+    frame.view.view.m = c.view;
+    frame.view.focalX = c.focalX;
+    frame.view.focalY = c.focalY;
+    frame.view.extent = {c.width, c.height};
+    frame.centerX = c.centerX;
+    frame.centerY = c.centerY;
+  }
+  dataset.fromCache = true;
+  return dataset;
+}
+
+void writeCache(const std::filesystem::path& cacheDir, uint64_t key,
+                const CameraDataset& dataset) {
+  std::vector<CachedFrame> cached;
+  std::string paths;
+  for (const CameraDataset::Frame& frame : dataset.frames) {
+    const std::u8string image = frame.image.u8string();
+    cached.push_back({
+        .view = frame.view.view.m,
+        .focalX = frame.view.focalX,
+        .focalY = frame.view.focalY,
+        .centerX = frame.centerX,
+        .centerY = frame.centerY,
+        .width = frame.view.extent.width,
+        .height = frame.view.extent.height,
+        .pathOffset = static_cast<uint32_t>(paths.size()),
+        .pathLength = static_cast<uint32_t>(image.size()),
+    });
+    paths.append(image.begin(), image.end());
+  }
+  const CacheHeader header{
+      .frameCount = static_cast<uint32_t>(cached.size()),
+      .pointCount = static_cast<uint32_t>(dataset.pointPositions.size() / 3),
+      .pathBytes = paths.size(),
+  };
+
+  writeCacheFile(cacheDir, kCacheFormat, key,
+                 {cacheBytes(header), cacheBytes(cached),
+                  cacheBytes(dataset.pointPositions),
+                  cacheBytes(dataset.pointColors),
+                  std::as_bytes(std::span(paths))});
+}
+
+}  // namespace
+
+std::vector<std::filesystem::path> CameraDataset::imagePaths() const {
+  std::vector<std::filesystem::path> paths;
+  paths.reserve(frames.size());
+  for (const Frame& frame : frames) {
+    paths.push_back(frame.image);
+  }
+  return paths;
+}
+
+bool isCameraDataset(const std::filesystem::path& source) {
+  return transformsFile(source).has_value() ||
+         (std::filesystem::is_directory(source) &&
+          colmapModelDirectory(source).has_value());
+}
+
+CameraDataset loadCameraDataset(const std::filesystem::path& source,
+                                const std::filesystem::path& cacheDir) {
+  const std::filesystem::path absolute = std::filesystem::absolute(source);
+  const std::optional<std::filesystem::path> transforms =
+      transformsFile(absolute);
+  const std::optional<std::filesystem::path> model =
+      transforms ? std::nullopt : colmapModelDirectory(absolute);
+  if (!transforms && !model) {
+    throw std::runtime_error(fmt::format(
+        "No COLMAP model or transforms.json found at {}", source.string()));
+  }
+
+  // The key covers every input byte and where the inputs are, since the
+  // cached image paths are resolved against it. The mapped inputs are
+  // parsed from on a miss.
+  std::vector<std::filesystem::path> inputs;
+  std::optional<ColmapPaths> colmap;
+  if (transforms) {
+    inputs.push_back(*transforms);
+  } else {
+    colmap = colmapPaths(*model);
+    inputs = {colmap->cameras, colmap->images};
+    if (std::filesystem::is_regular_file(colmap->points)) {
+      inputs.push_back(colmap->points);
+    }
+  }
+  std::vector<std::unique_ptr<MappedFile>> files;
+  CacheKey hasher(kCacheFormat);
+  for (const std::filesystem::path& input : inputs) {
+    const MappedFile& file =
+        *files.emplace_back(std::make_unique<MappedFile>(input));
+    file.prefetch();
+    hasher.add(input.generic_string());
+    hasher.add(file.bytes());
+  }
+  const uint64_t key = hasher.value();
+  if (std::optional<CameraDataset> cached = readCache(cacheDir, key)) {
+    return std::move(*cached);
+  }
+
+  CameraDataset dataset;
+  if (transforms) {
+    dataset.frames = readTransforms(*transforms, files[0]->bytes());
+  } else {
+    dataset.frames = readColmapImages(
+        *colmap, files[1]->bytes(),
+        readColmapCameras(colmap->cameras, files[0]->bytes()));
+    if (files.size() > 2) {
+      readColmapPoints(colmap->points, files[2]->bytes(), dataset);
+    }
+  }
+  if (dataset.frames.empty()) {
+    throw std::runtime_error(
+        fmt::format("No posed images in {}", source.string()));
+  }
+  std::sort(dataset.frames.begin(), dataset.frames.end(),
+            [](const CameraDataset::Frame& a, const CameraDataset::Frame& b) {
+              return a.image < b.image;
+            });
+
+  writeCache(cacheDir, key, dataset);
+  return dataset;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "DifferentiableSplatRasterizer.h"
+#include "DiskCache.h"
+
+// The posed cameras of a capture, one per image: world-to-camera transform
+// (+x right, +y down, +z forward) and pinhole intrinsics, ready to drive
+// DifferentiableSplatRasterizer or GpuSplatTrainer. Read from either
+//
+//   - a COLMAP sparse model (cameras.bin, images.bin and, optionally,
+//     points3D.bin), given as the model directory or a dataset root holding
+//     sparse/0 or sparse/ with the images in images/; or
+//   - a NeRF-style transforms.json (camera-to-world, OpenGL axes), given as
+//     the file or a directory holding transforms.json or
+//     transforms_train.json.
+//
+// Lens distortion is ignored: COLMAP models are read as pinholes, so
+// undistort the images first, as 3DGS expects.
+//
+// Parsing happens once per set of source files. The result goes to a
+// compact binary cache named by a hash of the files' contents and location,
+// and later loads of the same files read only that (after hashing them).
+struct CameraDataset {
+  using View = DifferentiableSplatRasterizer::View;
+
+  struct Frame {
+    std::filesystem::path image;
+    View view;
+    // Pixels. The rasterizers assume the image centre.
+    float centerX = 0.0f;
+    float centerY = 0.0f;
+  };
+
+  // Sorted by image path.
+  std::vector<Frame> frames;
+  // COLMAP's sparse points, e.g. to seed a SplatCloud: xyz and 8-bit rgb
+  // per point. Empty for transforms.json.
+  std::vector<float> pointPositions;
+  std::vector<uint8_t> pointColors;
+  // True when this load skipped parsing.
+  bool fromCache = false;
+
+  // The frames' images in frame order, for DatasetLoader.
+  [[nodiscard]] std::vector<std::filesystem::path> imagePaths() const;
+};
+
+// True for sources loadCameraDataset() recognizes (see CameraDataset).
+bool isCameraDataset(const std::filesystem::path& source);
+
+// Throws std::runtime_error for sources it cannot read. An unreadable or
+// stale cache is rebuilt; failing to write one is not an error.
+CameraDataset loadCameraDataset(
+    const std::filesystem::path& source,
+    const std::filesystem::path& cacheDir =
+        cacheDirectory() / "cameras");
@@ -0,0 +1,398 @@
+#include "CompactSplats.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "ThreadPool.h"
+
+namespace {
+
+using Section = CompactSplatFile::Section;
+
+constexpr std::array<char, 4> kMagic = {'C', 'S', 'P', 'L'};
+constexpr uint32_t kFileVersion = 1;
+constexpr size_t kChunkSplats = CompactSplatFile::kChunkSplats;
+constexpr size_t kChunkFloats = CompactSplatFile::kChunkFloats;
+
+// Offsets of the ranges within a chunk's floats.
+constexpr size_t kPosMin = 0;
+constexpr size_t kPosMax = 3;
+constexpr size_t kLogScaleMin = 6;
+constexpr size_t kLogScaleMax = 9;
+constexpr size_t kColorMin = 12;
+constexpr size_t kColorMax = 15;
+constexpr size_t kShRestRange = 18;
+
+// Smallest-three components lie within +-1/sqrt(2).
+constexpr float kSqrt2 = std::numbers::sqrt2_v<float>;
+
+struct FileHeader {
+  std::array<char, 4> magic = kMagic;
+  uint32_t fileVersion = kFileVersion;
+  uint64_t count = 0;
+  uint32_t shDegree = 0;
+  uint32_t chunkSplats = kChunkSplats;
+  std::array<uint64_t, Section::kSectionCount> offsets{};
+  std::array<uint64_t, Section::kSectionCount> sizes{};
+};
+
+size_t alignUp(size_t value) {
+  constexpr size_t kAlign = CompactSplatFile::kSectionAlignment;
+  return (value + kAlign - 1) / kAlign * kAlign;
+}
+
+// Bytes in each section for `count` splats of `degree`.
+std::array<size_t, Section::kSectionCount> sectionSizes(size_t count,
+                                                        int degree) {
+  const size_t chunks = (count + kChunkSplats - 1) / kChunkSplats;
+  return {
+      chunks * kChunkFloats * sizeof(float),
+      count * sizeof(uint32_t),
+      count * sizeof(uint32_t),
+      count * sizeof(uint32_t),
+      count * sizeof(uint32_t),
+      count * CompactSplatFile::shRestStride(degree),
+  };
+}
+
+// --- Encoding ---------------------------------------------------------------
+
+uint32_t quantize(float value, float lo, float hi, uint32_t maxCode) {
+  const float t = hi > lo ? (value - lo) / (hi - lo) : 0.0f;
+  return static_cast<uint32_t>(
+      std::lround(std::clamp(t, 0.0f, 1.0f) * static_cast<float>(maxCode)));
+}
+
+// x:11 y:10 z:11, x in the top bits.
+uint32_t pack111011(const float* v, const float* lo, const float* hi) {
+  return quantize(v[0], lo[0], hi[0], 2047) << 21 |
+         quantize(v[1], lo[1], hi[1], 1023) << 11 |
+         quantize(v[2], lo[2], hi[2], 2047);
+}
+
+uint32_t packRotation(const float* q) {
+  uint32_t largest = 0;
+  for (uint32_t i = 1; i < 4; ++i) {
+    if (std::abs(q[i]) > std::abs(q[largest])) {
+      largest = i;
+    }
+  }
+  // q and -q are the same rotation; flip so the dropped one is positive.
+  const float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+  uint32_t packed = largest << 30;
+  int shift = 20;
+  for (uint32_t i = 0; i < 4; ++i) {
+    if (i != largest) {
+      packed |= quantize(q[i] * sign, -1.0f / kSqrt2, 1.0f / kSqrt2, 1023)
+                << shift;
+      shift -= 10;
+    }
+  }
+  return packed;
+}
+
+uint8_t quantizeSigned(float value, float range) {
+  const float t = range > 0.0f ? value / range : 0.0f;
+  return static_cast<uint8_t>(
+      std::lround(std::clamp(t, -1.0f, 1.0f) * 127.0f) + 128);
+}
+
+// --- Decoding ---------------------------------------------------------------
+
+float dequantize(uint32_t code, float lo, float hi, uint32_t maxCode) {
+  return lo + (hi - lo) * (static_cast<float>(code) /
+                           static_cast<float>(maxCode));
+}
+
+std::array<float, 3> unpack111011(uint32_t v, const float* lo,
+                                  const float* hi) {
+  return {dequantize(v >> 21, lo[0], hi[0], 2047),
+          dequantize((v >> 11) & 1023, lo[1], hi[1], 1023),
+          dequantize(v & 2047, lo[2], hi[2], 2047)};
+}
+
+std::array<float, 4> unpackRotation(uint32_t packed) {
+  const uint32_t largest = packed >> 30;
+  std::array<float, 4> q{};
+  float sum = 0.0f;
+  int shift = 20;
+  for (uint32_t i = 0; i < 4; ++i) {
+    if (i != largest) {
+      q[i] = dequantize((packed >> shift) & 1023, -1.0f / kSqrt2,
+                        1.0f / kSqrt2, 1023);
+      sum += q[i] * q[i];
+      shift -= 10;
+    }
+  }
+  q[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+  return q;
+}
+
+float dequantizeSigned(uint8_t code, float range) {
+  return static_cast<float>(static_cast<int>(code) - 128) / 127.0f * range;
+}
+
+template <typename T>
+T readAt(std::span<const uint8_t> bytes, size_t index) {
+  T value{};
+  std::memcpy(&value, bytes.data() + index * sizeof(T), sizeof(T));
+  return value;
+}
+
+}  // namespace
+
+CompactSplatFile::CompactSplatFile(const std::filesystem::path& path)
+    : file_(path) {
+  const auto fail = [&](std::string_view what) {
+    return std::runtime_error(
+        fmt::format("Invalid compact splat file: {} ({})", path.string(),
+                    what));
+  };
+
+  const std::span<const uint8_t> bytes = file_.bytes();
+  FileHeader header;
+  if (bytes.size() < sizeof(header)) {
+    throw fail("too short");
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (header.magic != kMagic) {
+    throw fail("bad magic");
+  }
+  if (header.fileVersion != kFileVersion) {
+    throw fail(fmt::format("unsupported version {}", header.fileVersion));
+  }
+  if (header.chunkSplats != kChunkSplats ||
+      header.shDegree > SplatCloud::kMaxShDegree) {
+    throw fail("unsupported layout");
+  }
+
+  count_ = header.count;
+  shDegree_ = static_cast<int>(header.shDegree);
+  const std::array<size_t, kSectionCount> expected =
+      sectionSizes(count_, shDegree_);
+  for (size_t s = 0; s < kSectionCount; ++s) {
+    if (header.sizes[s] != expected[s] || header.offsets[s] > bytes.size() ||
+        bytes.size() - header.offsets[s] < header.sizes[s]) {
+      throw fail("truncated or inconsistent sections");
+    }
+    sections_[s] = bytes.subspan(header.offsets[s], header.sizes[s]);
+  }
+}
+
+std::span<const uint8_t> CompactSplatFile::section(Section section) const {
+  return sections_[section];
+}
+
+size_t CompactSplatFile::shRestStride(int degree) {
+  const size_t restBytes = (SplatCloud::shCoefficients(degree) - 1) * 3;
+  return (restBytes + 3) / 4 * 4;
+}
+
+std::vector<float> CompactSplatFile::decodePositions() const {
+  const std::span<const uint8_t> chunks = section(kChunks);
+  const std::span<const uint8_t> packed = section(kPositions);
+  std::vector<float> positions(count_ * 3);
+  std::array<float, kChunkFloats> bounds{};
+  for (size_t i = 0; i < count_; ++i) {
+    if (i % kChunkSplats == 0) {
+      std::memcpy(bounds.data(),
+                  chunks.data() + i / kChunkSplats * sizeof(bounds),
+                  sizeof(bounds));
+    }
+    const std::array<float, 3> p =
+        unpack111011(readAt<uint32_t>(packed, i), &bounds[kPosMin],
+                     &bounds[kPosMax]);
+    std::copy(p.begin(), p.end(), positions.begin() + i * 3);
+  }
+  return positions;
+}
+
+void CompactSplatFile::decodeChunk(size_t chunk, SplatCloud& cloud,
+                                   size_t first) const {
+  const size_t coeffs = cloud.shCoefficients();
+  const size_t restStride = shRestStride(shDegree_);
+  std::array<float, kChunkFloats> bounds{};
+  std::memcpy(bounds.data(), section(kChunks).data() + chunk * sizeof(bounds),
+              sizeof(bounds));
+  const size_t begin = chunk * kChunkSplats;
+  const size_t end = std::min(begin + kChunkSplats, count_);
+  for (size_t i = begin; i < end; ++i) {
+    const size_t o = first + (i - begin);
+    const std::array<float, 3> p =
+        unpack111011(readAt<uint32_t>(section(kPositions), i),
+                     &bounds[kPosMin], &bounds[kPosMax]);
+    const std::array<float, 3> logScale =
+        unpack111011(readAt<uint32_t>(section(kScales), i),
+                     &bounds[kLogScaleMin], &bounds[kLogScaleMax]);
+    for (size_t c = 0; c < 3; ++c) {
+      cloud.positions[o * 3 + c] = p[c];
+      cloud.scales[o * 3 + c] = std::exp(logScale[c]);
+    }
+
+    const std::array<float, 4> q =
+        unpackRotation(readAt<uint32_t>(section(kRotations), i));
+    std::copy(q.begin(), q.end(), cloud.rotations.begin() + o * 4);
+
+    const auto color = readAt<uint32_t>(section(kColors), i);
+    float* sh = cloud.sh.data() + o * coeffs * 3;
+    for (size_t c = 0; c < 3; ++c) {
+      sh[c] = dequantize((color >> (8 * c)) & 255, bounds[kColorMin + c],
+                         bounds[kColorMax + c], 255);
+    }
+    cloud.opacities[o] = static_cast<float>(color >> 24) / 255.0f;
+
+    const uint8_t* rest = section(kShRest).data() + i * restStride;
+    for (size_t j = 0; j < (coeffs - 1) * 3; ++j) {
+      sh[3 + j] = dequantizeSigned(rest[j], bounds[kShRestRange]);
+    }
+  }
+}
+
+SplatCloud CompactSplatFile::decode(size_t threadCount) const {
+  SplatCloud cloud;
+  cloud.resize(count_, shDegree_);
+  ThreadPool pool(threadCount);
+  std::vector<std::future<void>> tasks;
+  for (size_t chunk = 0; chunk < chunkCount(); ++chunk) {
+    tasks.push_back(pool.submit(
+        [&, chunk]() { decodeChunk(chunk, cloud, chunk * kChunkSplats); }));
+  }
+  for (std::future<void>& task : tasks) {
+    task.get();
+  }
+  return cloud;
+}
+
+SplatCloud CompactSplatFile::decodeChunk(size_t chunk) const {
+  SplatCloud cloud;
+  cloud.resize(chunkSplats(chunk), shDegree_);
+  decodeChunk(chunk, cloud, 0);
+  return cloud;
+}
+
+size_t CompactSplatFile::chunkBytes(size_t chunk) const {
+  return kChunkFloats * sizeof(float) +
+         chunkSplats(chunk) * (4 * sizeof(uint32_t) + shRestStride(shDegree_));
+}
+
+void writeCompactSplats(const std::filesystem::path& path,
+                        const SplatCloud& cloud) {
+  FileHeader header{
+      .count = cloud.count,
+      .shDegree = static_cast<uint32_t>(cloud.shDegree),
+  };
+  header.sizes = sectionSizes(cloud.count, cloud.shDegree);
+  size_t offset = alignUp(sizeof(header));
+  for (size_t s = 0; s < Section::kSectionCount; ++s) {
+    header.offsets[s] = offset;
+    offset = alignUp(offset + header.sizes[s]);
+  }
+
+  std::vector<uint8_t> image(offset);
+  std::memcpy(image.data(), &header, sizeof(header));
+  const auto sectionData = [&](Section s) {
+    return image.data() + header.offsets[s];
+  };
+  const auto writeWord = [&](Section s, size_t index, uint32_t value) {
+    std::memcpy(sectionData(s) + index * sizeof(value), &value,
+                sizeof(value));
+  };
+
+  const std::vector<uint32_t> order = mortonOrder(cloud);
+  const size_t coeffs = cloud.shCoefficients();
+  const size_t restCount = (coeffs - 1) * 3;
+  const size_t restStride = CompactSplatFile::shRestStride(cloud.shDegree);
+  const size_t chunkCount = (cloud.count + kChunkSplats - 1) / kChunkSplats;
+
+  for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+    const size_t begin = chunk * kChunkSplats;
+    const size_t end = std::min(begin + kChunkSplats, cloud.count);
+
+    // Log-scales quantize far better than linear ones; keep them around.
+    std::vector<float> logScales((end - begin) * 3);
+    std::array<float, kChunkFloats> bounds{};
+    for (size_t c = 0; c < 3; ++c) {
+      bounds[kPosMin + c] = bounds[kLogScaleMin + c] = bounds[kColorMin + c] =
+          std::numeric_limits<float>::max();
+      bounds[kPosMax + c] = bounds[kLogScaleMax + c] = bounds[kColorMax + c] =
+          std::numeric_limits<float>::lowest();
+    }
+    for (size_t i = begin; i < end; ++i) {
+      const size_t src = order[i];
+      const float* sh = cloud.sh.data() + src * coeffs * 3;
+      for (size_t c = 0; c < 3; ++c) {
+        const float p = cloud.positions[src * 3 + c];
+        const float s = std::log(std::max(cloud.scales[src * 3 + c], 1e-12f));
+        logScales[(i - begin) * 3 + c] = s;
+        bounds[kPosMin + c] = std::min(bounds[kPosMin + c], p);
+        bounds[kPosMax + c] = std::max(bounds[kPosMax + c], p);
+        bounds[kLogScaleMin + c] = std::min(bounds[kLogScaleMin + c], s);
+        bounds[kLogScaleMax + c] = std::max(bounds[kLogScaleMax + c], s);
+        bounds[kColorMin + c] = std::min(bounds[kColorMin + c], sh[c]);
+        bounds[kColorMax + c] = std::max(bounds[kColorMax + c], sh[c]);
+      }
+      for (size_t j = 0; j < restCount; ++j) {
+        bounds[kShRestRange] =
+            std::max(bounds[kShRestRange], std::abs(sh[3 + j]));
+      }
+    }
+    std::memcpy(sectionData(Section::kChunks) + chunk * sizeof(bounds),
+                bounds.data(), sizeof(bounds));
+
+    for (size_t i = begin; i < end; ++i) {
+      const size_t src = order[i];
+      const float* sh = cloud.sh.data() + src * coeffs * 3;
+      writeWord(Section::kPositions, i,
+                pack111011(&cloud.positions[src * 3], &bounds[kPosMin],
+                           &bounds[kPosMax]));
+      writeWord(Section::kScales, i,
+                pack111011(&logScales[(i - begin) * 3], &bounds[kLogScaleMin],
+                           &bounds[kLogScaleMax]));
+      writeWord(Section::kRotations, i,
+                packRotation(&cloud.rotations[src * 4]));
+
+      uint32_t color =
+          quantize(cloud.opacities[src], 0.0f, 1.0f, 255) << 24;
+      for (size_t c = 0; c < 3; ++c) {
+        color |= quantize(sh[c], bounds[kColorMin + c], bounds[kColorMax + c],
+                          255)
+                 << (8 * c);
+      }
+      writeWord(Section::kColors, i, color);
+
+      uint8_t* rest = sectionData(Section::kShRest) + i * restStride;
+      for (size_t j = 0; j < restCount; ++j) {
+        rest[j] = quantizeSigned(sh[3 + j], bounds[kShRestRange]);
+      }
+    }
+  }
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  out.write(reinterpret_cast<const char*>(image.data()),
+            static_cast<std::streamsize>(image.size()));
+  if (!out) {
+    throw std::runtime_error("Failed to write compact splats: " +
+                             path.string());
+  }
+}
+
+bool isCompactSplatFile(const std::filesystem::path& path) {
+  std::string ext = path.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return ext == ".csplat";
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include "MappedFile.h"
+#include "SplatCloud.h"
+
+// A quantized on-disk splat format (.csplat) that is read by mapping the
+// file and copying its sections straight into GPU buffers; the shaders
+// decode it (see shaders/splat_data.glsl). A degree-3 splat takes 64 bytes:
+// four packed words and 45 SH bytes padded to 48. Each 256-splat chunk adds
+// 80 bytes of bounds, so the file comes to about 64.3 bytes per splat,
+// against 248 for float PLY.
+//
+// Splats are stored in Morton order and grouped into chunks of kChunkSplats
+// spatial neighbours. Each chunk records the ranges its members are
+// quantized against. All values are little-endian, and every section starts
+// on a kSectionAlignment boundary:
+//
+//   chunks     ChunkBounds per chunk (kChunkFloats floats)
+//   positions  uint32 per splat: x:11 y:10 z:11 bits within the chunk bounds
+//   scales     uint32 per splat: log-scales packed like positions
+//   rotations  uint32 per splat: smallest-three quaternion, the index of the
+//              dropped largest component in the top 2 bits, then the other
+//              three components as 10 bits each
+//   colors     uint32 per splat: DC coefficients as r, g, b bytes within the
+//              chunk bounds, opacity in the top byte
+//   shRest     shRestStride() bytes per splat: the higher-order coefficients
+//              as signed bytes scaled by the chunk's shRestRange, in
+//              SplatCloud's [coefficient][channel] order
+class CompactSplatFile {
+ public:
+  enum Section : uint8_t {
+    kChunks,
+    kPositions,
+    kScales,
+    kRotations,
+    kColors,
+    kShRest,
+    kSectionCount,
+  };
+
+  static constexpr size_t kChunkSplats = 256;
+  static constexpr size_t kSectionAlignment = 256;
+  // posMin[3] posMax[3] logScaleMin[3] logScaleMax[3] colorMin[3]
+  // colorMax[3] shRestRange, padded to 16-byte multiples.
+  static constexpr size_t kChunkFloats = 20;
+
+  // Maps and validates `path`; throws std::runtime_error if it is not a
+  // well-formed .csplat file.
+  explicit CompactSplatFile(const std::filesystem::path& path);
+
+  [[nodiscard]] size_t count() const { return count_; }
+  [[nodiscard]] int shDegree() const { return shDegree_; }
+  [[nodiscard]] size_t chunkCount() const {
+    return (count_ + kChunkSplats - 1) / kChunkSplats;
+  }
+  // Splats in `chunk`: kChunkSplats except in the last one.
+  [[nodiscard]] size_t chunkSplats(size_t chunk) const {
+    return std::min(kChunkSplats, count_ - chunk * kChunkSplats);
+  }
+  // Bytes of the file that hold `chunk`.
+  [[nodiscard]] size_t chunkBytes(size_t chunk) const;
+  [[nodiscard]] std::span<const uint8_t> section(Section section) const;
+
+  // Bytes of higher-order SH per splat, padded to whole uint32 words.
+  static size_t shRestStride(int degree);
+
+  // Decodes the splat positions only (e.g. for CPU depth sorting).
+  [[nodiscard]] std::vector<float> decodePositions() const;
+  // Decodes everything back into floats, `threadCount` workers wide
+  // (0 = hardware concurrency).
+  [[nodiscard]] SplatCloud decode(size_t threadCount = 0) const;
+  // Decodes one chunk's splats, for streaming.
+  [[nodiscard]] SplatCloud decodeChunk(size_t chunk) const;
+
+ private:
+  // Decodes `chunk` into cloud splats [first, first + chunkSplats(chunk)).
+  void decodeChunk(size_t chunk, SplatCloud& cloud, size_t first) const;
+
+  MappedFile file_;
+  size_t count_ = 0;
+  int shDegree_ = 0;
+  std::array<std::span<const uint8_t>, kSectionCount> sections_;
+};
+
+// Quantizes `cloud` into a .csplat file. Splats are reordered into Morton
+// order on the way. Throws std::runtime_error if the file cannot be written.
+void writeCompactSplats(const std::filesystem::path& path,
+                        const SplatCloud& cloud);
+
+// True for paths with a .csplat extension.
+bool isCompactSplatFile(const std::filesystem::path& path);
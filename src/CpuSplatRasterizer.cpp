@@ -0,0 +1,817 @@
+#include "CpuSplatRasterizer.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <future>
+#include <numeric>
+#include <stdexcept>
+
+#include "SplatRasterCommon.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPLAT_RASTER_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define SPLAT_RASTER_NEON 1
+#endif
+
+namespace {
+
+using splat_raster::kLowPass;
+using splat_raster::kMaxAlpha;
+using splat_raster::kMinAlpha;
+using splat_raster::kMinTransmittance;
+using splat_raster::kNearPlane;
+using splat_raster::kShC0;
+using splat_raster::kShC1;
+using splat_raster::kShC2;
+using splat_raster::kShC3;
+using splat_raster::kTileSize;
+using splat_raster::Mat3;
+using splat_raster::multiply;
+using splat_raster::transpose;
+
+constexpr uint32_t kTilePixels = kTileSize * kTileSize;
+
+// SplatIndex chunks projected per work item.
+constexpr size_t kChunksPerItem = 16;
+
+// evalSh() in splat_project.glsl, for one channel-interleaved splat.
+Vec3 evalSh(const float* sh, Vec3 dir, int degree) {
+  const auto coeff = [&](size_t i) {
+    return Vec3{sh[i * 3], sh[i * 3 + 1], sh[i * 3 + 2]};
+  };
+  Vec3 result = coeff(0) * kShC0;
+  if (degree > 0) {
+    const float x = dir.x;
+    const float y = dir.y;
+    const float z = dir.z;
+    result = result + (coeff(1) * -y + coeff(2) * z - coeff(3) * x) * kShC1;
+    if (degree > 1) {
+      const float xx = x * x;
+      const float yy = y * y;
+      const float zz = z * z;
+      result = result + coeff(4) * (kShC2[0] * x * y) +
+               coeff(5) * (kShC2[1] * y * z) +
+               coeff(6) * (kShC2[2] * (2.0f * zz - xx - yy)) +
+               coeff(7) * (kShC2[3] * x * z) +
+               coeff(8) * (kShC2[4] * (xx - yy));
+      if (degree > 2) {
+        result = result + coeff(9) * (kShC3[0] * y * (3.0f * xx - yy)) +
+                 coeff(10) * (kShC3[1] * x * y * z) +
+                 coeff(11) * (kShC3[2] * y * (4.0f * zz - xx - yy)) +
+                 coeff(12) *
+                     (kShC3[3] * z * (2.0f * zz - 3.0f * xx - 3.0f * yy)) +
+                 coeff(13) * (kShC3[4] * x * (4.0f * zz - xx - yy)) +
+                 coeff(14) * (kShC3[5] * z * (xx - yy)) +
+                 coeff(15) * (kShC3[6] * x * (xx - 3.0f * yy));
+      }
+    }
+  }
+  return {std::max(result.x + 0.5f, 0.0f), std::max(result.y + 0.5f, 0.0f),
+          std::max(result.z + 0.5f, 0.0f)};
+}
+
+// Per-pixel blend state of one tile, row-major, one array per channel so a
+// pixel row loads straight into vector registers.
+struct alignas(32) TilePixels {
+  std::array<float, kTilePixels> transmittance;
+  std::array<float, kTilePixels> red;
+  std::array<float, kTilePixels> green;
+  std::array<float, kTilePixels> blue;
+  // All ones while the pixel still takes contributions.
+  std::array<uint32_t, kTilePixels> live;
+};
+
+// A splat relative to the tile being blended. dx0/dy0 are the offsets from
+// its centre to the tile's first pixel centre.
+struct BlendSplat {
+  float dx0;
+  float dy0;
+  float conicXX;
+  float conicXY;
+  float conicYY;
+  float opacity;
+  float red;
+  float green;
+  float blue;
+};
+
+// Blends `s` into tile rows [rowBegin, rowEnd), front to back, as
+// tile_raster.comp does per pixel. Returns how many pixels it finished.
+using BlendFn = uint32_t (*)(const BlendSplat& s, uint32_t rowBegin,
+                             uint32_t rowEnd, TilePixels& px);
+
+struct Kernel {
+  const char* isa;
+  BlendFn blend;
+};
+
+// The vector kernels use a Cephes-style exp: a degree-5 polynomial on
+// x - n ln 2, scaled by 2^n through the exponent bits. Inputs are clamped to
+// [-87, 0], all the blend needs, which keeps 2^n a normal float. Relative
+// error is a few ulp, well inside the GPU's own exp().
+constexpr float kExpMin = -87.0f;
+constexpr float kLog2e = 1.44269504088896341f;
+constexpr float kLn2Hi = 0.693359375f;
+constexpr float kLn2Lo = -2.12194440e-4f;
+constexpr std::array<float, 6> kExpPoly = {
+    1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f,
+    4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f};
+
+#ifdef SPLAT_RASTER_X86
+
+// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+
+// SSE2 is part of the x86-64 baseline, so these need no target attribute.
+__m128 exp128(__m128 x) {
+  x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(kExpMin)), _mm_setzero_ps());
+  // Round to nearest, the default MXCSR mode.
+  const __m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(kLog2e)));
+  const __m128 fn = _mm_cvtepi32_ps(n);
+  x = _mm_sub_ps(x, _mm_mul_ps(fn, _mm_set1_ps(kLn2Hi)));
+  x = _mm_sub_ps(x, _mm_mul_ps(fn, _mm_set1_ps(kLn2Lo)));
+  __m128 p = _mm_set1_ps(kExpPoly[0]);
+  for (size_t i = 1; i < kExpPoly.size(); ++i) {
+    p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(kExpPoly[i]));
+  }
+  const __m128 y = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, x), x), x), _mm_set1_ps(1.0f));
+  const __m128i scale =
+      _mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23);
+  return _mm_mul_ps(y, _mm_castsi128_ps(scale));
+}
+
+uint32_t blendSse2(const BlendSplat& s, uint32_t rowBegin, uint32_t rowEnd,
+                   TilePixels& px) {
+  const __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+  const __m128 negHalfXX = _mm_set1_ps(-0.5f * s.conicXX);
+  const __m128 opacity = _mm_set1_ps(s.opacity);
+  const __m128 maxAlpha = _mm_set1_ps(kMaxAlpha);
+  const __m128 minAlpha = _mm_set1_ps(kMinAlpha);
+  const __m128 minT = _mm_set1_ps(kMinTransmittance);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 zero = _mm_setzero_ps();
+  uint32_t finished = 0;
+  for (uint32_t row = rowBegin; row < rowEnd; ++row) {
+    const float dy = s.dy0 + static_cast<float>(row);
+    const __m128 xyDy = _mm_set1_ps(s.conicXY * dy);
+    const __m128 yTerm = _mm_set1_ps(-0.5f * s.conicYY * dy * dy);
+    for (uint32_t col = 0; col < kTileSize; col += 4) {
+      const size_t i = (row * kTileSize) + col;
+      const __m128 live = _mm_load_ps(
+          reinterpret_cast<const float*>(px.live.data() + i));
+      if (_mm_movemask_ps(live) == 0) {
+        continue;
+      }
+      const __m128 dx =
+          _mm_add_ps(lane, _mm_set1_ps(s.dx0 + static_cast<float>(col)));
+      const __m128 power = _mm_add_ps(
+          _mm_mul_ps(dx, _mm_sub_ps(_mm_mul_ps(negHalfXX, dx), xyDy)), yTerm);
+      const __m128 alpha =
+          _mm_min_ps(maxAlpha, _mm_mul_ps(opacity, exp128(power)));
+      const __m128 hit = _mm_and_ps(
+          live, _mm_and_ps(_mm_cmple_ps(power, zero),
+                           _mm_cmpge_ps(alpha, minAlpha)));
+
+      const __m128 t = _mm_load_ps(px.transmittance.data() + i);
+      const __m128 next = _mm_mul_ps(t, _mm_sub_ps(one, alpha));
+      const __m128 finish = _mm_and_ps(hit, _mm_cmplt_ps(next, minT));
+      const __m128 blend = _mm_andnot_ps(finish, hit);
+      const __m128 weight = _mm_and_ps(blend, _mm_mul_ps(alpha, t));
+      _mm_store_ps(px.red.data() + i,
+                   _mm_add_ps(_mm_load_ps(px.red.data() + i),
+                              _mm_mul_ps(_mm_set1_ps(s.red), weight)));
+      _mm_store_ps(px.green.data() + i,
+                   _mm_add_ps(_mm_load_ps(px.green.data() + i),
+                              _mm_mul_ps(_mm_set1_ps(s.green), weight)));
+      _mm_store_ps(px.blue.data() + i,
+                   _mm_add_ps(_mm_load_ps(px.blue.data() + i),
+                              _mm_mul_ps(_mm_set1_ps(s.blue), weight)));
+      _mm_store_ps(px.transmittance.data() + i,
+                   _mm_or_ps(_mm_and_ps(blend, next), _mm_andnot_ps(blend, t)));
+      _mm_store_ps(reinterpret_cast<float*>(px.live.data() + i),
+                   _mm_andnot_ps(finish, live));
+      finished += static_cast<uint32_t>(
+          std::popcount(static_cast<unsigned>(_mm_movemask_ps(finish))));
+    }
+  }
+  return finished;
+}
+
+__attribute__((target("avx2,fma"))) __m256 exp256(__m256 x) {
+  x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(kExpMin)),
+                    _mm256_setzero_ps());
+  const __m256 fn = _mm256_round_ps(
+      _mm256_mul_ps(x, _mm256_set1_ps(kLog2e)),
+      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  x = _mm256_fnmadd_ps(fn, _mm256_set1_ps(kLn2Hi), x);
+  x = _mm256_fnmadd_ps(fn, _mm256_set1_ps(kLn2Lo), x);
+  __m256 p = _mm256_set1_ps(kExpPoly[0]);
+  for (size_t i = 1; i < kExpPoly.size(); ++i) {
+    p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(kExpPoly[i]));
+  }
+  const __m256 y = _mm256_add_ps(
+      _mm256_fmadd_ps(_mm256_mul_ps(p, x), x, x), _mm256_set1_ps(1.0f));
+  const __m256i scale = _mm256_slli_epi32(
+      _mm256_add_epi32(_mm256_cvtps_epi32(fn), _mm256_set1_epi32(127)), 23);
+  return _mm256_mul_ps(y, _mm256_castsi256_ps(scale));
+}
+
+__attribute__((target("avx2,fma"))) uint32_t blendAvx2(const BlendSplat& s,
+                                                       uint32_t rowBegin,
+                                                       uint32_t rowEnd,
+                                                       TilePixels& px) {
+  const __m256 lane =
+      _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+  const __m256 negHalfXX = _mm256_set1_ps(-0.5f * s.conicXX);
+  const __m256 opacity = _mm256_set1_ps(s.opacity);
+  const __m256 maxAlpha = _mm256_set1_ps(kMaxAlpha);
+  const __m256 minAlpha = _mm256_set1_ps(kMinAlpha);
+  const __m256 minT = _mm256_set1_ps(kMinTransmittance);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 red = _mm256_set1_ps(s.red);
+  const __m256 green = _mm256_set1_ps(s.green);
+  const __m256 blue = _mm256_set1_ps(s.blue);
+  uint32_t finished = 0;
+  for (uint32_t row = rowBegin; row < rowEnd; ++row) {
+    const float dy = s.dy0 + static_cast<float>(row);
+    const __m256 xyDy = _mm256_set1_ps(s.conicXY * dy);
+    const __m256 yTerm = _mm256_set1_ps(-0.5f * s.conicYY * dy * dy);
+    for (uint32_t col = 0; col < kTileSize; col += 8) {
+      const size_t i = (row * kTileSize) + col;
+      const __m256 live = _mm256_load_ps(
+          reinterpret_cast<const float*>(px.live.data() + i));
+      if (_mm256_testz_ps(live, live) != 0) {
+        continue;
+      }
+      const __m256 dx = _mm256_add_ps(
+          lane, _mm256_set1_ps(s.dx0 + static_cast<float>(col)));
+      const __m256 power =
+          _mm256_fmadd_ps(dx, _mm256_fmsub_ps(negHalfXX, dx, xyDy), yTerm);
+      const __m256 alpha =
+          _mm256_min_ps(maxAlpha, _mm256_mul_ps(opacity, exp256(power)));
+      const __m256 hit = _mm256_and_ps(
+          live, _mm256_and_ps(_mm256_cmp_ps(power, zero, _CMP_LE_OQ),
+                              _mm256_cmp_ps(alpha, minAlpha, _CMP_GE_OQ)));
+
+      const __m256 t = _mm256_load_ps(px.transmittance.data() + i);
+      const __m256 next = _mm256_mul_ps(t, _mm256_sub_ps(one, alpha));
+      const __m256 finish =
+          _mm256_and_ps(hit, _mm256_cmp_ps(next, minT, _CMP_LT_OQ));
+      const __m256 blend = _mm256_andnot_ps(finish, hit);
+      const __m256 weight = _mm256_and_ps(blend, _mm256_mul_ps(alpha, t));
+      _mm256_store_ps(px.red.data() + i,
+                      _mm256_fmadd_ps(red, weight,
+                                      _mm256_load_ps(px.red.data() + i)));
+      _mm256_store_ps(px.green.data() + i,
+                      _mm256_fmadd_ps(green, weight,
+                                      _mm256_load_ps(px.green.data() + i)));
+      _mm256_store_ps(px.blue.data() + i,
+                      _mm256_fmadd_ps(blue, weight,
+                                      _mm256_load_ps(px.blue.data() + i)));
+      _mm256_store_ps(px.transmittance.data() + i,
+                      _mm256_blendv_ps(t, next, blend));
+      _mm256_store_ps(reinterpret_cast<float*>(px.live.data() + i),
+                      _mm256_andnot_ps(finish, live));
+      finished += static_cast<uint32_t>(
+          std::popcount(static_cast<unsigned>(_mm256_movemask_ps(finish))));
+    }
+  }
+  return finished;
+}
+
+// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+
+Kernel selectKernel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return {"avx2", blendAvx2};
+  }
+  return {"sse2", blendSse2};
+}
+
+#elif defined(SPLAT_RASTER_NEON)
+
+float32x4_t expNeon(float32x4_t x) {
+  x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(kExpMin)), vdupq_n_f32(0.0f));
+  const int32x4_t n = vcvtnq_s32_f32(vmulq_n_f32(x, kLog2e));
+  const float32x4_t fn = vcvtq_f32_s32(n);
+  x = vfmsq_n_f32(x, fn, kLn2Hi);
+  x = vfmsq_n_f32(x, fn, kLn2Lo);
+  float32x4_t p = vdupq_n_f32(kExpPoly[0]);
+  for (size_t i = 1; i < kExpPoly.size(); ++i) {
+    p = vfmaq_f32(vdupq_n_f32(kExpPoly[i]), p, x);
+  }
+  const float32x4_t y =
+      vaddq_f32(vfmaq_f32(x, vmulq_f32(p, x), x), vdupq_n_f32(1.0f));
+  const int32x4_t scale = vshlq_n_s32(vaddq_s32(n, vdupq_n_s32(127)), 23);
+  return vmulq_f32(y, vreinterpretq_f32_s32(scale));
+}
+
+uint32_t blendNeon(const BlendSplat& s, uint32_t rowBegin, uint32_t rowEnd,
+                   TilePixels& px) {
+  const float32x4_t lane = {0.0f, 1.0f, 2.0f, 3.0f};
+  const float negHalfXX = -0.5f * s.conicXX;
+  uint32_t finished = 0;
+  for (uint32_t row = rowBegin; row < rowEnd; ++row) {
+    const float dy = s.dy0 + static_cast<float>(row);
+    const float32x4_t xyDy = vdupq_n_f32(s.conicXY * dy);
+    const float32x4_t yTerm = vdupq_n_f32(-0.5f * s.conicYY * dy * dy);
+    for (uint32_t col = 0; col < kTileSize; col += 4) {
+      const size_t i = (row * kTileSize) + col;
+      const uint32x4_t live = vld1q_u32(px.live.data() + i);
+      if (vmaxvq_u32(live) == 0) {
+        continue;
+      }
+      const float32x4_t dx =
+          vaddq_f32(lane, vdupq_n_f32(s.dx0 + static_cast<float>(col)));
+      const float32x4_t power = vfmaq_f32(
+          yTerm, dx, vsubq_f32(vmulq_n_f32(dx, negHalfXX), xyDy));
+      const float32x4_t alpha = vminq_f32(
+          vdupq_n_f32(kMaxAlpha), vmulq_n_f32(expNeon(power), s.opacity));
+      const uint32x4_t hit = vandq_u32(
+          live, vandq_u32(vcleq_f32(power, vdupq_n_f32(0.0f)),
+                          vcgeq_f32(alpha, vdupq_n_f32(kMinAlpha))));
+
+      const float32x4_t t = vld1q_f32(px.transmittance.data() + i);
+      const float32x4_t next =
+          vmulq_f32(t, vsubq_f32(vdupq_n_f32(1.0f), alpha));
+      const uint32x4_t finish = vandq_u32(
+          hit, vcltq_f32(next, vdupq_n_f32(kMinTransmittance)));
+      const uint32x4_t blend = vbicq_u32(hit, finish);
+      const float32x4_t weight = vreinterpretq_f32_u32(
+          vandq_u32(blend, vreinterpretq_u32_f32(vmulq_f32(alpha, t))));
+      vst1q_f32(px.red.data() + i,
+                vfmaq_n_f32(vld1q_f32(px.red.data() + i), weight, s.red));
+      vst1q_f32(px.green.data() + i,
+                vfmaq_n_f32(vld1q_f32(px.green.data() + i), weight, s.green));
+      vst1q_f32(px.blue.data() + i,
+                vfmaq_n_f32(vld1q_f32(px.blue.data() + i), weight, s.blue));
+      vst1q_f32(px.transmittance.data() + i, vbslq_f32(blend, next, t));
+      vst1q_u32(px.live.data() + i, vbicq_u32(live, finish));
+      finished += vaddvq_u32(vshrq_n_u32(finish, 31));
+    }
+  }
+  return finished;
+}
+
+Kernel selectKernel() {
+  return {"neon", blendNeon};
+}
+
+#else
+
+uint32_t blendScalar(const BlendSplat& s, uint32_t rowBegin, uint32_t rowEnd,
+                     TilePixels& px) {
+  uint32_t finished = 0;
+  for (uint32_t row = rowBegin; row < rowEnd; ++row) {
+    const float dy = s.dy0 + static_cast<float>(row);
+    for (uint32_t col = 0; col < kTileSize; ++col) {
+      const size_t i = (row * kTileSize) + col;
+      if (px.live[i] == 0) {
+        continue;
+      }
+      const float dx = s.dx0 + static_cast<float>(col);
+      const float power =
+          -0.5f * (s.conicXX * dx * dx + s.conicYY * dy * dy) -
+          s.conicXY * dx * dy;
+      if (power > 0.0f) {
+        continue;
+      }
+      const float alpha = std::min(kMaxAlpha, s.opacity * std::exp(power));
+      if (alpha < kMinAlpha) {
+        continue;
+      }
+      const float t = px.transmittance[i];
+      const float next = t * (1.0f - alpha);
+      if (next < kMinTransmittance) {
+        px.live[i] = 0;
+        ++finished;
+        continue;
+      }
+      const float weight = alpha * t;
+      px.red[i] += s.red * weight;
+      px.green[i] += s.green * weight;
+      px.blue[i] += s.blue * weight;
+      px.transmittance[i] = next;
+    }
+  }
+  return finished;
+}
+
+Kernel selectKernel() {
+  return {"scalar", blendScalar};
+}
+
+#endif
+
+const Kernel& kernel() {
+  static const Kernel k = selectKernel();
+  return k;
+}
+
+// Each worker's share of the tiles as a [front, back) range packed into one
+// word, so that the owner popping from the front and thieves splitting off
+// the back agree through a single compare-and-swap.
+class TileQueues {
+ public:
+  TileQueues(size_t workers, uint32_t tileCount) : ranges_(workers) {
+    for (size_t w = 0; w < workers; ++w) {
+      ranges_[w].bounds.store(
+          pack(static_cast<uint32_t>(tileCount * w / workers),
+               static_cast<uint32_t>(tileCount * (w + 1) / workers)),
+          std::memory_order_relaxed);
+    }
+  }
+
+  // Next tile for `worker`: its own first, then half of the first other
+  // worker's remainder it can take. False once every range is empty.
+  bool next(size_t worker, uint32_t& tile) {
+    while (true) {
+      if (pop(ranges_[worker].bounds, tile)) {
+        return true;
+      }
+      if (!steal(worker)) {
+        return false;
+      }
+    }
+  }
+
+ private:
+  struct alignas(64) Range {
+    std::atomic<uint64_t> bounds{0};
+  };
+
+  static uint64_t pack(uint32_t front, uint32_t back) {
+    return (uint64_t{back} << 32) | front;
+  }
+
+  static bool pop(std::atomic<uint64_t>& bounds, uint32_t& tile) {
+    uint64_t current = bounds.load(std::memory_order_relaxed);
+    while (true) {
+      const auto front = static_cast<uint32_t>(current);
+      const auto back = static_cast<uint32_t>(current >> 32);
+      if (front >= back) {
+        return false;
+      }
+      if (bounds.compare_exchange_weak(current, pack(front + 1, back),
+                                       std::memory_order_relaxed)) {
+        tile = front;
+        return true;
+      }
+    }
+  }
+
+  // Moves the back half of another worker's range into `worker`'s own,
+  // which is empty. Tiles in transit are invisible to other thieves, but
+  // they are never lost: the thief blends them.
+  bool steal(size_t worker) {
+    for (size_t k = 1; k < ranges_.size(); ++k) {
+      std::atomic<uint64_t>& victim =
+          ranges_[(worker + k) % ranges_.size()].bounds;
+      uint64_t current = victim.load(std::memory_order_relaxed);
+      while (true) {
+        const auto front = static_cast<uint32_t>(current);
+        const auto back = static_cast<uint32_t>(current >> 32);
+        if (front >= back) {
+          break;
+        }
+        const uint32_t split = back - ((back - front + 1) / 2);
+        if (victim.compare_exchange_weak(current, pack(front, split),
+                                         std::memory_order_relaxed)) {
+          ranges_[worker].bounds.store(pack(split, back),
+                                       std::memory_order_relaxed);
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  std::vector<Range> ranges_;
+};
+
+}  // namespace
+
+CpuSplatRasterizer::CpuSplatRasterizer(size_t threadCount)
+    : pool_(threadCount), arenas_(pool_.size()) {}
+
+const char* CpuSplatRasterizer::isa() {
+  return kernel().isa;
+}
+
+template <typename Fn>
+void CpuSplatRasterizer::runWorkers(Fn&& fn) {
+  std::vector<std::future<void>> done;
+  done.reserve(pool_.size());
+  for (size_t w = 0; w < pool_.size(); ++w) {
+    done.push_back(pool_.submit([&fn, w]() { fn(w); }));
+  }
+  for (std::future<void>& worker : done) {
+    worker.get();
+  }
+}
+
+ImageData CpuSplatRasterizer::render(const SplatCloud& cloud,
+                                     const Camera& camera, VkExtent2D extent,
+                                     int shDegree) {
+  chunks_.resize((cloud.count + SplatIndex::kChunkSplats - 1) /
+                 SplatIndex::kChunkSplats);
+  std::iota(chunks_.begin(), chunks_.end(), 0u);
+  visibleCount_ = cloud.count;
+  return renderChunks(cloud, camera, extent, shDegree);
+}
+
+ImageData CpuSplatRasterizer::render(const SplatCloud& cloud,
+                                     const SplatIndex& index,
+                                     const SplatIndex::Culling& culling,
+                                     const Camera& camera, VkExtent2D extent,
+                                     int shDegree) {
+  if (index.splatCount() != cloud.count) {
+    throw std::invalid_argument("CpuSplatRasterizer: index of another cloud");
+  }
+  visibleCount_ = index.cull(camera, extent, culling, chunks_);
+  return renderChunks(cloud, camera, extent, shDegree);
+}
+
+ImageData CpuSplatRasterizer::renderChunks(const SplatCloud& cloud,
+                                           const Camera& camera,
+                                           VkExtent2D extent, int shDegree) {
+  if (extent.width == 0 || extent.height == 0) {
+    throw std::invalid_argument("CpuSplatRasterizer: empty extent");
+  }
+  tilesX_ = (extent.width + kTileSize - 1) / kTileSize;
+  tilesY_ = (extent.height + kTileSize - 1) / kTileSize;
+
+  project(cloud, camera, extent, shDegree);
+  gather();
+
+  ImageData image;
+  image.width = static_cast<int>(extent.width);
+  image.height = static_cast<int>(extent.height);
+  image.format = PixelFormat::kRgba32Sfloat;
+  image.pixels.resize(size_t{extent.width} * extent.height * 4 *
+                      sizeof(float));
+  rasterize(extent, image);
+  return image;
+}
+
+void CpuSplatRasterizer::project(const SplatCloud& cloud,
+                                 const Camera& camera, VkExtent2D extent,
+                                 int shDegree) {
+  const Mat4 view = camera.view();
+  const Vec3 eye = camera.position();
+  const float focal = camera.focalLength(extent);
+  const float width = static_cast<float>(extent.width);
+  const float height = static_cast<float>(extent.height);
+  const float limitX = 1.3f * 0.5f * width / focal;
+  const float limitY = 1.3f * 0.5f * height / focal;
+  const int degree = std::clamp(shDegree, 0, cloud.shDegree);
+  const size_t coeffs = cloud.shCoefficients();
+  const uint32_t tileCount = tilesX_ * tilesY_;
+
+  Mat3 w{};
+  for (size_t r = 0; r < 3; ++r) {
+    for (size_t c = 0; c < 3; ++c) {
+      w[r][c] = view(static_cast<int>(r), static_cast<int>(c));
+    }
+  }
+
+  projected_.resize(cloud.count);
+  std::atomic<size_t> nextItem{0};
+  runWorkers([&](size_t worker) {
+    Arena& arena = arenas_[worker];
+    arena.instances.clear();
+    arena.tileCounts.assign(tileCount, 0);
+
+    while (true) {
+      const size_t first = nextItem.fetch_add(kChunksPerItem);
+      if (first >= chunks_.size()) {
+        break;
+      }
+      const size_t last = std::min(first + kChunksPerItem, chunks_.size());
+      for (size_t k = first; k < last; ++k) {
+        const size_t begin = size_t{chunks_[k]} * SplatIndex::kChunkSplats;
+        const size_t end =
+            std::min(begin + SplatIndex::kChunkSplats, cloud.count);
+        for (size_t id = begin; id < end; ++id) {
+          const float opacity = cloud.opacities[id];
+          if (opacity < kMinAlpha) {
+            continue;
+          }
+          const Vec3 p{cloud.positions[id * 3], cloud.positions[id * 3 + 1],
+                       cloud.positions[id * 3 + 2]};
+          const Vec3 t{dot(view.row3(0), p) + view(0, 3),
+                       dot(view.row3(1), p) + view(1, 3),
+                       dot(view.row3(2), p) + view(2, 3)};
+          if (t.z < kNearPlane) {
+            continue;
+          }
+
+          // Sigma = R S S^T R^T.
+          const float qr = cloud.rotations[id * 4];
+          const float qx = cloud.rotations[id * 4 + 1];
+          const float qy = cloud.rotations[id * 4 + 2];
+          const float qz = cloud.rotations[id * 4 + 3];
+          const Mat3 rotation = {{
+              {1.0f - 2.0f * (qy * qy + qz * qz), 2.0f * (qx * qy - qr * qz),
+               2.0f * (qx * qz + qr * qy)},
+              {2.0f * (qx * qy + qr * qz), 1.0f - 2.0f * (qx * qx + qz * qz),
+               2.0f * (qy * qz - qr * qx)},
+              {2.0f * (qx * qz - qr * qy), 2.0f * (qy * qz + qr * qx),
+               1.0f - 2.0f * (qx * qx + qy * qy)},
+          }};
+          Mat3 m = rotation;
+          for (size_t r = 0; r < 3; ++r) {
+            for (size_t c = 0; c < 3; ++c) {
+              m[r][c] *= cloud.scales[id * 3 + c];
+            }
+          }
+          const Mat3 sigma = multiply(m, transpose(m));
+
+          // Jacobian of the projection, with the centre clamped just outside
+          // the view so splats at grazing angles don't explode.
+          const float invZ = 1.0f / t.z;
+          const float tx = std::clamp(t.x * invZ, -limitX, limitX) * t.z;
+          const float ty = std::clamp(t.y * invZ, -limitY, limitY) * t.z;
+          const Mat3 jacobian = {{
+              {focal * invZ, 0.0f, -focal * tx * invZ * invZ},
+              {0.0f, focal * invZ, -focal * ty * invZ * invZ},
+              {0.0f, 0.0f, 0.0f},
+          }};
+          const Mat3 tw = multiply(jacobian, w);
+          const Mat3 cov = multiply(multiply(tw, sigma), transpose(tw));
+
+          // Low-pass filter: every splat covers at least about a pixel.
+          const float a = cov[0][0] + kLowPass;
+          const float b = cov[0][1];
+          const float c = cov[1][1] + kLowPass;
+          const float det = a * c - b * b;
+          if (det <= 0.0f) {
+            continue;
+          }
+          const float mid = 0.5f * (a + c);
+          const float lambda = mid + std::sqrt(std::max(0.1f, mid * mid - det));
+          const float radius = std::ceil(3.0f * std::sqrt(lambda));
+          const float cx = focal * t.x * invZ + 0.5f * width;
+          const float cy = focal * t.y * invZ + 0.5f * height;
+          if (cx + radius < 0.0f || cy + radius < 0.0f ||
+              cx - radius > width || cy - radius > height) {
+            continue;
+          }
+
+          const auto tileRange = [](float lo, float hi, uint32_t tiles) {
+            const float size = static_cast<float>(kTileSize);
+            const float limit = static_cast<float>(tiles);
+            return std::array<uint32_t, 2>{
+                static_cast<uint32_t>(
+                    std::clamp(std::floor(lo / size), 0.0f, limit)),
+                static_cast<uint32_t>(
+                    std::clamp(std::ceil(hi / size), 0.0f, limit))};
+          };
+          const auto xs = tileRange(cx - radius, cx + radius, tilesX_);
+          const auto ys = tileRange(cy - radius, cy + radius, tilesY_);
+          if (xs[0] >= xs[1] || ys[0] >= ys[1]) {
+            continue;
+          }
+
+          const Vec3 color = evalSh(&cloud.sh[id * coeffs * 3],
+                                    normalize(p - eye), degree);
+          // Peak power along a pixel row dy from the centre is
+          // -dy^2 / (2 cov_yy); rows below log(kMinAlpha / opacity) blend
+          // nothing. A pixel of slack covers rounding.
+          const float cutoff = std::log(kMinAlpha / opacity);
+          const float reach = std::sqrt(-2.0f * cutoff * c) + 1.0f;
+          projected_[id] = Projected{
+              .centerX = cx,
+              .centerY = cy,
+              .conicXX = c / det,
+              .conicXY = -b / det,
+              .conicYY = a / det,
+              .opacity = opacity,
+              .red = color.x,
+              .green = color.y,
+              .blue = color.z,
+              .depth = t.z,
+              .reach = reach,
+          };
+
+          for (uint32_t y = ys[0]; y < ys[1]; ++y) {
+            for (uint32_t x = xs[0]; x < xs[1]; ++x) {
+              const uint32_t tile = y * tilesX_ + x;
+              arena.instances.push_back({tile, static_cast<uint32_t>(id)});
+              ++arena.tileCounts[tile];
+            }
+          }
+        }
+      }
+    }
+  });
+}
+
+void CpuSplatRasterizer::gather() {
+  // Tile-major offsets, each tile's run split between the workers in order;
+  // every arena's counts become its write cursors.
+  const uint32_t tileCount = tilesX_ * tilesY_;
+  tileOffsets_.resize(size_t{tileCount} + 1);
+  uint32_t total = 0;
+  for (uint32_t tile = 0; tile < tileCount; ++tile) {
+    tileOffsets_[tile] = total;
+    for (Arena& arena : arenas_) {
+      const uint32_t count = arena.tileCounts[tile];
+      arena.tileCounts[tile] = total;
+      total += count;
+    }
+  }
+  tileOffsets_[tileCount] = total;
+  instanceCount_ = total;
+
+  keys_.resize(total);
+  runWorkers([&](size_t worker) {
+    Arena& arena = arenas_[worker];
+    for (const Instance& instance : arena.instances) {
+      // Depths are positive, so their bits sort like the floats.
+      const uint32_t depthBits =
+          std::bit_cast<uint32_t>(projected_[instance.splat].depth);
+      keys_[arena.tileCounts[instance.tile]++] =
+          (uint64_t{depthBits} << 32) | instance.splat;
+    }
+  });
+}
+
+void CpuSplatRasterizer::rasterize(VkExtent2D extent, ImageData& image) {
+  const BlendFn blend = kernel().blend;
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  auto* out = reinterpret_cast<float*>(image.pixels.data());
+  TileQueues queues(pool_.size(), tilesX_ * tilesY_);
+
+  runWorkers([&](size_t worker) {
+    TilePixels px;
+    uint32_t tile = 0;
+    while (queues.next(worker, tile)) {
+      const uint32_t x0 = (tile % tilesX_) * kTileSize;
+      const uint32_t y0 = (tile / tilesX_) * kTileSize;
+      const uint32_t cols = std::min(kTileSize, extent.width - x0);
+      const uint32_t rows = std::min(kTileSize, extent.height - y0);
+
+      px.transmittance.fill(1.0f);
+      px.red.fill(0.0f);
+      px.green.fill(0.0f);
+      px.blue.fill(0.0f);
+      for (uint32_t i = 0; i < kTilePixels; ++i) {
+        const bool inside = i / kTileSize < rows && i % kTileSize < cols;
+        px.live[i] = inside ? ~0u : 0u;
+      }
+      uint32_t live = rows * cols;
+
+      // Front to back; ties fall back to the splat index, so the output
+      // does not depend on how projection was split between workers.
+      const auto first = keys_.begin() + tileOffsets_[tile];
+      const auto last = keys_.begin() + tileOffsets_[tile + 1];
+      std::sort(first, last);
+      const float originX = static_cast<float>(x0) + 0.5f;
+      const float originY = static_cast<float>(y0) + 0.5f;
+      for (auto key = first; key != last && live > 0; ++key) {
+        const Projected& p = projected_[static_cast<uint32_t>(*key)];
+        const float top = p.centerY - p.reach - originY;
+        const float bottom = p.centerY + p.reach - originY;
+        if (bottom < 0.0f || top >= static_cast<float>(rows)) {
+          continue;
+        }
+        const auto rowBegin =
+            static_cast<uint32_t>(std::max(std::ceil(top), 0.0f));
+        const auto rowEnd = static_cast<uint32_t>(
+            std::min(std::floor(bottom) + 1.0f, static_cast<float>(rows)));
+        const BlendSplat s{
+            .dx0 = originX - p.centerX,
+            .dy0 = originY - p.centerY,
+            .conicXX = p.conicXX,
+            .conicXY = p.conicXY,
+            .conicYY = p.conicYY,
+            .opacity = p.opacity,
+            .red = p.red,
+            .green = p.green,
+            .blue = p.blue,
+        };
+        live -= blend(s, rowBegin, rowEnd, px);
+      }
+
+      for (uint32_t row = 0; row < rows; ++row) {
+        float* dst = out + ((size_t{y0 + row} * extent.width + x0) * 4);
+        for (uint32_t col = 0; col < cols; ++col) {
+          const size_t i = (row * kTileSize) + col;
+          dst[col * 4] = px.red[i];
+          dst[col * 4 + 1] = px.green[i];
+          dst[col * 4 + 2] = px.blue[i];
+          dst[col * 4 + 3] = 1.0f - px.transmittance[i];
+        }
+      }
+    }
+  });
+}
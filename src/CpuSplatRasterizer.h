@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Camera.h"
+#include "ImageIO.h"
+#include "SplatCloud.h"
+#include "SplatIndex.h"
+#include "ThreadPool.h"
+
+// Renders a SplatCloud without a GPU, with the same semantics as
+// TileSplatLayer: splat_project.glsl's projection and tile_raster.comp's
+// front-to-back blending over 16x16 tiles. It is the reference the Vulkan
+// paths are checked against, and a renderer for machines with no graphics
+// hardware. Each render():
+//
+//   1. projects the splats in parallel chunks, optionally only those a
+//      SplatIndex keeps; every worker appends one (tile, splat) instance per
+//      tile a splat touches to its own arena;
+//   2. gathers the arenas into per-tile lists;
+//   3. blends the tiles, each worker draining its own share of them and then
+//      stealing half of whatever another worker has left. A tile's list is
+//      sorted front to back first, and each splat's falloff is evaluated a
+//      pixel row at a time with SIMD (AVX2, SSE2, NEON or scalar).
+//
+// Results match the GPU's to within its half-float colour storage.
+class CpuSplatRasterizer {
+ public:
+  // A threadCount of 0 uses std::thread::hardware_concurrency().
+  explicit CpuSplatRasterizer(size_t threadCount = 0);
+
+  // Renders `cloud` as `camera` sees it at `extent`, evaluating SH bands up
+  // to `shDegree`. The result is RGBA32F with premultiplied colour and
+  // coverage in alpha, like TileSplatLayer's storage image, and can be
+  // handed straight to ImageLayer or writeImage().
+  [[nodiscard]] ImageData render(const SplatCloud& cloud, const Camera& camera,
+                                 VkExtent2D extent,
+                                 int shDegree = SplatCloud::kMaxShDegree);
+  // As above, but only the chunks `index` (built from `cloud`) keeps under
+  // `culling` are projected.
+  [[nodiscard]] ImageData render(const SplatCloud& cloud,
+                                 const SplatIndex& index,
+                                 const SplatIndex::Culling& culling,
+                                 const Camera& camera, VkExtent2D extent,
+                                 int shDegree = SplatCloud::kMaxShDegree);
+
+  // Splats that survived culling, and splat-tile overlaps, in the last
+  // render().
+  [[nodiscard]] size_t lastVisibleCount() const { return visibleCount_; }
+  [[nodiscard]] size_t lastInstanceCount() const { return instanceCount_; }
+  [[nodiscard]] size_t threadCount() const { return pool_.size(); }
+
+  // Name of the instruction set the blend kernel dispatches to.
+  static const char* isa();
+
+ private:
+  // A splat as projected for the current view; what the blend needs.
+  struct Projected {
+    float centerX;
+    float centerY;
+    float conicXX;
+    float conicXY;
+    float conicYY;
+    float opacity;
+    float red;
+    float green;
+    float blue;
+    float depth;
+    // Pixels from the centre, vertically, past which every alpha is below
+    // the blend cutoff.
+    float reach;
+  };
+
+  // One splat-tile overlap.
+  struct Instance {
+    uint32_t tile;
+    uint32_t splat;
+  };
+
+  // A worker's scratch for binning. It grows to the largest frame seen and
+  // is reused, so steady-state frames don't allocate.
+  struct Arena {
+    std::vector<Instance> instances;
+    // Instances per tile; turned into write cursors by gather().
+    std::vector<uint32_t> tileCounts;
+  };
+
+  // Runs fn(worker) once on every pool thread and waits for all of them.
+  template <typename Fn>
+  void runWorkers(Fn&& fn);
+
+  ImageData renderChunks(const SplatCloud& cloud, const Camera& camera,
+                         VkExtent2D extent, int shDegree);
+  // Projects the splats of chunks_ (SplatIndex chunks).
+  void project(const SplatCloud& cloud, const Camera& camera,
+               VkExtent2D extent, int shDegree);
+  void gather();
+  void rasterize(VkExtent2D extent, ImageData& image);
+
+  ThreadPool pool_;
+  std::vector<Arena> arenas_;
+  std::vector<uint32_t> chunks_;
+  std::vector<Projected> projected_;
+  // Per tile, (depth bits << 32 | splat) keys; tile t's run starts at
+  // tileOffsets_[t].
+  std::vector<uint64_t> keys_;
+  std::vector<uint32_t> tileOffsets_;
+  uint32_t tilesX_ = 0;
+  uint32_t tilesY_ = 0;
+  size_t visibleCount_ = 0;
+  size_t instanceCount_ = 0;
+};
@@ -0,0 +1,147 @@
+#include "DatasetLoader.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <deque>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace {
+
+bool hasWildcard(std::string_view s) {
+  return s.find_first_of("*?") != std::string_view::npos;
+}
+
+// Matches '*' (any run of characters) and '?' (any single character).
+bool wildcardMatch(std::string_view pattern, std::string_view name) {
+  size_t p = 0;
+  size_t n = 0;
+  size_t starP = std::string_view::npos;
+  size_t starN = 0;
+  while (n < name.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+      ++p;
+      ++n;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      starP = p++;
+      starN = n;
+    } else if (starP != std::string_view::npos) {
+      p = starP + 1;
+      n = ++starN;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') {
+    ++p;
+  }
+  return p == pattern.size();
+}
+
+bool isImageFile(const std::filesystem::path& path) {
+  static constexpr std::array<std::string_view, 9> kExtensions = {
+      ".png", ".jpg", ".jpeg", ".exr", ".tif", ".tiff", ".bmp", ".tga", ".hdr"};
+
+  std::string ext = path.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return std::find(kExtensions.begin(), kExtensions.end(), ext) !=
+         kExtensions.end();
+}
+
+}  // namespace
+
+DatasetLoader::DatasetLoader(const std::filesystem::path& source)
+    : DatasetLoader(source, Options{}) {}
+
+DatasetLoader::DatasetLoader(const std::filesystem::path& source,
+                             const Options& options)
+    : paths_(resolve(source)),
+      pool_(options.threadCount),
+      maxInFlight_(options.maxInFlight != 0 ? options.maxInFlight
+                                            : 2 * pool_.size()),
+      format_(options.format) {}
+
+DatasetLoader::DatasetLoader(std::vector<std::filesystem::path> paths,
+                             const Options& options)
+    : paths_(std::move(paths)),
+      pool_(options.threadCount),
+      maxInFlight_(options.maxInFlight != 0 ? options.maxInFlight
+                                            : 2 * pool_.size()),
+      format_(options.format) {}
+
+bool DatasetLoader::isDatasetSource(const std::filesystem::path& source) {
+  return hasWildcard(source.filename().string()) ||
+         std::filesystem::is_directory(source);
+}
+
+std::vector<std::filesystem::path> DatasetLoader::resolve(
+    const std::filesystem::path& source) {
+  std::vector<std::filesystem::path> paths;
+
+  const std::string pattern = source.filename().string();
+  if (hasWildcard(pattern)) {
+    const auto dir =
+        source.has_parent_path() ? source.parent_path() : ".";
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+      if (entry.is_regular_file() &&
+          wildcardMatch(pattern, entry.path().filename().string())) {
+        paths.push_back(entry.path());
+      }
+    }
+  } else if (std::filesystem::is_directory(source)) {
+    for (const auto& entry : std::filesystem::directory_iterator(source)) {
+      if (entry.is_regular_file() && isImageFile(entry.path())) {
+        paths.push_back(entry.path());
+      }
+    }
+  } else {
+    paths.push_back(source);
+  }
+
+  if (paths.empty()) {
+    throw std::runtime_error(
+        fmt::format("No images found for dataset: {}", source.string()));
+  }
+
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+void DatasetLoader::forEach(
+    const std::function<void(size_t, ImageData&&)>& fn) {
+  std::deque<std::future<ImageData>> inFlight;
+  size_t next = 0;
+
+  const auto schedule = [&]() {
+    while (next < paths_.size() && inFlight.size() < maxInFlight_) {
+      inFlight.push_back(
+          pool_.submit([path = paths_[next], format = format_]() {
+            return loadImage(path, format);
+          }));
+      ++next;
+    }
+  };
+
+  // Topped up only once `fn` has returned, so the image it holds counts
+  // against maxInFlight_ too.
+  for (size_t i = 0; i < paths_.size(); ++i) {
+    schedule();
+    ImageData image = inFlight.front().get();
+    inFlight.pop_front();
+    fn(i, std::move(image));
+  }
+}
+
+std::vector<ImageData> DatasetLoader::loadAll() {
+  std::vector<ImageData> images(paths_.size());
+  forEach([&](size_t i, ImageData&& image) { images[i] = std::move(image); });
+  return images;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "ImageIO.h"
+#include "ThreadPool.h"
+
+// Decodes a sequence of images (e.g. the views of a capture set) on a worker
+// pool. Images are delivered strictly in path order while at most
+// maxInFlight decoded images are held at any one time.
+class DatasetLoader {
+ public:
+  struct Options {
+    size_t threadCount = 0;  // 0 = hardware concurrency
+    size_t maxInFlight = 0;  // 0 = twice the thread count
+    std::optional<PixelFormat> format;  // unset = keep source precision
+  };
+
+  // `source` is a directory (all image files in it), a glob whose filename
+  // part contains '*' or '?' (e.g. "data/*.png"), or a single image file.
+  explicit DatasetLoader(const std::filesystem::path& source);
+  DatasetLoader(const std::filesystem::path& source, const Options& options);
+  // Loads exactly `paths`, in their given order, e.g. the images of a
+  // CameraDataset so that image i is taken by its frame i.
+  DatasetLoader(std::vector<std::filesystem::path> paths,
+                const Options& options);
+
+  [[nodiscard]] const std::vector<std::filesystem::path>& paths() const {
+    return paths_;
+  }
+  [[nodiscard]] size_t size() const { return paths_.size(); }
+
+  void forEach(const std::function<void(size_t, ImageData&&)>& fn);
+  std::vector<ImageData> loadAll();
+
+  static bool isDatasetSource(const std::filesystem::path& source);
+  static std::vector<std::filesystem::path> resolve(
+      const std::filesystem::path& source);
+
+ private:
+  std::vector<std::filesystem::path> paths_;
+  ThreadPool pool_;
+  size_t maxInFlight_ = 0;
+  std::optional<PixelFormat> format_;
+};
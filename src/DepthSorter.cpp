@@ -0,0 +1,91 @@
+#include "DepthSorter.h"
+
+#include <array>
+#include <bit>
+#include <numeric>
+#include <utility>
+
+namespace {
+
+constexpr int kRadixBits = 8;
+constexpr size_t kBuckets = size_t{1} << kRadixBits;
+
+// Maps a float to an unsigned key with the same ordering, then flips it so
+// that larger depths come first.
+uint32_t farthestFirstKey(float depth) {
+  const auto bits = std::bit_cast<uint32_t>(depth);
+  const uint32_t ascending =
+      (bits & 0x80000000u) != 0 ? ~bits : bits | 0x80000000u;
+  return ~ascending;
+}
+
+}  // namespace
+
+void DepthSorter::sort(std::span<const float> positions, Vec3 forward,
+                       std::vector<uint32_t>& order) {
+  const size_t count = positions.size() / 3;
+  order.resize(count);
+  keys_.resize(count);
+  // dot(p - eye, forward) differs from dot(p, forward) by a constant.
+  for (size_t i = 0; i < count; ++i) {
+    const Vec3 p{positions[i * 3], positions[(i * 3) + 1],
+                 positions[(i * 3) + 2]};
+    keys_[i] = farthestFirstKey(dot(p, forward));
+  }
+  std::iota(order.begin(), order.end(), 0u);
+  radixSort(order);
+}
+
+void DepthSorter::sort(std::span<const float> positions, Vec3 forward,
+                       std::span<const uint32_t> subset,
+                       std::vector<uint32_t>& order) {
+  order.assign(subset.begin(), subset.end());
+  keys_.resize(order.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    const size_t id = order[i];
+    const Vec3 p{positions[id * 3], positions[(id * 3) + 1],
+                 positions[(id * 3) + 2]};
+    keys_[i] = farthestFirstKey(dot(p, forward));
+  }
+  radixSort(order);
+}
+
+void DepthSorter::radixSort(std::vector<uint32_t>& order) {
+  const size_t count = order.size();
+  if (count == 0) {
+    return;
+  }
+  scratchKeys_.resize(count);
+  scratchValues_.resize(count);
+
+  std::vector<uint32_t>* keys = &keys_;
+  std::vector<uint32_t>* values = &order;
+  std::vector<uint32_t>* outKeys = &scratchKeys_;
+  std::vector<uint32_t>* outValues = &scratchValues_;
+
+  for (int shift = 0; shift < 32; shift += kRadixBits) {
+    std::array<size_t, kBuckets> offsets{};
+    for (const uint32_t key : *keys) {
+      ++offsets[(key >> shift) & (kBuckets - 1)];
+    }
+    // Every key shares this digit: the pass would be a plain copy.
+    if (offsets[((*keys)[0] >> shift) & (kBuckets - 1)] == count) {
+      continue;
+    }
+    std::exclusive_scan(offsets.begin(), offsets.end(), offsets.begin(),
+                        size_t{0});
+
+    for (size_t i = 0; i < count; ++i) {
+      const uint32_t key = (*keys)[i];
+      const size_t dst = offsets[(key >> shift) & (kBuckets - 1)]++;
+      (*outKeys)[dst] = key;
+      (*outValues)[dst] = (*values)[i];
+    }
+    std::swap(keys, outKeys);
+    std::swap(values, outValues);
+  }
+
+  if (values != &order) {
+    order.swap(*values);
+  }
+}
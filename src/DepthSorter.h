@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Math.h"
+
+// Orders splats back to front along a view direction: an LSD radix sort over
+// 32-bit depth keys, linear in the splat count. Scratch memory is kept
+// between calls, so steady-state sorting does not allocate.
+class DepthSorter {
+ public:
+  // Fills `order` with indices into `positions` (xyz triplets), farthest
+  // along the view direction `forward` first. The eye position does not
+  // change the order, so it is not needed.
+  void sort(std::span<const float> positions, Vec3 forward,
+            std::vector<uint32_t>& order);
+  // As above, but orders only the splats listed in `subset`.
+  void sort(std::span<const float> positions, Vec3 forward,
+            std::span<const uint32_t> subset, std::vector<uint32_t>& order);
+
+ private:
+  // Sorts `order` by keys_, both already filled in.
+  void radixSort(std::vector<uint32_t>& order);
+
+  std::vector<uint32_t> keys_;
+  std::vector<uint32_t> scratchKeys_;
+  std::vector<uint32_t> scratchValues_;
+};
@@ -0,0 +1,787 @@
+#include "DifferentiableSplatRasterizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <future>
+#include <stdexcept>
+
+#include "SplatIndex.h"
+#include "SplatRasterCommon.h"
+
+namespace {
+
+using splat_raster::kLowPass;
+using splat_raster::kMaxAlpha;
+using splat_raster::kMinAlpha;
+using splat_raster::kMinTransmittance;
+using splat_raster::kNearPlane;
+using splat_raster::kShC0;
+using splat_raster::kShC1;
+using splat_raster::kShC2;
+using splat_raster::kShC3;
+using splat_raster::kTileSize;
+using splat_raster::Mat3;
+using splat_raster::multiply;
+using splat_raster::transpose;
+
+constexpr size_t kMaxShCoefficients =
+    SplatCloud::shCoefficients(SplatCloud::kMaxShDegree);
+
+// Splats projected per work item.
+constexpr size_t kSplatsPerItem = SplatIndex::kChunkSplats * 16;
+
+using ShBasis = std::array<float, kMaxShCoefficients>;
+
+// The SH basis functions evalSh() weighs the coefficients by, for the
+// first shCoefficients(degree) of them.
+void shBasis(Vec3 dir, int degree, ShBasis& basis) {
+  const float x = dir.x;
+  const float y = dir.y;
+  const float z = dir.z;
+  basis[0] = kShC0;
+  if (degree > 0) {
+    basis[1] = -kShC1 * y;
+    basis[2] = kShC1 * z;
+    basis[3] = -kShC1 * x;
+  }
+  if (degree > 1) {
+    const float xx = x * x;
+    const float yy = y * y;
+    const float zz = z * z;
+    basis[4] = kShC2[0] * x * y;
+    basis[5] = kShC2[1] * y * z;
+    basis[6] = kShC2[2] * (2.0f * zz - xx - yy);
+    basis[7] = kShC2[3] * x * z;
+    basis[8] = kShC2[4] * (xx - yy);
+    if (degree > 2) {
+      basis[9] = kShC3[0] * y * (3.0f * xx - yy);
+      basis[10] = kShC3[1] * x * y * z;
+      basis[11] = kShC3[2] * y * (4.0f * zz - xx - yy);
+      basis[12] = kShC3[3] * z * (2.0f * zz - 3.0f * xx - 3.0f * yy);
+      basis[13] = kShC3[4] * x * (4.0f * zz - xx - yy);
+      basis[14] = kShC3[5] * z * (xx - yy);
+      basis[15] = kShC3[6] * x * (xx - 3.0f * yy);
+    }
+  }
+}
+
+// Gradients of the shBasis() functions with respect to the direction.
+void shBasisGradient(Vec3 dir, int degree, std::array<Vec3, 16>& gradient) {
+  const float x = dir.x;
+  const float y = dir.y;
+  const float z = dir.z;
+  gradient[0] = {};
+  if (degree > 0) {
+    gradient[1] = {0.0f, -kShC1, 0.0f};
+    gradient[2] = {0.0f, 0.0f, kShC1};
+    gradient[3] = {-kShC1, 0.0f, 0.0f};
+  }
+  if (degree > 1) {
+    gradient[4] = Vec3{y, x, 0.0f} * kShC2[0];
+    gradient[5] = Vec3{0.0f, z, y} * kShC2[1];
+    gradient[6] = Vec3{-2.0f * x, -2.0f * y, 4.0f * z} * kShC2[2];
+    gradient[7] = Vec3{z, 0.0f, x} * kShC2[3];
+    gradient[8] = Vec3{2.0f * x, -2.0f * y, 0.0f} * kShC2[4];
+    if (degree > 2) {
+      const float xx = x * x;
+      const float yy = y * y;
+      const float zz = z * z;
+      gradient[9] = Vec3{6.0f * x * y, 3.0f * (xx - yy), 0.0f} * kShC3[0];
+      gradient[10] = Vec3{y * z, x * z, x * y} * kShC3[1];
+      gradient[11] =
+          Vec3{-2.0f * x * y, 4.0f * zz - xx - 3.0f * yy, 8.0f * y * z} *
+          kShC3[2];
+      gradient[12] = Vec3{-6.0f * x * z, -6.0f * y * z,
+                          6.0f * zz - 3.0f * xx - 3.0f * yy} *
+                     kShC3[3];
+      gradient[13] =
+          Vec3{4.0f * zz - 3.0f * xx - yy, -2.0f * x * y, 8.0f * x * z} *
+          kShC3[4];
+      gradient[14] = Vec3{2.0f * x * z, -2.0f * y * z, xx - yy} * kShC3[5];
+      gradient[15] = Vec3{3.0f * (xx - yy), -6.0f * x * y, 0.0f} * kShC3[6];
+    }
+  }
+}
+
+Mat3 rotationMatrix(const float* q) {
+  const float r = q[0];
+  const float x = q[1];
+  const float y = q[2];
+  const float z = q[3];
+  return {{
+      {1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y - r * z),
+       2.0f * (x * z + r * y)},
+      {2.0f * (x * y + r * z), 1.0f - 2.0f * (x * x + z * z),
+       2.0f * (y * z - r * x)},
+      {2.0f * (x * z - r * y), 2.0f * (y * z + r * x),
+       1.0f - 2.0f * (x * x + y * y)},
+  }};
+}
+
+// Everything the projection of one splat computes on the way to its screen
+// footprint; the backward pass recomputes it rather than storing it.
+struct Projection {
+  Vec3 t;           // camera space
+  float tx = 0.0f;  // t.x and t.y clamped to just outside the view
+  float ty = 0.0f;
+  bool clampedX = false;
+  bool clampedY = false;
+  Mat3 rotation{};
+  Mat3 m{};  // rotation * scales
+  Mat3 sigma{};
+  // The first two rows of the Jacobian times the view rotation; the third
+  // stays zero.
+  Mat3 tw{};
+  float a = 0.0f;  // low-passed 2D covariance xx xy yy
+  float b = 0.0f;
+  float c = 0.0f;
+  float det = 0.0f;
+};
+
+struct ViewTerms {
+  Mat3 w{};
+  Vec3 translation;
+  Vec3 eye;
+  float focalX = 0.0f;
+  float focalY = 0.0f;
+  float width = 0.0f;
+  float height = 0.0f;
+  float limitX = 0.0f;
+  float limitY = 0.0f;
+};
+
+ViewTerms viewTerms(const DifferentiableSplatRasterizer::View& view) {
+  ViewTerms v;
+  for (size_t r = 0; r < 3; ++r) {
+    for (size_t c = 0; c < 3; ++c) {
+      v.w[r][c] = view.view(static_cast<int>(r), static_cast<int>(c));
+    }
+  }
+  v.translation = {view.view(0, 3), view.view(1, 3), view.view(2, 3)};
+  // eye = -W^T translation.
+  const Vec3 t = v.translation;
+  v.eye = {-(v.w[0][0] * t.x + v.w[1][0] * t.y + v.w[2][0] * t.z),
+           -(v.w[0][1] * t.x + v.w[1][1] * t.y + v.w[2][1] * t.z),
+           -(v.w[0][2] * t.x + v.w[1][2] * t.y + v.w[2][2] * t.z)};
+  v.focalX = view.focalX;
+  v.focalY = view.focalY;
+  v.width = static_cast<float>(view.extent.width);
+  v.height = static_cast<float>(view.extent.height);
+  v.limitX = 1.3f * 0.5f * v.width / v.focalX;
+  v.limitY = 1.3f * 0.5f * v.height / v.focalY;
+  return v;
+}
+
+Vec3 splatPosition(const SplatCloud& cloud, size_t id) {
+  return {cloud.positions[id * 3], cloud.positions[id * 3 + 1],
+          cloud.positions[id * 3 + 2]};
+}
+
+// False if the splat is behind the near plane or degenerate.
+bool projectSplat(const SplatCloud& cloud, size_t id, const ViewTerms& v,
+                  Projection& p) {
+  const Vec3 pos = splatPosition(cloud, id);
+  p.t = {v.w[0][0] * pos.x + v.w[0][1] * pos.y + v.w[0][2] * pos.z +
+             v.translation.x,
+         v.w[1][0] * pos.x + v.w[1][1] * pos.y + v.w[1][2] * pos.z +
+             v.translation.y,
+         v.w[2][0] * pos.x + v.w[2][1] * pos.y + v.w[2][2] * pos.z +
+             v.translation.z};
+  if (p.t.z < kNearPlane) {
+    return false;
+  }
+
+  p.rotation = rotationMatrix(&cloud.rotations[id * 4]);
+  p.m = p.rotation;
+  for (size_t r = 0; r < 3; ++r) {
+    for (size_t c = 0; c < 3; ++c) {
+      p.m[r][c] *= cloud.scales[id * 3 + c];
+    }
+  }
+  p.sigma = multiply(p.m, transpose(p.m));
+
+  const float invZ = 1.0f / p.t.z;
+  const float u = p.t.x * invZ;
+  const float v2 = p.t.y * invZ;
+  p.clampedX = u < -v.limitX || u > v.limitX;
+  p.clampedY = v2 < -v.limitY || v2 > v.limitY;
+  p.tx = std::clamp(u, -v.limitX, v.limitX) * p.t.z;
+  p.ty = std::clamp(v2, -v.limitY, v.limitY) * p.t.z;
+  const Mat3 jacobian = {{
+      {v.focalX * invZ, 0.0f, -v.focalX * p.tx * invZ * invZ},
+      {0.0f, v.focalY * invZ, -v.focalY * p.ty * invZ * invZ},
+      {0.0f, 0.0f, 0.0f},
+  }};
+  p.tw = multiply(jacobian, v.w);
+  const Mat3 cov = multiply(multiply(p.tw, p.sigma), transpose(p.tw));
+  p.a = cov[0][0] + kLowPass;
+  p.b = cov[0][1];
+  p.c = cov[1][1] + kLowPass;
+  p.det = p.a * p.c - p.b * p.b;
+  return p.det > 0.0f;
+}
+
+}  // namespace
+
+void SplatGradients::resize(size_t splatCount, int degree) {
+  count = splatCount;
+  shDegree = degree;
+  const auto fill = [&](std::vector<float>& values, size_t perSplat) {
+    values.assign(splatCount * perSplat, 0.0f);
+  };
+  fill(positions, 3);
+  fill(covariances, 6);
+  fill(scales, 3);
+  fill(rotations, 4);
+  fill(opacities, 1);
+  fill(sh, SplatCloud::shCoefficients(degree) * 3);
+  fill(screenPositions, 2);
+}
+
+DifferentiableSplatRasterizer::View DifferentiableSplatRasterizer::viewOf(
+    const Camera& camera, VkExtent2D extent) {
+  const float focal = camera.focalLength(extent);
+  return View{
+      .view = camera.view(),
+      .focalX = focal,
+      .focalY = focal,
+      .extent = extent,
+  };
+}
+
+DifferentiableSplatRasterizer::DifferentiableSplatRasterizer(
+    size_t threadCount)
+    : pool_(threadCount),
+      arenas_(pool_.size()),
+      screenGradients_(pool_.size()) {}
+
+template <typename Fn>
+void DifferentiableSplatRasterizer::runWorkers(Fn&& fn) {
+  std::vector<std::future<void>> done;
+  done.reserve(pool_.size());
+  for (size_t w = 0; w < pool_.size(); ++w) {
+    done.push_back(pool_.submit([&fn, w]() { fn(w); }));
+  }
+  for (std::future<void>& worker : done) {
+    worker.get();
+  }
+}
+
+ImageData DifferentiableSplatRasterizer::forward(const SplatCloud& cloud,
+                                                 const View& view,
+                                                 int shDegree) {
+  if (view.extent.width == 0 || view.extent.height == 0) {
+    throw std::invalid_argument("DifferentiableSplatRasterizer: empty extent");
+  }
+  cloud_ = &cloud;
+  view_ = view;
+  shDegree_ = std::clamp(shDegree, 0, cloud.shDegree);
+  tilesX_ = (view.extent.width + kTileSize - 1) / kTileSize;
+  tilesY_ = (view.extent.height + kTileSize - 1) / kTileSize;
+
+  project();
+  gather();
+
+  ImageData image;
+  image.width = static_cast<int>(view.extent.width);
+  image.height = static_cast<int>(view.extent.height);
+  image.format = PixelFormat::kRgba32Sfloat;
+  image.pixels.resize(size_t{view.extent.width} * view.extent.height * 4 *
+                      sizeof(float));
+  rasterize(image);
+  return image;
+}
+
+void DifferentiableSplatRasterizer::project() {
+  const SplatCloud& cloud = *cloud_;
+  const ViewTerms v = viewTerms(view_);
+  const size_t coeffs = cloud.shCoefficients();
+  const uint32_t tileCount = tilesX_ * tilesY_;
+
+  projected_.resize(cloud.count);
+  std::atomic<size_t> nextItem{0};
+  std::atomic<size_t> visible{0};
+  runWorkers([&](size_t worker) {
+    Arena& arena = arenas_[worker];
+    arena.instances.clear();
+    arena.tileCounts.assign(tileCount, 0);
+    size_t projectedCount = 0;
+    ShBasis basis{};
+
+    while (true) {
+      const size_t begin = nextItem.fetch_add(kSplatsPerItem);
+      if (begin >= cloud.count) {
+        break;
+      }
+      const size_t end = std::min(begin + kSplatsPerItem, cloud.count);
+      for (size_t id = begin; id < end; ++id) {
+        Projected& out = projected_[id];
+        out.visible = false;
+        const float opacity = cloud.opacities[id];
+        Projection p;
+        if (opacity < kMinAlpha || !projectSplat(cloud, id, v, p)) {
+          continue;
+        }
+
+        const float mid = 0.5f * (p.a + p.c);
+        const float lambda =
+            mid + std::sqrt(std::max(0.1f, mid * mid - p.det));
+        const float radius = std::ceil(3.0f * std::sqrt(lambda));
+        const float invZ = 1.0f / p.t.z;
+        const float cx = v.focalX * p.t.x * invZ + 0.5f * v.width;
+        const float cy = v.focalY * p.t.y * invZ + 0.5f * v.height;
+        const auto tileRange = [](float lo, float hi, uint32_t tiles) {
+          const float size = static_cast<float>(kTileSize);
+          const float limit = static_cast<float>(tiles);
+          return std::array<uint32_t, 2>{
+              static_cast<uint32_t>(
+                  std::clamp(std::floor(lo / size), 0.0f, limit)),
+              static_cast<uint32_t>(
+                  std::clamp(std::ceil(hi / size), 0.0f, limit))};
+        };
+        const auto xs = tileRange(cx - radius, cx + radius, tilesX_);
+        const auto ys = tileRange(cy - radius, cy + radius, tilesY_);
+        if (xs[0] >= xs[1] || ys[0] >= ys[1]) {
+          continue;
+        }
+
+        shBasis(normalize(splatPosition(cloud, id) - v.eye), shDegree_,
+                basis);
+        const float* sh = &cloud.sh[id * coeffs * 3];
+        std::array<float, 3> color{};
+        for (size_t ch = 0; ch < 3; ++ch) {
+          float sum = 0.5f;
+          for (size_t k = 0; k < SplatCloud::shCoefficients(shDegree_);
+               ++k) {
+            sum += basis[k] * sh[k * 3 + ch];
+          }
+          color[ch] = std::max(sum, 0.0f);
+        }
+        out = Projected{
+            .centerX = cx,
+            .centerY = cy,
+            .conicXX = p.c / p.det,
+            .conicXY = -p.b / p.det,
+            .conicYY = p.a / p.det,
+            .opacity = opacity,
+            .color = color,
+            .depth = p.t.z,
+            .visible = true,
+        };
+        ++projectedCount;
+
+        for (uint32_t y = ys[0]; y < ys[1]; ++y) {
+          for (uint32_t x = xs[0]; x < xs[1]; ++x) {
+            const uint32_t tile = y * tilesX_ + x;
+            arena.instances.push_back((uint64_t{tile} << 32) | id);
+            ++arena.tileCounts[tile];
+          }
+        }
+      }
+    }
+    visible += projectedCount;
+  });
+  visibleCount_ = visible;
+}
+
+void DifferentiableSplatRasterizer::gather() {
+  // As CpuSplatRasterizer::gather(): tile-major offsets, each tile's run
+  // split between the workers in order.
+  const uint32_t tileCount = tilesX_ * tilesY_;
+  tileOffsets_.resize(size_t{tileCount} + 1);
+  uint32_t total = 0;
+  for (uint32_t tile = 0; tile < tileCount; ++tile) {
+    tileOffsets_[tile] = total;
+    for (Arena& arena : arenas_) {
+      const uint32_t count = arena.tileCounts[tile];
+      arena.tileCounts[tile] = total;
+      total += count;
+    }
+  }
+  tileOffsets_[tileCount] = total;
+
+  keys_.resize(total);
+  runWorkers([&](size_t worker) {
+    Arena& arena = arenas_[worker];
+    for (const uint64_t instance : arena.instances) {
+      const auto tile = static_cast<uint32_t>(instance >> 32);
+      const auto splat = static_cast<uint32_t>(instance);
+      const uint32_t depthBits =
+          std::bit_cast<uint32_t>(projected_[splat].depth);
+      keys_[arena.tileCounts[tile]++] = (uint64_t{depthBits} << 32) | splat;
+    }
+  });
+}
+
+void DifferentiableSplatRasterizer::rasterize(ImageData& image) {
+  const uint32_t width = view_.extent.width;
+  const uint32_t height = view_.extent.height;
+  finalTransmittance_.resize(size_t{width} * height);
+  visited_.resize(size_t{width} * height);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  auto* out = reinterpret_cast<float*>(image.pixels.data());
+
+  std::atomic<uint32_t> nextTile{0};
+  runWorkers([&](size_t /*worker*/) {
+    const uint32_t tileCount = tilesX_ * tilesY_;
+    for (uint32_t tile = nextTile++; tile < tileCount; tile = nextTile++) {
+      const uint32_t x0 = (tile % tilesX_) * kTileSize;
+      const uint32_t y0 = (tile / tilesX_) * kTileSize;
+      const uint32_t x1 = std::min(x0 + kTileSize, width);
+      const uint32_t y1 = std::min(y0 + kTileSize, height);
+      // Front to back; ties fall back to the splat index, so the output
+      // does not depend on how projection was split between workers.
+      const auto first = keys_.begin() + tileOffsets_[tile];
+      const auto last = keys_.begin() + tileOffsets_[tile + 1];
+      std::sort(first, last);
+      const auto count = static_cast<uint32_t>(last - first);
+
+      for (uint32_t y = y0; y < y1; ++y) {
+        for (uint32_t x = x0; x < x1; ++x) {
+          const float px = static_cast<float>(x) + 0.5f;
+          const float py = static_cast<float>(y) + 0.5f;
+          float t = 1.0f;
+          std::array<float, 3> color{};
+          uint32_t visited = 0;
+          for (uint32_t k = 0; k < count; ++k) {
+            const Projected& s =
+                projected_[static_cast<uint32_t>(first[k])];
+            const float dx = px - s.centerX;
+            const float dy = py - s.centerY;
+            const float power =
+                -0.5f * (s.conicXX * dx * dx + s.conicYY * dy * dy) -
+                s.conicXY * dx * dy;
+            if (power > 0.0f) {
+              continue;
+            }
+            const float alpha =
+                std::min(kMaxAlpha, s.opacity * std::exp(power));
+            if (alpha < kMinAlpha) {
+              continue;
+            }
+            const float next = t * (1.0f - alpha);
+            if (next < kMinTransmittance) {
+              break;
+            }
+            for (size_t ch = 0; ch < 3; ++ch) {
+              color[ch] += s.color[ch] * alpha * t;
+            }
+            t = next;
+            visited = k + 1;
+          }
+
+          const size_t pixel = size_t{y} * width + x;
+          finalTransmittance_[pixel] = t;
+          visited_[pixel] = visited;
+          float* dst = out + pixel * 4;
+          dst[0] = color[0];
+          dst[1] = color[1];
+          dst[2] = color[2];
+          dst[3] = 1.0f - t;
+        }
+      }
+    }
+  });
+}
+
+void DifferentiableSplatRasterizer::backward(
+    std::span<const float> imageGradient, SplatGradients& gradients) {
+  if (cloud_ == nullptr) {
+    throw std::logic_error("DifferentiableSplatRasterizer: backward() before "
+                           "forward()");
+  }
+  if (imageGradient.size() !=
+      size_t{view_.extent.width} * view_.extent.height * 4) {
+    throw std::invalid_argument(
+        "DifferentiableSplatRasterizer: image gradient of the wrong size");
+  }
+  backwardTiles(imageGradient);
+  reduceScreenGradients();
+  backwardProject(gradients);
+}
+
+void DifferentiableSplatRasterizer::backwardTiles(
+    std::span<const float> imageGradient) {
+  const uint32_t width = view_.extent.width;
+  const uint32_t height = view_.extent.height;
+  const size_t splatCount = cloud_->count;
+
+  std::atomic<uint32_t> nextTile{0};
+  runWorkers([&](size_t worker) {
+    std::vector<float>& grad = screenGradients_[worker];
+    grad.assign(splatCount * kScreenGradients, 0.0f);
+
+    const uint32_t tileCount = tilesX_ * tilesY_;
+    for (uint32_t tile = nextTile++; tile < tileCount; tile = nextTile++) {
+      const uint32_t x0 = (tile % tilesX_) * kTileSize;
+      const uint32_t y0 = (tile / tilesX_) * kTileSize;
+      const uint32_t x1 = std::min(x0 + kTileSize, width);
+      const uint32_t y1 = std::min(y0 + kTileSize, height);
+      const auto first = keys_.begin() + tileOffsets_[tile];
+
+      for (uint32_t y = y0; y < y1; ++y) {
+        for (uint32_t x = x0; x < x1; ++x) {
+          const size_t pixel = size_t{y} * width + x;
+          const float* dOut = &imageGradient[pixel * 4];
+          const float finalT = finalTransmittance_[pixel];
+          const float px = static_cast<float>(x) + 0.5f;
+          const float py = static_cast<float>(y) + 0.5f;
+          // Transmittance behind the current splat, and the colour blended
+          // behind it relative to that.
+          float t = finalT;
+          std::array<float, 3> behind{};
+
+          for (uint32_t k = visited_[pixel]; k-- > 0;) {
+            const auto id = static_cast<uint32_t>(first[k]);
+            const Projected& s = projected_[id];
+            const float dx = px - s.centerX;
+            const float dy = py - s.centerY;
+            const float power =
+                -0.5f * (s.conicXX * dx * dx + s.conicYY * dy * dy) -
+                s.conicXY * dx * dy;
+            if (power > 0.0f) {
+              continue;
+            }
+            const float gaussian = std::exp(power);
+            const float alpha = std::min(kMaxAlpha, s.opacity * gaussian);
+            if (alpha < kMinAlpha) {
+              continue;
+            }
+            const float oneMinus = 1.0f - alpha;
+            t /= oneMinus;
+            const float weight = alpha * t;
+
+            float* g = &grad[size_t{id} * kScreenGradients];
+            float dAlpha = dOut[3] * finalT / oneMinus;
+            for (size_t ch = 0; ch < 3; ++ch) {
+              g[6 + ch] += weight * dOut[ch];
+              dAlpha += t * (s.color[ch] - behind[ch]) * dOut[ch];
+              behind[ch] = alpha * s.color[ch] + oneMinus * behind[ch];
+            }
+            // The clamp at kMaxAlpha cuts the opacity and falloff off.
+            if (s.opacity * gaussian > kMaxAlpha) {
+              continue;
+            }
+            g[5] += gaussian * dAlpha;
+            const float dPower = alpha * dAlpha;
+            g[0] += dPower * (s.conicXX * dx + s.conicXY * dy);
+            g[1] += dPower * (s.conicYY * dy + s.conicXY * dx);
+            g[2] += dPower * -0.5f * dx * dx;
+            g[3] += dPower * -dx * dy;
+            g[4] += dPower * -0.5f * dy * dy;
+          }
+        }
+      }
+    }
+  });
+}
+
+void DifferentiableSplatRasterizer::reduceScreenGradients() {
+  // Workers sum disjoint splat ranges across every buffer into the first.
+  const size_t floats = cloud_->count * kScreenGradients;
+  const size_t workers = pool_.size();
+  runWorkers([&](size_t worker) {
+    const size_t begin = floats * worker / workers;
+    const size_t end = floats * (worker + 1) / workers;
+    float* sum = screenGradients_[0].data();
+    for (size_t w = 1; w < workers; ++w) {
+      const float* part = screenGradients_[w].data();
+      for (size_t i = begin; i < end; ++i) {
+        sum[i] += part[i];
+      }
+    }
+  });
+}
+
+void DifferentiableSplatRasterizer::backwardProject(
+    SplatGradients& gradients) {
+  const SplatCloud& cloud = *cloud_;
+  const ViewTerms v = viewTerms(view_);
+  const size_t coeffs = cloud.shCoefficients();
+  const size_t usedCoeffs = SplatCloud::shCoefficients(shDegree_);
+  gradients.resize(cloud.count, cloud.shDegree);
+  const std::vector<float>& screen = screenGradients_[0];
+
+  std::atomic<size_t> nextItem{0};
+  runWorkers([&](size_t /*worker*/) {
+    ShBasis basis{};
+    std::array<Vec3, 16> basisGradient{};
+    while (true) {
+      const size_t begin = nextItem.fetch_add(kSplatsPerItem);
+      if (begin >= cloud.count) {
+        break;
+      }
+      const size_t end = std::min(begin + kSplatsPerItem, cloud.count);
+      for (size_t id = begin; id < end; ++id) {
+        if (!projected_[id].visible) {
+          continue;
+        }
+        const float* g = &screen[id * kScreenGradients];
+        Projection p;
+        projectSplat(cloud, id, v, p);
+        const float invZ = 1.0f / p.t.z;
+        const float invZ2 = invZ * invZ;
+        Vec3 dT;  // camera-space position
+
+        // Centre.
+        gradients.screenPositions[id * 2] = g[0];
+        gradients.screenPositions[id * 2 + 1] = g[1];
+        dT.x += g[0] * v.focalX * invZ;
+        dT.y += g[1] * v.focalY * invZ;
+        dT.z -= (g[0] * v.focalX * p.t.x + g[1] * v.focalY * p.t.y) * invZ2;
+
+        // Conic -> low-passed 2D covariance [[a, b], [b, c]].
+        const float invDet = 1.0f / p.det;
+        const float invDet2 = invDet * invDet;
+        const float dA = g[2];
+        const float dB = g[3];
+        const float dC = g[4];
+        const float da = -dA * p.c * p.c * invDet2 +
+                         dB * p.b * p.c * invDet2 +
+                         dC * (invDet - p.a * p.c * invDet2);
+        const float db = 2.0f * dA * p.b * p.c * invDet2 -
+                         dB * (invDet + 2.0f * p.b * p.b * invDet2) +
+                         2.0f * dC * p.a * p.b * invDet2;
+        const float dc = dA * (invDet - p.a * p.c * invDet2) +
+                         dB * p.a * p.b * invDet2 -
+                         dC * p.a * p.a * invDet2;
+        // Symmetric, so b's gradient splits over both of its elements.
+        const Mat3 dCov = {{
+            {da, 0.5f * db, 0.0f},
+            {0.5f * db, dc, 0.0f},
+            {0.0f, 0.0f, 0.0f},
+        }};
+
+        // cov = TW sigma TW^T.
+        const Mat3 dSigma = multiply(multiply(transpose(p.tw), dCov), p.tw);
+        float* dCov3 = &gradients.covariances[id * 6];
+        dCov3[0] = dSigma[0][0];
+        dCov3[1] = 2.0f * dSigma[0][1];
+        dCov3[2] = 2.0f * dSigma[0][2];
+        dCov3[3] = dSigma[1][1];
+        dCov3[4] = 2.0f * dSigma[1][2];
+        dCov3[5] = dSigma[2][2];
+        Mat3 dTw = multiply(multiply(dCov, p.tw), p.sigma);
+        for (auto& row : dTw) {
+          for (float& value : row) {
+            value *= 2.0f;
+          }
+        }
+        // TW = J W, and only J depends on the position.
+        const Mat3 dJ = multiply(dTw, transpose(v.w));
+        dT.z -= (dJ[0][0] * v.focalX + dJ[1][1] * v.focalY) * invZ2;
+        if (p.clampedX) {
+          dT.z += dJ[0][2] * v.focalX * p.tx * invZ2 * invZ;
+        } else {
+          dT.x -= dJ[0][2] * v.focalX * invZ2;
+          dT.z += 2.0f * dJ[0][2] * v.focalX * p.tx * invZ2 * invZ;
+        }
+        if (p.clampedY) {
+          dT.z += dJ[1][2] * v.focalY * p.ty * invZ2 * invZ;
+        } else {
+          dT.y -= dJ[1][2] * v.focalY * invZ2;
+          dT.z += 2.0f * dJ[1][2] * v.focalY * p.ty * invZ2 * invZ;
+        }
+
+        // sigma = M M^T, M = R S.
+        const Mat3 dM = multiply(dSigma, p.m);
+        const float* scale = &cloud.scales[id * 3];
+        Mat3 dR{};
+        for (size_t c = 0; c < 3; ++c) {
+          float dScale = 0.0f;
+          for (size_t r = 0; r < 3; ++r) {
+            dScale += 2.0f * dM[r][c] * p.rotation[r][c];
+            dR[r][c] = 2.0f * dM[r][c] * scale[c];
+          }
+          gradients.scales[id * 3 + c] = dScale;
+        }
+        const float* q = &cloud.rotations[id * 4];
+        const float qr = q[0];
+        const float qx = q[1];
+        const float qy = q[2];
+        const float qz = q[3];
+        float* dQ = &gradients.rotations[id * 4];
+        dQ[0] = 2.0f * (-qz * dR[0][1] + qy * dR[0][2] + qz * dR[1][0] -
+                        qx * dR[1][2] - qy * dR[2][0] + qx * dR[2][1]);
+        dQ[1] = 2.0f * (qy * dR[0][1] + qz * dR[0][2] + qy * dR[1][0] -
+                        2.0f * qx * dR[1][1] - qr * dR[1][2] +
+                        qz * dR[2][0] + qr * dR[2][1] -
+                        2.0f * qx * dR[2][2]);
+        dQ[2] = 2.0f * (-2.0f * qy * dR[0][0] + qx * dR[0][1] +
+                        qr * dR[0][2] + qx * dR[1][0] + qz * dR[1][2] -
+                        qr * dR[2][0] + qz * dR[2][1] -
+                        2.0f * qy * dR[2][2]);
+        dQ[3] = 2.0f * (-2.0f * qz * dR[0][0] - qr * dR[0][1] +
+                        qx * dR[0][2] + qr * dR[1][0] -
+                        2.0f * qz * dR[1][1] + qy * dR[1][2] +
+                        qx * dR[2][0] + qy * dR[2][1]);
+
+        gradients.opacities[id] = g[5];
+
+        // Colour -> SH coefficients and view direction. Channels clamped
+        // at zero pass nothing back.
+        const Vec3 offset = splatPosition(cloud, id) - v.eye;
+        const float distance = length(offset);
+        const Vec3 dir = offset * (1.0f / distance);
+        shBasis(dir, shDegree_, basis);
+        shBasisGradient(dir, shDegree_, basisGradient);
+        const float* sh = &cloud.sh[id * coeffs * 3];
+        float* dSh = &gradients.sh[id * coeffs * 3];
+        Vec3 dDir;
+        for (size_t ch = 0; ch < 3; ++ch) {
+          if (projected_[id].color[ch] <= 0.0f) {
+            continue;
+          }
+          const float dColor = g[6 + ch];
+          for (size_t k = 0; k < usedCoeffs; ++k) {
+            dSh[k * 3 + ch] = basis[k] * dColor;
+            dDir = dDir + basisGradient[k] * (sh[k * 3 + ch] * dColor);
+          }
+        }
+        const Vec3 dOffset =
+            (dDir - dir * dot(dir, dDir)) * (1.0f / distance);
+
+        // t = W p + translation.
+        float* dPos = &gradients.positions[id * 3];
+        for (size_t c = 0; c < 3; ++c) {
+          dPos[c] = v.w[0][c] * dT.x + v.w[1][c] * dT.y + v.w[2][c] * dT.z;
+        }
+        dPos[0] += dOffset.x;
+        dPos[1] += dOffset.y;
+        dPos[2] += dOffset.z;
+      }
+    }
+  });
+}
+
+double DifferentiableSplatRasterizer::l1Loss(
+    const ImageData& image, const ImageData& target,
+    std::vector<float>& imageGradient) {
+  if (image.format != PixelFormat::kRgba32Sfloat ||
+      target.format != PixelFormat::kRgba32Sfloat ||
+      image.width != target.width || image.height != target.height) {
+    throw std::invalid_argument(
+        "DifferentiableSplatRasterizer: l1Loss needs two RGBA32F images of "
+        "the same size");
+  }
+  const size_t pixels =
+      static_cast<size_t>(image.width) * static_cast<size_t>(image.height);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  const auto* a = reinterpret_cast<const float*>(image.pixels.data());
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  const auto* b = reinterpret_cast<const float*>(target.pixels.data());
+  imageGradient.assign(pixels * 4, 0.0f);
+  const float scale = 1.0f / static_cast<float>(pixels * 3);
+  double sum = 0.0;
+  for (size_t i = 0; i < pixels; ++i) {
+    for (size_t ch = 0; ch < 3; ++ch) {
+      const float diff = a[i * 4 + ch] - b[i * 4 + ch];
+      sum += std::abs(diff);
+      imageGradient[i * 4 + ch] =
+          diff > 0.0f ? scale : (diff < 0.0f ? -scale : 0.0f);
+    }
+  }
+  return sum * scale;
+}
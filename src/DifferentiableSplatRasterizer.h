@@ -0,0 +1,145 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Camera.h"
+#include "ImageIO.h"
+#include "Math.h"
+#include "SplatCloud.h"
+#include "ThreadPool.h"
+
+// Loss gradients with respect to a SplatCloud's attributes, laid out like
+// the cloud's own arrays.
+struct SplatGradients {
+  size_t count = 0;
+  int shDegree = 0;
+  std::vector<float> positions;
+  // The 3D covariance, xx xy xz yy yz zz per splat. Off-diagonal entries
+  // count both of their matrix elements.
+  std::vector<float> covariances;
+  // Through the covariance into the stored standard deviations and
+  // quaternion (as stored, without renormalization).
+  std::vector<float> scales;
+  std::vector<float> rotations;
+  std::vector<float> opacities;
+  std::vector<float> sh;
+  // Of the projected centres, in pixels, x y per splat; what 3DGS
+  // densification thresholds.
+  std::vector<float> screenPositions;
+
+  void resize(size_t splatCount, int degree);
+};
+
+// Forward and backward splat rasterization on the CPU, for training scenes
+// on machines with no GPU. forward() renders like CpuSplatRasterizer: the
+// same projection, 16x16 tiles blended front to back, with the same alpha
+// and transmittance cutoffs, but a plain scalar blend that records what
+// backward() needs: each pixel's final transmittance and last contributor.
+//
+// backward() takes the loss gradient of every output pixel and walks each
+// tile's splats back to front, recovering the transmittance in front of each
+// one instead of storing it. Tiles are spread over the pool; every worker
+// accumulates screen-space gradients (centre, conic, opacity, colour) into
+// its own per-splat buffer, with no atomics, and the buffers are summed
+// once at the end. A final parallel pass over the splats chains those
+// through the projection into the SplatGradients.
+class DifferentiableSplatRasterizer {
+ public:
+  // A pinhole view: world to camera (+x right, +y down, +z forward), and
+  // focal lengths in pixels with the principal point at the image centre.
+  struct View {
+    Mat4 view;
+    float focalX = 0.0f;
+    float focalY = 0.0f;
+    VkExtent2D extent{};
+  };
+
+  [[nodiscard]] static View viewOf(const Camera& camera, VkExtent2D extent);
+
+  // A threadCount of 0 uses std::thread::hardware_concurrency().
+  explicit DifferentiableSplatRasterizer(size_t threadCount = 0);
+
+  // Renders `cloud` from `view` into RGBA32F with premultiplied colour and
+  // coverage in alpha, like CpuSplatRasterizer. `cloud` must stay unchanged
+  // until the matching backward().
+  [[nodiscard]] ImageData forward(const SplatCloud& cloud, const View& view,
+                                  int shDegree = SplatCloud::kMaxShDegree);
+
+  // Back-propagates `imageGradient`, the loss gradient of each float of the
+  // last forward()'s image, into `gradients` (resized to the cloud).
+  void backward(std::span<const float> imageGradient,
+                SplatGradients& gradients);
+
+  // Mean absolute RGB difference between two RGBA32F images of the same
+  // size; fills `imageGradient` with its gradient with respect to `image`.
+  static double l1Loss(const ImageData& image, const ImageData& target,
+                       std::vector<float>& imageGradient);
+
+  // Splats projected, and splat-tile overlaps, in the last forward().
+  [[nodiscard]] size_t lastVisibleCount() const { return visibleCount_; }
+  [[nodiscard]] size_t lastInstanceCount() const { return keys_.size(); }
+  [[nodiscard]] size_t threadCount() const { return pool_.size(); }
+
+ private:
+  // A splat as projected for the current view, with what the backward pass
+  // needs to chain screen-space gradients back to the cloud.
+  struct Projected {
+    float centerX;
+    float centerY;
+    float conicXX;
+    float conicXY;
+    float conicYY;
+    float opacity;
+    std::array<float, 3> color;
+    float depth;
+    bool visible;
+  };
+
+  // Screen-space gradients of one splat: centre x y, conic xx xy yy,
+  // opacity, colour r g b.
+  static constexpr size_t kScreenGradients = 9;
+
+  struct Arena {
+    std::vector<uint64_t> instances;  // tile << 32 | splat
+    std::vector<uint32_t> tileCounts;
+  };
+
+  template <typename Fn>
+  void runWorkers(Fn&& fn);
+
+  void project();
+  void gather();
+  void rasterize(ImageData& image);
+  void backwardTiles(std::span<const float> imageGradient);
+  void reduceScreenGradients();
+  void backwardProject(SplatGradients& gradients);
+
+  ThreadPool pool_;
+  std::vector<Arena> arenas_;
+
+  // State of the last forward().
+  const SplatCloud* cloud_ = nullptr;
+  View view_;
+  int shDegree_ = 0;
+  uint32_t tilesX_ = 0;
+  uint32_t tilesY_ = 0;
+  std::vector<Projected> projected_;
+  // Per tile, (depth bits << 32 | splat) keys sorted front to back; tile
+  // t's run starts at tileOffsets_[t].
+  std::vector<uint64_t> keys_;
+  std::vector<uint32_t> tileOffsets_;
+  // Per pixel: transmittance left after blending, and how many of its
+  // tile's keys were visited, up to and including the last one blended.
+  std::vector<float> finalTransmittance_;
+  std::vector<uint32_t> visited_;
+  size_t visibleCount_ = 0;
+
+  // Per worker, kScreenGradients floats per splat; summed into the first.
+  std::vector<std::vector<float>> screenGradients_;
+};
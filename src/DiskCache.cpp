@@ -0,0 +1,134 @@
+#include "DiskCache.h"
+
+#include <fmt/core.h>
+
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+namespace {
+
+static_assert(std::endian::native == std::endian::little,
+              "Cache files are read and written in host byte order");
+
+struct FileHeader {
+  std::array<char, 4> magic{};
+  uint32_t version = 0;
+  uint64_t key = 0;
+  uint64_t payloadSize = 0;
+};
+static_assert(sizeof(FileHeader) == 24);
+
+std::filesystem::path cacheFilePath(const std::filesystem::path& directory,
+                                    uint64_t key) {
+  return directory / fmt::format("{:016x}.bin", key);
+}
+
+}  // namespace
+
+std::filesystem::path cacheDirectory() {
+  std::filesystem::path base;
+  // NOLINTBEGIN(concurrency-mt-unsafe)
+  if (const char* xdg = std::getenv("XDG_CACHE_HOME");
+      xdg != nullptr && *xdg != '\0') {
+    base = xdg;
+  } else if (const char* home = std::getenv("HOME");
+             home != nullptr && *home != '\0') {
+    base = std::filesystem::path(home) / ".cache";
+  } else {
+    base = std::filesystem::temp_directory_path();
+  }
+  // NOLINTEND(concurrency-mt-unsafe)
+  return base / "splatting_sandbox";
+}
+
+CacheKey::CacheKey(const CacheFormat& format) {
+  add(std::as_bytes(std::span(format.magic)));
+  add(cacheBytes(format.version));
+}
+
+void CacheKey::add(std::span<const std::byte> bytes) {
+  for (const std::byte byte : bytes) {
+    hash_ = (hash_ ^ std::to_integer<uint64_t>(byte)) * 0x100000001b3ULL;
+  }
+}
+
+std::optional<std::vector<uint8_t>> readCacheFile(
+    const std::filesystem::path& directory, const CacheFormat& format,
+    uint64_t key) {
+  const std::filesystem::path path = cacheFilePath(directory, key);
+  std::error_code ec;
+  const uintmax_t fileSize = std::filesystem::file_size(path, ec);
+  std::ifstream in(path, std::ios::binary);
+  if (ec || !in || fileSize < sizeof(FileHeader)) {
+    return std::nullopt;
+  }
+  FileHeader header;
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      header.magic != format.magic || header.version != format.version ||
+      header.key != key ||
+      fileSize != sizeof(header) + header.payloadSize) {
+    return std::nullopt;
+  }
+  std::vector<uint8_t> payload(header.payloadSize);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (!in.read(reinterpret_cast<char*>(payload.data()),
+               static_cast<std::streamsize>(payload.size()))) {
+    return std::nullopt;
+  }
+  return payload;
+}
+
+bool writeCacheFile(const std::filesystem::path& directory,
+                    const CacheFormat& format, uint64_t key,
+                    std::initializer_list<std::span<const std::byte>> parts) {
+  FileHeader header{
+      .magic = format.magic,
+      .version = format.version,
+      .key = key,
+  };
+  for (const std::span<const std::byte> part : parts) {
+    header.payloadSize += part.size();
+  }
+
+  const std::filesystem::path path = cacheFilePath(directory, key);
+  std::filesystem::path tmp = path;
+  tmp += ".tmp";
+  std::error_code ec;
+  std::filesystem::create_directories(directory, ec);
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const std::span<const std::byte> part : parts) {
+      out.write(reinterpret_cast<const char*>(part.data()),
+                static_cast<std::streamsize>(part.size()));
+    }
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+    if (!out) {
+      out.close();
+      std::filesystem::remove(tmp, ec);
+      return false;
+    }
+  }
+  std::filesystem::rename(tmp, path, ec);
+  if (ec) {
+    std::filesystem::remove(tmp, ec);
+    return false;
+  }
+  return true;
+}
+
+bool CachePayloadReader::read(std::span<std::byte> out) {
+  if (out.size() > payload_.size() - offset_) {
+    return false;
+  }
+  if (!out.empty()) {
+    std::memcpy(out.data(), payload_.data() + offset_, out.size());
+    offset_ += out.size();
+  }
+  return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <initializer_list>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// $XDG_CACHE_HOME/splatting_sandbox, falling back to ~/.cache and then the
+// system temp directory. Every on-disk cache lives under it.
+std::filesystem::path cacheDirectory();
+
+// One kind of cache file. Bump `version` whenever what ends up in the file
+// changes.
+struct CacheFormat {
+  std::array<char, 4> magic{};
+  uint32_t version = 0;
+};
+
+// 64-bit FNV-1a over the format and everything a cached result depends on.
+class CacheKey {
+ public:
+  explicit CacheKey(const CacheFormat& format);
+
+  void add(std::span<const std::byte> bytes);
+  void add(std::span<const uint8_t> bytes) { add(std::as_bytes(bytes)); }
+  void add(std::string_view text) { add(std::as_bytes(std::span(text))); }
+  [[nodiscard]] uint64_t value() const { return hash_; }
+
+ private:
+  uint64_t hash_ = 0xcbf29ce484222325ULL;
+};
+
+// Cache files are named by their key under a directory and start with a
+// header holding the format, the key and the payload size, so foreign, stale
+// and truncated files all read as misses.
+std::optional<std::vector<uint8_t>> readCacheFile(
+    const std::filesystem::path& directory, const CacheFormat& format,
+    uint64_t key);
+// Writes `parts` back to back through a temporary file and a rename, so
+// readers only ever see complete files. Returns false on failure, which
+// callers may ignore: a missing cache only costs recomputing the result.
+bool writeCacheFile(const std::filesystem::path& directory,
+                    const CacheFormat& format, uint64_t key,
+                    std::initializer_list<std::span<const std::byte>> parts);
+
+// Sequential reads of trivially copyable values from a cache payload. A read
+// past the end fails and leaves its target untouched.
+class CachePayloadReader {
+ public:
+  explicit CachePayloadReader(std::span<const uint8_t> payload)
+      : payload_(payload) {}
+
+  bool read(std::span<std::byte> out);
+  template <typename T>
+  bool read(T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return read(std::as_writable_bytes(std::span(&value, 1)));
+  }
+  // Fills the vector at its current size.
+  template <typename T>
+  bool read(std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return read(std::as_writable_bytes(std::span(values)));
+  }
+
+  [[nodiscard]] bool atEnd() const { return offset_ == payload_.size(); }
+
+ private:
+  std::span<const uint8_t> payload_;
+  size_t offset_ = 0;
+};
+
+template <typename T>
+std::span<const std::byte> cacheBytes(const T& value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  return std::as_bytes(std::span(&value, 1));
+}
+template <typename T>
+std::span<const std::byte> cacheBytes(const std::vector<T>& values) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  return std::as_bytes(std::span(values));
+}
@@ -0,0 +1,93 @@
+#include "DiskPipelineCache.h"
+
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "DiskCache.h"
+#include "VulkanErrors.h"
+
+namespace {
+
+constexpr CacheFormat kCacheFormat{.magic = {'S', 'S', 'P', 'C'}, .version = 2};
+
+// The blob's own header has no driver version, and a driver update can
+// invalidate it without changing the UUID, so the key includes it.
+uint64_t cacheKey(const VkPhysicalDeviceProperties& props) {
+  CacheKey key(kCacheFormat);
+  key.add(cacheBytes(props.vendorID));
+  key.add(cacheBytes(props.deviceID));
+  key.add(cacheBytes(props.driverVersion));
+  key.add(std::span<const uint8_t>(props.pipelineCacheUUID));
+  return key.value();
+}
+
+// Checks the driver's own header too, so a foreign blob never reaches
+// vkCreatePipelineCache.
+bool blobMatches(const std::vector<uint8_t>& blob,
+                 const VkPhysicalDeviceProperties& props) {
+  VkPipelineCacheHeaderVersionOne header{};
+  if (blob.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, blob.data(), sizeof(header));
+  return header.headerSize >= sizeof(header) &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == props.vendorID &&
+         header.deviceID == props.deviceID &&
+         std::memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID,
+                     VK_UUID_SIZE) == 0;
+}
+
+}  // namespace
+
+DiskPipelineCache::DiskPipelineCache(VkDevice device,
+                                     VkPhysicalDevice physicalDevice,
+                                     std::filesystem::path directory)
+    : device_(device), directory_(std::move(directory)) {
+  vkGetPhysicalDeviceProperties(physicalDevice, &props_);
+
+  std::optional<std::vector<uint8_t>> blob =
+      readCacheFile(directory_, kCacheFormat, cacheKey(props_));
+  if (blob && !blobMatches(*blob, props_)) {
+    blob.reset();
+  }
+  loaded_ = blob.has_value();
+  cache_ = PipelineCache(
+      device_, VkPipelineCacheCreateInfo{
+                   .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+                   .initialDataSize = blob ? blob->size() : 0,
+                   .pInitialData = blob ? blob->data() : nullptr,
+               });
+}
+
+DiskPipelineCache::~DiskPipelineCache() {
+  try {
+    save();
+  } catch (const std::exception&) {
+    // A missing cache only costs compile time on the next launch.
+  }
+}
+
+void DiskPipelineCache::save() const {
+  size_t size = 0;
+  VK_CHECK(vkGetPipelineCacheData(device_, cache_.get(), &size, nullptr));
+  std::vector<uint8_t> blob(size);
+  VK_CHECK(vkGetPipelineCacheData(device_, cache_.get(), &size, blob.data()));
+  blob.resize(size);
+
+  if (!writeCacheFile(directory_, kCacheFormat, cacheKey(props_),
+                      {cacheBytes(blob)})) {
+    throw std::runtime_error(fmt::format(
+        "Failed to write pipeline cache to {}", directory_.string()));
+  }
+}
+
+std::filesystem::path DiskPipelineCache::defaultDirectory() {
+  return cacheDirectory() / "pipelines";
+}
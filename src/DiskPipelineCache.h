@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <filesystem>
+
+#include "VulkanHandles.h"
+
+// Process-wide VkPipelineCache that survives restarts. The file is a
+// DiskCache.h cache file keyed by the GPU (vendor, device, pipelineCacheUUID)
+// and driver version it was produced with, so each device and driver gets
+// its own; a file that fails to parse is dropped and the cache starts empty.
+class DiskPipelineCache {
+ public:
+  DiskPipelineCache(VkDevice device, VkPhysicalDevice physicalDevice,
+                    std::filesystem::path directory = defaultDirectory());
+  // Saves; failures are ignored since the cache is only an optimisation.
+  ~DiskPipelineCache();
+
+  DiskPipelineCache(const DiskPipelineCache&) = delete;
+  DiskPipelineCache& operator=(const DiskPipelineCache&) = delete;
+  DiskPipelineCache(DiskPipelineCache&&) = delete;
+  DiskPipelineCache& operator=(DiskPipelineCache&&) = delete;
+
+  [[nodiscard]] VkPipelineCache get() const { return cache_.get(); }
+  // True when the cache was seeded from a valid file on disk.
+  [[nodiscard]] bool loaded() const { return loaded_; }
+
+  // Writes the current contents to disk, replacing the file atomically.
+  void save() const;
+
+  // cacheDirectory()/pipelines (see DiskCache.h).
+  static std::filesystem::path defaultDirectory();
+
+ private:
+  VkDevice device_ = VK_NULL_HANDLE;
+  VkPhysicalDeviceProperties props_{};
+  std::filesystem::path directory_;
+  PipelineCache cache_;
+  bool loaded_ = false;
+};
@@ -0,0 +1,297 @@
+#include "FrameProfiler.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+#include "VulkanErrors.h"
+
+namespace {
+
+const char* sourceName(FrameProfiler::Source source) {
+  return source == FrameProfiler::Source::kGpu ? "gpu" : "cpu";
+}
+
+// Nearest-rank percentile of an ascending range.
+double percentile(const std::vector<float>& sorted, double fraction) {
+  const auto rank = static_cast<size_t>(
+      std::ceil(fraction * static_cast<double>(sorted.size())));
+  return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+std::string jsonString(std::string_view text) {
+  std::string out = "\"";
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  out += '"';
+  return out;
+}
+
+std::ofstream openForWrite(const std::filesystem::path& path) {
+  std::ofstream out(path, std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("Failed to open profile output: " +
+                             path.string());
+  }
+  return out;
+}
+
+}  // namespace
+
+double FrameProfiler::CpuTimer::lap() {
+  const auto now = std::chrono::steady_clock::now();
+  const double ms =
+      std::chrono::duration<double, std::milli>(now - start_).count();
+  start_ = now;
+  return ms;
+}
+
+FrameProfiler::GpuScope::GpuScope(FrameProfiler* profiler,
+                                  VkCommandBuffer cmd, std::string_view name)
+    : profiler_(profiler),
+      cmd_(cmd),
+      scope_(profiler != nullptr ? profiler->beginGpuScope(cmd, name)
+                                 : kNoScope) {}
+
+FrameProfiler::GpuScope::~GpuScope() {
+  if (profiler_ != nullptr) {
+    profiler_->endGpuScope(cmd_, scope_);
+  }
+}
+
+FrameProfiler::FrameProfiler(VkDevice device, VkPhysicalDevice physicalDevice,
+                             uint32_t queueFamily, uint32_t framesInFlight,
+                             size_t history)
+    : device_(device), history_(std::max<size_t>(history, 1)) {
+  slotScopes_.resize(framesInFlight);
+
+  VkPhysicalDeviceProperties props{};
+  vkGetPhysicalDeviceProperties(physicalDevice, &props);
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount,
+                                           nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount,
+                                           families.data());
+
+  const uint32_t validBits = families.at(queueFamily).timestampValidBits;
+  if (validBits == 0) {
+    return;
+  }
+  if (validBits < 64) {
+    timestampMask_ = (uint64_t{1} << validBits) - 1;
+  }
+  nsPerTick_ = props.limits.timestampPeriod;
+
+  pool_ = QueryPool(device_, VkQueryPoolCreateInfo{
+                                 .sType =
+                                     VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                                 .queryType = VK_QUERY_TYPE_TIMESTAMP,
+                                 .queryCount = firstQuery(framesInFlight),
+                             });
+}
+
+void FrameProfiler::collect(uint32_t frameIndex) {
+  std::vector<std::string>& scopes = slotScopes_[frameIndex];
+  if (scopes.empty()) {
+    return;
+  }
+
+  // Each query yields {timestamp, availability}. A scope left open never
+  // wrote its end query, so availability is checked instead of waiting.
+  const auto queryCount = static_cast<uint32_t>(scopes.size() * 2);
+  std::vector<uint64_t> results(size_t{queryCount} * 2);
+  const VkResult result = vkGetQueryPoolResults(
+      device_, pool_.get(), firstQuery(frameIndex), queryCount,
+      results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+  if (result != VK_NOT_READY) {
+    VK_CHECK(result);
+  }
+
+  std::vector<std::pair<std::string_view, double>> totals;
+  for (size_t i = 0; i < scopes.size(); ++i) {
+    const uint64_t* begin = &results[i * 4];
+    const uint64_t* end = begin + 2;
+    if (begin[1] == 0 || end[1] == 0) {
+      continue;
+    }
+    const uint64_t ticks = (end[0] - begin[0]) & timestampMask_;
+    const double ms = static_cast<double>(ticks) * nsPerTick_ * 1e-6;
+
+    auto it = std::find_if(totals.begin(), totals.end(), [&](const auto& t) {
+      return t.first == scopes[i];
+    });
+    if (it == totals.end()) {
+      totals.emplace_back(scopes[i], ms);
+    } else {
+      it->second += ms;
+    }
+  }
+  for (const auto& [name, ms] : totals) {
+    addSample(name, Source::kGpu, ms);
+  }
+  scopes.clear();
+}
+
+void FrameProfiler::beginFrame(uint32_t frameIndex, VkCommandBuffer cmd) {
+  currentSlot_ = frameIndex;
+  slotScopes_[frameIndex].clear();
+  if (gpuTimingSupported()) {
+    vkCmdResetQueryPool(cmd, pool_.get(), firstQuery(frameIndex),
+                        kMaxGpuScopes * 2);
+  }
+}
+
+uint32_t FrameProfiler::beginGpuScope(VkCommandBuffer cmd,
+                                      std::string_view name) {
+  std::vector<std::string>& scopes = slotScopes_[currentSlot_];
+  if (!gpuTimingSupported() || scopes.size() >= kMaxGpuScopes) {
+    return kNoScope;
+  }
+
+  const auto scope = static_cast<uint32_t>(scopes.size());
+  scopes.emplace_back(name);
+  vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool_.get(),
+                      firstQuery(currentSlot_) + (scope * 2));
+  return scope;
+}
+
+void FrameProfiler::endGpuScope(VkCommandBuffer cmd, uint32_t scope) {
+  if (scope == kNoScope) {
+    return;
+  }
+  vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool_.get(),
+                      firstQuery(currentSlot_) + (scope * 2) + 1);
+}
+
+void FrameProfiler::addCpuSample(std::string_view name, double milliseconds) {
+  addSample(name, Source::kCpu, milliseconds);
+}
+
+void FrameProfiler::addSample(std::string_view name, Source source,
+                              double milliseconds) {
+  Metric& m = metric(name, source);
+  if (m.ring.size() < history_) {
+    m.ring.push_back(static_cast<float>(milliseconds));
+  } else {
+    m.ring[m.next] = static_cast<float>(milliseconds);
+  }
+  m.next = (m.next + 1) % history_;
+  ++m.count;
+}
+
+FrameProfiler::Metric& FrameProfiler::metric(std::string_view name,
+                                             Source source) {
+  for (Metric& m : metrics_) {
+    if (m.source == source && m.name == name) {
+      return m;
+    }
+  }
+  return metrics_.emplace_back(Metric{.name = std::string(name),
+                                      .source = source});
+}
+
+const FrameProfiler::Metric* FrameProfiler::findMetric(std::string_view name,
+                                                       Source source) const {
+  for (const Metric& m : metrics_) {
+    if (m.source == source && m.name == name) {
+      return &m;
+    }
+  }
+  return nullptr;
+}
+
+std::vector<float> FrameProfiler::ordered(const Metric& metric) {
+  std::vector<float> out = metric.ring;
+  if (metric.count > metric.ring.size()) {
+    // The ring has wrapped: `next` is the oldest sample.
+    std::rotate(out.begin(),
+                out.begin() + static_cast<std::ptrdiff_t>(metric.next),
+                out.end());
+  }
+  return out;
+}
+
+FrameProfiler::Summary FrameProfiler::summarize(const Metric& metric) {
+  Summary summary{
+      .name = metric.name,
+      .source = metric.source,
+      .count = metric.ring.size(),
+  };
+  if (metric.ring.empty()) {
+    return summary;
+  }
+
+  std::vector<float> sorted = metric.ring;
+  std::sort(sorted.begin(), sorted.end());
+  summary.mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) /
+                 static_cast<double>(sorted.size());
+  summary.p50 = percentile(sorted, 0.50);
+  summary.p95 = percentile(sorted, 0.95);
+  summary.p99 = percentile(sorted, 0.99);
+  summary.max = sorted.back();
+  return summary;
+}
+
+std::vector<FrameProfiler::Summary> FrameProfiler::summaries() const {
+  std::vector<Summary> out;
+  out.reserve(metrics_.size());
+  for (const Metric& m : metrics_) {
+    out.push_back(summarize(m));
+  }
+  return out;
+}
+
+std::vector<float> FrameProfiler::samples(std::string_view name,
+                                          Source source) const {
+  const Metric* m = findMetric(name, source);
+  return m != nullptr ? ordered(*m) : std::vector<float>{};
+}
+
+void FrameProfiler::writeCsv(const std::filesystem::path& path) const {
+  std::ofstream out = openForWrite(path);
+  out << "source,metric,samples,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+  for (const Summary& s : summaries()) {
+    out << fmt::format("{},{},{},{:.4f},{:.4f},{:.4f},{:.4f},{:.4f}\n",
+                       sourceName(s.source), s.name, s.count, s.mean, s.p50,
+                       s.p95, s.p99, s.max);
+  }
+  if (!out) {
+    throw std::runtime_error("Failed to write profile: " + path.string());
+  }
+}
+
+void FrameProfiler::writeJson(const std::filesystem::path& path) const {
+  std::ofstream out = openForWrite(path);
+  out << "{\n  \"metrics\": [";
+  for (size_t i = 0; i < metrics_.size(); ++i) {
+    const Summary s = summarize(metrics_[i]);
+    out << (i == 0 ? "\n" : ",\n");
+    out << fmt::format(
+        "    {{\"source\": \"{}\", \"name\": {}, \"samples\": {}, "
+        "\"mean_ms\": {:.4f}, \"p50_ms\": {:.4f}, \"p95_ms\": {:.4f}, "
+        "\"p99_ms\": {:.4f}, \"max_ms\": {:.4f}, \"history_ms\": [",
+        sourceName(s.source), jsonString(s.name), s.count, s.mean, s.p50,
+        s.p95, s.p99, s.max);
+    const std::vector<float> history = ordered(metrics_[i]);
+    for (size_t j = 0; j < history.size(); ++j) {
+      out << fmt::format("{}{:.4f}", j == 0 ? "" : ", ", history[j]);
+    }
+    out << "]}";
+  }
+  out << "\n  ]\n}\n";
+  if (!out) {
+    throw std::runtime_error("Failed to write profile: " + path.string());
+  }
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "VulkanHandles.h"
+
+// Rolling frame timings: GPU timestamp scopes recorded into each frame's
+// command buffer, and CPU durations reported by the caller. Every metric
+// keeps its last `history` samples, in milliseconds.
+//
+// GPU results are read when the Renderer reuses a frame slot, after its fence
+// has signalled, so collecting them never stalls. Scopes sharing a name within
+// one frame are summed into a single sample.
+class FrameProfiler {
+ public:
+  static constexpr size_t kDefaultHistory = 240;
+  // Per frame; further scopes are dropped.
+  static constexpr uint32_t kMaxGpuScopes = 32;
+
+  enum class Source { kCpu, kGpu };
+
+  struct Summary {
+    std::string name;
+    Source source = Source::kCpu;
+    size_t count = 0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+  };
+
+  // Measures CPU time between laps.
+  class CpuTimer {
+   public:
+    CpuTimer() : start_(std::chrono::steady_clock::now()) {}
+    // Milliseconds since construction or the previous lap.
+    double lap();
+
+   private:
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  // Brackets the commands recorded during its lifetime with a GPU scope.
+  class GpuScope {
+   public:
+    GpuScope(FrameProfiler* profiler, VkCommandBuffer cmd,
+             std::string_view name);
+    ~GpuScope();
+
+    GpuScope(const GpuScope&) = delete;
+    GpuScope& operator=(const GpuScope&) = delete;
+    GpuScope(GpuScope&&) = delete;
+    GpuScope& operator=(GpuScope&&) = delete;
+
+   private:
+    FrameProfiler* profiler_ = nullptr;
+    VkCommandBuffer cmd_ = VK_NULL_HANDLE;
+    uint32_t scope_ = 0;
+  };
+
+  FrameProfiler(VkDevice device, VkPhysicalDevice physicalDevice,
+                uint32_t queueFamily, uint32_t framesInFlight,
+                size_t history = kDefaultHistory);
+
+  FrameProfiler(const FrameProfiler&) = delete;
+  FrameProfiler& operator=(const FrameProfiler&) = delete;
+  FrameProfiler(FrameProfiler&&) = delete;
+  FrameProfiler& operator=(FrameProfiler&&) = delete;
+
+  // Reads back the GPU scopes of the frame last recorded in `frameIndex`.
+  // Its fence must have signalled.
+  void collect(uint32_t frameIndex);
+  // Resets the slot's queries; `cmd` must be outside a render pass.
+  void beginFrame(uint32_t frameIndex, VkCommandBuffer cmd);
+
+  // Returns a handle for endGpuScope().
+  uint32_t beginGpuScope(VkCommandBuffer cmd, std::string_view name);
+  void endGpuScope(VkCommandBuffer cmd, uint32_t scope);
+
+  void addCpuSample(std::string_view name, double milliseconds);
+
+  // False when the graphics queue has no timestamp support; GPU scopes are
+  // then no-ops.
+  [[nodiscard]] bool gpuTimingSupported() const {
+    return pool_.get() != VK_NULL_HANDLE;
+  }
+
+  // One entry per metric, in the order they were first reported.
+  [[nodiscard]] std::vector<Summary> summaries() const;
+  // Retained samples of one metric, oldest first.
+  [[nodiscard]] std::vector<float> samples(std::string_view name,
+                                           Source source) const;
+
+  // The summaries as CSV, one metric per row.
+  void writeCsv(const std::filesystem::path& path) const;
+  // The summaries plus every retained sample as JSON.
+  void writeJson(const std::filesystem::path& path) const;
+
+ private:
+  static constexpr uint32_t kNoScope = UINT32_MAX;
+
+  struct Metric {
+    std::string name;
+    Source source = Source::kCpu;
+    std::vector<float> ring;
+    size_t next = 0;
+    size_t count = 0;
+  };
+
+  Metric& metric(std::string_view name, Source source);
+  [[nodiscard]] const Metric* findMetric(std::string_view name,
+                                         Source source) const;
+  void addSample(std::string_view name, Source source, double milliseconds);
+  [[nodiscard]] uint32_t firstQuery(uint32_t frameIndex) const {
+    return frameIndex * kMaxGpuScopes * 2;
+  }
+  [[nodiscard]] static std::vector<float> ordered(const Metric& metric);
+  [[nodiscard]] static Summary summarize(const Metric& metric);
+
+  VkDevice device_ = VK_NULL_HANDLE;
+  QueryPool pool_;
+  double nsPerTick_ = 1.0;
+  uint64_t timestampMask_ = ~uint64_t{0};
+  size_t history_ = 0;
+
+  // Names of the scopes recorded into each frame slot, in query order.
+  std::vector<std::vector<std::string>> slotScopes_;
+  uint32_t currentSlot_ = 0;
+
+  std::vector<Metric> metrics_;
+};
@@ -0,0 +1,628 @@
+#include "GaussianSplatLayer.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+
+#include "VulkanErrors.h"
+#include "VulkanShaders.h"
+
+#ifndef SHADER_DIR
+#define SHADER_DIR "shaders"
+#endif
+
+namespace {
+
+// Matches PushConstants in splat.vert.
+struct PushConstants {
+  Mat4 view;
+  std::array<float, 2> focal;
+  std::array<float, 2> viewport;
+  std::array<float, 2> tanHalfFov;
+};
+static_assert(sizeof(PushConstants) == 88);
+
+// Matches PushConstants in splat_color.comp.
+struct ColorPushConstants {
+  std::array<float, 4> cameraPos;
+  uint32_t count;
+};
+
+// Matches the constant_ids in splat_project.glsl.
+struct ShSpecialization {
+  uint32_t degree;
+  uint32_t coeffs;
+};
+
+// Matches PushConstants in splat_depth.comp.
+struct DepthPushConstants {
+  std::array<float, 4> forward;
+  uint32_t count;
+};
+
+// local_size_x of splat_color.comp and splat_depth.comp.
+constexpr uint32_t kWorkgroupSize = 256;
+
+// Beside the attributes (see SplatBuffers::shaderBinding).
+constexpr uint32_t kOrderBinding = 5;
+constexpr uint32_t kColorsBinding = 11;
+// Half-float rgb and opacity.
+constexpr VkDeviceSize kColorSize = 8;
+// The depth pass writes the sorter's keys and values instead of the order.
+constexpr uint32_t kKeysBinding = 5;
+constexpr uint32_t kValuesBinding = 7;
+
+// Re-sort once the view direction turns by more than about half a degree.
+constexpr float kResortCosine = 0.99996f;
+
+}  // namespace
+
+GaussianSplatLayer::GaussianSplatLayer(
+    const Renderer::Context& ctx, std::shared_ptr<const SplatBuffers> splats)
+    : PipelineLayerBase(ctx), splats_(std::move(splats)) {
+  if (GpuRadixSort::isSupported(ctx.physicalDevice)) {
+    gpuSort_ = std::make_unique<GpuRadixSort>(
+        ctx, static_cast<uint32_t>(splats_->capacity()), 1);
+  }
+
+  const VkDeviceSize orderSize = splats_->capacity() * sizeof(uint32_t);
+  const VkDeviceSize visibleSize =
+      splats_->index().chunkCount() * sizeof(uint32_t);
+  slots_.resize(ctx.framesInFlight);
+  for (OrderSlot& slot : slots_) {
+    slot.buffer =
+        Buffer(device_, VkBufferCreateInfo{
+                            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                            .size = orderSize,
+                            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                        });
+    // Written by the CPU every sort; device-local when the heap is mappable.
+    slot.memory = ctx.allocator->allocate(
+        slot.buffer.get(),
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    slot.visible =
+        Buffer(device_, VkBufferCreateInfo{
+                            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                            .size = visibleSize,
+                            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                        });
+    slot.visibleMemory = ctx.allocator->allocate(
+        slot.visible.get(),
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+  colors_ = Buffer(device_, VkBufferCreateInfo{
+                                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                                .size = splats_->capacity() * kColorSize,
+                                .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            });
+  colorsMemory_ = ctx.allocator->allocate(colors_.get(),
+                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  createDescriptors(ctx);
+  createPipeline(ctx.swapchainFormat);
+  createColorPipelines();
+  if (gpuSort_) {
+    createDepthPipeline();
+  }
+}
+
+void GaussianSplatLayer::createDescriptors(const Renderer::Context& ctx) {
+  const uint32_t attributeCount = splats_->attributeCount();
+  // The attributes, then `extra`.
+  const auto makeBindings = [&](std::initializer_list<uint32_t> extra,
+                                VkShaderStageFlags stages) {
+    std::vector<VkDescriptorSetLayoutBinding> bindings =
+        splats_->layoutBindings(stages);
+    for (const uint32_t binding : extra) {
+      bindings.push_back({
+          .binding = binding,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .descriptorCount = 1,
+          .stageFlags = stages,
+      });
+    }
+    return bindings;
+  };
+  const std::vector<VkDescriptorSetLayoutBinding> drawBindings =
+      makeBindings({kOrderBinding, kColorsBinding}, VK_SHADER_STAGE_VERTEX_BIT);
+  descriptorSetLayout_ = DescriptorSetLayout(device_, drawBindings);
+  const std::vector<VkDescriptorSetLayoutBinding> colorBindings =
+      makeBindings({kColorsBinding, SplatBuffers::kVisibleChunksBinding},
+                   VK_SHADER_STAGE_COMPUTE_BIT);
+  colorSetLayout_ = DescriptorSetLayout(device_, colorBindings);
+  std::vector<VkDescriptorSetLayoutBinding> depthBindings;
+  if (gpuSort_) {
+    depthBindings = makeBindings(
+        {kKeysBinding, kValuesBinding, SplatBuffers::kVisibleChunksBinding},
+        VK_SHADER_STAGE_COMPUTE_BIT);
+    depthSetLayout_ = DescriptorSetLayout(device_, depthBindings);
+  }
+
+  // One draw set per frame slot, plus the GPU-sorted draw set; then a
+  // colour pass set and a depth pass set per frame slot.
+  const auto slotCount = static_cast<uint32_t>(slots_.size());
+  const uint32_t drawSetCount = slotCount + (gpuSort_ ? 1 : 0);
+  const uint32_t colorSetCount = slotCount;
+  const uint32_t depthSetCount = gpuSort_ ? slotCount : 0;
+  const uint32_t setCount = drawSetCount + colorSetCount + depthSetCount;
+  descriptorPool_ = DescriptorPool(
+      device_, setCount,
+      VkDescriptorPoolSize{
+          .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .descriptorCount =
+              static_cast<uint32_t>(drawSetCount * drawBindings.size() +
+                                    colorSetCount * colorBindings.size() +
+                                    depthSetCount * depthBindings.size()),
+      });
+
+  std::vector<VkDescriptorSetLayout> layouts(drawSetCount,
+                                             descriptorSetLayout_.get());
+  layouts.resize(drawSetCount + colorSetCount, colorSetLayout_.get());
+  layouts.resize(setCount, depthSetLayout_.get());
+  std::vector<VkDescriptorSet> sets(setCount);
+  const VkDescriptorSetAllocateInfo dsai{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = descriptorPool_.get(),
+      .descriptorSetCount = setCount,
+      .pSetLayouts = layouts.data(),
+  };
+  VK_CHECK(vkAllocateDescriptorSets(ctx.device, &dsai, sets.data()));
+
+  // Points `set` at the attributes, then at `extra` in binding order.
+  const auto writeSet = [&](VkDescriptorSet set,
+                            const std::vector<VkDescriptorSetLayoutBinding>&
+                                bindings,
+                            std::initializer_list<VkDescriptorBufferInfo>
+                                extra) {
+    std::vector<VkDescriptorBufferInfo> infos;
+    for (uint32_t i = 0; i < attributeCount; ++i) {
+      infos.push_back(
+          splats_->descriptor(static_cast<SplatBuffers::Attribute>(i)));
+    }
+    infos.insert(infos.end(), extra);
+
+    std::vector<VkWriteDescriptorSet> writes(bindings.size());
+    for (uint32_t i = 0; i < writes.size(); ++i) {
+      writes[i] = {
+          .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+          .dstSet = set,
+          .dstBinding = bindings[i].binding,
+          .descriptorCount = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .pBufferInfo = &infos[i],
+      };
+    }
+    vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()),
+                           writes.data(), 0, nullptr);
+  };
+
+  const VkDescriptorBufferInfo colors{.buffer = colors_.get(),
+                                      .range = VK_WHOLE_SIZE};
+  for (size_t s = 0; s < slots_.size(); ++s) {
+    slots_[s].descriptorSet = sets[s];
+    writeSet(sets[s], drawBindings,
+             {{.buffer = slots_[s].buffer.get(), .range = VK_WHOLE_SIZE},
+              colors});
+    slots_[s].colorSet = sets[drawSetCount + s];
+    writeSet(slots_[s].colorSet, colorBindings,
+             {colors,
+              {.buffer = slots_[s].visible.get(), .range = VK_WHOLE_SIZE}});
+  }
+  if (gpuSort_) {
+    gpuOrderSet_ = sets[slotCount];
+    writeSet(gpuOrderSet_, drawBindings, {gpuSort_->values(), colors});
+    for (size_t s = 0; s < slots_.size(); ++s) {
+      slots_[s].depthSet = sets[drawSetCount + colorSetCount + s];
+      writeSet(slots_[s].depthSet, depthBindings,
+               {gpuSort_->keys(), gpuSort_->values(),
+                {.buffer = slots_[s].visible.get(), .range = VK_WHOLE_SIZE}});
+    }
+  }
+}
+
+void GaussianSplatLayer::createPipeline(VkFormat swapchainFormat) {
+  const ShaderModule vertModule(
+      device_, splats_->encoding() == SplatBuffers::Encoding::kCompact
+                   ? SHADER_DIR "/splat_compact.vert.spv"
+                   : SHADER_DIR "/splat.vert.spv");
+  const ShaderModule fragModule(device_, SHADER_DIR "/splat.frag.spv");
+
+  const std::array<VkPipelineShaderStageCreateInfo, 2> stages{{
+      {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .stage = VK_SHADER_STAGE_VERTEX_BIT,
+          .module = vertModule.get(),
+          .pName = "main",
+      },
+      {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+          .module = fragModule.get(),
+          .pName = "main",
+      },
+  }};
+
+  const VkPushConstantRange pcRange{
+      .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+      .size = sizeof(PushConstants),
+  };
+
+  const VkDescriptorSetLayout layoutHandle = descriptorSetLayout_.get();
+  const VkPipelineLayoutCreateInfo layoutCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = 1,
+      .pSetLayouts = &layoutHandle,
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &pcRange,
+  };
+  pipelineLayout_ = PipelineLayout(device_, layoutCI);
+
+  const VkPipelineVertexInputStateCreateInfo vertexInput{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+  };
+
+  const VkPipelineInputAssemblyStateCreateInfo inputAssembly{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+      .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+  };
+
+  const VkPipelineViewportStateCreateInfo viewportState{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+      .viewportCount = 1,
+      .scissorCount = 1,
+  };
+
+  const VkPipelineRasterizationStateCreateInfo rasterizer{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+      .polygonMode = VK_POLYGON_MODE_FILL,
+      .cullMode = VK_CULL_MODE_NONE,
+      .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+      .lineWidth = 1.0f,
+  };
+
+  const VkPipelineMultisampleStateCreateInfo multisample{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+      .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+  };
+
+  // Premultiplied "over", composited back to front.
+  const VkPipelineColorBlendAttachmentState colorBlendAttachment{
+      .blendEnable = VK_TRUE,
+      .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+      .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+      .colorBlendOp = VK_BLEND_OP_ADD,
+      .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+      .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+      .alphaBlendOp = VK_BLEND_OP_ADD,
+      .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+  };
+
+  const VkPipelineColorBlendStateCreateInfo colorBlend{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+      .attachmentCount = 1,
+      .pAttachments = &colorBlendAttachment,
+  };
+
+  const std::array<VkDynamicState, 2> dynamicStates = {
+      VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+  const VkPipelineDynamicStateCreateInfo dynamicState{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .dynamicStateCount = 2,
+      .pDynamicStates = dynamicStates.data(),
+  };
+
+  const VkPipelineRenderingCreateInfo renderingCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+      .colorAttachmentCount = 1,
+      .pColorAttachmentFormats = &swapchainFormat,
+  };
+
+  const VkGraphicsPipelineCreateInfo pipelineCI{
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .pNext = &renderingCI,
+      .stageCount = 2,
+      .pStages = stages.data(),
+      .pVertexInputState = &vertexInput,
+      .pInputAssemblyState = &inputAssembly,
+      .pViewportState = &viewportState,
+      .pRasterizationState = &rasterizer,
+      .pMultisampleState = &multisample,
+      .pColorBlendState = &colorBlend,
+      .pDynamicState = &dynamicState,
+      .layout = pipelineLayout_.get(),
+  };
+  pipeline_ = Pipeline(device_, pipelineCI, pipelineCache_);
+}
+
+void GaussianSplatLayer::createColorPipelines() {
+  const ShaderModule module(
+      device_, splats_->encoding() == SplatBuffers::Encoding::kCompact
+                   ? SHADER_DIR "/splat_color_compact.comp.spv"
+                   : SHADER_DIR "/splat_color.comp.spv");
+
+  const VkPushConstantRange pcRange{
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      .size = sizeof(ColorPushConstants),
+  };
+  const VkDescriptorSetLayout layoutHandle = colorSetLayout_.get();
+  colorLayout_ = PipelineLayout(
+      device_, VkPipelineLayoutCreateInfo{
+                   .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                   .setLayoutCount = 1,
+                   .pSetLayouts = &layoutHandle,
+                   .pushConstantRangeCount = 1,
+                   .pPushConstantRanges = &pcRange,
+               });
+
+  // One variant per SH degree the cloud has.
+  const std::array<VkSpecializationMapEntry, 2> specEntries{{
+      {0, offsetof(ShSpecialization, degree), sizeof(uint32_t)},
+      {1, offsetof(ShSpecialization, coeffs), sizeof(uint32_t)},
+  }};
+  for (int degree = 0; degree <= splats_->shDegree(); ++degree) {
+    const ShSpecialization specData{
+        .degree = static_cast<uint32_t>(degree),
+        .coeffs = static_cast<uint32_t>(
+            SplatCloud::shCoefficients(splats_->shDegree())),
+    };
+    const VkSpecializationInfo specInfo{
+        .mapEntryCount = static_cast<uint32_t>(specEntries.size()),
+        .pMapEntries = specEntries.data(),
+        .dataSize = sizeof(specData),
+        .pData = &specData,
+    };
+    colorPipelines_[static_cast<size_t>(degree)] = Pipeline(
+        device_,
+        VkComputePipelineCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage =
+                {
+                    .sType =
+                        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = module.get(),
+                    .pName = "main",
+                    .pSpecializationInfo = &specInfo,
+                },
+            .layout = colorLayout_.get(),
+        },
+        pipelineCache_);
+  }
+}
+
+void GaussianSplatLayer::createDepthPipeline() {
+  const ShaderModule module(
+      device_, splats_->encoding() == SplatBuffers::Encoding::kCompact
+                   ? SHADER_DIR "/splat_depth_compact.comp.spv"
+                   : SHADER_DIR "/splat_depth.comp.spv");
+
+  const VkPushConstantRange pcRange{
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      .size = sizeof(DepthPushConstants),
+  };
+  const VkDescriptorSetLayout layoutHandle = depthSetLayout_.get();
+  depthLayout_ = PipelineLayout(
+      device_, VkPipelineLayoutCreateInfo{
+                   .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                   .setLayoutCount = 1,
+                   .pSetLayouts = &layoutHandle,
+                   .pushConstantRangeCount = 1,
+                   .pPushConstantRanges = &pcRange,
+               });
+
+  depthPipeline_ = Pipeline(
+      device_,
+      VkComputePipelineCreateInfo{
+          .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+          .stage =
+              {
+                  .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                  .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                  .module = module.get(),
+                  .pName = "main",
+              },
+          .layout = depthLayout_.get(),
+      },
+      pipelineCache_);
+}
+
+void GaussianSplatLayer::prepare(VkCommandBuffer cmd, const Camera& camera,
+                                 VkExtent2D extent, uint32_t frameSlot) {
+  if (!splats_->ready()) {
+    return;
+  }
+  visibleCount_ =
+      splats_->index().cull(camera, extent, culling_, visibleChunks_);
+  // This slot's last frame has completed, so its buffers are free to
+  // rewrite.
+  OrderSlot& slot = slots_[frameSlot];
+  if (usingGpuSort()) {
+    recordGpuSort(cmd, camera, slot);
+    recordColors(cmd, camera, slot, gpuChunks_, gpuCount_);
+  } else {
+    // The draw uses the latest finished sort, whose chunks may lag this
+    // frame's culling.
+    updateOrder(camera);
+    recordColors(cmd, camera, slot, orderChunks_,
+                 static_cast<uint32_t>(order_.size()));
+  }
+}
+
+void GaussianSplatLayer::recordGpuSort(VkCommandBuffer cmd,
+                                       const Camera& camera, OrderSlot& slot) {
+  const Vec3 forward = camera.forward();
+  if (gpuSorted_ && dot(forward, gpuForward_) >= kResortCosine &&
+      visibleChunks_ == gpuChunks_ &&
+      splats_->generation() == gpuSplatGeneration_) {
+    return;
+  }
+  gpuForward_ = forward;
+  gpuChunks_ = visibleChunks_;
+  gpuSplatGeneration_ = splats_->generation();
+  gpuCount_ = visibleCount_;
+  gpuSorted_ = true;
+  if (visibleCount_ == 0) {
+    return;
+  }
+
+  std::memcpy(slot.visibleMemory.mapped(), visibleChunks_.data(),
+              visibleChunks_.size() * sizeof(uint32_t));
+
+  // Earlier frames' draws and sorts may still be reading the keys and
+  // values about to be overwritten.
+  vkCmdPipelineBarrier(cmd,
+                       VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 0, nullptr);
+
+  const uint32_t count = visibleCount_;
+  const DepthPushConstants pc{
+      .forward = {forward.x, forward.y, forward.z, 0.0f},
+      .count = count,
+  };
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, depthPipeline_.get());
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          depthLayout_.get(), 0, 1, &slot.depthSet, 0,
+                          nullptr);
+  vkCmdPushConstants(cmd, depthLayout_.get(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(pc), &pc);
+  vkCmdDispatch(cmd, (count + kWorkgroupSize - 1) / kWorkgroupSize, 1, 1);
+
+  gpuSort_->record(cmd, count, 32, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+}
+
+void GaussianSplatLayer::recordColors(VkCommandBuffer cmd,
+                                      const Camera& camera, OrderSlot& slot,
+                                      const std::vector<uint32_t>& chunks,
+                                      uint32_t count) {
+  if (count == 0) {
+    return;
+  }
+  std::memcpy(slot.visibleMemory.mapped(), chunks.data(),
+              chunks.size() * sizeof(uint32_t));
+
+  // The previous frame's draw may still be reading the colours.
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 0, nullptr);
+
+  const Vec3 eye = camera.position();
+  const ColorPushConstants pc{
+      .cameraPos = {eye.x, eye.y, eye.z, 1.0f},
+      .count = count,
+  };
+  const auto degree =
+      static_cast<size_t>(std::clamp(shDegree_, 0, splats_->shDegree()));
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    colorPipelines_[degree].get());
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          colorLayout_.get(), 0, 1, &slot.colorSet, 0,
+                          nullptr);
+  vkCmdPushConstants(cmd, colorLayout_.get(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(pc), &pc);
+  vkCmdDispatch(cmd, (count + kWorkgroupSize - 1) / kWorkgroupSize, 1, 1);
+
+  const VkMemoryBarrier written{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+  };
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &written, 0,
+                       nullptr, 0, nullptr);
+}
+
+void GaussianSplatLayer::updateOrder(const Camera& camera) {
+  const Vec3 forward = camera.forward();
+  if (!pendingSort_.valid() &&
+      (orderGeneration_ == 0 || dot(forward, orderForward_) < kResortCosine ||
+       visibleChunks_ != orderChunks_ ||
+       splats_->generation() != orderSplatGeneration_)) {
+    pendingForward_ = forward;
+    pendingChunks_ = visibleChunks_;
+    // Dynamic clouds change under the worker, so it sorts a snapshot.
+    pendingPositions_ = splats_->hostPositionsSnapshot();
+    pendingCount_ = splats_->count();
+    pendingSplatGeneration_ = splats_->generation();
+    pendingSort_ = sortThread_.submit([this]() {
+      pendingSplats_.clear();
+      for (const uint32_t chunk : pendingChunks_) {
+        const size_t begin = size_t{chunk} * SplatIndex::kChunkSplats;
+        const size_t end =
+            std::min(begin + SplatIndex::kChunkSplats, pendingCount_);
+        for (size_t id = begin; id < end; ++id) {
+          pendingSplats_.push_back(static_cast<uint32_t>(id));
+        }
+      }
+      sorter_.sort(*pendingPositions_, pendingForward_, pendingSplats_,
+                   pendingOrder_);
+    });
+  }
+
+  // The first sort is waited for, so the cloud never draws unsorted.
+  if (pendingSort_.valid() &&
+      (orderGeneration_ == 0 || pendingSort_.wait_for(std::chrono::seconds(
+                                    0)) == std::future_status::ready)) {
+    pendingSort_.get();
+    order_.swap(pendingOrder_);
+    orderForward_ = pendingForward_;
+    orderChunks_.swap(pendingChunks_);
+    orderSplatGeneration_ = pendingSplatGeneration_;
+    pendingPositions_.reset();
+    ++orderGeneration_;
+  }
+}
+
+void GaussianSplatLayer::render(VkCommandBuffer cmd, const Camera& camera,
+                                VkExtent2D extent, uint32_t frameSlot) {
+  if (!splats_->ready()) {
+    return;
+  }
+
+  VkDescriptorSet descriptorSet = gpuOrderSet_;
+  uint32_t instanceCount = gpuCount_;
+  if (!usingGpuSort() || !gpuSorted_) {
+    // This slot's last frame has completed, so its buffer is free to
+    // rewrite.
+    OrderSlot& slot = slots_[frameSlot];
+    if (slot.generation != orderGeneration_) {
+      std::memcpy(slot.memory.mapped(), order_.data(),
+                  order_.size() * sizeof(uint32_t));
+      slot.generation = orderGeneration_;
+    }
+    descriptorSet = slot.descriptorSet;
+    instanceCount = static_cast<uint32_t>(order_.size());
+  }
+  if (instanceCount == 0) {
+    return;
+  }
+
+  const float focal = camera.focalLength(extent);
+  const PushConstants pc{
+      .view = camera.view(),
+      .focal = {focal, focal},
+      .viewport = {static_cast<float>(extent.width),
+                   static_cast<float>(extent.height)},
+      .tanHalfFov = {0.5f * static_cast<float>(extent.width) / focal,
+                     0.5f * static_cast<float>(extent.height) / focal},
+  };
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_.get());
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipelineLayout_.get(), 0, 1, &descriptorSet, 0,
+                          nullptr);
+  vkCmdPushConstants(cmd, pipelineLayout_.get(), VK_SHADER_STAGE_VERTEX_BIT, 0,
+                     sizeof(pc), &pc);
+  vkCmdDraw(cmd, 4, instanceCount, 0, 0);
+}
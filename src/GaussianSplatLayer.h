@@ -0,0 +1,153 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "Camera.h"
+#include "DepthSorter.h"
+#include "GpuAllocator.h"
+#include "GpuRadixSort.h"
+#include "LayerBase.h"
+#include "SplatBuffers.h"
+#include "SplatIndex.h"
+#include "ThreadPool.h"
+
+// Draws a SplatBuffers cloud as instanced screen-space quads, one per
+// Gaussian, alpha-blended back to front.
+//
+// View-dependent colours are evaluated once per drawn splat and frame by a
+// compute pass, splat_color.comp, rather than by every quad corner; the
+// vertex shader reads one packed colour instead of up to 48 coefficients.
+// The pass has a pipeline specialized for each SH degree, so lowering the
+// degree under load cuts its reads to the bands still in use.
+//
+// Every frame the cloud's SplatIndex culls chunks that are off screen or too
+// small, and only the rest are sorted and drawn. The depth order is
+// recomputed whenever the view direction, the visible set or the splats
+// themselves (for dynamic clouds) change.
+// Where the device supports it, the splats are sorted on the GPU by a
+// GpuRadixSort recorded into the frame itself (see prepare()). Otherwise
+// they are sorted on a worker thread, and drawn with as soon as that is
+// ready; until then the previous order is used. Each frame in flight has its
+// own host-visible order buffer, refreshed when it falls behind the latest
+// CPU sort.
+class GaussianSplatLayer : public PipelineLayerBase {
+ public:
+  GaussianSplatLayer(const Renderer::Context& ctx,
+                     std::shared_ptr<const SplatBuffers> splats);
+
+  // Call from Renderer::renderFrame's prepare callback with
+  // Renderer::frameSlot(), before render(). Culls the cloud for this frame,
+  // records the GPU depth sort when it is enabled and the view has turned or
+  // the visible set changed, and records the colour pass.
+  void prepare(VkCommandBuffer cmd, const Camera& camera, VkExtent2D extent,
+               uint32_t frameSlot);
+
+  // Call from inside Renderer::renderFrame with Renderer::frameSlot(), after
+  // prepare(). Draws nothing until the splat upload has landed.
+  void render(VkCommandBuffer cmd, const Camera& camera, VkExtent2D extent,
+              uint32_t frameSlot);
+
+  // Highest SH degree evaluated; clamped to the cloud's own degree. Takes
+  // effect at the next prepare().
+  void setShDegree(int degree) { shDegree_ = degree; }
+
+  // Sorts on the GPU when the device supports it (the default), on the CPU
+  // otherwise.
+  void setGpuSort(bool enabled) { gpuSortEnabled_ = enabled; }
+  [[nodiscard]] bool gpuSortSupported() const { return gpuSort_ != nullptr; }
+
+  void setCulling(const SplatIndex::Culling& culling) { culling_ = culling; }
+  // Splats that survived culling in the last prepare().
+  [[nodiscard]] uint32_t visibleCount() const { return visibleCount_; }
+
+ private:
+  struct OrderSlot {
+    Buffer buffer;
+    GpuAllocation memory;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    uint64_t generation = 0;
+    // The drawn chunks, for the colour and depth passes.
+    Buffer visible;
+    GpuAllocation visibleMemory;
+    VkDescriptorSet colorSet = VK_NULL_HANDLE;
+    VkDescriptorSet depthSet = VK_NULL_HANDLE;
+  };
+
+  void createDescriptors(const Renderer::Context& ctx);
+  void createPipeline(VkFormat swapchainFormat);
+  void createColorPipelines();
+  void createDepthPipeline();
+  void recordGpuSort(VkCommandBuffer cmd, const Camera& camera,
+                     OrderSlot& slot);
+  // Shades the first `count` splats of `chunks`: the ones the draw uses.
+  void recordColors(VkCommandBuffer cmd, const Camera& camera,
+                    OrderSlot& slot, const std::vector<uint32_t>& chunks,
+                    uint32_t count);
+  void updateOrder(const Camera& camera);
+  [[nodiscard]] bool usingGpuSort() const {
+    return gpuSortEnabled_ && gpuSort_ != nullptr;
+  }
+
+  std::shared_ptr<const SplatBuffers> splats_;
+  int shDegree_ = SplatCloud::kMaxShDegree;
+  SplatIndex::Culling culling_;
+  std::vector<uint32_t> visibleChunks_;
+  uint32_t visibleCount_ = 0;
+
+  DescriptorSetLayout descriptorSetLayout_;
+  DescriptorPool descriptorPool_;
+  std::vector<OrderSlot> slots_;
+
+  // Colour pass: one packed colour per splat, written before and read by
+  // the draw of the same frame. Pipelines are indexed by SH degree, up to
+  // the cloud's.
+  Buffer colors_;
+  GpuAllocation colorsMemory_;
+  DescriptorSetLayout colorSetLayout_;
+  PipelineLayout colorLayout_;
+  std::array<Pipeline, SplatCloud::kMaxShDegree + 1> colorPipelines_;
+
+  // GPU sorting: splat_depth.comp fills the sorter's keys and values from
+  // the visible splats, and the draw reads the sorted values through
+  // gpuOrderSet_.
+  std::unique_ptr<GpuRadixSort> gpuSort_;
+  bool gpuSortEnabled_ = true;
+  DescriptorSetLayout depthSetLayout_;
+  VkDescriptorSet gpuOrderSet_ = VK_NULL_HANDLE;
+  PipelineLayout depthLayout_;
+  Pipeline depthPipeline_;
+  // View direction, visible chunks and splat generation of the last
+  // recorded GPU sort, and how many splats it ordered.
+  bool gpuSorted_ = false;
+  Vec3 gpuForward_;
+  std::vector<uint32_t> gpuChunks_;
+  uint64_t gpuSplatGeneration_ = 0;
+  uint32_t gpuCount_ = 0;
+
+  // Latest finished sort, and the view direction, visible chunks and splat
+  // generation it was made for.
+  std::vector<uint32_t> order_;
+  uint64_t orderGeneration_ = 0;
+  Vec3 orderForward_;
+  std::vector<uint32_t> orderChunks_;
+  uint64_t orderSplatGeneration_ = 0;
+
+  // Owned by the worker while pendingSort_ is running.
+  DepthSorter sorter_;
+  std::vector<uint32_t> pendingOrder_;
+  std::vector<uint32_t> pendingSplats_;
+  Vec3 pendingForward_;
+  std::vector<uint32_t> pendingChunks_;
+  std::shared_ptr<const std::vector<float>> pendingPositions_;
+  size_t pendingCount_ = 0;
+  uint64_t pendingSplatGeneration_ = 0;
+  std::future<void> pendingSort_;
+  // Last, so it is joined before anything its tasks touch is destroyed.
+  ThreadPool sortThread_{1};
+};
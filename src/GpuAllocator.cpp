@@ -0,0 +1,246 @@
+#include "GpuAllocator.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+#include "VulkanErrors.h"
+
+namespace {
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+GpuAllocator::GpuAllocator(VkDevice device, VkPhysicalDevice physicalDevice,
+                           VkDeviceSize blockSize)
+    : device_(device), blockSize_(blockSize) {
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps_);
+}
+
+GpuAllocator::~GpuAllocator() = default;
+
+GpuAllocation GpuAllocator::allocate(VkBuffer buffer,
+                                     VkMemoryPropertyFlags required,
+                                     VkMemoryPropertyFlags preferred) {
+  VkMemoryRequirements reqs{};
+  vkGetBufferMemoryRequirements(device_, buffer, &reqs);
+  GpuAllocation allocation = allocate(reqs, required, preferred, false);
+  VK_CHECK(vkBindBufferMemory(device_, buffer, allocation.memory(),
+                              allocation.offset()));
+  return allocation;
+}
+
+GpuAllocation GpuAllocator::allocate(VkImage image,
+                                     VkMemoryPropertyFlags required,
+                                     VkMemoryPropertyFlags preferred) {
+  VkMemoryRequirements reqs{};
+  vkGetImageMemoryRequirements(device_, image, &reqs);
+  GpuAllocation allocation = allocate(reqs, required, preferred, true);
+  VK_CHECK(vkBindImageMemory(device_, image, allocation.memory(),
+                             allocation.offset()));
+  return allocation;
+}
+
+GpuAllocation GpuAllocator::allocate(const VkMemoryRequirements& reqs,
+                                     VkMemoryPropertyFlags required,
+                                     VkMemoryPropertyFlags preferred,
+                                     bool optimal) {
+  const uint32_t memoryType =
+      findMemoryType(reqs.memoryTypeBits, required, preferred);
+  const size_t poolIndex = (size_t{memoryType} * 2) + (optimal ? 1 : 0);
+
+  const std::lock_guard lock(mutex_);
+  auto& pool = pools_[poolIndex];
+
+  Block* block = nullptr;
+  VkDeviceSize offset = 0;
+  if (reqs.size > blockSize_ / 2) {
+    pool.push_back(createBlock(memoryType, reqs.size));
+    block = pool.back().get();
+    block->dedicated = true;
+    block->freeRanges.clear();
+  } else {
+    // Best fit: the smallest free range that still holds the aligned request.
+    VkDeviceSize bestSize = std::numeric_limits<VkDeviceSize>::max();
+    for (const auto& candidate : pool) {
+      if (candidate->dedicated) {
+        continue;
+      }
+      for (const auto& [rangeOffset, rangeSize] : candidate->freeRanges) {
+        const VkDeviceSize start = alignUp(rangeOffset, reqs.alignment);
+        if (start + reqs.size <= rangeOffset + rangeSize &&
+            rangeSize < bestSize) {
+          block = candidate.get();
+          offset = start;
+          bestSize = rangeSize;
+        }
+      }
+    }
+
+    if (block == nullptr) {
+      pool.push_back(createBlock(memoryType, blockSize_));
+      block = pool.back().get();
+    }
+
+    // Split the chosen range; alignment padding stays free on the left.
+    auto range = std::prev(block->freeRanges.upper_bound(offset));
+    const VkDeviceSize rangeOffset = range->first;
+    const VkDeviceSize rangeEnd = range->first + range->second;
+    block->freeRanges.erase(range);
+    if (offset > rangeOffset) {
+      block->freeRanges.emplace(rangeOffset, offset - rangeOffset);
+    }
+    if (offset + reqs.size < rangeEnd) {
+      block->freeRanges.emplace(offset + reqs.size,
+                                rangeEnd - (offset + reqs.size));
+    }
+  }
+
+  block->pool = poolIndex;
+  ++block->liveCount;
+  bytesInUse_ += reqs.size;
+  ++allocationCount_;
+  return {this, block, offset, reqs.size};
+}
+
+void GpuAllocator::release(Block* block, VkDeviceSize offset,
+                           VkDeviceSize size) {
+  const std::lock_guard lock(mutex_);
+  bytesInUse_ -= size;
+  --allocationCount_;
+
+  auto& pool = pools_[block->pool];
+  if (--block->liveCount == 0) {
+    // Keep one empty shared block per pool around to absorb churn.
+    const bool lastShared =
+        !block->dedicated &&
+        std::count_if(pool.begin(), pool.end(), [](const auto& b) {
+          return !b->dedicated;
+        }) == 1;
+    if (!lastShared) {
+      std::erase_if(pool, [block](const auto& b) { return b.get() == block; });
+      return;
+    }
+  }
+
+  auto next = block->freeRanges.lower_bound(offset);
+  VkDeviceSize start = offset;
+  VkDeviceSize end = offset + size;
+  if (next != block->freeRanges.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == start) {
+      start = prev->first;
+      block->freeRanges.erase(prev);
+    }
+  }
+  if (next != block->freeRanges.end() && next->first == end) {
+    end = next->first + next->second;
+    block->freeRanges.erase(next);
+  }
+  block->freeRanges.emplace(start, end - start);
+}
+
+uint32_t GpuAllocator::findMemoryType(uint32_t typeBits,
+                                      VkMemoryPropertyFlags required,
+                                      VkMemoryPropertyFlags preferred) const {
+  const VkMemoryPropertyFlags wanted = required | preferred;
+  for (uint32_t i = 0; i < memProps_.memoryTypeCount; ++i) {
+    if (((typeBits & (1u << i)) != 0) &&
+        (memProps_.memoryTypes[i].propertyFlags & wanted) == wanted) {
+      return i;
+    }
+  }
+  return ::findMemoryType(memProps_, typeBits, required);
+}
+
+std::unique_ptr<GpuAllocator::Block> GpuAllocator::createBlock(
+    uint32_t memoryType, VkDeviceSize size) {
+  auto block = std::make_unique<Block>();
+  block->memory = DeviceMemory(
+      device_, VkMemoryAllocateInfo{
+                   .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+                   .allocationSize = size,
+                   .memoryTypeIndex = memoryType,
+               });
+  block->size = size;
+  block->freeRanges.emplace(0, size);
+
+  // Freeing the memory implicitly unmaps it.
+  if ((memProps_.memoryTypes[memoryType].propertyFlags &
+       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0u) {
+    void* mapped = nullptr;
+    VK_CHECK(vkMapMemory(device_, block->memory.get(), 0, VK_WHOLE_SIZE, 0,
+                         &mapped));
+    block->mapped = static_cast<uint8_t*>(mapped);
+  }
+  return block;
+}
+
+GpuAllocator::Stats GpuAllocator::stats() const {
+  const std::lock_guard lock(mutex_);
+  Stats stats{
+      .bytesInUse = bytesInUse_,
+      .allocationCount = allocationCount_,
+  };
+
+  VkDeviceSize freeBytes = 0;
+  VkDeviceSize largestFree = 0;
+  for (const auto& pool : pools_) {
+    for (const auto& block : pool) {
+      stats.bytesReserved += block->size;
+      ++stats.blockCount;
+      for (const auto& [offset, size] : block->freeRanges) {
+        freeBytes += size;
+        largestFree = std::max(largestFree, size);
+      }
+    }
+  }
+  if (freeBytes > 0) {
+    stats.fragmentation = 1.0f - (static_cast<float>(largestFree) /
+                                  static_cast<float>(freeBytes));
+  }
+  return stats;
+}
+
+GpuAllocation::~GpuAllocation() {
+  reset();
+}
+
+GpuAllocation::GpuAllocation(GpuAllocation&& other) noexcept
+    : allocator_(std::exchange(other.allocator_, nullptr)),
+      block_(std::exchange(other.block_, nullptr)),
+      offset_(other.offset_),
+      size_(other.size_) {}
+
+GpuAllocation& GpuAllocation::operator=(GpuAllocation&& other) noexcept {
+  if (this != &other) {
+    reset();
+    allocator_ = std::exchange(other.allocator_, nullptr);
+    block_ = std::exchange(other.block_, nullptr);
+    offset_ = other.offset_;
+    size_ = other.size_;
+  }
+  return *this;
+}
+
+VkDeviceMemory GpuAllocation::memory() const {
+  return block_ != nullptr ? block_->memory.get() : VK_NULL_HANDLE;
+}
+
+uint8_t* GpuAllocation::mapped() const {
+  return block_ != nullptr && block_->mapped != nullptr
+             ? block_->mapped + offset_
+             : nullptr;
+}
+
+void GpuAllocation::reset() noexcept {
+  if (allocator_ != nullptr) {
+    allocator_->release(block_, offset_, size_);
+    allocator_ = nullptr;
+    block_ = nullptr;
+  }
+}
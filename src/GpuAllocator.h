@@ -0,0 +1,128 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "VulkanHandles.h"
+
+class GpuAllocation;
+
+// Sub-allocates buffers and images out of large VkDeviceMemory blocks so the
+// number of driver allocations stays far below maxMemoryAllocationCount.
+//
+// Each (memory type, linear/optimal) pair gets its own pool of blocks; keeping
+// buffers and optimal-tiling images apart sidesteps bufferImageGranularity.
+// Within a block, free ranges are kept sorted by offset, picked best-fit and
+// coalesced with their neighbours when released. Requests larger than half a
+// block get a dedicated block of their own. Host-visible blocks stay mapped.
+//
+// Thread-safe.
+class GpuAllocator {
+ public:
+  static constexpr VkDeviceSize kDefaultBlockSize = VkDeviceSize{64} << 20;
+
+  struct Stats {
+    // Device memory held by blocks, used or not.
+    VkDeviceSize bytesReserved = 0;
+    VkDeviceSize bytesInUse = 0;
+    size_t blockCount = 0;
+    size_t allocationCount = 0;
+    // 1 - largest free range / total free bytes: 0 while free space is one
+    // contiguous range, approaching 1 as it splinters.
+    float fragmentation = 0.0f;
+  };
+
+  GpuAllocator(VkDevice device, VkPhysicalDevice physicalDevice,
+               VkDeviceSize blockSize = kDefaultBlockSize);
+  ~GpuAllocator();
+
+  GpuAllocator(const GpuAllocator&) = delete;
+  GpuAllocator& operator=(const GpuAllocator&) = delete;
+  GpuAllocator(GpuAllocator&&) = delete;
+  GpuAllocator& operator=(GpuAllocator&&) = delete;
+
+  // Allocates memory with the `required` properties, plus the `preferred`
+  // ones when some memory type has them, and binds it to the resource.
+  // Images are assumed to use optimal tiling.
+  GpuAllocation allocate(VkBuffer buffer, VkMemoryPropertyFlags required,
+                         VkMemoryPropertyFlags preferred = 0);
+  GpuAllocation allocate(VkImage image, VkMemoryPropertyFlags required,
+                         VkMemoryPropertyFlags preferred = 0);
+
+  [[nodiscard]] VkDevice device() const { return device_; }
+  [[nodiscard]] Stats stats() const;
+
+ private:
+  friend class GpuAllocation;
+
+  struct Block {
+    DeviceMemory memory;
+    VkDeviceSize size = 0;
+    uint8_t* mapped = nullptr;
+    // Free ranges: offset -> size.
+    std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+    size_t liveCount = 0;
+    size_t pool = 0;
+    bool dedicated = false;
+  };
+
+  GpuAllocation allocate(const VkMemoryRequirements& reqs,
+                         VkMemoryPropertyFlags required,
+                         VkMemoryPropertyFlags preferred, bool optimal);
+  [[nodiscard]] uint32_t findMemoryType(uint32_t typeBits,
+                                       VkMemoryPropertyFlags required,
+                                       VkMemoryPropertyFlags preferred) const;
+  void release(Block* block, VkDeviceSize offset, VkDeviceSize size);
+  std::unique_ptr<Block> createBlock(uint32_t memoryType, VkDeviceSize size);
+
+  VkDevice device_ = VK_NULL_HANDLE;
+  VkPhysicalDeviceMemoryProperties memProps_{};
+  VkDeviceSize blockSize_ = 0;
+
+  mutable std::mutex mutex_;
+  // Indexed by memoryType * 2 + optimal.
+  std::array<std::vector<std::unique_ptr<Block>>, 2 * VK_MAX_MEMORY_TYPES>
+      pools_;
+  VkDeviceSize bytesInUse_ = 0;
+  size_t allocationCount_ = 0;
+};
+
+// A range of device memory owned by a GpuAllocator, returned to it on
+// destruction. Move-only, like the VulkanHandle wrappers.
+class GpuAllocation {
+ public:
+  GpuAllocation() = default;
+  ~GpuAllocation();
+
+  GpuAllocation(const GpuAllocation&) = delete;
+  GpuAllocation& operator=(const GpuAllocation&) = delete;
+  GpuAllocation(GpuAllocation&& other) noexcept;
+  GpuAllocation& operator=(GpuAllocation&& other) noexcept;
+
+  [[nodiscard]] VkDeviceMemory memory() const;
+  [[nodiscard]] VkDeviceSize offset() const { return offset_; }
+  [[nodiscard]] VkDeviceSize size() const { return size_; }
+  // Host pointer to the start of the range; nullptr unless host-visible.
+  [[nodiscard]] uint8_t* mapped() const;
+
+ private:
+  friend class GpuAllocator;
+
+  GpuAllocation(GpuAllocator* allocator, GpuAllocator::Block* block,
+                VkDeviceSize offset, VkDeviceSize size) noexcept
+      : allocator_(allocator), block_(block), offset_(offset), size_(size) {}
+
+  void reset() noexcept;
+
+  GpuAllocator* allocator_ = nullptr;
+  GpuAllocator::Block* block_ = nullptr;
+  VkDeviceSize offset_ = 0;
+  VkDeviceSize size_ = 0;
+};
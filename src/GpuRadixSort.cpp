@@ -0,0 +1,447 @@
+#include "GpuRadixSort.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+#include "VulkanCompute.h"
+#include "VulkanErrors.h"
+#include "VulkanShaders.h"
+
+#ifndef SHADER_DIR
+#define SHADER_DIR "shaders"
+#endif
+
+namespace {
+
+constexpr uint32_t kRadix = 256;
+constexpr uint32_t kDigitBits = 8;
+constexpr uint32_t kDefaultWorkgroupSize = 256;
+
+// Matches PushConstants in radix_sort.glsl.
+struct PushConstants {
+  uint32_t count;
+  uint32_t shift;
+  uint32_t keyWord;
+  uint32_t keyWords;
+  uint32_t blockCount;
+  uint32_t indirect;
+};
+
+// Matches the constant_ids in radix_sort.glsl and radix_scatter.comp.
+struct SpecializationData {
+  uint32_t workgroupSize;
+  uint32_t itemsPerThread;
+  uint32_t maxSubgroups;
+};
+
+// Shared memory of radix_scatter.comp: the block's digit bases plus one
+// count per digit per subgroup.
+size_t scatterSharedBytes(uint32_t workgroupSize, uint32_t subgroupSize) {
+  const size_t subgroups = workgroupSize / subgroupSize;
+  return (1 + subgroups) * kRadix * sizeof(uint32_t);
+}
+
+}  // namespace
+
+bool GpuRadixSort::isSupported(VkPhysicalDevice physicalDevice) {
+  const VkPhysicalDeviceSubgroupProperties subgroup =
+      subgroupProperties(physicalDevice);
+  constexpr VkSubgroupFeatureFlags kRequired =
+      VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+  // Ballots are uvec4s, so at most 128 lanes.
+  return (subgroup.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0 &&
+         (subgroup.supportedOperations & kRequired) == kRequired &&
+         subgroup.subgroupSize <= 128;
+}
+
+GpuRadixSort::GpuRadixSort(const Renderer::Context& ctx, uint32_t maxCount,
+                           uint32_t keyWords)
+    : GpuRadixSort(ctx, maxCount, keyWords, Options{}) {}
+
+GpuRadixSort::GpuRadixSort(const Renderer::Context& ctx, uint32_t maxCount,
+                           uint32_t keyWords, const Options& options)
+    : device_(ctx.device),
+      maxCount_(maxCount),
+      keyWords_(keyWords),
+      options_(options) {
+  if (keyWords_ != 1 && keyWords_ != 2) {
+    throw std::invalid_argument("GpuRadixSort keys must be 1 or 2 words");
+  }
+  if (!isSupported(ctx.physicalDevice)) {
+    throw std::runtime_error(
+        "GpuRadixSort needs subgroup ballots in compute shaders");
+  }
+
+  VkPhysicalDeviceProperties props{};
+  vkGetPhysicalDeviceProperties(ctx.physicalDevice, &props);
+  const VkPhysicalDeviceLimits& limits = props.limits;
+  const uint32_t subgroupSize =
+      subgroupProperties(ctx.physicalDevice).subgroupSize;
+  if (options_.workgroupSize == 0) {
+    // Subgroup sizes are powers of two, so halving keeps a multiple.
+    options_.workgroupSize = std::max(kDefaultWorkgroupSize, subgroupSize);
+    while (options_.workgroupSize > subgroupSize &&
+           scatterSharedBytes(options_.workgroupSize, subgroupSize) >
+               limits.maxComputeSharedMemorySize) {
+      options_.workgroupSize /= 2;
+    }
+  }
+  if (options_.itemsPerThread == 0 ||
+      options_.workgroupSize % subgroupSize != 0 ||
+      options_.workgroupSize > limits.maxComputeWorkGroupSize[0] ||
+      options_.workgroupSize > limits.maxComputeWorkGroupInvocations ||
+      scatterSharedBytes(options_.workgroupSize, subgroupSize) >
+          limits.maxComputeSharedMemorySize) {
+    throw std::invalid_argument(fmt::format(
+        "Unsupported GpuRadixSort layout: {} invocations x {} items "
+        "(subgroup size {})",
+        options_.workgroupSize, options_.itemsPerThread, subgroupSize));
+  }
+  maxSubgroups_ = options_.workgroupSize / subgroupSize;
+
+  const uint32_t blockSize = options_.workgroupSize * options_.itemsPerThread;
+  const uint32_t maxBlocks = divideRoundingUp(std::max(maxCount_, 1u),
+                                              blockSize);
+  const VkDeviceSize keyBytes =
+      VkDeviceSize{std::max(maxCount_, 1u)} * keyWords_ * sizeof(uint32_t);
+  const VkDeviceSize valueBytes =
+      VkDeviceSize{std::max(maxCount_, 1u)} * sizeof(uint32_t);
+  for (size_t i = 0; i < 2; ++i) {
+    keys_[i] = createBuffer(*ctx.allocator, keyBytes);
+    values_[i] = createBuffer(*ctx.allocator, valueBytes);
+  }
+
+  uint32_t entries = maxBlocks * kRadix;
+  histograms_ = createBuffer(*ctx.allocator, entries * sizeof(uint32_t));
+  count_ = createBuffer(*ctx.allocator, sizeof(uint32_t));
+  while (true) {
+    const uint32_t groups = divideRoundingUp(entries, blockSize);
+    scanSums_.push_back(
+        createBuffer(*ctx.allocator, groups * sizeof(uint32_t)));
+    if (groups == 1) {
+      break;
+    }
+    entries = groups;
+  }
+
+  createDescriptors();
+  createPipelines(ctx.pipelineCache);
+}
+
+GpuRadixSort::StorageBuffer GpuRadixSort::createBuffer(
+    GpuAllocator& allocator, VkDeviceSize size) {
+  StorageBuffer result;
+  result.buffer =
+      Buffer(device_, VkBufferCreateInfo{
+                          .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                          .size = size,
+                          .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      });
+  result.memory = allocator.allocate(result.buffer.get(),
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  return result;
+}
+
+VkDescriptorBufferInfo GpuRadixSort::keys() const {
+  return {.buffer = keys_[0].buffer.get(), .range = VK_WHOLE_SIZE};
+}
+
+VkDescriptorBufferInfo GpuRadixSort::values() const {
+  return {.buffer = values_[0].buffer.get(), .range = VK_WHOLE_SIZE};
+}
+
+VkDescriptorBufferInfo GpuRadixSort::countBuffer() const {
+  return {.buffer = count_.buffer.get(), .range = VK_WHOLE_SIZE};
+}
+
+void GpuRadixSort::createDescriptors() {
+  // keysIn, valuesIn, keysOut, valuesOut, histograms, indirect count.
+  std::array<VkDescriptorSetLayoutBinding, 6> sortBindings{};
+  for (uint32_t i = 0; i < sortBindings.size(); ++i) {
+    sortBindings[i] = {
+        .binding = i,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+    };
+  }
+  sortSetLayout_ = DescriptorSetLayout(device_, sortBindings);
+
+  // data, sums.
+  const std::array<VkDescriptorSetLayoutBinding, 2> scanBindings{
+      sortBindings[0], sortBindings[1]};
+  scanSetLayout_ = DescriptorSetLayout(device_, scanBindings);
+
+  const auto scanSetCount = static_cast<uint32_t>(scanSums_.size());
+  const uint32_t setCount = 2 + scanSetCount;
+  descriptorPool_ = DescriptorPool(
+      device_, setCount,
+      VkDescriptorPoolSize{
+          .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .descriptorCount = 2 * static_cast<uint32_t>(sortBindings.size()) +
+                             scanSetCount * 2,
+      });
+
+  std::vector<VkDescriptorSetLayout> layouts(setCount,
+                                             scanSetLayout_.get());
+  layouts[0] = sortSetLayout_.get();
+  layouts[1] = sortSetLayout_.get();
+  std::vector<VkDescriptorSet> sets(setCount);
+  const VkDescriptorSetAllocateInfo dsai{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = descriptorPool_.get(),
+      .descriptorSetCount = setCount,
+      .pSetLayouts = layouts.data(),
+  };
+  VK_CHECK(vkAllocateDescriptorSets(device_, &dsai, sets.data()));
+  sortSets_ = {sets[0], sets[1]};
+  scanSets_.assign(sets.begin() + 2, sets.end());
+
+  const auto whole = [](const StorageBuffer& b) {
+    return VkDescriptorBufferInfo{.buffer = b.buffer.get(),
+                                  .range = VK_WHOLE_SIZE};
+  };
+  std::vector<VkDescriptorBufferInfo> infos;
+  std::vector<VkWriteDescriptorSet> writes;
+  infos.reserve(2 * sortBindings.size() + scanSetCount * 2);
+  const auto write = [&](VkDescriptorSet set, uint32_t binding,
+                         const StorageBuffer& b) {
+    infos.push_back(whole(b));
+    writes.push_back({
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set,
+        .dstBinding = binding,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &infos.back(),
+    });
+  };
+  for (size_t src = 0; src < 2; ++src) {
+    const size_t dst = 1 - src;
+    write(sortSets_[src], 0, keys_[src]);
+    write(sortSets_[src], 1, values_[src]);
+    write(sortSets_[src], 2, keys_[dst]);
+    write(sortSets_[src], 3, values_[dst]);
+    write(sortSets_[src], 4, histograms_);
+    write(sortSets_[src], 5, count_);
+  }
+  for (size_t level = 0; level < scanSets_.size(); ++level) {
+    write(scanSets_[level], 0,
+          level == 0 ? histograms_ : scanSums_[level - 1]);
+    write(scanSets_[level], 1, scanSums_[level]);
+  }
+  vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()),
+                         writes.data(), 0, nullptr);
+}
+
+void GpuRadixSort::createPipelines(VkPipelineCache cache) {
+  const VkPushConstantRange pcRange{
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      .size = sizeof(PushConstants),
+  };
+  const auto makeLayout = [&](const DescriptorSetLayout& setLayout) {
+    const VkDescriptorSetLayout handle = setLayout.get();
+    return PipelineLayout(
+        device_, VkPipelineLayoutCreateInfo{
+                     .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                     .setLayoutCount = 1,
+                     .pSetLayouts = &handle,
+                     .pushConstantRangeCount = 1,
+                     .pPushConstantRanges = &pcRange,
+                 });
+  };
+  sortLayout_ = makeLayout(sortSetLayout_);
+  scanLayout_ = makeLayout(scanSetLayout_);
+
+  const SpecializationData specData{
+      .workgroupSize = options_.workgroupSize,
+      .itemsPerThread = options_.itemsPerThread,
+      .maxSubgroups = maxSubgroups_,
+  };
+  const std::array<VkSpecializationMapEntry, 3> specEntries{{
+      {0, offsetof(SpecializationData, workgroupSize), sizeof(uint32_t)},
+      {1, offsetof(SpecializationData, itemsPerThread), sizeof(uint32_t)},
+      {2, offsetof(SpecializationData, maxSubgroups), sizeof(uint32_t)},
+  }};
+  const VkSpecializationInfo specInfo{
+      .mapEntryCount = static_cast<uint32_t>(specEntries.size()),
+      .pMapEntries = specEntries.data(),
+      .dataSize = sizeof(specData),
+      .pData = &specData,
+  };
+
+  const auto makePipeline = [&](const char* path,
+                                const PipelineLayout& layout) {
+    const ShaderModule module(device_, path);
+    return Pipeline(
+        device_,
+        VkComputePipelineCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage =
+                {
+                    .sType =
+                        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = module.get(),
+                    .pName = "main",
+                    .pSpecializationInfo = &specInfo,
+                },
+            .layout = layout.get(),
+        },
+        cache);
+  };
+  histogram_ =
+      makePipeline(SHADER_DIR "/radix_histogram.comp.spv", sortLayout_);
+  scan_ = makePipeline(SHADER_DIR "/radix_scan.comp.spv", scanLayout_);
+  scanAdd_ = makePipeline(SHADER_DIR "/radix_scan_add.comp.spv", scanLayout_);
+  scatter_ = makePipeline(SHADER_DIR "/radix_scatter.comp.spv", sortLayout_);
+}
+
+void GpuRadixSort::record(VkCommandBuffer cmd, uint32_t count,
+                          uint32_t keyBits,
+                          VkPipelineStageFlags consumerStages) const {
+  if (count > maxCount_) {
+    throw std::invalid_argument(fmt::format(
+        "Cannot sort {} keys (capacity {})", count, maxCount_));
+  }
+  recordPasses(cmd, count, false, keyBits, consumerStages);
+}
+
+void GpuRadixSort::recordIndirect(VkCommandBuffer cmd, uint32_t keyBits,
+                                  VkPipelineStageFlags consumerStages) const {
+  recordPasses(cmd, maxCount_, true, keyBits, consumerStages);
+}
+
+void GpuRadixSort::recordPasses(VkCommandBuffer cmd, uint32_t count,
+                                bool indirect, uint32_t keyBits,
+                                VkPipelineStageFlags consumerStages) const {
+  if (keyBits == 0 || keyBits > 32 * keyWords_) {
+    throw std::invalid_argument(fmt::format(
+        "Cannot sort keys of {} bits (at most {})", keyBits, 32 * keyWords_));
+  }
+
+  // The caller's key, value and count writes, and the previous sort's
+  // readers of the scratch buffers, all come before this sort.
+  const VkMemoryBarrier before{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask =
+          VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+  };
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &before, 0,
+                       nullptr, 0, nullptr);
+
+  // Indirect sorts size every dispatch for `count` (the capacity); blocks
+  // past the real count exit early.
+  const bool sorting = indirect || count > 1;
+  const uint32_t passes = divideRoundingUp(keyBits, kDigitBits);
+  const uint32_t blockSize = options_.workgroupSize * options_.itemsPerThread;
+  const uint32_t blockCount = divideRoundingUp(std::max(count, 1u), blockSize);
+  if (sorting) {
+    for (uint32_t pass = 0; pass < passes; ++pass) {
+      const PushConstants pc{
+          .count = count,
+          .shift = (pass % 4) * kDigitBits,
+          .keyWord = pass / 4,
+          .keyWords = keyWords_,
+          .blockCount = blockCount,
+          .indirect = indirect ? 1u : 0u,
+      };
+      const VkDescriptorSet set = sortSets_[pass % 2];
+
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, histogram_.get());
+      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                              sortLayout_.get(), 0, 1, &set, 0, nullptr);
+      vkCmdPushConstants(cmd, sortLayout_.get(), VK_SHADER_STAGE_COMPUTE_BIT,
+                         0, sizeof(pc), &pc);
+      vkCmdDispatch(cmd, blockCount, 1, 1);
+      computeBarrier(cmd);
+
+      recordScan(cmd, blockCount * kRadix);
+
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scatter_.get());
+      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                              sortLayout_.get(), 0, 1, &set, 0, nullptr);
+      vkCmdPushConstants(cmd, sortLayout_.get(), VK_SHADER_STAGE_COMPUTE_BIT,
+                         0, sizeof(pc), &pc);
+      vkCmdDispatch(cmd, blockCount, 1, 1);
+      computeBarrier(cmd);
+    }
+  }
+
+  // An odd number of passes leaves the result in the ping-pong copies.
+  if (sorting && passes % 2 == 1) {
+    const VkMemoryBarrier toCopy{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &toCopy, 0,
+                         nullptr, 0, nullptr);
+    const VkBufferCopy keyRegion{
+        .size = VkDeviceSize{count} * keyWords_ * sizeof(uint32_t)};
+    const VkBufferCopy valueRegion{
+        .size = VkDeviceSize{count} * sizeof(uint32_t)};
+    vkCmdCopyBuffer(cmd, keys_[1].buffer.get(), keys_[0].buffer.get(), 1,
+                    &keyRegion);
+    vkCmdCopyBuffer(cmd, values_[1].buffer.get(), values_[0].buffer.get(), 1,
+                    &valueRegion);
+  }
+
+  const VkMemoryBarrier after{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask =
+          VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+  };
+  vkCmdPipelineBarrier(
+      cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+      consumerStages, 0, 1, &after, 0, nullptr, 0, nullptr);
+}
+
+void GpuRadixSort::recordScan(VkCommandBuffer cmd, uint32_t entries) const {
+  const uint32_t blockSize = options_.workgroupSize * options_.itemsPerThread;
+
+  // Scan down the levels until one block covers everything...
+  std::vector<uint32_t> levelEntries;
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scan_.get());
+  for (size_t level = 0;; ++level) {
+    levelEntries.push_back(entries);
+    const uint32_t groups = divideRoundingUp(entries, blockSize);
+    const PushConstants pc{.count = entries};
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            scanLayout_.get(), 0, 1, &scanSets_[level], 0,
+                            nullptr);
+    vkCmdPushConstants(cmd, scanLayout_.get(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(pc), &pc);
+    vkCmdDispatch(cmd, groups, 1, 1);
+    computeBarrier(cmd);
+    if (groups == 1) {
+      break;
+    }
+    entries = groups;
+  }
+
+  // ...then add each level's scanned block totals back into the one above.
+  if (levelEntries.size() > 1) {
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scanAdd_.get());
+  }
+  for (size_t level = levelEntries.size() - 1; level-- > 0;) {
+    const PushConstants pc{.count = levelEntries[level]};
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            scanLayout_.get(), 0, 1, &scanSets_[level], 0,
+                            nullptr);
+    vkCmdPushConstants(cmd, scanLayout_.get(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(pc), &pc);
+    vkCmdDispatch(cmd, divideRoundingUp(levelEntries[level], blockSize), 1,
+                  1);
+    computeBarrier(cmd);
+  }
+}
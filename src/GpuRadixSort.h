@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "GpuAllocator.h"
+#include "Renderer.h"
+#include "VulkanHandles.h"
+
+// Sorts key/value pairs on the GPU with a least-significant-digit radix
+// sort: per 8-bit digit, a histogram pass, a multi-level exclusive scan and
+// a stable scatter. Keys are one or two 32-bit words (low word first), so
+// composite keys such as tile id above depth sort in one go; only the
+// requested low bits are visited.
+//
+// The sorter owns its key and value buffers, plus the ping-pong copies and
+// scan scratch. Callers fill keys() and values() from their own shaders and
+// read the sorted pairs back from the same buffers. When the number of pairs
+// is only known on the GPU, the producer writes it to countBuffer() and the
+// sort is recorded with recordIndirect(). Needs subgroup ballots in compute
+// shaders (see isSupported()).
+class GpuRadixSort {
+ public:
+  struct Options {
+    // Invocations per workgroup; a multiple of the subgroup size. 0 picks
+    // 256, or fewer where narrow subgroups would overflow the scatter
+    // pass's shared memory.
+    uint32_t workgroupSize = 0;
+    // Elements per invocation in the histogram and scatter passes, and
+    // scan entries per invocation. Larger blocks shorten the scan but leave
+    // fewer workgroups for small inputs.
+    uint32_t itemsPerThread = 16;
+  };
+
+  static bool isSupported(VkPhysicalDevice physicalDevice);
+
+  // Sorts up to `maxCount` pairs with `keyWords` (1 or 2) words per key.
+  GpuRadixSort(const Renderer::Context& ctx, uint32_t maxCount,
+               uint32_t keyWords);
+  GpuRadixSort(const Renderer::Context& ctx, uint32_t maxCount,
+               uint32_t keyWords, const Options& options);
+
+  GpuRadixSort(const GpuRadixSort&) = delete;
+  GpuRadixSort& operator=(const GpuRadixSort&) = delete;
+  GpuRadixSort(GpuRadixSort&&) = delete;
+  GpuRadixSort& operator=(GpuRadixSort&&) = delete;
+  ~GpuRadixSort() = default;
+
+  [[nodiscard]] uint32_t maxCount() const { return maxCount_; }
+  [[nodiscard]] uint32_t keyWords() const { return keyWords_; }
+  // The layout in use, with the workgroup size resolved.
+  [[nodiscard]] const Options& options() const { return options_; }
+  [[nodiscard]] VkDescriptorBufferInfo keys() const;
+  [[nodiscard]] VkDescriptorBufferInfo values() const;
+  // A single uint32 pair count read by recordIndirect().
+  [[nodiscard]] VkDescriptorBufferInfo countBuffer() const;
+
+  // Records a sort of the first `count` pairs by the low `keyBits` bits of
+  // their keys. Compute and transfer writes to keys() and values() recorded
+  // earlier are waited for; afterwards the sorted pairs are visible to
+  // shader and transfer reads in `consumerStages`.
+  void record(VkCommandBuffer cmd, uint32_t count, uint32_t keyBits,
+              VkPipelineStageFlags consumerStages) const;
+  // As record(), for the first min(countBuffer(), maxCount()) pairs. The
+  // passes are sized for maxCount(), so the cost of the dispatches that find
+  // nothing to do is paid as well.
+  void recordIndirect(VkCommandBuffer cmd, uint32_t keyBits,
+                      VkPipelineStageFlags consumerStages) const;
+
+ private:
+  struct StorageBuffer {
+    Buffer buffer;
+    GpuAllocation memory;
+  };
+
+  StorageBuffer createBuffer(GpuAllocator& allocator, VkDeviceSize size);
+  void createDescriptors();
+  void createPipelines(VkPipelineCache cache);
+  void recordPasses(VkCommandBuffer cmd, uint32_t count, bool indirect,
+                    uint32_t keyBits,
+                    VkPipelineStageFlags consumerStages) const;
+  void recordScan(VkCommandBuffer cmd, uint32_t entries) const;
+
+  VkDevice device_ = VK_NULL_HANDLE;
+  uint32_t maxCount_ = 0;
+  uint32_t keyWords_ = 1;
+  Options options_;
+  uint32_t maxSubgroups_ = 1;
+
+  // [0] holds the caller's data, [1] the odd passes' output.
+  std::array<StorageBuffer, 2> keys_;
+  std::array<StorageBuffer, 2> values_;
+  StorageBuffer histograms_;
+  StorageBuffer count_;
+  // One per scan level; level n scans level n-1's sums (level 0 scans the
+  // histograms).
+  std::vector<StorageBuffer> scanSums_;
+
+  DescriptorSetLayout sortSetLayout_;
+  DescriptorSetLayout scanSetLayout_;
+  DescriptorPool descriptorPool_;
+  // [0] reads the caller's buffers, [1] the ping-pong copies.
+  std::array<VkDescriptorSet, 2> sortSets_{};
+  std::vector<VkDescriptorSet> scanSets_;
+
+  PipelineLayout sortLayout_;
+  PipelineLayout scanLayout_;
+  Pipeline histogram_;
+  Pipeline scan_;
+  Pipeline scanAdd_;
+  Pipeline scatter_;
+};
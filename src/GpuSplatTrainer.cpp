@@ -0,0 +1,1451 @@
+#include "GpuSplatTrainer.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+
+#include "UploadManager.h"
+#include "VulkanCompute.h"
+#include "VulkanErrors.h"
+#include "VulkanShaders.h"
+
+#ifndef SHADER_DIR
+#define SHADER_DIR "shaders"
+#endif
+
+namespace {
+
+// Matches shaders/tile_common.glsl and shaders/train_common.glsl.
+constexpr uint32_t kTileSize = 16;
+constexpr uint32_t kScreenGradients = 9;
+constexpr VkDeviceSize kTrainSplatSize = 48;
+constexpr VkDeviceSize kPixelStateSize = 8;
+// Matches kSsimTermFloats in shaders/train_ssim.glsl.
+constexpr VkDeviceSize kSsimTermSize = 15 * sizeof(float);
+// local_size_x of train_project.comp, train_step.comp and tile_ranges.comp.
+constexpr uint32_t kWorkgroupSize = 256;
+// Invocations per workgroup and instances per batch in train_backward.comp.
+constexpr uint32_t kBackwardInvocations = kTileSize * kTileSize;
+constexpr uint32_t kBackwardBatch = 32;
+// Bounds of the instance capacity picked when Options::maxInstances is 0.
+constexpr uint32_t kMinDefaultInstances = uint32_t{1} << 20;
+constexpr uint32_t kMaxDefaultInstances = uint32_t{1} << 24;
+
+// Set 0 bindings beside the parameters (see shaders/train_data.glsl).
+constexpr uint32_t kProjectedBinding = 5;
+constexpr uint32_t kInstanceGradientsBinding = 6;
+constexpr uint32_t kKeysBinding = 7;
+constexpr uint32_t kValuesBinding = 8;
+constexpr uint32_t kCountBinding = 9;
+constexpr uint32_t kInstanceSplatsBinding = 10;
+// train_step.comp's moments follow the parameters' order from here.
+constexpr uint32_t kMomentsBinding = 7;
+constexpr uint32_t kStepDensifyStatsBinding = 12;
+
+// Set 0 bindings of the densify passes (see shaders/train_densify.glsl).
+constexpr uint32_t kDensifyStatsBinding = 5;
+constexpr uint32_t kOutputsBinding = 6;
+constexpr uint32_t kTotalsBinding = 7;
+// train_densify_scatter.comp reads the scanned outputs at kOutputsBinding
+// and the source moments from kSourceMomentsBinding, in the parameters'
+// order, as it does the destination parameters, their moments and the
+// fresh statistics.
+constexpr uint32_t kSourceMomentsBinding = 8;
+constexpr uint32_t kDestinationBinding = 13;
+constexpr uint32_t kDestinationMomentsBinding = 18;
+constexpr uint32_t kDestinationStatsBinding = 23;
+// Output count, cloned, split, pruned (the Totals block of
+// train_densify_mark.comp).
+constexpr VkDeviceSize kDensifyTotalsSize = 4 * sizeof(uint32_t);
+// The densify prefix sum runs radix_scan.comp and radix_scan_add.comp with
+// these specialization constants.
+constexpr uint32_t kScanWorkgroupSize = 256;
+constexpr uint32_t kScanItemsPerThread = 16;
+
+// The readback buffer holds the instance count, then the per-tile loss sums
+// (vec2s).
+constexpr VkDeviceSize kLossSumsOffset = 8;
+constexpr VkDeviceSize kLossSumSize = 2 * sizeof(float);
+
+// Kept off the activations' flat ends when converting the initial cloud.
+constexpr float kMinScale = 1e-7f;
+constexpr float kOpacityEpsilon = 1e-4f;
+
+// Matches the Iteration block in shaders/train_common.glsl (std140).
+struct IterationUniforms {
+  Mat4 view;
+  std::array<float, 4> cameraPos;
+  std::array<float, 2> focal;
+  std::array<float, 2> viewport;
+  std::array<float, 2> tanHalfFov;
+  std::array<uint32_t, 2> tiles;
+  uint32_t capacity;
+  uint32_t count;
+  float ssimWeight;
+  float lossScale;
+  std::array<float, 4> rates;
+  std::array<float, 2> shRates;
+  float beta1;
+  float beta2;
+  float epsilon;
+  float correction1;
+  float correction2;
+  float padding;
+};
+static_assert(sizeof(IterationUniforms) == 176);
+
+// Matches the constant_ids in splat_project.glsl.
+struct ShSpecialization {
+  uint32_t degree;
+  uint32_t coeffs;
+};
+
+// Matches PushConstants in tile_ranges.comp.
+struct RangesPushConstants {
+  uint32_t capacity;
+};
+
+// Matches PushConstants in shaders/train_densify.glsl.
+struct DensifyPushConstants {
+  uint32_t count;
+  uint32_t shFloats;
+  uint32_t seed;
+  float gradientThreshold;
+  float scaleThreshold;
+  float minOpacity;
+};
+
+// Matches PushConstants in shaders/radix_sort.glsl; the scan passes only
+// read the count.
+struct ScanPushConstants {
+  uint32_t count;
+  std::array<uint32_t, 5> unused;
+};
+
+// Matches the constant_ids in shaders/radix_sort.glsl.
+struct ScanSpecialization {
+  uint32_t workgroupSize;
+  uint32_t itemsPerThread;
+};
+
+// Shared memory of train_backward.comp: the staged batch (vec3s counted at
+// a 16-byte stride), one partial sum per gradient, instance and subgroup,
+// and the furthest instance visited.
+size_t backwardSharedBytes(uint32_t maxSubgroups) {
+  return size_t{kBackwardBatch} * (8 + 16 + 16 + 4) +
+         size_t{maxSubgroups} * kBackwardBatch * kScreenGradients *
+             sizeof(float) +
+         sizeof(uint32_t);
+}
+
+}  // namespace
+
+bool GpuSplatTrainer::isSupported(VkPhysicalDevice physicalDevice) {
+  const VkPhysicalDeviceSubgroupProperties subgroup =
+      subgroupProperties(physicalDevice);
+  return GpuRadixSort::isSupported(physicalDevice) &&
+         (subgroup.supportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT) !=
+             0;
+}
+
+GpuSplatTrainer::GpuSplatTrainer(const Renderer::Context& ctx,
+                                 const SplatCloud& initial,
+                                 const Options& options)
+    : ctx_(ctx),
+      device_(ctx.device),
+      physicalDevice_(ctx.physicalDevice),
+      queue_(ctx.graphicsQueue),
+      pipelineCache_(ctx.pipelineCache),
+      allocator_(ctx.allocator),
+      uploads_(ctx.uploads),
+      options_(options),
+      count_(static_cast<uint32_t>(initial.count)),
+      shDegree_(initial.shDegree) {
+  if (!isSupported(physicalDevice_)) {
+    throw std::runtime_error(
+        "GpuSplatTrainer needs subgroup arithmetic in compute shaders");
+  }
+  if (initial.count == 0) {
+    throw std::invalid_argument("GpuSplatTrainer needs at least one splat");
+  }
+  if (options_.iterationsInFlight == 0) {
+    throw std::invalid_argument(
+        "GpuSplatTrainer needs at least one iteration in flight");
+  }
+  subgroupSize_ = subgroupProperties(physicalDevice_).subgroupSize;
+
+  commandPool_ = CommandPool(
+      device_, VkCommandPoolCreateInfo{
+                   .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                   .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                   .queueFamilyIndex = ctx.queueFamily,
+               });
+  sampler_ = Sampler(device_,
+                     VkSamplerCreateInfo{
+                         .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+                         .magFilter = VK_FILTER_NEAREST,
+                         .minFilter = VK_FILTER_NEAREST,
+                         .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+                         .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                         .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                         .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                         .maxLod = 0.0f,
+                     });
+
+  projected_ = createBuffer(VkDeviceSize{count_} * kTrainSplatSize,
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  createInstanceBuffers(options_.maxInstances != 0
+                            ? options_.maxInstances
+                            : defaultMaxInstances(initial.count));
+  uploadParameters(initial);
+
+  slots_.resize(options_.iterationsInFlight);
+  std::vector<VkCommandBuffer> commandBuffers(slots_.size());
+  const VkCommandBufferAllocateInfo ai{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = commandPool_.get(),
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = static_cast<uint32_t>(commandBuffers.size()),
+  };
+  VK_CHECK(vkAllocateCommandBuffers(device_, &ai, commandBuffers.data()));
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    Slot& slot = slots_[i];
+    slot.cmd = commandBuffers[i];
+    slot.fence =
+        Fence(device_, VkFenceCreateInfo{
+                           .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                       });
+    slot.uniforms = createBuffer(sizeof(IterationUniforms),
+                                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+
+  createDescriptors();
+  createPipelines();
+}
+
+GpuSplatTrainer::~GpuSplatTrainer() { finish(); }
+
+uint32_t GpuSplatTrainer::defaultMaxInstances(size_t splatCount) {
+  return static_cast<uint32_t>(std::clamp<uint64_t>(
+      uint64_t{splatCount} * 8, kMinDefaultInstances, kMaxDefaultInstances));
+}
+
+void GpuSplatTrainer::createInstanceBuffers(uint32_t capacity) {
+  // Freed first, so the old and new buffers never coexist.
+  sort_.reset();
+  instanceSplats_ = StorageBuffer{};
+  instanceGradients_ = StorageBuffer{};
+  sort_ = std::make_unique<GpuRadixSort>(ctx_, capacity, 2);
+  instanceSplats_ = createBuffer(VkDeviceSize{capacity} * sizeof(uint32_t),
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  instanceGradients_ = createBuffer(
+      VkDeviceSize{capacity} * kScreenGradients * sizeof(float),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+GpuSplatTrainer::StorageBuffer GpuSplatTrainer::createBuffer(
+    VkDeviceSize size, VkBufferUsageFlags usage,
+    VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred) {
+  StorageBuffer result;
+  result.buffer = Buffer(device_, VkBufferCreateInfo{
+                                      .sType =
+                                          VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                                      .size = size,
+                                      .usage = usage,
+                                  });
+  result.memory =
+      allocator_->allocate(result.buffer.get(), required, preferred);
+  return result;
+}
+
+uint32_t GpuSplatTrainer::parameterFloats(size_t p) const {
+  switch (p) {
+    case kPositions:
+    case kLogScales:
+      return 3;
+    case kRotations:
+      return 4;
+    case kOpacityLogits:
+      return 1;
+    default:
+      return 3 * static_cast<uint32_t>(SplatCloud::shCoefficients(shDegree_));
+  }
+}
+
+GpuSplatTrainer::ParameterSet GpuSplatTrainer::createParameterSet(
+    uint32_t capacity) {
+  ParameterSet set;
+  set.capacity = capacity;
+  // The first set is written by the upload queue; every set is then read
+  // and written by compute and copied from by download().
+  const std::vector<uint32_t>& families = uploads_->queueFamilies();
+  for (size_t p = 0; p < kParameterCount; ++p) {
+    const VkDeviceSize size =
+        VkDeviceSize{capacity} * parameterFloats(p) * sizeof(float);
+    StorageBuffer& parameter = set.parameters[p];
+    parameter.buffer = Buffer(
+        device_,
+        VkBufferCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = size,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .sharingMode = families.size() > 1 ? VK_SHARING_MODE_CONCURRENT
+                                               : VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = static_cast<uint32_t>(families.size()),
+            .pQueueFamilyIndices = families.data(),
+        });
+    parameter.memory = allocator_->allocate(
+        parameter.buffer.get(), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    set.moments[p] = createBuffer(2 * size,
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+  set.densifyStats = createBuffer(
+      VkDeviceSize{capacity} * 2 * sizeof(float),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  return set;
+}
+
+void GpuSplatTrainer::uploadParameters(const SplatCloud& cloud) {
+  // Stored unactivated, as Adam steps them.
+  std::array<std::vector<float>, kParameterCount> raw;
+  raw[kPositions] = cloud.positions;
+  raw[kLogScales].resize(cloud.scales.size());
+  std::transform(cloud.scales.begin(), cloud.scales.end(),
+                 raw[kLogScales].begin(),
+                 [](float s) { return std::log(std::max(s, kMinScale)); });
+  raw[kRotations] = cloud.rotations;
+  raw[kOpacityLogits].resize(cloud.opacities.size());
+  std::transform(cloud.opacities.begin(), cloud.opacities.end(),
+                 raw[kOpacityLogits].begin(), [](float o) {
+                   const float p =
+                       std::clamp(o, kOpacityEpsilon, 1.0f - kOpacityEpsilon);
+                   return std::log(p / (1.0f - p));
+                 });
+  raw[kSh] = cloud.sh;
+
+  current_ = createParameterSet(count_);
+  for (size_t p = 0; p < kParameterCount; ++p) {
+    const VkDeviceSize size = raw[p].size() * sizeof(float);
+    parametersTicket_ = uploads_->uploadBuffer(
+        current_.parameters[p].buffer.get(), 0, size,
+        [&](uint8_t* dst) { std::memcpy(dst, raw[p].data(), size); });
+  }
+  uploads_->flush();
+
+  submitAndWait([&](VkCommandBuffer cmd) {
+    for (const StorageBuffer& moments : current_.moments) {
+      vkCmdFillBuffer(cmd, moments.buffer.get(), 0, VK_WHOLE_SIZE, 0);
+    }
+    vkCmdFillBuffer(cmd, current_.densifyStats.buffer.get(), 0, VK_WHOLE_SIZE,
+                    0);
+  });
+}
+
+void GpuSplatTrainer::createDescriptors() {
+  constexpr VkDescriptorType kBuffer = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  constexpr VkShaderStageFlags kCompute = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  uint32_t bufferDescriptors = 0;
+  const auto makeSetLayout = [&](std::initializer_list<uint32_t> bindings) {
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+    for (const uint32_t binding : bindings) {
+      layoutBindings.push_back(layoutBinding(binding, kBuffer, kCompute));
+    }
+    bufferDescriptors += static_cast<uint32_t>(bindings.size());
+    return DescriptorSetLayout(device_, layoutBindings);
+  };
+  projectSetLayout_ = makeSetLayout(
+      {kPositions, kLogScales, kRotations, kOpacityLogits, kSh,
+       kProjectedBinding, kKeysBinding, kValuesBinding, kCountBinding,
+       kInstanceSplatsBinding});
+  // keys, count, ranges.
+  rangesSetLayout_ = makeSetLayout({0, 1, 2});
+  // values, ranges, projected, instance splats, image, states.
+  rasterSetLayout_ = makeSetLayout({0, 1, 2, 3, 4, 5});
+  // image, SSIM terms, loss sums.
+  lossSetLayout_ = makeSetLayout({0, 1, 2});
+  // image, SSIM terms, image gradient.
+  lossGradSetLayout_ = makeSetLayout({0, 1, 2});
+  // values, ranges, projected, instance splats, states, image gradient,
+  // instance gradients.
+  backwardSetLayout_ = makeSetLayout({0, 1, 2, 3, 4, 5, 6});
+  stepSetLayout_ = makeSetLayout(
+      {kPositions, kLogScales, kRotations, kOpacityLogits, kSh,
+       kProjectedBinding, kInstanceGradientsBinding, kMomentsBinding + 0,
+       kMomentsBinding + 1, kMomentsBinding + 2, kMomentsBinding + 3,
+       kMomentsBinding + 4, kStepDensifyStatsBinding});
+  iterationSetLayout_ = DescriptorSetLayout(
+      device_,
+      layoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kCompute));
+  targetSetLayout_ = DescriptorSetLayout(
+      device_,
+      layoutBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kCompute));
+
+  // One set per pass, plus the uniforms per slot.
+  const std::array<VkDescriptorSetLayout, 7> passLayouts{
+      projectSetLayout_.get(), rangesSetLayout_.get(),
+      rasterSetLayout_.get(),  lossSetLayout_.get(),
+      lossGradSetLayout_.get(), backwardSetLayout_.get(),
+      stepSetLayout_.get(),
+  };
+  const auto slotCount = static_cast<uint32_t>(slots_.size());
+  const std::array<VkDescriptorPoolSize, 2> poolSizes{{
+      {.type = kBuffer, .descriptorCount = bufferDescriptors},
+      {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+       .descriptorCount = slotCount},
+  }};
+  descriptorPool_ = DescriptorPool(
+      device_, static_cast<uint32_t>(passLayouts.size()) + slotCount,
+      poolSizes);
+
+  std::array<VkDescriptorSet, passLayouts.size()> passSets{};
+  const VkDescriptorSetAllocateInfo passAi{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = descriptorPool_.get(),
+      .descriptorSetCount = static_cast<uint32_t>(passLayouts.size()),
+      .pSetLayouts = passLayouts.data(),
+  };
+  VK_CHECK(vkAllocateDescriptorSets(device_, &passAi, passSets.data()));
+  projectSet_ = passSets[0];
+  rangesSet_ = passSets[1];
+  rasterSet_ = passSets[2];
+  lossSet_ = passSets[3];
+  lossGradSet_ = passSets[4];
+  backwardSet_ = passSets[5];
+  stepSet_ = passSets[6];
+
+  const VkDescriptorSetLayout iterationLayout = iterationSetLayout_.get();
+  for (Slot& slot : slots_) {
+    const VkDescriptorSetAllocateInfo slotAi{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptorPool_.get(),
+        .descriptorSetCount = 1,
+        .pSetLayouts = &iterationLayout,
+    };
+    VK_CHECK(vkAllocateDescriptorSets(device_, &slotAi, &slot.iterationSet));
+    const VkDescriptorBufferInfo info{
+        .buffer = slot.uniforms.buffer.get(),
+        .range = sizeof(IterationUniforms),
+    };
+    const VkWriteDescriptorSet write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = slot.iterationSet,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .pBufferInfo = &info,
+    };
+    vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+  }
+
+  // The densify passes' sets come from densifyPool_ (see reserveDensify()).
+  const auto makeDensifyLayout = [&](const std::vector<uint32_t>& bindings) {
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+    for (const uint32_t binding : bindings) {
+      layoutBindings.push_back(layoutBinding(binding, kBuffer, kCompute));
+    }
+    return DescriptorSetLayout(device_, layoutBindings);
+  };
+  markBindings_ = {kPositions,      kLogScales, kRotations,
+                   kOpacityLogits,  kSh,        kDensifyStatsBinding,
+                   kOutputsBinding, kTotalsBinding};
+  markSetLayout_ = makeDensifyLayout(markBindings_);
+  scatterBindings_ = {kPositions,     kLogScales, kRotations,
+                      kOpacityLogits, kSh,        kDensifyStatsBinding,
+                      kOutputsBinding};
+  for (uint32_t p = 0; p < kParameterCount; ++p) {
+    scatterBindings_.push_back(kSourceMomentsBinding + p);
+    scatterBindings_.push_back(kDestinationBinding + p);
+    scatterBindings_.push_back(kDestinationMomentsBinding + p);
+  }
+  scatterBindings_.push_back(kDestinationStatsBinding);
+  scatterSetLayout_ = makeDensifyLayout(scatterBindings_);
+  // data, sums.
+  scanSetLayout_ = makeSetLayout({0, 1});
+}
+
+void GpuSplatTrainer::writeDescriptors() {
+  // The per-image buffers come with the first view.
+  if (pixelCapacity_ == 0) {
+    return;
+  }
+  const auto whole = [](const StorageBuffer& buffer) {
+    return VkDescriptorBufferInfo{.buffer = buffer.buffer.get(),
+                                  .range = VK_WHOLE_SIZE};
+  };
+  std::array<VkDescriptorBufferInfo, kParameterCount> parameters{};
+  std::array<VkDescriptorBufferInfo, kParameterCount> moments{};
+  for (size_t p = 0; p < kParameterCount; ++p) {
+    parameters[p] = whole(current_.parameters[p]);
+    moments[p] = whole(current_.moments[p]);
+  }
+  const VkDescriptorBufferInfo densifyStats = whole(current_.densifyStats);
+  const VkDescriptorBufferInfo keys = sort_->keys();
+  const VkDescriptorBufferInfo values = sort_->values();
+  const VkDescriptorBufferInfo count = sort_->countBuffer();
+  const VkDescriptorBufferInfo projected = whole(projected_);
+  const VkDescriptorBufferInfo instanceSplats = whole(instanceSplats_);
+  const VkDescriptorBufferInfo instanceGradients = whole(instanceGradients_);
+  const VkDescriptorBufferInfo ranges = whole(tileRanges_);
+  const VkDescriptorBufferInfo image = whole(image_);
+  const VkDescriptorBufferInfo states = whole(states_);
+  const VkDescriptorBufferInfo ssimTerms = whole(ssimTerms_);
+  const VkDescriptorBufferInfo imageGradient = whole(imageGradient_);
+  const VkDescriptorBufferInfo lossSums = whole(lossSums_);
+
+  std::vector<VkWriteDescriptorSet> writes;
+  const auto write = [&](VkDescriptorSet set, uint32_t binding,
+                         const VkDescriptorBufferInfo& info) {
+    writes.push_back({
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set,
+        .dstBinding = binding,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &info,
+    });
+  };
+  for (uint32_t p = 0; p < kParameterCount; ++p) {
+    write(projectSet_, p, parameters[p]);
+    write(stepSet_, p, parameters[p]);
+    write(stepSet_, kMomentsBinding + p, moments[p]);
+  }
+  write(projectSet_, kProjectedBinding, projected);
+  write(projectSet_, kKeysBinding, keys);
+  write(projectSet_, kValuesBinding, values);
+  write(projectSet_, kCountBinding, count);
+  write(projectSet_, kInstanceSplatsBinding, instanceSplats);
+
+  write(rangesSet_, 0, keys);
+  write(rangesSet_, 1, count);
+  write(rangesSet_, 2, ranges);
+
+  write(rasterSet_, 0, values);
+  write(rasterSet_, 1, ranges);
+  write(rasterSet_, 2, projected);
+  write(rasterSet_, 3, instanceSplats);
+  write(rasterSet_, 4, image);
+  write(rasterSet_, 5, states);
+
+  write(lossSet_, 0, image);
+  write(lossSet_, 1, ssimTerms);
+  write(lossSet_, 2, lossSums);
+
+  write(lossGradSet_, 0, image);
+  write(lossGradSet_, 1, ssimTerms);
+  write(lossGradSet_, 2, imageGradient);
+
+  write(backwardSet_, 0, values);
+  write(backwardSet_, 1, ranges);
+  write(backwardSet_, 2, projected);
+  write(backwardSet_, 3, instanceSplats);
+  write(backwardSet_, 4, states);
+  write(backwardSet_, 5, imageGradient);
+  write(backwardSet_, 6, instanceGradients);
+
+  write(stepSet_, kProjectedBinding, projected);
+  write(stepSet_, kInstanceGradientsBinding, instanceGradients);
+  write(stepSet_, kStepDensifyStatsBinding, densifyStats);
+
+  vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()),
+                         writes.data(), 0, nullptr);
+}
+
+void GpuSplatTrainer::createPipelines() {
+  const auto makeLayout =
+      [&](std::initializer_list<VkDescriptorSetLayout> setLayouts,
+          uint32_t pushConstantSize) {
+        const VkPushConstantRange pcRange{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .size = pushConstantSize,
+        };
+        return PipelineLayout(
+            device_,
+            VkPipelineLayoutCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                .setLayoutCount = static_cast<uint32_t>(setLayouts.size()),
+                .pSetLayouts = setLayouts.begin(),
+                .pushConstantRangeCount = pushConstantSize > 0 ? 1u : 0u,
+                .pPushConstantRanges = &pcRange,
+            });
+      };
+  const auto makeCompute = [&](const char* path, const PipelineLayout& layout,
+                               const VkSpecializationInfo* specInfo =
+                                   nullptr) {
+    const ShaderModule module(device_, path);
+    return Pipeline(
+        device_,
+        VkComputePipelineCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage =
+                {
+                    .sType =
+                        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = module.get(),
+                    .pName = "main",
+                    .pSpecializationInfo = specInfo,
+                },
+            .layout = layout.get(),
+        },
+        pipelineCache_);
+  };
+
+  const VkDescriptorSetLayout iteration = iterationSetLayout_.get();
+  const VkDescriptorSetLayout target = targetSetLayout_.get();
+  projectLayout_ = makeLayout({projectSetLayout_.get(), iteration}, 0);
+  rangesLayout_ =
+      makeLayout({rangesSetLayout_.get()}, sizeof(RangesPushConstants));
+  rasterLayout_ = makeLayout({rasterSetLayout_.get(), iteration}, 0);
+  lossLayout_ = makeLayout({lossSetLayout_.get(), iteration, target}, 0);
+  lossGradLayout_ =
+      makeLayout({lossGradSetLayout_.get(), iteration, target}, 0);
+  backwardLayout_ = makeLayout({backwardSetLayout_.get(), iteration}, 0);
+  stepLayout_ = makeLayout({stepSetLayout_.get(), iteration}, 0);
+  markLayout_ =
+      makeLayout({markSetLayout_.get()}, sizeof(DensifyPushConstants));
+  scatterLayout_ =
+      makeLayout({scatterSetLayout_.get()}, sizeof(DensifyPushConstants));
+  scanLayout_ = makeLayout({scanSetLayout_.get()}, sizeof(ScanPushConstants));
+
+  // The projection and the step are specialized per SH degree trained; the
+  // coefficient stride is always the cloud's.
+  const std::array<VkSpecializationMapEntry, 2> shEntries{{
+      {0, offsetof(ShSpecialization, degree), sizeof(uint32_t)},
+      {1, offsetof(ShSpecialization, coeffs), sizeof(uint32_t)},
+  }};
+  for (int degree = 0; degree <= shDegree_; ++degree) {
+    const ShSpecialization specData{
+        .degree = static_cast<uint32_t>(degree),
+        .coeffs = static_cast<uint32_t>(SplatCloud::shCoefficients(shDegree_)),
+    };
+    const VkSpecializationInfo specInfo{
+        .mapEntryCount = static_cast<uint32_t>(shEntries.size()),
+        .pMapEntries = shEntries.data(),
+        .dataSize = sizeof(specData),
+        .pData = &specData,
+    };
+    project_[static_cast<size_t>(degree)] = makeCompute(
+        SHADER_DIR "/train_project.comp.spv", projectLayout_, &specInfo);
+    step_[static_cast<size_t>(degree)] = makeCompute(
+        SHADER_DIR "/train_step.comp.spv", stepLayout_, &specInfo);
+  }
+  ranges_ = makeCompute(SHADER_DIR "/tile_ranges.comp.spv", rangesLayout_);
+  raster_ = makeCompute(SHADER_DIR "/train_raster.comp.spv", rasterLayout_);
+  loss_ = makeCompute(SHADER_DIR "/train_loss.comp.spv", lossLayout_);
+  lossGrad_ =
+      makeCompute(SHADER_DIR "/train_loss_grad.comp.spv", lossGradLayout_);
+
+  // The backward pass sums across subgroups in shared memory.
+  const uint32_t maxSubgroups =
+      std::max(kBackwardInvocations / subgroupSize_, 1u);
+  VkPhysicalDeviceProperties props{};
+  vkGetPhysicalDeviceProperties(physicalDevice_, &props);
+  const size_t sharedBytes = backwardSharedBytes(maxSubgroups);
+  if (sharedBytes > props.limits.maxComputeSharedMemorySize) {
+    throw std::runtime_error(fmt::format(
+        "GpuSplatTrainer's backward pass needs {} bytes of shared memory "
+        "with {}-wide subgroups; the device has {}",
+        sharedBytes, subgroupSize_, props.limits.maxComputeSharedMemorySize));
+  }
+  const VkSpecializationMapEntry subgroupEntry{0, 0, sizeof(uint32_t)};
+  const VkSpecializationInfo subgroupInfo{
+      .mapEntryCount = 1,
+      .pMapEntries = &subgroupEntry,
+      .dataSize = sizeof(maxSubgroups),
+      .pData = &maxSubgroups,
+  };
+  backward_ = makeCompute(SHADER_DIR "/train_backward.comp.spv",
+                          backwardLayout_, &subgroupInfo);
+
+  mark_ = makeCompute(SHADER_DIR "/train_densify_mark.comp.spv", markLayout_);
+  scatter_ =
+      makeCompute(SHADER_DIR "/train_densify_scatter.comp.spv", scatterLayout_);
+  const std::array<VkSpecializationMapEntry, 2> scanEntries{{
+      {0, offsetof(ScanSpecialization, workgroupSize), sizeof(uint32_t)},
+      {1, offsetof(ScanSpecialization, itemsPerThread), sizeof(uint32_t)},
+  }};
+  const ScanSpecialization scanData{
+      .workgroupSize = kScanWorkgroupSize,
+      .itemsPerThread = kScanItemsPerThread,
+  };
+  const VkSpecializationInfo scanInfo{
+      .mapEntryCount = static_cast<uint32_t>(scanEntries.size()),
+      .pMapEntries = scanEntries.data(),
+      .dataSize = sizeof(scanData),
+      .pData = &scanData,
+  };
+  scan_ = makeCompute(SHADER_DIR "/radix_scan.comp.spv", scanLayout_,
+                      &scanInfo);
+  scanAdd_ = makeCompute(SHADER_DIR "/radix_scan_add.comp.spv", scanLayout_,
+                         &scanInfo);
+}
+
+uint32_t GpuSplatTrainer::addView(const View& view, const ImageData& image) {
+  const VkExtent2D extent = view.extent;
+  if (extent.width == 0 || extent.height == 0) {
+    throw std::invalid_argument("Training views must not be empty");
+  }
+  if (static_cast<uint32_t>(image.width) != extent.width ||
+      static_cast<uint32_t>(image.height) != extent.height) {
+    throw std::invalid_argument(fmt::format(
+        "Training image is {}x{} but its view is {}x{}", image.width,
+        image.height, extent.width, extent.height));
+  }
+  const VkFormat format = toVkFormat(image.format);
+  VkFormatProperties formatProps{};
+  vkGetPhysicalDeviceFormatProperties(physicalDevice_, format, &formatProps);
+  constexpr VkFormatFeatureFlags kRequiredFeatures =
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+  if ((formatProps.optimalTilingFeatures & kRequiredFeatures) !=
+      kRequiredFeatures) {
+    throw std::runtime_error(
+        fmt::format("Training image format {} is not supported for sampling",
+                    static_cast<int>(format)));
+  }
+
+  reserveImage(extent);
+
+  TrainingView& training = views_.emplace_back();
+  training.view = view;
+  // Written by the upload queue and read by compute.
+  const std::vector<uint32_t>& families = uploads_->queueFamilies();
+  training.image =
+      Image(device_, VkImageCreateInfo{
+                         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                         .imageType = VK_IMAGE_TYPE_2D,
+                         .format = format,
+                         .extent = {extent.width, extent.height, 1},
+                         .mipLevels = 1,
+                         .arrayLayers = 1,
+                         .samples = VK_SAMPLE_COUNT_1_BIT,
+                         .tiling = VK_IMAGE_TILING_OPTIMAL,
+                         .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                  VK_IMAGE_USAGE_SAMPLED_BIT,
+                         .sharingMode = families.size() > 1
+                                            ? VK_SHARING_MODE_CONCURRENT
+                                            : VK_SHARING_MODE_EXCLUSIVE,
+                         .queueFamilyIndexCount =
+                             static_cast<uint32_t>(families.size()),
+                         .pQueueFamilyIndices = families.data(),
+                     });
+  training.memory = allocator_->allocate(training.image.get(),
+                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  training.uploadTicket = uploads_->uploadImage(
+      training.image.get(), {extent.width, extent.height, 1},
+      image.pixels.size(), [&](uint8_t* dst) {
+        std::memcpy(dst, image.pixels.data(), image.pixels.size());
+      });
+  uploads_->flush();
+
+  training.imageView =
+      ImageView(device_, VkImageViewCreateInfo{
+                             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                             .image = training.image.get(),
+                             .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                             .format = format,
+                             .subresourceRange =
+                                 {
+                                     .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                     .levelCount = 1,
+                                     .layerCount = 1,
+                                 },
+                         });
+
+  training.descriptorPool = DescriptorPool(
+      device_, 1,
+      VkDescriptorPoolSize{
+          .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          .descriptorCount = 1,
+      });
+  const VkDescriptorSetLayout targetLayout = targetSetLayout_.get();
+  const VkDescriptorSetAllocateInfo dsai{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = training.descriptorPool.get(),
+      .descriptorSetCount = 1,
+      .pSetLayouts = &targetLayout,
+  };
+  VK_CHECK(vkAllocateDescriptorSets(device_, &dsai, &training.targetSet));
+  const VkDescriptorImageInfo imageInfo{
+      .sampler = sampler_.get(),
+      .imageView = training.imageView.get(),
+      .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+  };
+  const VkWriteDescriptorSet write{
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet = training.targetSet,
+      .dstBinding = 0,
+      .descriptorCount = 1,
+      .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      .pImageInfo = &imageInfo,
+  };
+  vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+
+  return static_cast<uint32_t>(views_.size() - 1);
+}
+
+void GpuSplatTrainer::reserveImage(VkExtent2D extent) {
+  const uint32_t pixels = extent.width * extent.height;
+  const uint32_t tiles = divideRoundingUp(extent.width, kTileSize) *
+                         divideRoundingUp(extent.height, kTileSize);
+  if (pixels <= pixelCapacity_ && tiles <= tileCapacity_) {
+    return;
+  }
+  // The queued iterations still use the old buffers.
+  finish();
+  pixelCapacity_ = std::max(pixelCapacity_, pixels);
+  tileCapacity_ = std::max(tileCapacity_, tiles);
+  lastExtent_ = {};
+
+  const VkDeviceSize pixelCount = pixelCapacity_;
+  const VkDeviceSize tileCount = tileCapacity_;
+  constexpr VkBufferUsageFlags kStorage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  constexpr VkMemoryPropertyFlags kDeviceLocal =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  image_ = createBuffer(pixelCount * 4 * sizeof(float),
+                        kStorage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                        kDeviceLocal);
+  states_ = createBuffer(pixelCount * kPixelStateSize, kStorage, kDeviceLocal);
+  ssimTerms_ = createBuffer(pixelCount * kSsimTermSize, kStorage, kDeviceLocal);
+  imageGradient_ =
+      createBuffer(pixelCount * 4 * sizeof(float), kStorage, kDeviceLocal);
+  tileRanges_ = createBuffer(tileCount * 2 * sizeof(uint32_t),
+                         kStorage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         kDeviceLocal);
+  lossSums_ = createBuffer(tileCount * kLossSumSize,
+                           kStorage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           kDeviceLocal);
+  // Cached, as the loss sums are read back on the CPU.
+  for (Slot& slot : slots_) {
+    slot.readback = createBuffer(kLossSumsOffset + tileCount * kLossSumSize,
+                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+  }
+  writeDescriptors();
+}
+
+void GpuSplatTrainer::submit(VkCommandBuffer cmd, uint64_t uploadTicket,
+                             VkFence fence) {
+  // Uploads land on their own queue; wait for them on the GPU.
+  const VkSemaphore timeline = uploads_->timeline();
+  const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  const VkTimelineSemaphoreSubmitInfo timelineInfo{
+      .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+      .waitSemaphoreValueCount = 1,
+      .pWaitSemaphoreValues = &uploadTicket,
+  };
+  const VkSubmitInfo si{
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = &timelineInfo,
+      .waitSemaphoreCount = 1,
+      .pWaitSemaphores = &timeline,
+      .pWaitDstStageMask = &waitStage,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &cmd,
+  };
+  VK_CHECK(vkQueueSubmit(queue_, 1, &si, fence));
+}
+
+template <typename Fn>
+void GpuSplatTrainer::submitAndWait(Fn&& record) {
+  VkCommandBuffer cmd = VK_NULL_HANDLE;
+  const VkCommandBufferAllocateInfo ai{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = commandPool_.get(),
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+  VK_CHECK(vkAllocateCommandBuffers(device_, &ai, &cmd));
+  const VkCommandBufferBeginInfo bi{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  VK_CHECK(vkBeginCommandBuffer(cmd, &bi));
+  record(cmd);
+  VK_CHECK(vkEndCommandBuffer(cmd));
+
+  const Fence fence(device_, VkFenceCreateInfo{
+                                 .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                             });
+  submit(cmd, parametersTicket_, fence.get());
+  const VkFence handle = fence.get();
+  VK_CHECK(vkWaitForFences(device_, 1, &handle, VK_TRUE, UINT64_MAX));
+  vkFreeCommandBuffers(device_, commandPool_.get(), 1, &cmd);
+}
+
+void GpuSplatTrainer::step(uint32_t view) {
+  if (view >= views_.size()) {
+    throw std::out_of_range(fmt::format(
+        "Training view {} out of range ({} views)", view, views_.size()));
+  }
+  const TrainingView& training = views_[view];
+  Slot& slot = slots_[nextSlot_];
+  nextSlot_ = (nextSlot_ + 1) % static_cast<uint32_t>(slots_.size());
+  // This slot's last iteration must have completed before its command
+  // buffer and uniforms are reused.
+  if (slot.pending) {
+    collect(slot);
+  }
+
+  const VkExtent2D extent = training.view.extent;
+  const std::array<uint32_t, 2> tiles{
+      divideRoundingUp(extent.width, kTileSize),
+      divideRoundingUp(extent.height, kTileSize)};
+  const uint32_t tileCount = tiles[0] * tiles[1];
+  const uint32_t capacity = sort_->maxCount();
+  const auto degree =
+      static_cast<size_t>(std::clamp(activeDegree_, 0, shDegree_));
+
+  ++stats_.iterations;
+  const auto t = static_cast<double>(stats_.iterations);
+  const Mat4& w = training.view.view;
+  const Vec3 translation{w(0, 3), w(1, 3), w(2, 3)};
+  const LearningRates& rates = options_.rates;
+  const float width = static_cast<float>(extent.width);
+  const float height = static_cast<float>(extent.height);
+  const IterationUniforms uniforms{
+      .view = w,
+      // eye = -W^T translation.
+      .cameraPos = {-(w(0, 0) * translation.x + w(1, 0) * translation.y +
+                      w(2, 0) * translation.z),
+                    -(w(0, 1) * translation.x + w(1, 1) * translation.y +
+                      w(2, 1) * translation.z),
+                    -(w(0, 2) * translation.x + w(1, 2) * translation.y +
+                      w(2, 2) * translation.z),
+                    1.0f},
+      .focal = {training.view.focalX, training.view.focalY},
+      .viewport = {width, height},
+      .tanHalfFov = {0.5f * width / training.view.focalX,
+                     0.5f * height / training.view.focalY},
+      .tiles = tiles,
+      .capacity = capacity,
+      .count = count_,
+      .ssimWeight = options_.ssimWeight,
+      .lossScale = 1.0f / (3.0f * width * height),
+      .rates = {rates.position, rates.logScale, rates.rotation,
+                rates.opacityLogit},
+      .shRates = {rates.shDc, rates.shRest},
+      .beta1 = options_.beta1,
+      .beta2 = options_.beta2,
+      .epsilon = options_.epsilon,
+      .correction1 =
+          static_cast<float>(1.0 - std::pow(double{options_.beta1}, t)),
+      .correction2 =
+          static_cast<float>(1.0 - std::pow(double{options_.beta2}, t)),
+      .padding = 0.0f,
+  };
+  std::memcpy(slot.uniforms.memory.mapped(), &uniforms, sizeof(uniforms));
+  slot.tileCount = tileCount;
+  slot.lossScale = uniforms.lossScale;
+  slot.ssimWeight = uniforms.ssimWeight;
+
+  const VkCommandBuffer cmd = slot.cmd;
+  VK_CHECK(vkResetCommandBuffer(cmd, 0));
+  const VkCommandBufferBeginInfo bi{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  VK_CHECK(vkBeginCommandBuffer(cmd, &bi));
+
+  const auto dispatch = [&](const Pipeline& pipeline,
+                            const PipelineLayout& layout, VkDescriptorSet set,
+                            uint32_t setCount, uint32_t groupsX,
+                            uint32_t groupsY) {
+    const std::array<VkDescriptorSet, 3> sets{set, slot.iterationSet,
+                                              training.targetSet};
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.get());
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout.get(),
+                            0, setCount, sets.data(), 0, nullptr);
+    vkCmdDispatch(cmd, groupsX, groupsY, 1);
+  };
+
+  // The previous iteration's step wrote the parameters, and its passes may
+  // still be reading the shared buffers that are about to be rewritten.
+  memoryBarrier(cmd,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                    VK_ACCESS_TRANSFER_WRITE_BIT);
+  const VkDescriptorBufferInfo countInfo = sort_->countBuffer();
+  vkCmdFillBuffer(cmd, countInfo.buffer, 0, sizeof(uint32_t), 0);
+  vkCmdFillBuffer(cmd, tileRanges_.buffer.get(), 0,
+                  VkDeviceSize{tileCount} * 2 * sizeof(uint32_t), 0);
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  // 1. Project, emit the tile instances, sort them and find each tile's.
+  dispatch(project_[degree], projectLayout_, projectSet_, 2,
+           divideRoundingUp(count_, kWorkgroupSize), 1);
+  const auto tileBits =
+      static_cast<uint32_t>(std::bit_width(std::max(tileCount, 1u) - 1));
+  sort_->recordIndirect(cmd, 32 + tileBits,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+  const RangesPushConstants rangesPc{.capacity = capacity};
+  vkCmdPushConstants(cmd, rangesLayout_.get(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(rangesPc), &rangesPc);
+  dispatch(ranges_, rangesLayout_, rangesSet_, 1,
+           divideRoundingUp(capacity, kWorkgroupSize), 1);
+  computeBarrier(cmd);
+
+  // 2. Forward blend.
+  dispatch(raster_, rasterLayout_, rasterSet_, 2, tiles[0], tiles[1]);
+  computeBarrier(cmd);
+
+  // 3. Loss and its gradient per pixel.
+  dispatch(loss_, lossLayout_, lossSet_, 3, tiles[0], tiles[1]);
+  computeBarrier(cmd);
+  dispatch(lossGrad_, lossGradLayout_, lossGradSet_, 3, tiles[0], tiles[1]);
+  computeBarrier(cmd);
+
+  // 4. Backward blend, to one gradient per tile instance.
+  dispatch(backward_, backwardLayout_, backwardSet_, 2, tiles[0], tiles[1]);
+  computeBarrier(cmd);
+
+  // 5. Back through the projection, and the Adam step.
+  dispatch(step_[degree], stepLayout_, stepSet_, 2,
+           divideRoundingUp(count_, kWorkgroupSize), 1);
+
+  // The host reads the instance count and the loss sums.
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_TRANSFER_READ_BIT);
+  const VkBufferCopy countRegion{.size = sizeof(uint32_t)};
+  vkCmdCopyBuffer(cmd, countInfo.buffer, slot.readback.buffer.get(), 1,
+                  &countRegion);
+  const VkBufferCopy lossRegion{
+      .dstOffset = kLossSumsOffset,
+      .size = VkDeviceSize{tileCount} * kLossSumSize,
+  };
+  vkCmdCopyBuffer(cmd, lossSums_.buffer.get(), slot.readback.buffer.get(), 1,
+                  &lossRegion);
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                VK_ACCESS_HOST_READ_BIT);
+  VK_CHECK(vkEndCommandBuffer(cmd));
+
+  submit(cmd, std::max(parametersTicket_, training.uploadTicket),
+         slot.fence.get());
+  slot.pending = true;
+  lastExtent_ = extent;
+}
+
+void GpuSplatTrainer::collect(Slot& slot) {
+  const VkFence fence = slot.fence.get();
+  VK_CHECK(vkWaitForFences(device_, 1, &fence, VK_TRUE, UINT64_MAX));
+  VK_CHECK(vkResetFences(device_, 1, &fence));
+  slot.pending = false;
+
+  const uint8_t* data = slot.readback.memory.mapped();
+  std::memcpy(&stats_.instances, data, sizeof(uint32_t));
+  double l1 = 0.0;
+  double dssim = 0.0;
+  for (uint32_t tile = 0; tile < slot.tileCount; ++tile) {
+    std::array<float, 2> sums{};
+    std::memcpy(sums.data(), data + kLossSumsOffset + (tile * kLossSumSize),
+                sizeof(sums));
+    l1 += sums[0];
+    dssim += sums[1];
+  }
+  const double weight = slot.ssimWeight;
+  stats_.l1 = l1 * slot.lossScale;
+  dssim *= slot.lossScale;
+  stats_.ssim = weight > 0.0 ? 1.0 - dssim : 0.0;
+  stats_.loss = ((1.0 - weight) * stats_.l1) + (weight * dssim);
+}
+
+void GpuSplatTrainer::finish() {
+  // Oldest first, so the stats end on the latest.
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    Slot& slot = slots_[(nextSlot_ + i) % slots_.size()];
+    if (slot.pending) {
+      collect(slot);
+    }
+  }
+}
+
+void GpuSplatTrainer::reserveDensify() {
+  if (count_ <= densifyCapacity_) {
+    return;
+  }
+  densifyCapacity_ = std::max(count_, densifyCapacity_ + densifyCapacity_ / 2);
+
+  constexpr VkBufferUsageFlags kStorage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  constexpr VkMemoryPropertyFlags kDeviceLocal =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  densifyOutputs_ = createBuffer(
+      VkDeviceSize{densifyCapacity_} * sizeof(uint32_t), kStorage,
+      kDeviceLocal);
+  // One level per block of blocks, as GpuRadixSort lays out its scan.
+  constexpr uint32_t kBlockSize = kScanWorkgroupSize * kScanItemsPerThread;
+  scanSums_.clear();
+  for (uint32_t entries = densifyCapacity_;;) {
+    const uint32_t groups = divideRoundingUp(entries, kBlockSize);
+    scanSums_.push_back(createBuffer(VkDeviceSize{groups} * sizeof(uint32_t),
+                                     kStorage, kDeviceLocal));
+    if (groups == 1) {
+      break;
+    }
+    entries = groups;
+  }
+  if (densifyTotals_.buffer.get() == VK_NULL_HANDLE) {
+    densifyTotals_ = createBuffer(
+        kDensifyTotalsSize,
+        kStorage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        kDeviceLocal);
+    densifyReadback_ = createBuffer(kDensifyTotalsSize,
+                                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+  }
+
+  // Mark and scatter, then one set per scan level.
+  const auto scanLevels = static_cast<uint32_t>(scanSums_.size());
+  std::vector<VkDescriptorSetLayout> layouts{markSetLayout_.get(),
+                                             scatterSetLayout_.get()};
+  layouts.insert(layouts.end(), scanLevels, scanSetLayout_.get());
+  const VkDescriptorPoolSize poolSize{
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = static_cast<uint32_t>(markBindings_.size() +
+                                               scatterBindings_.size()) +
+                         (2 * scanLevels),
+  };
+  densifyPool_ = DescriptorPool(device_, static_cast<uint32_t>(layouts.size()),
+                                poolSize);
+  std::vector<VkDescriptorSet> sets(layouts.size());
+  const VkDescriptorSetAllocateInfo ai{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = densifyPool_.get(),
+      .descriptorSetCount = static_cast<uint32_t>(layouts.size()),
+      .pSetLayouts = layouts.data(),
+  };
+  VK_CHECK(vkAllocateDescriptorSets(device_, &ai, sets.data()));
+  markSet_ = sets[0];
+  scatterSet_ = sets[1];
+  scanSets_.assign(sets.begin() + 2, sets.end());
+
+  // Level 0 scans the outputs; level n scans level n-1's sums.
+  std::vector<VkDescriptorBufferInfo> infos;
+  infos.reserve(2 * scanLevels);
+  std::vector<VkWriteDescriptorSet> writes;
+  for (uint32_t level = 0; level < scanLevels; ++level) {
+    const StorageBuffer& data =
+        level == 0 ? densifyOutputs_ : scanSums_[level - 1];
+    for (uint32_t binding = 0; binding < 2; ++binding) {
+      infos.push_back({
+          .buffer = binding == 0 ? data.buffer.get()
+                                 : scanSums_[level].buffer.get(),
+          .range = VK_WHOLE_SIZE,
+      });
+      writes.push_back({
+          .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+          .dstSet = scanSets_[level],
+          .dstBinding = binding,
+          .descriptorCount = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .pBufferInfo = &infos.back(),
+      });
+    }
+  }
+  vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()),
+                         writes.data(), 0, nullptr);
+}
+
+GpuSplatTrainer::DensifyResult GpuSplatTrainer::densify(
+    const DensifyOptions& options) {
+  finish();
+  reserveDensify();
+
+  std::vector<VkDescriptorBufferInfo> infos;
+  std::vector<VkWriteDescriptorSet> writes;
+  // Room for the scatter set's writes, so the pointers stay put.
+  infos.reserve(32);
+  const auto write = [&](VkDescriptorSet set, uint32_t binding,
+                         const StorageBuffer& buffer) {
+    infos.push_back({.buffer = buffer.buffer.get(), .range = VK_WHOLE_SIZE});
+    writes.push_back({
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set,
+        .dstBinding = binding,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &infos.back(),
+    });
+  };
+  const auto flushWrites = [&] {
+    vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()),
+                           writes.data(), 0, nullptr);
+    writes.clear();
+    infos.clear();
+  };
+  // Both passes read the current parameters and statistics.
+  const auto writeSource = [&](VkDescriptorSet set) {
+    for (uint32_t p = 0; p < kParameterCount; ++p) {
+      write(set, p, current_.parameters[p]);
+    }
+    write(set, kDensifyStatsBinding, current_.densifyStats);
+    write(set, kOutputsBinding, densifyOutputs_);
+  };
+  writeSource(markSet_);
+  write(markSet_, kTotalsBinding, densifyTotals_);
+  flushWrites();
+
+  const DensifyPushConstants pc{
+      .count = count_,
+      .shFloats = parameterFloats(kSh),
+      .seed = densifySeed_++,
+      .gradientThreshold = options.gradientThreshold,
+      .scaleThreshold = options.percentDense * options.sceneExtent,
+      .minOpacity = options.minOpacity,
+  };
+  const uint32_t groups = divideRoundingUp(count_, kWorkgroupSize);
+
+  // 1. What each splat becomes, and the new index of each survivor.
+  submitAndWait([&](VkCommandBuffer cmd) {
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                      VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+    vkCmdFillBuffer(cmd, densifyTotals_.buffer.get(), 0, VK_WHOLE_SIZE, 0);
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_TRANSFER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mark_.get());
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            markLayout_.get(), 0, 1, &markSet_, 0, nullptr);
+    vkCmdPushConstants(cmd, markLayout_.get(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(pc), &pc);
+    vkCmdDispatch(cmd, groups, 1, 1);
+    computeBarrier(cmd);
+
+    // Exclusive prefix sum, down the levels and back up, as GpuRadixSort
+    // scans its histograms.
+    constexpr uint32_t kBlockSize = kScanWorkgroupSize * kScanItemsPerThread;
+    std::vector<uint32_t> levelEntries;
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scan_.get());
+    for (uint32_t entries = count_;;) {
+      const size_t level = levelEntries.size();
+      levelEntries.push_back(entries);
+      const uint32_t scanGroups = divideRoundingUp(entries, kBlockSize);
+      const ScanPushConstants scanPc{.count = entries};
+      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                              scanLayout_.get(), 0, 1, &scanSets_[level], 0,
+                              nullptr);
+      vkCmdPushConstants(cmd, scanLayout_.get(), VK_SHADER_STAGE_COMPUTE_BIT,
+                         0, sizeof(scanPc), &scanPc);
+      vkCmdDispatch(cmd, scanGroups, 1, 1);
+      computeBarrier(cmd);
+      if (scanGroups == 1) {
+        break;
+      }
+      entries = scanGroups;
+    }
+    if (levelEntries.size() > 1) {
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scanAdd_.get());
+    }
+    for (size_t level = levelEntries.size() - 1; level-- > 0;) {
+      const ScanPushConstants scanPc{.count = levelEntries[level]};
+      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                              scanLayout_.get(), 0, 1, &scanSets_[level], 0,
+                              nullptr);
+      vkCmdPushConstants(cmd, scanLayout_.get(), VK_SHADER_STAGE_COMPUTE_BIT,
+                         0, sizeof(scanPc), &scanPc);
+      vkCmdDispatch(cmd, divideRoundingUp(levelEntries[level], kBlockSize), 1,
+                    1);
+      computeBarrier(cmd);
+    }
+
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_TRANSFER_READ_BIT);
+    const VkBufferCopy region{.size = kDensifyTotalsSize};
+    vkCmdCopyBuffer(cmd, densifyTotals_.buffer.get(),
+                    densifyReadback_.buffer.get(), 1, &region);
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                  VK_ACCESS_HOST_READ_BIT);
+  });
+
+  std::array<uint32_t, 4> totals{};
+  std::memcpy(totals.data(), densifyReadback_.memory.mapped(),
+              sizeof(totals));
+  const DensifyResult result{
+      .cloned = totals[1],
+      .split = totals[2],
+      .pruned = totals[3],
+      .count = totals[0],
+  };
+  if (result.count == 0) {
+    throw std::runtime_error(
+        "GpuSplatTrainer::densify() would prune every splat");
+  }
+
+  // 2. Write the survivors into the spare set, grown by half again when
+  // they do not fit.
+  const bool grow = result.count > spare_.capacity;
+  if (grow) {
+    // Freed first, so the old and new spare sets never coexist.
+    spare_ = ParameterSet{};
+    spare_ = createParameterSet(
+        std::max(result.count, current_.capacity + current_.capacity / 2));
+  }
+  writeSource(scatterSet_);
+  for (uint32_t p = 0; p < kParameterCount; ++p) {
+    write(scatterSet_, kSourceMomentsBinding + p, current_.moments[p]);
+    write(scatterSet_, kDestinationBinding + p, spare_.parameters[p]);
+    write(scatterSet_, kDestinationMomentsBinding + p, spare_.moments[p]);
+  }
+  write(scatterSet_, kDestinationStatsBinding, spare_.densifyStats);
+  flushWrites();
+  submitAndWait([&](VkCommandBuffer cmd) {
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scatter_.get());
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            scatterLayout_.get(), 0, 1, &scatterSet_, 0,
+                            nullptr);
+    vkCmdPushConstants(cmd, scatterLayout_.get(), VK_SHADER_STAGE_COMPUTE_BIT,
+                       0, sizeof(pc), &pc);
+    vkCmdDispatch(cmd, groups, 1, 1);
+  });
+
+  std::swap(current_, spare_);
+  count_ = result.count;
+  if (grow) {
+    projected_ = createBuffer(VkDeviceSize{current_.capacity} * kTrainSplatSize,
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+  // 3. Grow the tile instances with the cloud, or past the last iteration's
+  // overflow, by half again at least.
+  if (options_.maxInstances == 0) {
+    const uint32_t capacity = sort_->maxCount();
+    const uint32_t wanted =
+        std::max(defaultMaxInstances(count_),
+                 std::min(stats_.instances, kMaxDefaultInstances));
+    if (wanted > capacity) {
+      createInstanceBuffers(std::min(
+          std::max(wanted, capacity + capacity / 2), kMaxDefaultInstances));
+    }
+  }
+  writeDescriptors();
+  return result;
+}
+
+SplatCloud GpuSplatTrainer::download() {
+  finish();
+  SplatCloud cloud;
+  cloud.resize(count_, shDegree_);
+  std::array<std::vector<float>*, kParameterCount> raw{
+      &cloud.positions, &cloud.scales, &cloud.rotations, &cloud.opacities,
+      &cloud.sh};
+  std::array<VkDeviceSize, kParameterCount> offsets{};
+  VkDeviceSize total = 0;
+  for (size_t p = 0; p < kParameterCount; ++p) {
+    offsets[p] = total;
+    total += raw[p]->size() * sizeof(float);
+  }
+
+  const StorageBuffer staging = createBuffer(
+      total, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+  submitAndWait([&](VkCommandBuffer cmd) {
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_TRANSFER_READ_BIT);
+    for (size_t p = 0; p < kParameterCount; ++p) {
+      const VkBufferCopy region{
+          .dstOffset = offsets[p],
+          .size = raw[p]->size() * sizeof(float),
+      };
+      vkCmdCopyBuffer(cmd, current_.parameters[p].buffer.get(),
+                      staging.buffer.get(), 1, &region);
+    }
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                  VK_ACCESS_HOST_READ_BIT);
+  });
+  for (size_t p = 0; p < kParameterCount; ++p) {
+    std::memcpy(raw[p]->data(), staging.memory.mapped() + offsets[p],
+                raw[p]->size() * sizeof(float));
+  }
+
+  // Apply the activations train_data.glsl applies.
+  for (float& scale : cloud.scales) {
+    scale = std::exp(scale);
+  }
+  for (float& opacity : cloud.opacities) {
+    opacity = 1.0f / (1.0f + std::exp(-opacity));
+  }
+  for (size_t i = 0; i < count_; ++i) {
+    float* q = &cloud.rotations[i * 4];
+    const float length = std::sqrt((q[0] * q[0]) + (q[1] * q[1]) +
+                                   (q[2] * q[2]) + (q[3] * q[3]));
+    if (length > 0.0f) {
+      for (size_t c = 0; c < 4; ++c) {
+        q[c] /= length;
+      }
+    }
+  }
+  return cloud;
+}
+
+ImageData GpuSplatTrainer::downloadImage() {
+  finish();
+  if (lastExtent_.width == 0) {
+    throw std::logic_error("GpuSplatTrainer has not rendered an image yet");
+  }
+  const VkDeviceSize size =
+      VkDeviceSize{lastExtent_.width} * lastExtent_.height * 4 * sizeof(float);
+  const StorageBuffer staging = createBuffer(
+      size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+  submitAndWait([&](VkCommandBuffer cmd) {
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_TRANSFER_READ_BIT);
+    const VkBufferCopy region{.size = size};
+    vkCmdCopyBuffer(cmd, image_.buffer.get(), staging.buffer.get(), 1,
+                    &region);
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                  VK_ACCESS_HOST_READ_BIT);
+  });
+
+  ImageData image;
+  image.width = static_cast<int>(lastExtent_.width);
+  image.height = static_cast<int>(lastExtent_.height);
+  image.format = PixelFormat::kRgba32Sfloat;
+  image.pixels.resize(size);
+  std::memcpy(image.pixels.data(), staging.memory.mapped(), size);
+  return image;
+}
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "DifferentiableSplatRasterizer.h"
+#include "GpuAllocator.h"
+#include "GpuRadixSort.h"
+#include "ImageIO.h"
+#include "Renderer.h"
+#include "SplatCloud.h"
+#include "VulkanHandles.h"
+
+// Optimizes a splat cloud against posed ground-truth images on the GPU. The
+// parameters (stored as 3DGS optimizes them: log-scales, opacity logits and
+// unnormalized quaternions) and Adam's moments live in device-local buffers
+// for the trainer's whole life; only the loss comes back per iteration.
+//
+// Each step() records one command buffer for one view:
+//
+//   1. train_project.comp projects every splat and emits its tile instances,
+//      as tile_project.comp does, and a GpuRadixSort orders them by tile
+//      and depth; tile_ranges.comp finds each tile's run;
+//   2. train_raster.comp blends each tile front to back at full precision,
+//      keeping each pixel's final transmittance and last contributor;
+//   3. train_loss.comp and train_loss_grad.comp compare the image with the
+//      view's texture, (1 - w) L1 + w (1 - SSIM), and form its gradient;
+//   4. train_backward.comp walks each tile back to front and leaves one
+//      screen-space gradient per tile instance;
+//   5. train_step.comp sums each splat's instances, chains them through the
+//      projection and activations, applies Adam in place, and accumulates
+//      the statistics densify() decides by.
+//
+// densify() grows and prunes the cloud between steps by stream compaction:
+// train_densify_mark.comp counts what each splat becomes, a prefix sum
+// gives the survivors their new indices, and train_densify_scatter.comp
+// writes them, moments included, into a second set of buffers that then
+// takes over. Neither set shrinks, and the second grows geometrically, so
+// repeated densification reallocates rarely; the tile instance buffers and
+// their sort grow the same way.
+//
+// Steps are queued up to Options::iterationsInFlight ahead of the GPU.
+// Needs subgroup arithmetic in compute shaders, on top of what GpuRadixSort
+// needs.
+class GpuSplatTrainer {
+ public:
+  using View = DifferentiableSplatRasterizer::View;
+
+  // Per parameter group. The defaults are 3DGS's; the position rate is
+  // meant to be scaled by the scene's extent, and decayed over training.
+  struct LearningRates {
+    float position = 1.6e-4f;
+    float logScale = 5e-3f;
+    float rotation = 1e-3f;
+    float opacityLogit = 5e-2f;
+    float shDc = 2.5e-3f;
+    float shRest = 2.5e-3f / 20.0f;
+  };
+
+  struct Options {
+    LearningRates rates;
+    float beta1 = 0.9f;
+    float beta2 = 0.999f;
+    float epsilon = 1e-15f;
+    // Weight of 1 - SSIM in the loss, against L1. 0 skips SSIM entirely.
+    float ssimWeight = 0.2f;
+    // Tile instances (splat-tile overlaps) per iteration; each costs 64
+    // bytes. Instances past it are dropped. 0 picks eight per splat, within
+    // [2^20, 2^24], and lets densify() grow it with the cloud or after an
+    // iteration overflowed it.
+    uint32_t maxInstances = 0;
+    uint32_t iterationsInFlight = 2;
+  };
+
+  struct Stats {
+    // Queued by step().
+    uint64_t iterations = 0;
+    // Of the last completed iteration: the loss, its L1 term and the SSIM
+    // (0 when not weighed in), averaged over pixels and channels, and the
+    // tile instances emitted (which may exceed instanceCapacity()).
+    double loss = 0.0;
+    double l1 = 0.0;
+    double ssim = 0.0;
+    uint32_t instances = 0;
+  };
+
+  // 3DGS's adaptive density control. A splat whose centre gradient, in
+  // normalized device coordinates and averaged over the steps that saw it
+  // since the last densify(), reaches `gradientThreshold` is cloned if it
+  // is small and split in two if it is large; faint splats are pruned.
+  struct DensifyOptions {
+    float gradientThreshold = 2e-4f;
+    // Splats larger than this fraction of `sceneExtent` (in their largest
+    // scale) are split rather than cloned.
+    float percentDense = 0.01f;
+    float sceneExtent = 1.0f;
+    float minOpacity = 0.005f;
+  };
+
+  struct DensifyResult {
+    uint32_t cloned = 0;
+    uint32_t split = 0;
+    uint32_t pruned = 0;
+    // Splats after densification.
+    uint32_t count = 0;
+  };
+
+  static bool isSupported(VkPhysicalDevice physicalDevice);
+
+  GpuSplatTrainer(const Renderer::Context& ctx, const SplatCloud& initial,
+                  const Options& options);
+  // Waits for the queued iterations.
+  ~GpuSplatTrainer();
+
+  GpuSplatTrainer(const GpuSplatTrainer&) = delete;
+  GpuSplatTrainer& operator=(const GpuSplatTrainer&) = delete;
+  GpuSplatTrainer(GpuSplatTrainer&&) = delete;
+  GpuSplatTrainer& operator=(GpuSplatTrainer&&) = delete;
+
+  // Uploads `image` (any PixelFormat, `view.extent` in size, straight
+  // colour over black) as the ground truth seen from `view`. Returns its
+  // index for step().
+  uint32_t addView(const View& view, const ImageData& image);
+  [[nodiscard]] uint32_t viewCount() const {
+    return static_cast<uint32_t>(views_.size());
+  }
+
+  // Highest SH degree trained, clamped to the cloud's; 3DGS starts at 0
+  // and adds a band every thousand iterations. Coefficients above it keep
+  // their values.
+  void setShDegree(int degree) { activeDegree_ = degree; }
+  void setLearningRates(const LearningRates& rates) { options_.rates = rates; }
+
+  // Queues one iteration against view `view`. Blocks only while
+  // iterationsInFlight are already queued; pending uploads are waited for
+  // on the GPU.
+  void step(uint32_t view);
+  // Waits for every queued iteration and collects its stats.
+  void finish();
+  [[nodiscard]] const Stats& stats() const { return stats_; }
+  [[nodiscard]] uint32_t instanceCapacity() const {
+    return sort_->maxCount();
+  }
+  [[nodiscard]] uint32_t splatCount() const { return count_; }
+
+  // Clones, splits and prunes splats by the statistics gathered since the
+  // last call, and starts them over. Waits for the queued iterations, and
+  // reads back only the totals. New splats start with zero moments.
+  DensifyResult densify(const DensifyOptions& options);
+
+  // The current parameters, activated, after finish().
+  [[nodiscard]] SplatCloud download();
+  // The last iteration's render, RGBA32F premultiplied, after finish().
+  [[nodiscard]] ImageData downloadImage();
+
+ private:
+  struct StorageBuffer {
+    Buffer buffer;
+    GpuAllocation memory;
+  };
+
+  enum Parameter : uint8_t {
+    kPositions,
+    kLogScales,
+    kRotations,
+    kOpacityLogits,
+    kSh,
+    kParameterCount,
+  };
+
+  // The parameters, their moments (first and second per parameter,
+  // interleaved) and the densification statistics, for `capacity` splats.
+  struct ParameterSet {
+    std::array<StorageBuffer, kParameterCount> parameters;
+    std::array<StorageBuffer, kParameterCount> moments;
+    StorageBuffer densifyStats;
+    uint32_t capacity = 0;
+  };
+
+  // Per iteration in flight.
+  struct Slot {
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    Fence fence;
+    StorageBuffer uniforms;
+    // Host copy of the instance count, then the per-tile loss sums.
+    StorageBuffer readback;
+    // What the loss sums are scaled by.
+    uint32_t tileCount = 0;
+    float lossScale = 0.0f;
+    float ssimWeight = 0.0f;
+    bool pending = false;
+    VkDescriptorSet iterationSet = VK_NULL_HANDLE;
+  };
+
+  // A ground-truth image and its camera.
+  struct TrainingView {
+    View view;
+    Image image;
+    GpuAllocation memory;
+    ImageView imageView;
+    uint64_t uploadTicket = 0;
+    DescriptorPool descriptorPool;
+    VkDescriptorSet targetSet = VK_NULL_HANDLE;
+  };
+
+  static uint32_t defaultMaxInstances(size_t splatCount);
+
+  StorageBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                             VkMemoryPropertyFlags required,
+                             VkMemoryPropertyFlags preferred = 0);
+  // Floats of parameter `p` per splat.
+  [[nodiscard]] uint32_t parameterFloats(size_t p) const;
+  ParameterSet createParameterSet(uint32_t capacity);
+  void uploadParameters(const SplatCloud& cloud);
+  // Grows the per-splat buffers densify() marks and scans to fit count_.
+  void reserveDensify();
+  // Replaces the sort and the per-instance buffers with ones for
+  // `capacity` instances.
+  void createInstanceBuffers(uint32_t capacity);
+  void createDescriptors();
+  void createPipelines();
+  // Grows the per-pixel and per-tile buffers to fit `extent`.
+  void reserveImage(VkExtent2D extent);
+  void writeDescriptors();
+  void collect(Slot& slot);
+  // Submits `cmd` once the uploads up to `uploadTicket` have landed.
+  void submit(VkCommandBuffer cmd, uint64_t uploadTicket, VkFence fence);
+  // Records `record` into a one-off command buffer and waits for it.
+  template <typename Fn>
+  void submitAndWait(Fn&& record);
+
+  // Kept to rebuild sort_ with.
+  Renderer::Context ctx_;
+  VkDevice device_ = VK_NULL_HANDLE;
+  VkPhysicalDevice physicalDevice_ = VK_NULL_HANDLE;
+  VkQueue queue_ = VK_NULL_HANDLE;
+  VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+  GpuAllocator* allocator_ = nullptr;
+  UploadManager* uploads_ = nullptr;
+  Options options_;
+  Stats stats_;
+
+  uint32_t count_ = 0;
+  int shDegree_ = 0;
+  int activeDegree_ = SplatCloud::kMaxShDegree;
+  uint64_t parametersTicket_ = 0;
+  uint32_t subgroupSize_ = 0;
+
+  // Trained from current_; densify() writes spare_, then swaps them.
+  ParameterSet current_;
+  ParameterSet spare_;
+  std::unique_ptr<GpuRadixSort> sort_;
+  StorageBuffer projected_;
+  StorageBuffer instanceSplats_;
+  StorageBuffer instanceGradients_;
+  // Sized for the largest view.
+  uint32_t pixelCapacity_ = 0;
+  uint32_t tileCapacity_ = 0;
+  StorageBuffer tileRanges_;
+  StorageBuffer image_;
+  StorageBuffer states_;
+  StorageBuffer ssimTerms_;
+  StorageBuffer imageGradient_;
+  StorageBuffer lossSums_;
+  VkExtent2D lastExtent_{};
+  // densify(): outputs per splat, scanned in place into their new indices
+  // (one sums buffer per scan level), and the totals with their host copy.
+  uint32_t densifyCapacity_ = 0;
+  StorageBuffer densifyOutputs_;
+  std::vector<StorageBuffer> scanSums_;
+  StorageBuffer densifyTotals_;
+  StorageBuffer densifyReadback_;
+  uint32_t densifySeed_ = 0;
+
+  std::vector<TrainingView> views_;
+  Sampler sampler_;
+  CommandPool commandPool_;
+  std::vector<Slot> slots_;
+  uint32_t nextSlot_ = 0;
+
+  DescriptorSetLayout projectSetLayout_;
+  DescriptorSetLayout rangesSetLayout_;
+  DescriptorSetLayout rasterSetLayout_;
+  DescriptorSetLayout lossSetLayout_;
+  DescriptorSetLayout lossGradSetLayout_;
+  DescriptorSetLayout backwardSetLayout_;
+  DescriptorSetLayout stepSetLayout_;
+  DescriptorSetLayout iterationSetLayout_;
+  DescriptorSetLayout targetSetLayout_;
+  // The densify sets' bindings, which also size densifyPool_.
+  std::vector<uint32_t> markBindings_;
+  std::vector<uint32_t> scatterBindings_;
+  DescriptorSetLayout markSetLayout_;
+  DescriptorSetLayout scatterSetLayout_;
+  DescriptorSetLayout scanSetLayout_;
+  DescriptorPool descriptorPool_;
+  VkDescriptorSet projectSet_ = VK_NULL_HANDLE;
+  VkDescriptorSet rangesSet_ = VK_NULL_HANDLE;
+  VkDescriptorSet rasterSet_ = VK_NULL_HANDLE;
+  VkDescriptorSet lossSet_ = VK_NULL_HANDLE;
+  VkDescriptorSet lossGradSet_ = VK_NULL_HANDLE;
+  VkDescriptorSet backwardSet_ = VK_NULL_HANDLE;
+  VkDescriptorSet stepSet_ = VK_NULL_HANDLE;
+  // Reallocated with the densify buffers.
+  DescriptorPool densifyPool_;
+  VkDescriptorSet markSet_ = VK_NULL_HANDLE;
+  VkDescriptorSet scatterSet_ = VK_NULL_HANDLE;
+  std::vector<VkDescriptorSet> scanSets_;
+
+  PipelineLayout projectLayout_;
+  PipelineLayout rangesLayout_;
+  PipelineLayout rasterLayout_;
+  PipelineLayout lossLayout_;
+  PipelineLayout lossGradLayout_;
+  PipelineLayout backwardLayout_;
+  PipelineLayout stepLayout_;
+  PipelineLayout markLayout_;
+  PipelineLayout scatterLayout_;
+  PipelineLayout scanLayout_;
+  // Indexed by SH degree, up to the cloud's.
+  std::array<Pipeline, SplatCloud::kMaxShDegree + 1> project_;
+  std::array<Pipeline, SplatCloud::kMaxShDegree + 1> step_;
+  Pipeline ranges_;
+  Pipeline raster_;
+  Pipeline loss_;
+  Pipeline lossGrad_;
+  Pipeline backward_;
+  Pipeline mark_;
+  Pipeline scatter_;
+  Pipeline scan_;
+  Pipeline scanAdd_;
+};
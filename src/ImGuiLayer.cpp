@@ -39,6 +39,7 @@ ImGuiLayer::ImGuiLayer(SDL_Window* window, const Renderer::Context& ctx)
     initInfo.QueueFamily = ctx.queueFamily;
     initInfo.Queue = ctx.graphicsQueue;
     initInfo.DescriptorPool = pool_;
+    initInfo.PipelineCache = ctx.pipelineCache;
     initInfo.RenderPass = VK_NULL_HANDLE;
     initInfo.MinImageCount = ctx.imageCount;
     initInfo.ImageCount = ctx.imageCount;
@@ -0,0 +1,226 @@
+#include "ImageIO.h"
+
+#include <OpenImageIO/imageio.h>
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "PixelConvert.h"
+
+namespace {
+
+PixelFormat nativeFormat(const OIIO::ImageSpec& spec) {
+  switch (spec.format.basetype) {
+    case OIIO::TypeDesc::UINT8:
+    case OIIO::TypeDesc::INT8:
+      return PixelFormat::kRgba8Unorm;
+    case OIIO::TypeDesc::UINT16:
+    case OIIO::TypeDesc::INT16:
+      return PixelFormat::kRgba16Unorm;
+    case OIIO::TypeDesc::HALF:
+      return PixelFormat::kRgba16Sfloat;
+    default:
+      return PixelFormat::kRgba32Sfloat;
+  }
+}
+
+// Type OIIO decodes into, or encodes from, for a given pixel format.
+OIIO::TypeDesc readType(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::kRgba8Unorm:
+      return OIIO::TypeDesc::UINT8;
+    case PixelFormat::kRgba16Unorm:
+    case PixelFormat::kRgb10A2Unorm:
+      return OIIO::TypeDesc::UINT16;
+    case PixelFormat::kRgba16Sfloat:
+      return OIIO::TypeDesc::HALF;
+    case PixelFormat::kRgba32Sfloat:
+      return OIIO::TypeDesc::FLOAT;
+  }
+  throw std::logic_error("Unhandled PixelFormat");
+}
+
+void expandToRgba32f(const float* src, float* dst, size_t npixels,
+                     size_t nchans) {
+  for (size_t i = 0; i < npixels; ++i) {
+    for (size_t c = 0; c < 4; ++c) {
+      dst[c] = c < nchans ? src[c] : (c == 3 ? 1.0f : 0.0f);
+    }
+    src += nchans;
+    dst += 4;
+  }
+}
+
+void packRgb10A2(const uint16_t* src, uint32_t* dst, size_t npixels,
+                 size_t nchans) {
+  for (size_t i = 0; i < npixels; ++i) {
+    const auto channel = [&](size_t c, uint32_t fallback) -> uint32_t {
+      return c < nchans ? src[c] : fallback;
+    };
+    const uint32_t r = channel(0, 0) >> 6;
+    const uint32_t g = channel(1, 0) >> 6;
+    const uint32_t b = channel(2, 0) >> 6;
+    const uint32_t a = channel(3, 0xffff) >> 14;
+    dst[i] = (a << 30) | (b << 20) | (g << 10) | r;
+    src += nchans;
+  }
+}
+
+}  // namespace
+
+size_t bytesPerPixel(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::kRgba8Unorm:
+    case PixelFormat::kRgb10A2Unorm:
+      return 4;
+    case PixelFormat::kRgba16Unorm:
+    case PixelFormat::kRgba16Sfloat:
+      return 8;
+    case PixelFormat::kRgba32Sfloat:
+      return 16;
+  }
+  throw std::logic_error("Unhandled PixelFormat");
+}
+
+const char* pixelFormatName(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::kRgba8Unorm:
+      return "RGBA8 UNORM";
+    case PixelFormat::kRgba16Unorm:
+      return "RGBA16 UNORM";
+    case PixelFormat::kRgba16Sfloat:
+      return "RGBA16 SFLOAT";
+    case PixelFormat::kRgba32Sfloat:
+      return "RGBA32 SFLOAT";
+    case PixelFormat::kRgb10A2Unorm:
+      return "RGB10A2 UNORM";
+  }
+  throw std::logic_error("Unhandled PixelFormat");
+}
+
+struct ImageReader::Input {
+  OIIO::ImageInput::unique_ptr image;
+};
+
+ImageReader::ImageReader(const std::filesystem::path& path,
+                         std::optional<PixelFormat> format)
+    : path_(path),
+      input_(std::make_unique<Input>(
+          Input{.image = OIIO::ImageInput::open(path.string())})) {
+  if (!input_->image) {
+    throw std::runtime_error(fmt::format("Failed to open image: {} ({})",
+                                         path.string(), OIIO::geterror()));
+  }
+
+  const OIIO::ImageSpec& spec = input_->image->spec();
+  width_ = spec.width;
+  height_ = spec.height;
+  // Channels past RGBA are dropped by the reader itself.
+  channels_ = static_cast<size_t>(std::min(spec.nchannels, 4));
+  format_ = format.value_or(nativeFormat(spec));
+}
+
+ImageReader::~ImageReader() = default;
+
+size_t ImageReader::byteSize() const {
+  return static_cast<size_t>(width_) * height_ * bytesPerPixel(format_);
+}
+
+void ImageReader::readInto(uint8_t* dst) {
+  const OIIO::TypeDesc type = readType(format_);
+  const size_t rowPixels = static_cast<size_t>(width_);
+  const size_t dstRowBytes = rowPixels * bytesPerPixel(format_);
+
+  const auto readRows = [&](int y0, int y1, void* out) {
+    if (!input_->image->read_scanlines(0, 0, y0, y1, 0, 0,
+                                       static_cast<int>(channels_), type,
+                                       out)) {
+      throw std::runtime_error(
+          fmt::format("Failed to read image pixels: {} ({})", path_.string(),
+                      input_->image->geterror()));
+    }
+  };
+
+  if (channels_ == 4 && format_ != PixelFormat::kRgb10A2Unorm) {
+    readRows(0, height_, dst);
+    input_->image->close();
+    return;
+  }
+
+  // Decode a strip of rows into scratch memory, then expand it straight into
+  // the destination.
+  constexpr int kStripRows = 32;
+  std::vector<uint8_t> strip(rowPixels * kStripRows * channels_ *
+                             type.size());
+
+  for (int y0 = 0; y0 < height_; y0 += kStripRows) {
+    const int y1 = std::min(y0 + kStripRows, height_);
+    readRows(y0, y1, strip.data());
+
+    const size_t npixels = rowPixels * static_cast<size_t>(y1 - y0);
+    uint8_t* out = dst + (static_cast<size_t>(y0) * dstRowBytes);
+
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    switch (format_) {
+      case PixelFormat::kRgba8Unorm:
+        expandToRgba8(strip.data(), out, npixels, channels_);
+        break;
+      case PixelFormat::kRgba16Unorm:
+        expandToRgba16(reinterpret_cast<const uint16_t*>(strip.data()),
+                       reinterpret_cast<uint16_t*>(out), npixels, channels_);
+        break;
+      case PixelFormat::kRgba16Sfloat:
+        // 0x3c00 is 1.0 in IEEE half precision.
+        expandToRgba16(reinterpret_cast<const uint16_t*>(strip.data()),
+                       reinterpret_cast<uint16_t*>(out), npixels, channels_,
+                       0x3c00);
+        break;
+      case PixelFormat::kRgba32Sfloat:
+        expandToRgba32f(reinterpret_cast<const float*>(strip.data()),
+                        reinterpret_cast<float*>(out), npixels, channels_);
+        break;
+      case PixelFormat::kRgb10A2Unorm:
+        packRgb10A2(reinterpret_cast<const uint16_t*>(strip.data()),
+                    reinterpret_cast<uint32_t*>(out), npixels, channels_);
+        break;
+    }
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+  }
+  input_->image->close();
+}
+
+ImageData loadImage(const std::filesystem::path& path,
+                    std::optional<PixelFormat> format) {
+  ImageReader reader(path, format);
+  ImageData image{
+      .width = reader.width(),
+      .height = reader.height(),
+      .format = reader.format(),
+  };
+  image.pixels.resize(reader.byteSize());
+  reader.readInto(image.pixels.data());
+  return image;
+}
+
+void writeImage(const std::filesystem::path& path, const ImageData& image) {
+  if (image.format == PixelFormat::kRgb10A2Unorm) {
+    throw std::invalid_argument(
+        fmt::format("Cannot write {} pixels: {}",
+                    pixelFormatName(image.format), path.string()));
+  }
+
+  const OIIO::TypeDesc type = readType(image.format);
+  auto output = OIIO::ImageOutput::create(path.string());
+  if (!output) {
+    throw std::runtime_error(fmt::format("Failed to create image: {} ({})",
+                                         path.string(), OIIO::geterror()));
+  }
+
+  const OIIO::ImageSpec spec(image.width, image.height, 4, type);
+  if (!output->open(path.string(), spec) ||
+      !output->write_image(type, image.pixels.data()) || !output->close()) {
+    throw std::runtime_error(fmt::format("Failed to write image: {} ({})",
+                                         path.string(), output->geterror()));
+  }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+// Four-channel pixel layouts an image can be decoded into. Each maps 1:1 onto
+// a Vulkan format (R8G8B8A8_UNORM, R16G16B16A16_UNORM, R16G16B16A16_SFLOAT,
+// R32G32B32A32_SFLOAT, A2B10G10R10_UNORM_PACK32; see toVkFormat()).
+enum class PixelFormat {
+  kRgba8Unorm,
+  kRgba16Unorm,
+  kRgba16Sfloat,
+  kRgba32Sfloat,
+  kRgb10A2Unorm,
+};
+
+size_t bytesPerPixel(PixelFormat format);
+const char* pixelFormatName(PixelFormat format);
+
+// Inline, so Vulkan code that never decodes a file need not link ImageIO.cpp.
+inline VkFormat toVkFormat(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::kRgba8Unorm:
+      return VK_FORMAT_R8G8B8A8_UNORM;
+    case PixelFormat::kRgba16Unorm:
+      return VK_FORMAT_R16G16B16A16_UNORM;
+    case PixelFormat::kRgba16Sfloat:
+      return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case PixelFormat::kRgba32Sfloat:
+      return VK_FORMAT_R32G32B32A32_SFLOAT;
+    case PixelFormat::kRgb10A2Unorm:
+      return VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+  }
+  throw std::logic_error("Unhandled PixelFormat");
+}
+
+// Decoded image, expanded to tightly packed four-channel pixels.
+struct ImageData {
+  int width = 0;
+  int height = 0;
+  PixelFormat format = PixelFormat::kRgba8Unorm;
+  std::vector<uint8_t> pixels;
+};
+
+// Streams an image file into caller-provided memory (e.g. a mapped staging
+// buffer). Rows are decoded a strip at a time and expanded to four channels
+// on the way out, so no full-size intermediate copy is ever made.
+//
+// Without an explicit format the source's own precision is kept (8-bit stays
+// 8-bit, 16-bit stays 16-bit, float stays float).
+class ImageReader {
+ public:
+  explicit ImageReader(const std::filesystem::path& path,
+                       std::optional<PixelFormat> format = std::nullopt);
+  ~ImageReader();
+
+  ImageReader(const ImageReader&) = delete;
+  ImageReader& operator=(const ImageReader&) = delete;
+  ImageReader(ImageReader&&) = delete;
+  ImageReader& operator=(ImageReader&&) = delete;
+
+  [[nodiscard]] int width() const { return width_; }
+  [[nodiscard]] int height() const { return height_; }
+  [[nodiscard]] PixelFormat format() const { return format_; }
+  [[nodiscard]] size_t byteSize() const;
+
+  // Writes byteSize() bytes of tightly packed pixels to `dst`.
+  void readInto(uint8_t* dst);
+
+ private:
+  struct Input;
+
+  std::filesystem::path path_;
+  std::unique_ptr<Input> input_;
+  int width_ = 0;
+  int height_ = 0;
+  size_t channels_ = 0;
+  PixelFormat format_ = PixelFormat::kRgba8Unorm;
+};
+
+ImageData loadImage(const std::filesystem::path& path,
+                    std::optional<PixelFormat> format = std::nullopt);
+
+// Writes an image; the container is picked from the file extension. Packed
+// RGB10A2 pixels have no file equivalent and are rejected.
+void writeImage(const std::filesystem::path& path, const ImageData& image);
@@ -1,12 +1,12 @@
 #include "ImageLayer.h"
 
-#include <OpenImageIO/imageio.h>
 #include <fmt/core.h>
 
 #include <array>
 #include <cstring>
 #include <filesystem>
 #include <stdexcept>
+#include <vector>
 
 #include "VulkanErrors.h"
 #include "VulkanShaders.h"
@@ -16,15 +16,73 @@
 #endif
 
 ImageLayer::ImageLayer(const Renderer::Context& ctx,
-                       const std::filesystem::path& imagePath)
+                       const std::filesystem::path& imagePath,
+                       std::optional<PixelFormat> format,
+                       const TextureOptions& options)
     : PipelineLayerBase(ctx) {
-  const auto pixels = loadImagePixels(imagePath);
-  uploadTexture(pixels, ctx.physicalDevice, ctx.graphicsQueue, ctx.queueFamily);
+  const TextureOptions supported = supportedOptions(ctx, options);
+  if (supported.mipmaps ||
+      supported.compression != TextureCompression::kNone) {
+    initMips(ctx, loadMipChain(imagePath, format, supported));
+    return;
+  }
+
+  // Decode straight into the staging ring: no intermediate pixel copies.
+  ImageReader reader(imagePath, format);
+  imageWidth_ = reader.width();
+  imageHeight_ = reader.height();
+  textureFormat_ = toVkFormat(reader.format());
+
+  const UploadManager::ImageLevel level{
+      .extent = {static_cast<uint32_t>(imageWidth_),
+                 static_cast<uint32_t>(imageHeight_), 1},
+  };
+  init(ctx, std::span(&level, 1), reader.byteSize(),
+       [&](uint8_t* dst) { reader.readInto(dst); });
+}
+
+ImageLayer::ImageLayer(const Renderer::Context& ctx, const ImageData& image,
+                       const TextureOptions& options)
+    : PipelineLayerBase(ctx) {
+  initMips(ctx, loadMipChain(image, supportedOptions(ctx, options)));
+}
+
+ImageLayer::~ImageLayer() {
+  // The copy may still be writing the texture; wait for this upload only.
+  if (uploads_ != nullptr) {
+    uploads_->wait(uploadTicket_);
+  }
+}
+
+void ImageLayer::init(const Renderer::Context& ctx,
+                      std::span<const UploadManager::ImageLevel> levels,
+                      VkDeviceSize byteSize,
+                      const UploadManager::FillFn& fill) {
+  uploads_ = ctx.uploads;
+  mipLevels_ = static_cast<uint32_t>(levels.size());
+  createTexture(ctx.physicalDevice, *ctx.allocator);
+
+  uploadTicket_ = uploads_->uploadImage(texture_.get(), levels, byteSize, fill);
+  uploads_->flush();
+
   createDescriptors();
   createPipeline(ctx.swapchainFormat);
 }
 
+void ImageLayer::initMips(const Renderer::Context& ctx, const MipChain& chain) {
+  imageWidth_ = static_cast<int>(chain.width());
+  imageHeight_ = static_cast<int>(chain.height());
+  textureFormat_ = chain.format;
+  init(ctx, chain.levels, chain.data.size(), [&](uint8_t* dst) {
+    std::memcpy(dst, chain.data.data(), chain.data.size());
+  });
+}
+
 void ImageLayer::render(VkCommandBuffer cmd, VkExtent2D extent) const {
+  if (!uploads_->isComplete(uploadTicket_)) {
+    return;
+  }
+
   vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_.get());
   vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
                           pipelineLayout_.get(), 0, 1, &descriptorSet_, 0,
@@ -46,196 +104,40 @@ void ImageLayer::render(VkCommandBuffer cmd, VkExtent2D extent) const {
   vkCmdDraw(cmd, 6, 1, 0, 0);
 }
 
-std::vector<uint8_t> ImageLayer::loadImagePixels(
-    const std::filesystem::path& path) {
-  auto inp = OIIO::ImageInput::open(path.string());
-  if (!inp) {
-    throw std::runtime_error(fmt::format("Failed to open image: {} ({})",
-                                         path.string(), OIIO::geterror()));
-  }
-
-  const OIIO::ImageSpec& spec = inp->spec();
-  imageWidth_ = spec.width;
-  imageHeight_ = spec.height;
-
-  const size_t nchans = spec.nchannels;
-  const size_t npixels = static_cast<size_t>(imageWidth_) * imageHeight_;
-
-  std::vector<uint8_t> raw(npixels * nchans);
-  if (!inp->read_image(0, 0, 0, static_cast<int>(nchans),
-                       OIIO::TypeDesc::UINT8, raw.data())) {
-    throw std::runtime_error(fmt::format("Failed to read image pixels: {} ({})",
-                                         path.string(), inp->geterror()));
+void ImageLayer::createTexture(VkPhysicalDevice physicalDevice,
+                               GpuAllocator& allocator) {
+  if (!isSampleable(physicalDevice, textureFormat_)) {
+    throw std::runtime_error(fmt::format(
+        "Texture format (VkFormat {}) is not supported for sampling",
+        static_cast<int>(textureFormat_)));
   }
-  inp->close();
-
-  std::vector<uint8_t> pixels(npixels * 4);
-  auto* ptr = raw.data();
-  auto* pix = pixels.data();
-  for (size_t i = 0; i < npixels; ++i) {
-    for (std::size_t j = 0; j < 4u; ++j) {
-      if (j < nchans) {
-        (*pix++) = *ptr++;
-      } else {
-        (*pix++) = (j == 3u) ? 255 : 0;
-      }
-    }
-  }
-  return pixels;
-}
-
-void ImageLayer::uploadTexture(const std::vector<uint8_t>& pixels,
-                               VkPhysicalDevice physicalDevice, VkQueue queue,
-                               uint32_t queueFamily) {
-  const VkDeviceSize dataSize = static_cast<VkDeviceSize>(imageWidth_) *
-                                static_cast<VkDeviceSize>(imageHeight_) * 4;
-
-  VkPhysicalDeviceMemoryProperties memProps{};
-  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
-
-  // Staging buffer
-  const Buffer stagingBuffer(device_,
-                             VkBufferCreateInfo{
-                                 .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-                                 .size = dataSize,
-                                 .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                             });
-
-  VkMemoryRequirements reqs{};
-  vkGetBufferMemoryRequirements(device_, stagingBuffer.get(), &reqs);
-  const DeviceMemory stagingMemory(
-      device_, VkMemoryAllocateInfo{
-                   .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-                   .allocationSize = reqs.size,
-                   .memoryTypeIndex =
-                       findMemoryType(memProps, reqs.memoryTypeBits,
-                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
-               });
-  VK_CHECK(
-      vkBindBufferMemory(device_, stagingBuffer.get(), stagingMemory.get(), 0));
 
+  // Texture image, written by the upload queue and sampled by graphics
   {
-    void* mapped = nullptr;
-    VK_CHECK(
-        vkMapMemory(device_, stagingMemory.get(), 0, dataSize, 0, &mapped));
-    std::memcpy(mapped, pixels.data(), static_cast<size_t>(dataSize));
-    vkUnmapMemory(device_, stagingMemory.get());
-  }
-
-  // Texture image
-  {
+    const std::vector<uint32_t>& families = uploads_->queueFamilies();
     texture_ =
         Image(device_, VkImageCreateInfo{
                            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
                            .imageType = VK_IMAGE_TYPE_2D,
-                           .format = VK_FORMAT_R8G8B8A8_UNORM,
+                           .format = textureFormat_,
                            .extent = {static_cast<uint32_t>(imageWidth_),
                                       static_cast<uint32_t>(imageHeight_), 1},
-                           .mipLevels = 1,
+                           .mipLevels = mipLevels_,
                            .arrayLayers = 1,
                            .samples = VK_SAMPLE_COUNT_1_BIT,
                            .tiling = VK_IMAGE_TILING_OPTIMAL,
                            .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT |
                                     VK_IMAGE_USAGE_SAMPLED_BIT,
+                           .sharingMode = families.size() > 1
+                                              ? VK_SHARING_MODE_CONCURRENT
+                                              : VK_SHARING_MODE_EXCLUSIVE,
+                           .queueFamilyIndexCount =
+                               static_cast<uint32_t>(families.size()),
+                           .pQueueFamilyIndices = families.data(),
                        });
 
-    VkMemoryRequirements reqs{};
-    vkGetImageMemoryRequirements(device_, texture_.get(), &reqs);
-    textureMemory_ = DeviceMemory(
-        device_, VkMemoryAllocateInfo{
-                     .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-                     .allocationSize = reqs.size,
-                     .memoryTypeIndex =
-                         findMemoryType(memProps, reqs.memoryTypeBits,
-                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
-                 });
-    VK_CHECK(
-        vkBindImageMemory(device_, texture_.get(), textureMemory_.get(), 0));
-  }
-
-  // Upload via one-shot command buffer
-  {
-    const CommandPool uploadPool(
-        device_, VkCommandPoolCreateInfo{
-                     .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-                     .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
-                     .queueFamilyIndex = queueFamily,
-                 });
-
-    VkCommandBuffer uploadCmd = VK_NULL_HANDLE;
-    const VkCommandBufferAllocateInfo cbai{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = uploadPool.get(),
-        .commandBufferCount = 1,
-    };
-    VK_CHECK(vkAllocateCommandBuffers(device_, &cbai, &uploadCmd));
-
-    const VkCommandBufferBeginInfo beginInfo{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-    };
-    VK_CHECK(vkBeginCommandBuffer(uploadCmd, &beginInfo));
-
-    const VkImageMemoryBarrier toTransfer{
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = texture_.get(),
-        .subresourceRange =
-            {
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .levelCount = 1,
-                .layerCount = 1,
-            },
-    };
-    vkCmdPipelineBarrier(uploadCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
-                         nullptr, 1, &toTransfer);
-
-    const VkBufferImageCopy region{
-        .imageSubresource =
-            {
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .layerCount = 1,
-            },
-        .imageExtent = {static_cast<uint32_t>(imageWidth_),
-                        static_cast<uint32_t>(imageHeight_), 1},
-    };
-    vkCmdCopyBufferToImage(uploadCmd, stagingBuffer.get(), texture_.get(),
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-    const VkImageMemoryBarrier toShader{
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = texture_.get(),
-        .subresourceRange =
-            {
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .levelCount = 1,
-                .layerCount = 1,
-            },
-    };
-    vkCmdPipelineBarrier(uploadCmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
-                         0, nullptr, 1, &toShader);
-
-    VK_CHECK(vkEndCommandBuffer(uploadCmd));
-
-    const VkSubmitInfo si{
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &uploadCmd,
-    };
-    VK_CHECK(vkQueueSubmit(queue, 1, &si, VK_NULL_HANDLE));
-    VK_CHECK(vkQueueWaitIdle(queue));
+    textureMemory_ =
+        allocator.allocate(texture_.get(), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
   }
 
   // Image view
@@ -244,11 +146,11 @@ void ImageLayer::uploadTexture(const std::vector<uint8_t>& pixels,
                              .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
                              .image = texture_.get(),
                              .viewType = VK_IMAGE_VIEW_TYPE_2D,
-                             .format = VK_FORMAT_R8G8B8A8_UNORM,
+                             .format = textureFormat_,
                              .subresourceRange =
                                  {
                                      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                                     .levelCount = 1,
+                                     .levelCount = mipLevels_,
                                      .layerCount = 1,
                                  },
                          });
@@ -263,6 +165,7 @@ void ImageLayer::uploadTexture(const std::vector<uint8_t>& pixels,
                          .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
                          .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
                          .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                         .maxLod = VK_LOD_CLAMP_NONE,
                          .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
                      });
 }
@@ -410,17 +313,32 @@ void ImageLayer::createPipeline(VkFormat swapchainFormat) {
       .pDynamicState = &dynamicState,
       .layout = pipelineLayout_.get(),
   };
-  pipeline_ = Pipeline(device_, pipelineCI);
+  pipeline_ = Pipeline(device_, pipelineCI, pipelineCache_);
+}
+
+bool ImageLayer::isSampleable(VkPhysicalDevice physicalDevice,
+                              VkFormat format) {
+  VkFormatProperties formatProps{};
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProps);
+  const VkFormatFeatureFlags requiredFeatures =
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+      VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+  return (formatProps.optimalTilingFeatures & requiredFeatures) ==
+         requiredFeatures;
 }
 
-uint32_t ImageLayer::findMemoryType(VkPhysicalDeviceMemoryProperties memProps,
-                                    uint32_t typeBits,
-                                    VkMemoryPropertyFlags required) {
-  for (uint32_t i = 0; i < memProps.memoryTypeCount; ++i) {
-    if (((typeBits & (1u << i)) != 0) &&
-        (memProps.memoryTypes[i].propertyFlags & required) == required) {
-      return i;
-    }
+TextureOptions ImageLayer::supportedOptions(const Renderer::Context& ctx,
+                                            const TextureOptions& options) {
+  TextureOptions supported = options;
+  const VkFormat compressed =
+      options.compression == TextureCompression::kBc1
+          ? VK_FORMAT_BC1_RGB_UNORM_BLOCK
+          : VK_FORMAT_BC7_UNORM_BLOCK;
+  if (options.compression != TextureCompression::kNone &&
+      (!ctx.textureCompressionBC ||
+       !isSampleable(ctx.physicalDevice, compressed))) {
+    supported.compression = TextureCompression::kNone;
   }
-  throw std::runtime_error("No suitable Vulkan memory type found");
+  return supported;
 }
@@ -3,33 +3,56 @@
 #include <vulkan/vulkan.h>
 
 #include <filesystem>
-#include <vector>
+#include <optional>
+#include <span>
 
+#include "GpuAllocator.h"
+#include "ImageIO.h"
 #include "LayerBase.h"
+#include "TextureMips.h"
+#include "UploadManager.h"
 
 class ImageLayer : public PipelineLayerBase {
  public:
-  ImageLayer(const Renderer::Context& ctx, const std::filesystem::path& imagePath);
-
+  // Without an explicit format the texture keeps the source file's precision.
+  // Without mipmaps the file is decoded straight into staging memory; with
+  // them it is decoded whole first. Compression the device cannot sample
+  // falls back to uncompressed mips.
+  ImageLayer(const Renderer::Context& ctx,
+             const std::filesystem::path& imagePath,
+             std::optional<PixelFormat> format = std::nullopt,
+             const TextureOptions& options = {});
+  ImageLayer(const Renderer::Context& ctx, const ImageData& image,
+             const TextureOptions& options = {});
+  ~ImageLayer();
+
+  // Draws nothing until the texture upload has landed.
   void render(VkCommandBuffer cmd, VkExtent2D extent) const;
 
+  [[nodiscard]] uint64_t uploadTicket() const { return uploadTicket_; }
+
  private:
-  std::vector<uint8_t> loadImagePixels(const std::filesystem::path& path);
-  void uploadTexture(const std::vector<uint8_t>& pixels,
-                     VkPhysicalDevice physicalDevice,
-                     VkQueue queue,
-                     uint32_t queueFamily);
+  void init(const Renderer::Context& ctx,
+            std::span<const UploadManager::ImageLevel> levels,
+            VkDeviceSize byteSize, const UploadManager::FillFn& fill);
+  void initMips(const Renderer::Context& ctx, const MipChain& chain);
+  void createTexture(VkPhysicalDevice physicalDevice, GpuAllocator& allocator);
   void createDescriptors();
   void createPipeline(VkFormat swapchainFormat);
 
-  static uint32_t findMemoryType(VkPhysicalDeviceMemoryProperties memProps,
-                                 uint32_t typeBits,
-                                 VkMemoryPropertyFlags required);
+  static bool isSampleable(VkPhysicalDevice physicalDevice, VkFormat format);
+  // `options` with its compression dropped if the device cannot sample it.
+  static TextureOptions supportedOptions(const Renderer::Context& ctx,
+                                         const TextureOptions& options);
 
   int imageWidth_ = 0;
   int imageHeight_ = 0;
+  UploadManager* uploads_ = nullptr;
+  uint64_t uploadTicket_ = 0;
+  VkFormat textureFormat_ = VK_FORMAT_UNDEFINED;
+  uint32_t mipLevels_ = 1;
   Image texture_;
-  DeviceMemory textureMemory_;
+  GpuAllocation textureMemory_;
   ImageView textureView_;
   Sampler sampler_;
 
@@ -27,9 +27,12 @@ class PipelineLayerBase : public LayerBase {
   PipelineLayerBase& operator=(PipelineLayerBase&&) = delete;
 
  protected:
-  explicit PipelineLayerBase(const Renderer::Context& ctx) : LayerBase(ctx) {}
+  explicit PipelineLayerBase(const Renderer::Context& ctx)
+      : LayerBase(ctx), pipelineCache_(ctx.pipelineCache) {}
   ~PipelineLayerBase() = default;
 
+  VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+
   PipelineLayout pipelineLayout_;
   Pipeline pipeline_;
 };
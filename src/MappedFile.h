@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+// Read-only memory mapping of a whole file. Pages are faulted in on first
+// touch, so only the parts actually read cost I/O.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::filesystem::path& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&&) = delete;
+  MappedFile& operator=(MappedFile&&) = delete;
+
+  [[nodiscard]] std::span<const uint8_t> bytes() const {
+    return {data_, size_};
+  }
+  [[nodiscard]] size_t size() const { return size_; }
+
+  // Hints that the whole file is about to be read, so the kernel can start
+  // reading ahead on every page at once.
+  void prefetch() const;
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+
+// Just enough linear algebra for cameras and splat sorting. Matrices are
+// column-major to match GLSL push constants.
+
+struct Vec3 {
+  float x = 0.0f;
+  float y = 0.0f;
+  float z = 0.0f;
+};
+
+inline Vec3 operator+(Vec3 a, Vec3 b) {
+  return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+inline Vec3 operator-(Vec3 a, Vec3 b) {
+  return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+inline Vec3 operator*(Vec3 v, float s) {
+  return {v.x * s, v.y * s, v.z * s};
+}
+
+inline float dot(Vec3 a, Vec3 b) {
+  return (a.x * b.x) + (a.y * b.y) + (a.z * b.z);
+}
+
+inline Vec3 cross(Vec3 a, Vec3 b) {
+  return {(a.y * b.z) - (a.z * b.y), (a.z * b.x) - (a.x * b.z),
+          (a.x * b.y) - (a.y * b.x)};
+}
+
+inline float length(Vec3 v) {
+  return std::sqrt(dot(v, v));
+}
+
+inline Vec3 normalize(Vec3 v) {
+  return v * (1.0f / length(v));
+}
+
+// A plane that is positive on its outer side: dot(normal, p) + offset.
+struct Plane {
+  Vec3 normal;
+  float offset = 0.0f;
+};
+
+struct Mat4 {
+  // m[column * 4 + row].
+  std::array<float, 16> m{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+  [[nodiscard]] float operator()(int row, int column) const {
+    return m[(column * 4) + row];
+  }
+  float& operator()(int row, int column) { return m[(column * 4) + row]; }
+
+  // Row `row` of the upper 3x3 block.
+  [[nodiscard]] Vec3 row3(int row) const {
+    return {(*this)(row, 0), (*this)(row, 1), (*this)(row, 2)};
+  }
+};
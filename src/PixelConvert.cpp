@@ -0,0 +1,389 @@
+#include "PixelConvert.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXEL_CONVERT_X86 1
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PIXEL_CONVERT_NEON 1
+#endif
+
+namespace {
+
+using Expand8Fn = void (*)(const uint8_t*, uint8_t*, size_t, uint8_t);
+using Expand16Fn = void (*)(const uint16_t*, uint16_t*, size_t, uint16_t);
+
+// Scalar kernels. They also finish the tail that the vector loops leave.
+template <typename T, size_t Channels>
+void expandScalar(const T* src, T* dst, size_t count, T opaque) {
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t c = 0; c < Channels; ++c) {
+      dst[c] = src[c];
+    }
+    for (size_t c = Channels; c < 3; ++c) {
+      dst[c] = 0;
+    }
+    dst[3] = opaque;
+    src += Channels;
+    dst += 4;
+  }
+}
+
+struct Kernels {
+  const char* isa = "scalar";
+  Expand8Fn expand8[3] = {expandScalar<uint8_t, 1>, expandScalar<uint8_t, 2>,
+                          expandScalar<uint8_t, 3>};
+  Expand16Fn expand16[3] = {expandScalar<uint16_t, 1>,
+                            expandScalar<uint16_t, 2>,
+                            expandScalar<uint16_t, 3>};
+};
+
+#ifdef PIXEL_CONVERT_X86
+
+// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+
+// SSE2 is part of the x86-64 baseline, so these need no target attribute.
+void expand8c1Sse2(const uint8_t* src, uint8_t* dst, size_t count,
+                   uint8_t opaque) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i alpha = _mm_set1_epi16(static_cast<int16_t>(opaque << 8));
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    const __m128i lo = _mm_unpacklo_epi8(v, zero);
+    const __m128i hi = _mm_unpackhi_epi8(v, zero);
+    auto* out = reinterpret_cast<__m128i*>(dst + (i * 4));
+    _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(lo, alpha));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, alpha));
+    _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, alpha));
+    _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, alpha));
+  }
+  expandScalar<uint8_t, 1>(src + i, dst + (i * 4), count - i, opaque);
+}
+
+void expand8c2Sse2(const uint8_t* src, uint8_t* dst, size_t count,
+                   uint8_t opaque) {
+  const __m128i alpha = _mm_set1_epi16(static_cast<int16_t>(opaque << 8));
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i * 2)));
+    auto* out = reinterpret_cast<__m128i*>(dst + (i * 4));
+    _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(v, alpha));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(v, alpha));
+  }
+  expandScalar<uint8_t, 2>(src + (i * 2), dst + (i * 4), count - i, opaque);
+}
+
+void expand16c1Sse2(const uint16_t* src, uint16_t* dst, size_t count,
+                    uint16_t opaque) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i alpha = _mm_set1_epi32(static_cast<int32_t>(opaque) << 16);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    const __m128i lo = _mm_unpacklo_epi16(v, zero);
+    const __m128i hi = _mm_unpackhi_epi16(v, zero);
+    auto* out = reinterpret_cast<__m128i*>(dst + (i * 4));
+    _mm_storeu_si128(out + 0, _mm_unpacklo_epi32(lo, alpha));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi32(lo, alpha));
+    _mm_storeu_si128(out + 2, _mm_unpacklo_epi32(hi, alpha));
+    _mm_storeu_si128(out + 3, _mm_unpackhi_epi32(hi, alpha));
+  }
+  expandScalar<uint16_t, 1>(src + i, dst + (i * 4), count - i, opaque);
+}
+
+void expand16c2Sse2(const uint16_t* src, uint16_t* dst, size_t count,
+                    uint16_t opaque) {
+  const __m128i alpha = _mm_set1_epi32(static_cast<int32_t>(opaque) << 16);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i * 2)));
+    auto* out = reinterpret_cast<__m128i*>(dst + (i * 4));
+    _mm_storeu_si128(out + 0, _mm_unpacklo_epi32(v, alpha));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi32(v, alpha));
+  }
+  expandScalar<uint16_t, 2>(src + (i * 2), dst + (i * 4), count - i, opaque);
+}
+
+// RGB -> RGBA needs a byte shuffle. Each 16-byte load covers 4 (8-bit) or 2
+// (16-bit) whole pixels plus some bytes of the next ones, so the loops stop
+// early enough that no load reads past the end of the source.
+__attribute__((target("ssse3"))) void expand8c3Ssse3(const uint8_t* src,
+                                                     uint8_t* dst, size_t count,
+                                                     uint8_t opaque) {
+  const __m128i shuffle =
+      _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i alpha = _mm_set1_epi32(static_cast<int32_t>(opaque) << 24);
+  size_t i = 0;
+  for (; i + 6 <= count; i += 4) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i * 3)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (i * 4)),
+                     _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha));
+  }
+  expandScalar<uint8_t, 3>(src + (i * 3), dst + (i * 4), count - i, opaque);
+}
+
+__attribute__((target("ssse3"))) void expand16c3Ssse3(const uint16_t* src,
+                                                      uint16_t* dst,
+                                                      size_t count,
+                                                      uint16_t opaque) {
+  const __m128i shuffle =
+      _mm_setr_epi8(0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1);
+  const __m128i alpha = _mm_set1_epi64x(static_cast<int64_t>(opaque) << 48);
+  size_t i = 0;
+  for (; i + 3 <= count; i += 2) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i * 3)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (i * 4)),
+                     _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha));
+  }
+  expandScalar<uint16_t, 3>(src + (i * 3), dst + (i * 4), count - i, opaque);
+}
+
+// AVX2 widens with zero extension, then ORs the alpha lane in.
+__attribute__((target("avx2"))) void expand8c1Avx2(const uint8_t* src,
+                                                   uint8_t* dst, size_t count,
+                                                   uint8_t opaque) {
+  const __m256i alpha = _mm256_set1_epi32(static_cast<int32_t>(opaque) << 24);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i v =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + (i * 4)),
+                        _mm256_or_si256(_mm256_cvtepu8_epi32(v), alpha));
+  }
+  expandScalar<uint8_t, 1>(src + i, dst + (i * 4), count - i, opaque);
+}
+
+__attribute__((target("avx2"))) void expand8c2Avx2(const uint8_t* src,
+                                                   uint8_t* dst, size_t count,
+                                                   uint8_t opaque) {
+  const __m256i alpha = _mm256_set1_epi32(static_cast<int32_t>(opaque) << 24);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i * 2)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + (i * 4)),
+                        _mm256_or_si256(_mm256_cvtepu16_epi32(v), alpha));
+  }
+  expandScalar<uint8_t, 2>(src + (i * 2), dst + (i * 4), count - i, opaque);
+}
+
+__attribute__((target("avx2"))) void expand8c3Avx2(const uint8_t* src,
+                                                   uint8_t* dst, size_t count,
+                                                   uint8_t opaque) {
+  const __m256i shuffle = _mm256_setr_epi8(
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,  //
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m256i alpha = _mm256_set1_epi32(static_cast<int32_t>(opaque) << 24);
+  size_t i = 0;
+  for (; i + 10 <= count; i += 8) {
+    const uint8_t* p = src + (i * 3);
+    const __m256i v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + (i * 4)),
+                        _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha));
+  }
+  expand8c3Ssse3(src + (i * 3), dst + (i * 4), count - i, opaque);
+}
+
+__attribute__((target("avx2"))) void expand16c1Avx2(const uint16_t* src,
+                                                    uint16_t* dst, size_t count,
+                                                    uint16_t opaque) {
+  const __m256i alpha =
+      _mm256_set1_epi64x(static_cast<int64_t>(opaque) << 48);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128i v =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + (i * 4)),
+                        _mm256_or_si256(_mm256_cvtepu16_epi64(v), alpha));
+  }
+  expandScalar<uint16_t, 1>(src + i, dst + (i * 4), count - i, opaque);
+}
+
+__attribute__((target("avx2"))) void expand16c2Avx2(const uint16_t* src,
+                                                    uint16_t* dst, size_t count,
+                                                    uint16_t opaque) {
+  const __m256i alpha =
+      _mm256_set1_epi64x(static_cast<int64_t>(opaque) << 48);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i * 2)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + (i * 4)),
+                        _mm256_or_si256(_mm256_cvtepu32_epi64(v), alpha));
+  }
+  expandScalar<uint16_t, 2>(src + (i * 2), dst + (i * 4), count - i, opaque);
+}
+
+__attribute__((target("avx2"))) void expand16c3Avx2(const uint16_t* src,
+                                                    uint16_t* dst, size_t count,
+                                                    uint16_t opaque) {
+  const __m256i shuffle = _mm256_setr_epi8(
+      0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1,  //
+      0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1);
+  const __m256i alpha =
+      _mm256_set1_epi64x(static_cast<int64_t>(opaque) << 48);
+  size_t i = 0;
+  for (; i + 5 <= count; i += 4) {
+    const uint16_t* p = src + (i * 3);
+    const __m256i v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 6)), 1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + (i * 4)),
+                        _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha));
+  }
+  expand16c3Ssse3(src + (i * 3), dst + (i * 4), count - i, opaque);
+}
+
+// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+
+Kernels selectKernels() {
+  Kernels k;
+  k.isa = "sse2";
+  k.expand8[0] = expand8c1Sse2;
+  k.expand8[1] = expand8c2Sse2;
+  k.expand16[0] = expand16c1Sse2;
+  k.expand16[1] = expand16c2Sse2;
+
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("ssse3")) {
+    k.isa = "ssse3";
+    k.expand8[2] = expand8c3Ssse3;
+    k.expand16[2] = expand16c3Ssse3;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    k.isa = "avx2";
+    k.expand8[0] = expand8c1Avx2;
+    k.expand8[1] = expand8c2Avx2;
+    k.expand8[2] = expand8c3Avx2;
+    k.expand16[0] = expand16c1Avx2;
+    k.expand16[1] = expand16c2Avx2;
+    k.expand16[2] = expand16c3Avx2;
+  }
+  return k;
+}
+
+#elif defined(PIXEL_CONVERT_NEON)
+
+// De-interleaving loads and an interleaving store do the whole job.
+template <size_t Channels>
+void expand8Neon(const uint8_t* src, uint8_t* dst, size_t count,
+                 uint8_t opaque) {
+  const uint8x16_t zero = vdupq_n_u8(0);
+  const uint8x16_t alpha = vdupq_n_u8(opaque);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    uint8x16x4_t out{{zero, zero, zero, alpha}};
+    const uint8_t* p = src + (i * Channels);
+    if constexpr (Channels == 1) {
+      out.val[0] = vld1q_u8(p);
+    } else if constexpr (Channels == 2) {
+      const uint8x16x2_t in = vld2q_u8(p);
+      out.val[0] = in.val[0];
+      out.val[1] = in.val[1];
+    } else {
+      const uint8x16x3_t in = vld3q_u8(p);
+      out.val[0] = in.val[0];
+      out.val[1] = in.val[1];
+      out.val[2] = in.val[2];
+    }
+    vst4q_u8(dst + (i * 4), out);
+  }
+  expandScalar<uint8_t, Channels>(src + (i * Channels), dst + (i * 4),
+                                  count - i, opaque);
+}
+
+template <size_t Channels>
+void expand16Neon(const uint16_t* src, uint16_t* dst, size_t count,
+                  uint16_t opaque) {
+  const uint16x8_t zero = vdupq_n_u16(0);
+  const uint16x8_t alpha = vdupq_n_u16(opaque);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint16x8x4_t out{{zero, zero, zero, alpha}};
+    const uint16_t* p = src + (i * Channels);
+    if constexpr (Channels == 1) {
+      out.val[0] = vld1q_u16(p);
+    } else if constexpr (Channels == 2) {
+      const uint16x8x2_t in = vld2q_u16(p);
+      out.val[0] = in.val[0];
+      out.val[1] = in.val[1];
+    } else {
+      const uint16x8x3_t in = vld3q_u16(p);
+      out.val[0] = in.val[0];
+      out.val[1] = in.val[1];
+      out.val[2] = in.val[2];
+    }
+    vst4q_u16(dst + (i * 4), out);
+  }
+  expandScalar<uint16_t, Channels>(src + (i * Channels), dst + (i * 4),
+                                   count - i, opaque);
+}
+
+Kernels selectKernels() {
+  Kernels k;
+  k.isa = "neon";
+  k.expand8[0] = expand8Neon<1>;
+  k.expand8[1] = expand8Neon<2>;
+  k.expand8[2] = expand8Neon<3>;
+  k.expand16[0] = expand16Neon<1>;
+  k.expand16[1] = expand16Neon<2>;
+  k.expand16[2] = expand16Neon<3>;
+  return k;
+}
+
+#else
+
+Kernels selectKernels() {
+  return {};
+}
+
+#endif
+
+const Kernels& kernels() {
+  static const Kernels k = selectKernels();
+  return k;
+}
+
+}  // namespace
+
+void expandToRgba8(const uint8_t* src, uint8_t* dst, size_t pixelCount,
+                   size_t srcChannels, uint8_t opaque) {
+  if (srcChannels == 4) {
+    std::memcpy(dst, src, pixelCount * 4);
+    return;
+  }
+  if (srcChannels < 1 || srcChannels > 4) {
+    throw std::invalid_argument("expandToRgba8: unsupported channel count");
+  }
+  kernels().expand8[srcChannels - 1](src, dst, pixelCount, opaque);
+}
+
+void expandToRgba16(const uint16_t* src, uint16_t* dst, size_t pixelCount,
+                    size_t srcChannels, uint16_t opaque) {
+  if (srcChannels == 4) {
+    std::memcpy(dst, src, pixelCount * 4 * sizeof(uint16_t));
+    return;
+  }
+  if (srcChannels < 1 || srcChannels > 4) {
+    throw std::invalid_argument("expandToRgba16: unsupported channel count");
+  }
+  kernels().expand16[srcChannels - 1](src, dst, pixelCount, opaque);
+}
+
+const char* pixelConvertIsa() {
+  return kernels().isa;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Channel expansion of interleaved 1-, 2- or 3-channel pixels to RGBA.
+// Channels the source does not have are zero-filled and alpha is set to
+// `opaque`, matching the layout the texture upload path expects. A 4-channel
+// source is copied through unchanged.
+//
+// The implementation is chosen once at runtime from the CPU's features
+// (AVX2, SSSE3 or SSE2 on x86-64, NEON on AArch64, scalar otherwise).
+void expandToRgba8(const uint8_t* src, uint8_t* dst, size_t pixelCount,
+                   size_t srcChannels, uint8_t opaque = 0xff);
+void expandToRgba16(const uint16_t* src, uint16_t* dst, size_t pixelCount,
+                    size_t srcChannels, uint16_t opaque = 0xffff);
+
+// Name of the instruction set the kernels above dispatch to.
+const char* pixelConvertIsa();
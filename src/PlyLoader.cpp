@@ -0,0 +1,332 @@
+#include "PlyLoader.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+namespace {
+
+static_assert(std::endian::native == std::endian::little,
+              "PLY loading assumes a little-endian host");
+
+// Splats per conversion task: big enough to amortize the task overhead,
+// small enough to balance well across cores.
+constexpr size_t kChunkSplats = size_t{1} << 16;
+
+struct PlyProperty {
+  std::string name;
+  std::string type;
+  size_t offset = 0;
+};
+
+struct PlyElement {
+  std::string name;
+  size_t count = 0;
+  size_t stride = 0;
+  bool hasList = false;
+  std::vector<PlyProperty> properties;
+};
+
+// Where the vertex records start and what is in them.
+struct VertexLayout {
+  size_t count = 0;
+  size_t stride = 0;
+  size_t dataOffset = 0;
+  std::vector<PlyProperty> properties;
+};
+
+// Byte offsets of the splat fields within one vertex record.
+struct FieldOffsets {
+  std::array<size_t, 3> position{};
+  std::array<size_t, 3> scale{};
+  std::array<size_t, 4> rotation{};
+  std::array<size_t, 3> dc{};
+  size_t opacity = 0;
+  std::vector<size_t> rest;  // f_rest_0, f_rest_1, ...
+};
+
+size_t plyTypeSize(std::string_view type) {
+  if (type == "char" || type == "uchar" || type == "int8" ||
+      type == "uint8") {
+    return 1;
+  }
+  if (type == "short" || type == "ushort" || type == "int16" ||
+      type == "uint16") {
+    return 2;
+  }
+  if (type == "int" || type == "uint" || type == "float" ||
+      type == "int32" || type == "uint32" || type == "float32") {
+    return 4;
+  }
+  if (type == "double" || type == "float64") {
+    return 8;
+  }
+  return 0;
+}
+
+VertexLayout parseHeader(std::span<const uint8_t> bytes,
+                         const std::filesystem::path& path) {
+  const auto fail = [&](std::string_view what) {
+    return std::runtime_error(
+        fmt::format("Invalid PLY file: {} ({})", path.string(), what));
+  };
+
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  const std::string_view text(reinterpret_cast<const char*>(bytes.data()),
+                              bytes.size());
+  std::vector<PlyElement> elements;
+  bool sawMagic = false;
+  bool sawFormat = false;
+  size_t pos = 0;
+  while (true) {
+    const size_t eol = text.find('\n', pos);
+    if (eol == std::string_view::npos) {
+      throw fail("header is not terminated by end_header");
+    }
+    std::string_view line = text.substr(pos, eol - pos);
+    pos = eol + 1;
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+
+    if (!sawMagic) {
+      if (line != "ply") {
+        throw fail("missing ply magic");
+      }
+      sawMagic = true;
+      continue;
+    }
+    if (line == "end_header") {
+      break;
+    }
+
+    std::istringstream tokens{std::string(line)};
+    std::string keyword;
+    tokens >> keyword;
+    if (keyword == "format") {
+      std::string format;
+      tokens >> format;
+      if (format != "binary_little_endian") {
+        throw fail(fmt::format("unsupported format '{}'", format));
+      }
+      sawFormat = true;
+    } else if (keyword == "element") {
+      PlyElement& element = elements.emplace_back();
+      tokens >> element.name >> element.count;
+      if (!tokens) {
+        throw fail(fmt::format("malformed line '{}'", line));
+      }
+    } else if (keyword == "property") {
+      if (elements.empty()) {
+        throw fail("property outside of an element");
+      }
+      PlyElement& element = elements.back();
+      std::string type;
+      tokens >> type;
+      if (type == "list") {
+        element.hasList = true;
+        continue;
+      }
+      const size_t size = plyTypeSize(type);
+      std::string name;
+      tokens >> name;
+      if (size == 0 || !tokens) {
+        throw fail(fmt::format("malformed line '{}'", line));
+      }
+      element.properties.push_back({name, type, element.stride});
+      element.stride += size;
+    }
+    // comment and obj_info lines carry nothing we need.
+  }
+  if (!sawFormat) {
+    throw fail("missing format line");
+  }
+
+  // Records of earlier elements sit in front of the vertices; they can only
+  // be skipped if their size is known without parsing them.
+  size_t offset = pos;
+  for (const PlyElement& element : elements) {
+    if (element.name == "vertex") {
+      if (element.hasList) {
+        throw fail("list properties on vertices are not supported");
+      }
+      if (element.stride == 0) {
+        throw fail("vertices have no properties");
+      }
+      if (element.count > 0 &&
+          (bytes.size() - offset) / element.stride < element.count) {
+        throw fail(fmt::format("file is truncated ({} vertices declared)",
+                               element.count));
+      }
+      return {element.count, element.stride, offset, element.properties};
+    }
+    if (element.hasList) {
+      throw fail(fmt::format("cannot skip list element '{}'", element.name));
+    }
+    offset += element.count * element.stride;
+    if (offset > bytes.size()) {
+      throw fail("file is truncated");
+    }
+  }
+  throw fail("no vertex element");
+}
+
+FieldOffsets findFields(const VertexLayout& layout,
+                        const std::filesystem::path& path) {
+  const auto field = [&](const std::string& name) -> std::optional<size_t> {
+    const auto it = std::find_if(
+        layout.properties.begin(), layout.properties.end(),
+        [&](const PlyProperty& p) { return p.name == name; });
+    if (it == layout.properties.end()) {
+      return std::nullopt;
+    }
+    if (it->type != "float" && it->type != "float32") {
+      throw std::runtime_error(
+          fmt::format("Invalid PLY file: {} (property '{}' is {}, expected "
+                      "float)",
+                      path.string(), name, it->type));
+    }
+    return it->offset;
+  };
+  const auto required = [&](const std::string& name) {
+    const std::optional<size_t> offset = field(name);
+    if (!offset) {
+      throw std::runtime_error(fmt::format(
+          "Invalid PLY file: {} (missing property '{}'); not a Gaussian "
+          "splat scene?",
+          path.string(), name));
+    }
+    return *offset;
+  };
+
+  FieldOffsets f;
+  f.position = {required("x"), required("y"), required("z")};
+  f.scale = {required("scale_0"), required("scale_1"), required("scale_2")};
+  f.rotation = {required("rot_0"), required("rot_1"), required("rot_2"),
+                required("rot_3")};
+  f.dc = {required("f_dc_0"), required("f_dc_1"), required("f_dc_2")};
+  f.opacity = required("opacity");
+  while (const std::optional<size_t> offset =
+             field(fmt::format("f_rest_{}", f.rest.size()))) {
+    f.rest.push_back(*offset);
+  }
+  return f;
+}
+
+// The SH degree whose rest coefficients fill `restCount` floats.
+int shDegreeForRest(size_t restCount, const std::filesystem::path& path) {
+  for (int degree = 0; degree <= SplatCloud::kMaxShDegree; ++degree) {
+    if ((SplatCloud::shCoefficients(degree) - 1) * 3 == restCount) {
+      return degree;
+    }
+  }
+  throw std::runtime_error(
+      fmt::format("Invalid PLY file: {} ({} f_rest properties do not match an "
+                  "SH degree up to {})",
+                  path.string(), restCount, SplatCloud::kMaxShDegree));
+}
+
+float readFloat(const uint8_t* p) {
+  float value = 0.0f;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+// Converts vertices [begin, end) into `cloud`, whose arrays are already
+// sized. Chunks write disjoint ranges, so they can run concurrently.
+void convertChunk(const uint8_t* vertices, size_t stride,
+                  const FieldOffsets& f, size_t begin, size_t end,
+                  SplatCloud& cloud) {
+  const size_t coeffs = cloud.shCoefficients();
+  const size_t restPerChannel = coeffs - 1;
+  for (size_t i = begin; i < end; ++i) {
+    const uint8_t* v = vertices + i * stride;
+
+    for (size_t c = 0; c < 3; ++c) {
+      cloud.positions[i * 3 + c] = readFloat(v + f.position[c]);
+      cloud.scales[i * 3 + c] = std::exp(readFloat(v + f.scale[c]));
+    }
+
+    // Stored w x y z, like ours, but not necessarily unit length.
+    std::array<float, 4> q{};
+    float norm2 = 0.0f;
+    for (size_t c = 0; c < 4; ++c) {
+      q[c] = readFloat(v + f.rotation[c]);
+      norm2 += q[c] * q[c];
+    }
+    if (norm2 > 0.0f) {
+      const float invNorm = 1.0f / std::sqrt(norm2);
+      for (size_t c = 0; c < 4; ++c) {
+        cloud.rotations[i * 4 + c] = q[c] * invNorm;
+      }
+    } else {
+      cloud.rotations[i * 4] = 1.0f;  // Degenerate: identity.
+    }
+
+    cloud.opacities[i] = 1.0f / (1.0f + std::exp(-readFloat(v + f.opacity)));
+
+    // The file holds all rest coefficients of red, then green, then blue;
+    // ours interleaves the channels per coefficient.
+    float* sh = cloud.sh.data() + i * coeffs * 3;
+    for (size_t c = 0; c < 3; ++c) {
+      sh[c] = readFloat(v + f.dc[c]);
+      for (size_t k = 0; k < restPerChannel; ++k) {
+        sh[(k + 1) * 3 + c] = readFloat(v + f.rest[c * restPerChannel + k]);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+SplatCloud loadSplatPly(const std::filesystem::path& path,
+                        size_t threadCount) {
+  const MappedFile file(path);
+  const VertexLayout layout = parseHeader(file.bytes(), path);
+  const FieldOffsets fields = findFields(layout, path);
+
+  SplatCloud cloud;
+  cloud.resize(layout.count, shDegreeForRest(fields.rest.size(), path));
+  if (layout.count == 0) {
+    return cloud;
+  }
+
+  file.prefetch();
+  const uint8_t* vertices = file.bytes().data() + layout.dataOffset;
+  ThreadPool pool(threadCount);
+  std::vector<std::future<void>> chunks;
+  for (size_t begin = 0; begin < layout.count; begin += kChunkSplats) {
+    const size_t end = std::min(begin + kChunkSplats, layout.count);
+    chunks.push_back(pool.submit([&, begin, end]() {
+      convertChunk(vertices, layout.stride, fields, begin, end, cloud);
+    }));
+  }
+  for (std::future<void>& chunk : chunks) {
+    chunk.get();
+  }
+  return cloud;
+}
+
+bool isSplatPly(const std::filesystem::path& path) {
+  std::string ext = path.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return ext == ".ply";
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+#include "SplatCloud.h"
+
+// Loads trained scenes in the binary little-endian .ply layout written by the
+// reference 3D Gaussian Splatting implementation: one vertex per splat with
+// float properties x/y/z, f_dc_0..2, f_rest_*, opacity, scale_0..2 and
+// rot_0..3. Normals and any other extra properties are skipped.
+//
+// The file is memory-mapped and converted straight into SplatCloud's
+// structure-of-arrays layout in parallel chunks. Stored log-scales, opacity
+// logits and unnormalized quaternions are activated on the way in, and the
+// SH rest coefficients are reordered from the file's channel-major layout.
+// Throws std::runtime_error for files it cannot read.
+SplatCloud loadSplatPly(const std::filesystem::path& path,
+                        size_t threadCount = 0);  // 0 = hardware concurrency
+
+// True for paths with a .ply extension.
+bool isSplatPly(const std::filesystem::path& path);
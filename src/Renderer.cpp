@@ -8,13 +8,31 @@
 #include <stdexcept>
 #include <string>
 
+#include "DiskPipelineCache.h"
+#include "FrameProfiler.h"
+#include "GpuAllocator.h"
+#include "UploadManager.h"
 #include "VulkanErrors.h"
 
-Renderer::Renderer(SDL_Window* window) : window_(window) {
+Renderer::Renderer(SDL_Window* window, uint32_t framesInFlight)
+    : window_(window) {
   try {
     initInstanceAndSurface();
     initDeviceAndSwapchain();
-    initCommandsAndSync();
+    initCommandsAndSync(framesInFlight);
+  } catch (...) {
+    destroy();
+    throw;
+  }
+}
+
+Renderer::Renderer(const HeadlessConfig& config)
+    : swapchainFormat_(VK_FORMAT_R8G8B8A8_UNORM),
+      swapchainExtent_(config.extent) {
+  try {
+    initInstanceAndSurface();
+    initDeviceAndSwapchain();
+    initCommandsAndSync(config.framesInFlight);
   } catch (...) {
     destroy();
     throw;
@@ -29,13 +47,24 @@ void Renderer::destroy() {
   if (device_ != VK_NULL_HANDLE) {
     vkDeviceWaitIdle(device_);
 
+    for (auto& frame : frameContexts_) {
+      frame.retired.clear();
+    }
     destroySwapchainResources();
+    offscreen_.clear();
+    profiler_.reset();
+    uploads_.reset();
+    allocator_.reset();
+    pipelineCache_.reset();
     vkDestroySwapchainKHR(device_, swapchain_, nullptr);
     swapchain_ = VK_NULL_HANDLE;
 
-    vkDestroySemaphore(device_, sync_.imageAvailable, nullptr);
-    vkDestroyFence(device_, sync_.inFlight, nullptr);
-    vkDestroyCommandPool(device_, commandPool_, nullptr);
+    for (auto& frame : frameContexts_) {
+      vkDestroySemaphore(device_, frame.imageAvailable, nullptr);
+      vkDestroyFence(device_, frame.inFlight, nullptr);
+      vkDestroyCommandPool(device_, frame.commandPool, nullptr);
+    }
+    frameContexts_.clear();
 
     vkDestroyDevice(device_, nullptr);
     device_ = VK_NULL_HANDLE;
@@ -61,6 +90,12 @@ Renderer::Context Renderer::getContext() const {
       .queueFamily = graphicsQueueFamily_,
       .swapchainFormat = swapchainFormat_,
       .imageCount = static_cast<uint32_t>(frames_.size()),
+      .framesInFlight = static_cast<uint32_t>(frameContexts_.size()),
+      .pipelineCache = pipelineCache_->get(),
+      .allocator = allocator_.get(),
+      .uploads = uploads_.get(),
+      .profiler = profiler_.get(),
+      .textureCompressionBC = textureCompressionBC_,
   };
 }
 
@@ -101,6 +136,29 @@ VkPhysicalDevice Renderer::selectPhysicalDevice(
   return devices[0];
 }
 
+uint32_t Renderer::selectTransferQueueFamily(
+    const std::vector<VkQueueFamilyProperties>& queues,
+    uint32_t graphicsQueueFamily) {
+  // Prefer a pure copy-engine family (transfer without graphics or compute),
+  // then any non-graphics family with transfer. Graphics queues implicitly
+  // support transfer, so the graphics family is the fallback.
+  uint32_t fallback = graphicsQueueFamily;
+  for (uint32_t i = 0; i < queues.size(); ++i) {
+    const VkQueueFlags flags = queues[i].queueFlags;
+    if ((flags & VK_QUEUE_TRANSFER_BIT) == 0u ||
+        (flags & VK_QUEUE_GRAPHICS_BIT) != 0u || queues[i].queueCount == 0) {
+      continue;
+    }
+    if ((flags & VK_QUEUE_COMPUTE_BIT) == 0u) {
+      return i;
+    }
+    if (fallback == graphicsQueueFamily) {
+      fallback = i;
+    }
+  }
+  return fallback;
+}
+
 Renderer::SwapchainConfig Renderer::selectSwapchainConfig(
     SDL_Window* window, const VkSurfaceCapabilitiesKHR& caps,
     const std::vector<VkSurfaceFormatKHR>& formats,
@@ -150,14 +208,17 @@ Renderer::SwapchainConfig Renderer::selectSwapchainConfig(
 }
 
 void Renderer::initInstanceAndSurface() {
-  uint32_t extCount = 0;
-  const char* const* sdlExtensions =
-      SDL_Vulkan_GetInstanceExtensions(&extCount);
-  if (sdlExtensions == nullptr || extCount == 0) {
-    throw std::runtime_error("SDL_Vulkan_GetInstanceExtensions failed");
+  std::vector<const char*> extensions;
+  if (!isHeadless()) {
+    uint32_t extCount = 0;
+    const char* const* sdlExtensions =
+        SDL_Vulkan_GetInstanceExtensions(&extCount);
+    if (sdlExtensions == nullptr || extCount == 0) {
+      throw std::runtime_error("SDL_Vulkan_GetInstanceExtensions failed");
+    }
+    extensions.assign(sdlExtensions, sdlExtensions + extCount);
   }
 
-  std::vector<const char*> extensions(sdlExtensions, sdlExtensions + extCount);
   std::vector<const char*> validationLayers;
 #ifndef NDEBUG
   if (hasInstanceLayer("VK_LAYER_KHRONOS_validation")) {
@@ -184,7 +245,8 @@ void Renderer::initInstanceAndSurface() {
     throw std::runtime_error("vkCreateInstance failed");
   }
 
-  if (!SDL_Vulkan_CreateSurface(window_, instance_, nullptr, &surface_)) {
+  if (!isHeadless() &&
+      !SDL_Vulkan_CreateSurface(window_, instance_, nullptr, &surface_)) {
     throw std::runtime_error("SDL_Vulkan_CreateSurface failed");
   }
 }
@@ -209,9 +271,11 @@ void Renderer::initDeviceAndSwapchain() {
                                            queues.data());
 
   for (uint32_t i = 0; i < queueCount; ++i) {
-    VkBool32 presentSupport = VK_FALSE;
-    VK_CHECK(vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice_, i, surface_,
-                                                  &presentSupport));
+    VkBool32 presentSupport = VK_TRUE;
+    if (!isHeadless()) {
+      VK_CHECK(vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice_, i,
+                                                    surface_, &presentSupport));
+    }
     if (((queues[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0u) &&
         (presentSupport != 0u)) {
       graphicsQueueFamily_ = i;
@@ -224,35 +288,64 @@ void Renderer::initDeviceAndSwapchain() {
         "No queue family supports both graphics and present");
   }
 
+  transferQueueFamily_ =
+      selectTransferQueueFamily(queues, graphicsQueueFamily_);
+
   const float priority = 1.0f;
-  const VkDeviceQueueCreateInfo qci{
+  std::vector<VkDeviceQueueCreateInfo> queueInfos{{
       .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
       .queueFamilyIndex = graphicsQueueFamily_,
       .queueCount = 1,
       .pQueuePriorities = &priority,
-  };
+  }};
+  if (transferQueueFamily_ != graphicsQueueFamily_) {
+    queueInfos.push_back({
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = transferQueueFamily_,
+        .queueCount = 1,
+        .pQueuePriorities = &priority,
+    });
+  }
 
   const std::array<const char*, 1> deviceExtensions = {
       VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
-  const VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeature{
+  VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeature{
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
       .dynamicRendering = VK_TRUE,
   };
 
+  const VkPhysicalDeviceVulkan12Features vulkan12Features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+      .pNext = &dynamicRenderingFeature,
+      .timelineSemaphore = VK_TRUE,
+  };
+
+  // Optional: ImageLayer falls back to uncompressed textures without it.
+  VkPhysicalDeviceFeatures supportedFeatures{};
+  vkGetPhysicalDeviceFeatures(physicalDevice_, &supportedFeatures);
+  textureCompressionBC_ = supportedFeatures.textureCompressionBC == VK_TRUE;
+  const VkPhysicalDeviceFeatures enabledFeatures{
+      .textureCompressionBC = supportedFeatures.textureCompressionBC,
+  };
+
   const VkDeviceCreateInfo dci{
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-      .pNext = &dynamicRenderingFeature,
-      .queueCreateInfoCount = 1,
-      .pQueueCreateInfos = &qci,
-      .enabledExtensionCount = 1,
+      .pNext = &vulkan12Features,
+      .queueCreateInfoCount = static_cast<uint32_t>(queueInfos.size()),
+      .pQueueCreateInfos = queueInfos.data(),
+      .enabledExtensionCount = isHeadless() ? 0u : 1u,
       .ppEnabledExtensionNames = deviceExtensions.data(),
+      .pEnabledFeatures = &enabledFeatures,
   };
 
   VK_CHECK(vkCreateDevice(physicalDevice_, &dci, nullptr, &device_));
   vkGetDeviceQueue(device_, graphicsQueueFamily_, 0, &graphicsQueue_);
+  vkGetDeviceQueue(device_, transferQueueFamily_, 0, &transferQueue_);
 
-  createSwapchain(VK_NULL_HANDLE);
+  if (!isHeadless()) {
+    createSwapchain(VK_NULL_HANDLE);
+  }
 }
 
 void Renderer::createSwapchain(VkSwapchainKHR oldSwapchain) {
@@ -328,18 +421,7 @@ void Renderer::createSwapchain(VkSwapchainKHR oldSwapchain) {
   }
 }
 
-void Renderer::allocateFrameCommandsAndSync() {
-  std::vector<VkCommandBuffer> commandBuffers(frames_.size(), VK_NULL_HANDLE);
-  const VkCommandBufferAllocateInfo cbai{
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-      .commandPool = commandPool_,
-      .commandBufferCount = static_cast<uint32_t>(commandBuffers.size()),
-  };
-  VK_CHECK(vkAllocateCommandBuffers(device_, &cbai, commandBuffers.data()));
-  for (size_t i = 0; i < frames_.size(); ++i) {
-    frames_[i].commandBuffer = commandBuffers[i];
-  }
-
+void Renderer::createPresentSemaphores() {
   const VkSemaphoreCreateInfo semInfo{
       .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
   };
@@ -354,11 +436,7 @@ void Renderer::destroySwapchainResources() {
     return;
   }
 
-  std::vector<VkCommandBuffer> cmds;
   for (auto& frame : frames_) {
-    if (frame.commandBuffer != VK_NULL_HANDLE) {
-      cmds.push_back(frame.commandBuffer);
-    }
     if (frame.renderFinished != VK_NULL_HANDLE) {
       vkDestroySemaphore(device_, frame.renderFinished, nullptr);
     }
@@ -366,14 +444,14 @@ void Renderer::destroySwapchainResources() {
       vkDestroyImageView(device_, frame.view, nullptr);
     }
   }
-  if (commandPool_ != VK_NULL_HANDLE && !cmds.empty()) {
-    vkFreeCommandBuffers(device_, commandPool_,
-                         static_cast<uint32_t>(cmds.size()), cmds.data());
-  }
   frames_.clear();
 }
 
 void Renderer::recreateSwapchain() {
+  if (isHeadless()) {
+    return;
+  }
+
   int w = 0;
   int h = 0;
   SDL_GetWindowSizeInPixels(window_, &w, &h);
@@ -389,17 +467,19 @@ void Renderer::recreateSwapchain() {
   swapchain_ = VK_NULL_HANDLE;
 
   createSwapchain(oldSwapchain);
-  allocateFrameCommandsAndSync();
+  createPresentSemaphores();
 }
 
-void Renderer::initCommandsAndSync() {
+void Renderer::initCommandsAndSync(uint32_t framesInFlight) {
+  if (framesInFlight == 0) {
+    throw std::invalid_argument("framesInFlight must be at least 1");
+  }
+
   const VkCommandPoolCreateInfo cpci{
       .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
       .queueFamilyIndex = graphicsQueueFamily_,
   };
-  VK_CHECK(vkCreateCommandPool(device_, &cpci, nullptr, &commandPool_));
-
   const VkSemaphoreCreateInfo semInfo{
       .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
   };
@@ -408,53 +488,266 @@ void Renderer::initCommandsAndSync() {
       .flags = VK_FENCE_CREATE_SIGNALED_BIT,
   };
 
-  VK_CHECK(
-      vkCreateSemaphore(device_, &semInfo, nullptr, &sync_.imageAvailable));
-  VK_CHECK(vkCreateFence(device_, &fenceInfo, nullptr, &sync_.inFlight));
+  frameContexts_.resize(framesInFlight);
+  for (auto& frame : frameContexts_) {
+    VK_CHECK(vkCreateCommandPool(device_, &cpci, nullptr, &frame.commandPool));
+
+    const VkCommandBufferAllocateInfo cbai{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = frame.commandPool,
+        .commandBufferCount = 1,
+    };
+    VK_CHECK(vkAllocateCommandBuffers(device_, &cbai, &frame.commandBuffer));
+
+    VK_CHECK(
+        vkCreateSemaphore(device_, &semInfo, nullptr, &frame.imageAvailable));
+    VK_CHECK(vkCreateFence(device_, &fenceInfo, nullptr, &frame.inFlight));
+  }
+
+  pipelineCache_ =
+      std::make_unique<DiskPipelineCache>(device_, physicalDevice_);
+  allocator_ = std::make_unique<GpuAllocator>(device_, physicalDevice_);
+  uploads_ = std::make_unique<UploadManager>(*allocator_, transferQueue_,
+                                             transferQueueFamily_,
+                                             graphicsQueueFamily_);
+  profiler_ = std::make_unique<FrameProfiler>(
+      device_, physicalDevice_, graphicsQueueFamily_, framesInFlight);
 
-  allocateFrameCommandsAndSync();
+  if (isHeadless()) {
+    createOffscreenTargets();
+  } else {
+    createPresentSemaphores();
+  }
 }
 
-void Renderer::renderFrame(const std::function<void(VkCommandBuffer)>& drawFn) {
-  int w = 0;
-  int h = 0;
-  SDL_GetWindowSizeInPixels(window_, &w, &h);
-  if (w == 0 || h == 0) {
+void Renderer::recordReadback(VkCommandBuffer cmd, VkImage image,
+                              uint32_t frameIndex) {
+  const VkImageMemoryBarrier toTransfer{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = image,
+      .subresourceRange =
+          {
+              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+              .levelCount = 1,
+              .layerCount = 1,
+          },
+  };
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &toTransfer);
+
+  if (!readbackFn_) {
     return;
   }
 
-  VK_CHECK(vkWaitForFences(device_, 1, &sync_.inFlight, VK_TRUE, UINT64_MAX));
+  const VkBufferImageCopy region{
+      .imageSubresource =
+          {
+              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+              .layerCount = 1,
+          },
+      .imageExtent = {swapchainExtent_.width, swapchainExtent_.height, 1},
+  };
+  const VkBuffer readback = offscreen_[frameIndex].readback.get();
+  vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         readback, 1, &region);
+
+  const VkBufferMemoryBarrier toHost{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .buffer = readback,
+      .size = VK_WHOLE_SIZE,
+  };
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost, 0,
+                       nullptr);
+}
+
+void Renderer::createOffscreenTargets() {
+  const VkDeviceSize readbackSize = VkDeviceSize{swapchainExtent_.width} *
+                                    swapchainExtent_.height * 4;
+
+  offscreen_.resize(frameContexts_.size());
+  frames_.resize(frameContexts_.size());
+  for (size_t i = 0; i < offscreen_.size(); ++i) {
+    OffscreenTarget& target = offscreen_[i];
+    target.image = Image(
+        device_, VkImageCreateInfo{
+                     .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                     .imageType = VK_IMAGE_TYPE_2D,
+                     .format = swapchainFormat_,
+                     .extent = {swapchainExtent_.width,
+                                swapchainExtent_.height, 1},
+                     .mipLevels = 1,
+                     .arrayLayers = 1,
+                     .samples = VK_SAMPLE_COUNT_1_BIT,
+                     .tiling = VK_IMAGE_TILING_OPTIMAL,
+                     .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                              VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                 });
+    target.memory = allocator_->allocate(target.image.get(),
+                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    target.readback =
+        Buffer(device_, VkBufferCreateInfo{
+                            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                            .size = readbackSize,
+                            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                        });
+    // Cached memory keeps the host-side reads from crawling over the bus.
+    target.readbackMemory = allocator_->allocate(
+        target.readback.get(),
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+
+    frames_[i].image = target.image.get();
+    const VkImageViewCreateInfo ivci{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = frames_[i].image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = swapchainFormat_,
+        .subresourceRange =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .levelCount = 1,
+                .layerCount = 1,
+            },
+    };
+    VK_CHECK(vkCreateImageView(device_, &ivci, nullptr, &frames_[i].view));
+  }
+}
 
-  uint32_t imageIndex = 0;
-  const VkResult acquire =
-      vkAcquireNextImageKHR(device_, swapchain_, UINT64_MAX,
-                            sync_.imageAvailable, VK_NULL_HANDLE, &imageIndex);
+void Renderer::setReadbackCallback(ReadbackFn fn) {
+  if (!isHeadless()) {
+    throw std::logic_error("Readback is only available in headless mode");
+  }
+  readbackFn_ = std::move(fn);
+}
 
-  if (acquire == VK_ERROR_OUT_OF_DATE_KHR) {
-    recreateSwapchain();
+void Renderer::deliverReadback(uint32_t frameIndex) {
+  OffscreenTarget& target = offscreen_[frameIndex];
+  if (!target.readbackPending) {
     return;
   }
-  if (acquire != VK_SUCCESS && acquire != VK_SUBOPTIMAL_KHR) {
-    VK_CHECK(acquire);
+  target.readbackPending = false;
+  if (!readbackFn_) {
+    return;
+  }
+
+  const uint8_t* pixels = target.readbackMemory.mapped();
+  const size_t size = static_cast<size_t>(swapchainExtent_.width) *
+                      swapchainExtent_.height * 4;
+  const ImageData image{
+      .width = static_cast<int>(swapchainExtent_.width),
+      .height = static_cast<int>(swapchainExtent_.height),
+      .format = PixelFormat::kRgba8Unorm,
+      .pixels = std::vector<uint8_t>(pixels, pixels + size),
+  };
+  readbackFn_(target.frame, image);
+}
+
+void Renderer::finish() {
+  // Oldest first, so readbacks arrive in frame order.
+  const auto count = static_cast<uint32_t>(frameContexts_.size());
+  for (uint32_t i = 1; i <= count; ++i) {
+    const uint32_t frameIndex = (currentFrame_ + i) % count;
+    VK_CHECK(vkWaitForFences(device_, 1, &frameContexts_[frameIndex].inFlight,
+                             VK_TRUE, UINT64_MAX));
+    profiler_->collect(frameIndex);
+    if (isHeadless()) {
+      deliverReadback(frameIndex);
+    }
+  }
+}
+
+void Renderer::retire(std::shared_ptr<void> resource) {
+  // Frames complete in submission order, so the newest frame's fence covers
+  // every frame that could still reference the resource.
+  frameContexts_[currentFrame_].retired.push_back(std::move(resource));
+}
+
+void Renderer::renderFrame(
+    const std::function<void(VkCommandBuffer)>& drawFn,
+    const std::function<void(VkCommandBuffer)>& prepareFn) {
+  if (!isHeadless()) {
+    int w = 0;
+    int h = 0;
+    SDL_GetWindowSizeInPixels(window_, &w, &h);
+    if (w == 0 || h == 0) {
+      return;
+    }
+  }
+
+  FrameProfiler::CpuTimer frameTimer;
+  FrameProfiler::CpuTimer timer;
+
+  // Only wait for the frame that last used this slot; the frames after it
+  // keep the GPU busy while this one is recorded.
+  const uint32_t frameIndex =
+      (currentFrame_ + 1) % static_cast<uint32_t>(frameContexts_.size());
+  FrameContext& frameContext = frameContexts_[frameIndex];
+  VK_CHECK(vkWaitForFences(device_, 1, &frameContext.inFlight, VK_TRUE,
+                           UINT64_MAX));
+  frameContext.retired.clear();
+  profiler_->collect(frameIndex);
+  currentFrame_ = frameIndex;
+  profiler_->addCpuSample("wait", timer.lap());
+
+  // Headless frames own their target outright: no acquire, no present.
+  uint32_t imageIndex = frameIndex;
+  if (isHeadless()) {
+    deliverReadback(frameIndex);
+    profiler_->addCpuSample("readback", timer.lap());
+  } else {
+    const VkResult acquire = vkAcquireNextImageKHR(
+        device_, swapchain_, UINT64_MAX, frameContext.imageAvailable,
+        VK_NULL_HANDLE, &imageIndex);
+
+    if (acquire == VK_ERROR_OUT_OF_DATE_KHR) {
+      recreateSwapchain();
+      return;
+    }
+    if (acquire != VK_SUCCESS && acquire != VK_SUBOPTIMAL_KHR) {
+      VK_CHECK(acquire);
+    }
+    profiler_->addCpuSample("acquire", timer.lap());
   }
 
-  VK_CHECK(vkResetFences(device_, 1, &sync_.inFlight));
+  VK_CHECK(vkResetFences(device_, 1, &frameContext.inFlight));
 
   auto& frame = frames_[imageIndex];
-  VkCommandBuffer cmd = frame.commandBuffer;
+  VkCommandBuffer cmd = frameContext.commandBuffer;
   VkSemaphore renderFinished = frame.renderFinished;
-  VK_CHECK(vkResetCommandBuffer(cmd, 0));
+  VK_CHECK(vkResetCommandPool(device_, frameContext.commandPool, 0));
 
   const VkCommandBufferBeginInfo beginInfo{
       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
   };
   VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+  profiler_->beginFrame(frameIndex, cmd);
+  const uint32_t frameScope = profiler_->beginGpuScope(cmd, "frame");
+
+  if (prepareFn) {
+    prepareFn(cmd);
+  }
 
   const VkImageMemoryBarrier toColor{
       .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
       .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-      .oldLayout = frame.initialized ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-                                     : VK_IMAGE_LAYOUT_UNDEFINED,
+      .oldLayout = frame.initialized && !isHeadless()
+                       ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+                       : VK_IMAGE_LAYOUT_UNDEFINED,
       .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
       .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
       .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
@@ -506,40 +799,73 @@ void Renderer::renderFrame(const std::function<void(VkCommandBuffer)>& drawFn) {
 
   vkCmdEndRendering(cmd);
 
-  const VkImageMemoryBarrier toPresent{
-      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-      .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-      .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-      .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-      .image = frame.image,
-      .subresourceRange =
-          {
-              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-              .levelCount = 1,
-              .layerCount = 1,
-          },
-  };
-  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0,
-                       nullptr, 1, &toPresent);
+  if (isHeadless()) {
+    recordReadback(cmd, frame.image, frameIndex);
+  } else {
+    const VkImageMemoryBarrier toPresent{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = frame.image,
+        .subresourceRange =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .levelCount = 1,
+                .layerCount = 1,
+            },
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &toPresent);
+  }
 
+  profiler_->endGpuScope(cmd, frameScope);
   VK_CHECK(vkEndCommandBuffer(cmd));
-
-  const std::array<VkPipelineStageFlags, 1> waitStages = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+  profiler_->addCpuSample("record", timer.lap());
+
+  // Kick off anything recorded this frame, then wait on the uploads that
+  // have already finished: free on the GPU, but it makes their writes
+  // visible to this submission. In-flight uploads keep overlapping.
+  uploads_->flush();
+  const std::array<VkSemaphore, 2> waitSemaphores = {
+      frameContext.imageAvailable, uploads_->timeline()};
+  const std::array<uint64_t, 2> waitValues = {0, uploads_->completedValue()};
+  const std::array<VkPipelineStageFlags, 2> waitStages = {
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+  // Headless frames have no acquire to wait on and nothing to present.
+  const uint32_t firstWait = isHeadless() ? 1 : 0;
+  const auto waitCount =
+      static_cast<uint32_t>(waitSemaphores.size()) - firstWait;
+  const VkTimelineSemaphoreSubmitInfo timelineInfo{
+      .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+      .waitSemaphoreValueCount = waitCount,
+      .pWaitSemaphoreValues = waitValues.data() + firstWait,
+  };
   const VkSubmitInfo submitInfo{
       .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .waitSemaphoreCount = 1,
-      .pWaitSemaphores = &sync_.imageAvailable,
-      .pWaitDstStageMask = waitStages.data(),
+      .pNext = &timelineInfo,
+      .waitSemaphoreCount = waitCount,
+      .pWaitSemaphores = waitSemaphores.data() + firstWait,
+      .pWaitDstStageMask = waitStages.data() + firstWait,
       .commandBufferCount = 1,
       .pCommandBuffers = &cmd,
-      .signalSemaphoreCount = 1,
+      .signalSemaphoreCount = isHeadless() ? 0u : 1u,
       .pSignalSemaphores = &renderFinished,
   };
-  VK_CHECK(vkQueueSubmit(graphicsQueue_, 1, &submitInfo, sync_.inFlight));
+  VK_CHECK(
+      vkQueueSubmit(graphicsQueue_, 1, &submitInfo, frameContext.inFlight));
+  profiler_->addCpuSample("submit", timer.lap());
+
+  if (isHeadless()) {
+    offscreen_[frameIndex].frame = frameNumber_++;
+    offscreen_[frameIndex].readbackPending = static_cast<bool>(readbackFn_);
+    profiler_->addCpuSample("frame", frameTimer.lap());
+    return;
+  }
 
   const VkPresentInfoKHR presentInfo{
       .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -551,6 +877,8 @@ void Renderer::renderFrame(const std::function<void(VkCommandBuffer)>& drawFn) {
   };
 
   const VkResult present = vkQueuePresentKHR(graphicsQueue_, &presentInfo);
+  profiler_->addCpuSample("present", timer.lap());
+  profiler_->addCpuSample("frame", frameTimer.lap());
   if (present == VK_ERROR_OUT_OF_DATE_KHR || present == VK_SUBOPTIMAL_KHR) {
     recreateSwapchain();
     return;
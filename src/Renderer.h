@@ -5,8 +5,16 @@
 
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <vector>
 
+#include "GpuAllocator.h"
+#include "ImageIO.h"
+
+class DiskPipelineCache;
+class FrameProfiler;
+class UploadManager;
+
 class Renderer {
  public:
   struct Context {
@@ -17,9 +25,37 @@ class Renderer {
     uint32_t queueFamily = UINT32_MAX;
     VkFormat swapchainFormat = VK_FORMAT_UNDEFINED;
     uint32_t imageCount = 0;
+    uint32_t framesInFlight = 0;
+    // Disk-backed cache every pipeline should be created through.
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    GpuAllocator* allocator = nullptr;
+    // Shared uploader. Every frame waits for the uploads completed by the
+    // time it is submitted, so a layer may draw a resource once its ticket
+    // reports complete.
+    UploadManager* uploads = nullptr;
+    // Frame timings. Layers may wrap their commands in a GPU scope.
+    FrameProfiler* profiler = nullptr;
+    // BC1-BC7 images can be sampled (the feature is enabled when present).
+    bool textureCompressionBC = false;
   };
 
-  explicit Renderer(SDL_Window* window);
+  static constexpr uint32_t kDefaultFramesInFlight = 2;
+
+  // Offscreen rendering without a window, surface or swapchain, e.g. on a
+  // display-less machine with a software ICD such as lavapipe. Frames render
+  // into RGBA8 images, one per frame in flight.
+  struct HeadlessConfig {
+    VkExtent2D extent{1280, 720};
+    uint32_t framesInFlight = kDefaultFramesInFlight;
+  };
+
+  // Receives each headless frame's pixels, in frame order. Called from
+  // renderFrame() once the frame's slot comes round again, or from finish().
+  using ReadbackFn = std::function<void(uint64_t frame, const ImageData&)>;
+
+  explicit Renderer(SDL_Window* window,
+                    uint32_t framesInFlight = kDefaultFramesInFlight);
+  explicit Renderer(const HeadlessConfig& config);
   ~Renderer();
 
   Renderer(const Renderer&) = delete;
@@ -27,22 +63,56 @@ class Renderer {
   Renderer(Renderer&&) = delete;
   Renderer& operator=(Renderer&&) = delete;
 
-  void renderFrame(const std::function<void(VkCommandBuffer)>& drawFn = {});
+  // Records `drawFn` inside the frame's render pass. `prepareFn` is recorded
+  // before the pass begins, for work that cannot run inside one (compute
+  // dispatches, copies); it must leave its own barriers for the draws.
+  void renderFrame(const std::function<void(VkCommandBuffer)>& drawFn = {},
+                   const std::function<void(VkCommandBuffer)>& prepareFn = {});
+
+  // Keeps `resource` alive until every frame recorded so far has finished
+  // on the GPU, instead of stalling the device before destroying it.
+  void retire(std::shared_ptr<void> resource);
+
+  // Headless only. While set, every frame is copied back to host memory;
+  // the copy is recorded into the frame itself, so it never stalls.
+  void setReadbackCallback(ReadbackFn fn);
+  // Waits for all submitted frames and delivers their pending readbacks.
+  void finish();
 
   void recreateSwapchain();
+  // Frame-in-flight slot being recorded. Inside renderFrame's callback the
+  // slot's previous frame has finished on the GPU, so per-slot resources
+  // (one per Context::framesInFlight) may be rewritten.
+  [[nodiscard]] uint32_t frameSlot() const { return currentFrame_; }
+  [[nodiscard]] bool isHeadless() const { return window_ == nullptr; }
   [[nodiscard]] Context getContext() const;
   [[nodiscard]] VkExtent2D getSwapchainExtent() const;
 
  private:
-  struct FrameSync {
+  // Everything one frame in flight owns. The CPU only waits on a frame's
+  // fence when it comes round to reuse that slot, N frames later.
+  struct FrameContext {
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
     VkSemaphore imageAvailable = VK_NULL_HANDLE;
     VkFence inFlight = VK_NULL_HANDLE;
+    std::vector<std::shared_ptr<void>> retired;
+  };
+
+  // Headless render target for one frame slot, with its host readback copy.
+  struct OffscreenTarget {
+    Image image;
+    GpuAllocation memory;
+    Buffer readback;
+    GpuAllocation readbackMemory;
+    uint64_t frame = 0;
+    bool readbackPending = false;
   };
 
+  // The present wait is tied to the image, so its semaphore is per image.
   struct SwapchainImageResources {
     VkImage image = VK_NULL_HANDLE;
     VkImageView view = VK_NULL_HANDLE;
-    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
     VkSemaphore renderFinished = VK_NULL_HANDLE;
     bool initialized = false;
   };
@@ -56,10 +126,13 @@ class Renderer {
 
   void initInstanceAndSurface();
   void initDeviceAndSwapchain();
-  void initCommandsAndSync();
+  void initCommandsAndSync(uint32_t framesInFlight);
 
   void createSwapchain(VkSwapchainKHR oldSwapchain);
-  void allocateFrameCommandsAndSync();
+  void createPresentSemaphores();
+  void createOffscreenTargets();
+  void recordReadback(VkCommandBuffer cmd, VkImage image, uint32_t frameIndex);
+  void deliverReadback(uint32_t frameIndex);
   void destroySwapchainResources();
 
   void destroy();
@@ -67,6 +140,9 @@ class Renderer {
   static bool hasInstanceLayer(const char* layerName);
   static VkPhysicalDevice selectPhysicalDevice(
       const std::vector<VkPhysicalDevice>& devices);
+  static uint32_t selectTransferQueueFamily(
+      const std::vector<VkQueueFamilyProperties>& queues,
+      uint32_t graphicsQueueFamily);
   static SwapchainConfig selectSwapchainConfig(
       SDL_Window* window, const VkSurfaceCapabilitiesKHR& caps,
       const std::vector<VkSurfaceFormatKHR>& formats,
@@ -77,15 +153,26 @@ class Renderer {
   VkInstance instance_ = VK_NULL_HANDLE;
   VkSurfaceKHR surface_ = VK_NULL_HANDLE;
   VkPhysicalDevice physicalDevice_ = VK_NULL_HANDLE;
+  bool textureCompressionBC_ = false;
   VkDevice device_ = VK_NULL_HANDLE;
   VkQueue graphicsQueue_ = VK_NULL_HANDLE;
   uint32_t graphicsQueueFamily_ = UINT32_MAX;
+  VkQueue transferQueue_ = VK_NULL_HANDLE;
+  uint32_t transferQueueFamily_ = UINT32_MAX;
 
   VkSwapchainKHR swapchain_ = VK_NULL_HANDLE;
   VkFormat swapchainFormat_ = VK_FORMAT_UNDEFINED;
   VkExtent2D swapchainExtent_{};
   std::vector<SwapchainImageResources> frames_;
 
-  VkCommandPool commandPool_ = VK_NULL_HANDLE;
-  FrameSync sync_;
+  std::vector<FrameContext> frameContexts_;
+  uint32_t currentFrame_ = 0;
+  uint64_t frameNumber_ = 0;
+
+  std::vector<OffscreenTarget> offscreen_;
+  ReadbackFn readbackFn_;
+  std::unique_ptr<DiskPipelineCache> pipelineCache_;
+  std::unique_ptr<GpuAllocator> allocator_;
+  std::unique_ptr<UploadManager> uploads_;
+  std::unique_ptr<FrameProfiler> profiler_;
 };
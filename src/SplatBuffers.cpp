@@ -0,0 +1,347 @@
+#include "SplatBuffers.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t kNotStaged = std::numeric_limits<uint32_t>::max();
+// Matches the three-sigma extent the shaders draw.
+constexpr float kSigmas = 3.0f;
+
+std::span<const uint8_t> asBytes(const std::vector<float>& values) {
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  return {reinterpret_cast<const uint8_t*>(values.data()),
+          values.size() * sizeof(float)};
+}
+
+}  // namespace
+
+SplatBuffers::SplatBuffers(const Renderer::Context& ctx,
+                           const SplatCloud& cloud)
+    : count_(cloud.count),
+      capacity_(cloud.count),
+      shDegree_(cloud.shDegree),
+      uploads_(ctx.uploads),
+      hostPositions_(std::make_shared<std::vector<float>>(cloud.positions)),
+      index_(cloud) {
+  if (count_ == 0) {
+    throw std::invalid_argument("Cannot upload an empty splat cloud");
+  }
+
+  upload(ctx, kPositions, asBytes(cloud.positions));
+  upload(ctx, kScales, asBytes(cloud.scales));
+  upload(ctx, kRotations, asBytes(cloud.rotations));
+  upload(ctx, kOpacities, asBytes(cloud.opacities));
+  upload(ctx, kSh, asBytes(cloud.sh));
+  uploads_->flush();
+}
+
+SplatBuffers::SplatBuffers(const Renderer::Context& ctx,
+                           const CompactSplatFile& file)
+    : count_(file.count()),
+      capacity_(file.count()),
+      shDegree_(file.shDegree()),
+      encoding_(Encoding::kCompact),
+      uploads_(ctx.uploads),
+      hostPositions_(
+          std::make_shared<std::vector<float>>(file.decodePositions())),
+      index_(file) {
+  if (count_ == 0) {
+    throw std::invalid_argument("Cannot upload an empty splat cloud");
+  }
+
+  using Section = CompactSplatFile::Section;
+  upload(ctx, kPositions, file.section(Section::kPositions));
+  upload(ctx, kScales, file.section(Section::kScales));
+  upload(ctx, kRotations, file.section(Section::kRotations));
+  upload(ctx, kOpacities, file.section(Section::kColors));
+  upload(ctx, kSh, file.section(Section::kShRest));
+  upload(ctx, kChunks, file.section(Section::kChunks));
+  uploads_->flush();
+}
+
+SplatBuffers::SplatBuffers(const Renderer::Context& ctx, size_t capacity,
+                           int degree, uint32_t maxWritesPerFrame)
+    : capacity_(capacity),
+      shDegree_(degree),
+      uploads_(ctx.uploads),
+      hostPositions_(std::make_shared<std::vector<float>>(capacity * 3)),
+      index_(capacity),
+      maxWritesPerFrame_(maxWritesPerFrame),
+      stagedIndex_(capacity, kNotStaged),
+      hostRadii_(capacity, -1.0f),
+      chunkDirty_(index_.chunkCount()) {
+  if (capacity == 0 || maxWritesPerFrame == 0) {
+    throw std::invalid_argument("A dynamic splat cloud needs room");
+  }
+  staged_.resize(0, degree);
+
+  const size_t coeffs = SplatCloud::shCoefficients(degree);
+  createBuffer(ctx, kPositions, capacity * 3 * sizeof(float));
+  createBuffer(ctx, kScales, capacity * 3 * sizeof(float));
+  createBuffer(ctx, kRotations, capacity * 4 * sizeof(float));
+  createBuffer(ctx, kSh, capacity * coeffs * 3 * sizeof(float));
+  // Empty slots are transparent until written.
+  upload(ctx, kOpacities, asBytes(std::vector<float>(capacity, 0.0f)));
+  uploads_->flush();
+
+  const VkDeviceSize stagingSize =
+      VkDeviceSize{maxWritesPerFrame} * (3 + 3 + 4 + 1 + coeffs * 3) *
+      sizeof(float);
+  for (uint32_t i = 0; i < ctx.framesInFlight; ++i) {
+    staging_.emplace_back(*ctx.allocator, stagingSize);
+  }
+}
+
+SplatBuffers::~SplatBuffers() {
+  if (uploads_ != nullptr && uploadTicket_ != 0) {
+    uploads_->wait(uploadTicket_);
+  }
+}
+
+void SplatBuffers::createBuffer(const Renderer::Context& ctx,
+                                Attribute attribute, VkDeviceSize size) {
+  // Degree-0 compact clouds have no SH rest data, but every binding needs a
+  // buffer behind it.
+  size = std::max<VkDeviceSize>(size, 4);
+
+  // Written by the upload queue (and, when dynamic, by frames) and read by
+  // graphics.
+  const std::vector<uint32_t>& families = uploads_->queueFamilies();
+  buffers_[attribute] = Buffer(
+      ctx.device,
+      VkBufferCreateInfo{
+          .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+          .size = size,
+          .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+          .sharingMode = families.size() > 1 ? VK_SHARING_MODE_CONCURRENT
+                                             : VK_SHARING_MODE_EXCLUSIVE,
+          .queueFamilyIndexCount = static_cast<uint32_t>(families.size()),
+          .pQueueFamilyIndices = families.data(),
+      });
+  memory_[attribute] = ctx.allocator->allocate(
+      buffers_[attribute].get(), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void SplatBuffers::upload(const Renderer::Context& ctx, Attribute attribute,
+                          std::span<const uint8_t> data) {
+  createBuffer(ctx, attribute, data.size());
+  if (data.empty()) {
+    return;
+  }
+  // Tickets grow monotonically, so the last one covers every attribute.
+  uploadTicket_ = uploads_->uploadBuffer(
+      buffers_[attribute].get(), 0, data.size(),
+      [&](uint8_t* dst) { std::memcpy(dst, data.data(), data.size()); });
+}
+
+bool SplatBuffers::ready() const {
+  return uploads_->isComplete(uploadTicket_);
+}
+
+VkDescriptorBufferInfo SplatBuffers::descriptor(Attribute attribute) const {
+  return {
+      .buffer = buffers_[attribute].get(),
+      .range = VK_WHOLE_SIZE,
+  };
+}
+
+std::vector<VkDescriptorSetLayoutBinding> SplatBuffers::layoutBindings(
+    VkShaderStageFlags stages) const {
+  std::vector<VkDescriptorSetLayoutBinding> bindings(attributeCount());
+  for (uint32_t i = 0; i < bindings.size(); ++i) {
+    bindings[i] = {
+        .binding = shaderBinding(static_cast<Attribute>(i)),
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = stages,
+    };
+  }
+  return bindings;
+}
+
+size_t SplatBuffers::stage(uint32_t slot) {
+  if (!dynamic()) {
+    throw std::logic_error("Only dynamic splat clouds can be written");
+  }
+  if (slot >= capacity_) {
+    throw std::invalid_argument(
+        fmt::format("Splat slot {} past capacity {}", slot, capacity_));
+  }
+  if (stagedIndex_[slot] != kNotStaged) {
+    return stagedIndex_[slot];
+  }
+  if (stagedSlots_.size() == maxWritesPerFrame_) {
+    throw std::length_error(fmt::format(
+        "More than {} splat writes staged in one frame", maxWritesPerFrame_));
+  }
+  const size_t index = stagedSlots_.size();
+  stagedSlots_.push_back(slot);
+  stagedIndex_[slot] = static_cast<uint32_t>(index);
+  staged_.resize(index + 1, shDegree_);
+
+  const uint32_t chunk = slot / SplatIndex::kChunkSplats;
+  if (!chunkDirty_[chunk]) {
+    chunkDirty_[chunk] = true;
+    dirtyChunks_.push_back(chunk);
+  }
+  return index;
+}
+
+std::vector<float>& SplatBuffers::ownHostPositions() {
+  // A sorting thread may still be reading a snapshot; leave it be.
+  if (hostPositions_.use_count() > 1) {
+    hostPositions_ = std::make_shared<std::vector<float>>(*hostPositions_);
+  }
+  return *hostPositions_;
+}
+
+void SplatBuffers::write(uint32_t slot, const SplatCloudView& source,
+                         size_t index) {
+  if (source.shDegree != shDegree_ || index >= source.count) {
+    throw std::invalid_argument("Splat source does not match the cloud");
+  }
+  const size_t i = stage(slot);
+  const size_t coeffs = staged_.shCoefficients();
+  const auto copy = [&](std::span<const float> from, std::vector<float>& to,
+                        size_t stride) {
+    std::copy_n(from.begin() + static_cast<ptrdiff_t>(index * stride), stride,
+                to.begin() + static_cast<ptrdiff_t>(i * stride));
+  };
+  copy(source.positions, staged_.positions, 3);
+  copy(source.scales, staged_.scales, 3);
+  copy(source.rotations, staged_.rotations, 4);
+  copy(source.opacities, staged_.opacities, 1);
+  copy(source.sh, staged_.sh, coeffs * 3);
+
+  std::copy_n(source.positions.begin() + static_cast<ptrdiff_t>(index * 3), 3,
+              ownHostPositions().begin() + static_cast<ptrdiff_t>(slot) * 3);
+  hostRadii_[slot] = kSigmas * std::max({source.scales[index * 3],
+                                         source.scales[index * 3 + 1],
+                                         source.scales[index * 3 + 2]});
+}
+
+void SplatBuffers::hide(uint32_t slot) {
+  const size_t i = stage(slot);
+  const size_t coeffs = staged_.shCoefficients();
+  const auto clear = [&](std::vector<float>& to, size_t stride) {
+    std::fill_n(to.begin() + static_cast<ptrdiff_t>(i * stride), stride,
+                0.0f);
+  };
+  clear(staged_.positions, 3);
+  clear(staged_.scales, 3);
+  clear(staged_.rotations, 4);
+  clear(staged_.opacities, 1);
+  clear(staged_.sh, coeffs * 3);
+  // Leaves the chunk's bounds to the splats that are there.
+  hostRadii_[slot] = -1.0f;
+}
+
+void SplatBuffers::setCount(size_t count) {
+  if (!dynamic() || count > capacity_) {
+    throw std::invalid_argument(
+        fmt::format("Cannot hold {} splats (capacity {})", count, capacity_));
+  }
+  // The chunks that gain or lose splats.
+  const size_t lo = std::min(count, count_) / SplatIndex::kChunkSplats;
+  const size_t hi =
+      (std::max(count, count_) + SplatIndex::kChunkSplats - 1) /
+      SplatIndex::kChunkSplats;
+  for (size_t chunk = lo; chunk < hi; ++chunk) {
+    if (!chunkDirty_[chunk]) {
+      chunkDirty_[chunk] = true;
+      dirtyChunks_.push_back(static_cast<uint32_t>(chunk));
+    }
+  }
+  changed_ = changed_ || count != count_;
+  count_ = count;
+}
+
+void SplatBuffers::recordWrites(VkCommandBuffer cmd, uint32_t frameSlot) {
+  if (!dynamic() || (!changed_ && stagedSlots_.empty())) {
+    return;
+  }
+  index_.refit(*hostPositions_, hostRadii_, count_, dirtyChunks_);
+  for (const uint32_t chunk : dirtyChunks_) {
+    chunkDirty_[chunk] = false;
+  }
+  dirtyChunks_.clear();
+  changed_ = false;
+  ++generation_;
+  if (stagedSlots_.empty()) {
+    return;
+  }
+
+  // Staged in slot order, so runs of neighbouring slots copy as one region.
+  std::vector<uint32_t> order(stagedSlots_.size());
+  std::iota(order.begin(), order.end(), 0u);
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return stagedSlots_[a] < stagedSlots_[b];
+  });
+
+  // Earlier frames' shaders may still be reading the slots about to be
+  // overwritten.
+  vkCmdPipelineBarrier(cmd,
+                       VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 0, nullptr);
+
+  const StagingBuffer& staging = staging_[frameSlot];
+  VkDeviceSize stagingOffset = 0;
+  std::vector<VkBufferCopy> regions;
+  const auto copyAttribute = [&](Attribute attribute,
+                                 const std::vector<float>& values,
+                                 size_t stride) {
+    const VkDeviceSize bytes = stride * sizeof(float);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto* dst = reinterpret_cast<float*>(staging.data() + stagingOffset);
+    regions.clear();
+    for (size_t k = 0; k < order.size(); ++k) {
+      std::copy_n(values.begin() + static_cast<ptrdiff_t>(order[k] * stride),
+                  stride, dst + k * stride);
+      const VkDeviceSize dstOffset = stagedSlots_[order[k]] * bytes;
+      if (!regions.empty() &&
+          regions.back().dstOffset + regions.back().size == dstOffset) {
+        regions.back().size += bytes;
+      } else {
+        regions.push_back({
+            .srcOffset = stagingOffset + k * bytes,
+            .dstOffset = dstOffset,
+            .size = bytes,
+        });
+      }
+    }
+    vkCmdCopyBuffer(cmd, staging.buffer(), buffers_[attribute].get(),
+                    static_cast<uint32_t>(regions.size()), regions.data());
+    stagingOffset += maxWritesPerFrame_ * bytes;
+  };
+  copyAttribute(kPositions, staged_.positions, 3);
+  copyAttribute(kScales, staged_.scales, 3);
+  copyAttribute(kRotations, staged_.rotations, 4);
+  copyAttribute(kOpacities, staged_.opacities, 1);
+  copyAttribute(kSh, staged_.sh, staged_.shCoefficients() * 3);
+
+  const VkMemoryBarrier written{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+  };
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 1, &written, 0, nullptr, 0, nullptr);
+
+  for (const uint32_t slot : stagedSlots_) {
+    stagedIndex_[slot] = kNotStaged;
+  }
+  stagedSlots_.clear();
+  staged_.resize(0, shDegree_);
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "CompactSplats.h"
+#include "GpuAllocator.h"
+#include "Renderer.h"
+#include "SplatCloud.h"
+#include "SplatIndex.h"
+#include "StagingBuffer.h"
+#include "UploadManager.h"
+#include "VulkanHandles.h"
+
+// A splat cloud resident on the GPU: one storage buffer per attribute,
+// filled through the shared UploadManager. Layers bind the buffers directly;
+// nothing is repacked per frame.
+//
+// A SplatCloud is uploaded as its float arrays. A CompactSplatFile is copied
+// from the mapping section by section, still quantized, and decoded by the
+// shaders (built with SPLAT_COMPACT; see shaders/splat_data.glsl). In that
+// encoding kOpacities holds the packed DC colors and opacities, kSh only the
+// higher-order coefficients, and kChunks the per-chunk bounds.
+//
+// A SplatIndex over the cloud is built alongside, for layers to cull with;
+// float clouds should be in Morton order (see SplatIndex.h) for it to be
+// effective.
+//
+// A dynamic cloud starts empty with a fixed capacity, in the float
+// encoding, and its splats are rewritten in place: write() stages single
+// splats, and recordWrites() copies them into the buffers from inside the
+// frame, so frames still in flight never see a half-updated cloud. Layers
+// size their own buffers by capacity() and re-sort when generation()
+// changes.
+class SplatBuffers {
+ public:
+  enum class Encoding : uint8_t { kFloat, kCompact };
+
+  enum Attribute : uint8_t {
+    kPositions,
+    kScales,
+    kRotations,
+    kOpacities,
+    kSh,
+    kChunks,  // kCompact only
+    kAttributeCount,
+  };
+
+  SplatBuffers(const Renderer::Context& ctx, const SplatCloud& cloud);
+  SplatBuffers(const Renderer::Context& ctx, const CompactSplatFile& file);
+  // A dynamic cloud: room for `capacity` splats of SH `degree`, at most
+  // `maxWritesPerFrame` of them written per recordWrites().
+  SplatBuffers(const Renderer::Context& ctx, size_t capacity, int degree,
+               uint32_t maxWritesPerFrame);
+  // Waits for this cloud's upload only.
+  ~SplatBuffers();
+
+  SplatBuffers(const SplatBuffers&) = delete;
+  SplatBuffers& operator=(const SplatBuffers&) = delete;
+  SplatBuffers(SplatBuffers&&) = delete;
+  SplatBuffers& operator=(SplatBuffers&&) = delete;
+
+  [[nodiscard]] size_t count() const { return count_; }
+  [[nodiscard]] size_t capacity() const { return capacity_; }
+  [[nodiscard]] bool dynamic() const { return !staging_.empty(); }
+  // Changes whenever the splats do.
+  [[nodiscard]] uint64_t generation() const { return generation_; }
+  [[nodiscard]] int shDegree() const { return shDegree_; }
+  [[nodiscard]] Encoding encoding() const { return encoding_; }
+  // Attributes with a buffer in this encoding: kChunks is compact-only.
+  [[nodiscard]] uint32_t attributeCount() const {
+    return encoding_ == Encoding::kCompact ? kAttributeCount : kChunks;
+  }
+  [[nodiscard]] uint64_t uploadTicket() const { return uploadTicket_; }
+  // True once every attribute has landed on the GPU.
+  [[nodiscard]] bool ready() const;
+
+  [[nodiscard]] VkDescriptorBufferInfo descriptor(Attribute attribute) const;
+
+  // Binding of `attribute` in shaders/splat_data.glsl, which leaves binding
+  // 5 to the including shader.
+  static uint32_t shaderBinding(Attribute attribute) {
+    return attribute == kChunks ? 6 : static_cast<uint32_t>(attribute);
+  }
+  // Binding of the visible chunk list in shaders/splat_visible.glsl.
+  static constexpr uint32_t kVisibleChunksBinding = 10;
+  // One storage buffer binding per attribute, in Attribute order.
+  [[nodiscard]] std::vector<VkDescriptorSetLayoutBinding> layoutBindings(
+      VkShaderStageFlags stages) const;
+
+  // Host copy of the positions, kept for CPU-side depth sorting. The
+  // snapshot stays valid and unchanged however the cloud changes later, for
+  // sorting on another thread.
+  [[nodiscard]] const std::vector<float>& hostPositions() const {
+    return *hostPositions_;
+  }
+  [[nodiscard]] std::shared_ptr<const std::vector<float>>
+  hostPositionsSnapshot() const {
+    return hostPositions_;
+  }
+  [[nodiscard]] const SplatIndex& index() const { return index_; }
+
+  // Dynamic clouds only; see the class comment. write() stages splat
+  // `index` of `source` for `slot`; hide() stages a zero-opacity splat.
+  // Both throw std::length_error past maxWritesPerFrame() staged splats.
+  void write(uint32_t slot, const SplatCloudView& source, size_t index);
+  void hide(uint32_t slot);
+  // The cloud is slots [0, count).
+  void setCount(size_t count);
+  [[nodiscard]] uint32_t maxWritesPerFrame() const {
+    return maxWritesPerFrame_;
+  }
+  [[nodiscard]] uint32_t stagedWrites() const {
+    return static_cast<uint32_t>(stagedSlots_.size());
+  }
+  // Call from Renderer::renderFrame's prepare callback with
+  // Renderer::frameSlot(), before any layer's prepare(). Records the staged
+  // writes and a barrier that makes them visible to later shaders.
+  void recordWrites(VkCommandBuffer cmd, uint32_t frameSlot);
+
+ private:
+  void createBuffer(const Renderer::Context& ctx, Attribute attribute,
+                    VkDeviceSize size);
+  void upload(const Renderer::Context& ctx, Attribute attribute,
+              std::span<const uint8_t> data);
+  // Stages `slot` and returns its index among this frame's staged splats.
+  size_t stage(uint32_t slot);
+  // Makes hostPositions_ safe to change in place.
+  std::vector<float>& ownHostPositions();
+
+  size_t count_ = 0;
+  size_t capacity_ = 0;
+  int shDegree_ = 0;
+  uint64_t generation_ = 0;
+  Encoding encoding_ = Encoding::kFloat;
+  UploadManager* uploads_ = nullptr;
+  uint64_t uploadTicket_ = 0;
+  std::array<Buffer, kAttributeCount> buffers_;
+  std::array<GpuAllocation, kAttributeCount> memory_;
+  std::shared_ptr<std::vector<float>> hostPositions_;
+  SplatIndex index_;
+
+  // Dynamic clouds: a staging buffer per frame in flight, and the splats
+  // staged for the next recordWrites() with the slots they go to.
+  uint32_t maxWritesPerFrame_ = 0;
+  std::vector<StagingBuffer> staging_;
+  SplatCloud staged_;
+  std::vector<uint32_t> stagedSlots_;
+  // Index into stagedSlots_ per slot, or kNotStaged.
+  std::vector<uint32_t> stagedIndex_;
+  std::vector<float> hostRadii_;
+  std::vector<uint32_t> dirtyChunks_;
+  std::vector<bool> chunkDirty_;
+  bool changed_ = false;
+};
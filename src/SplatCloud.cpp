@@ -0,0 +1,175 @@
+#include "SplatCloud.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+#include "SplatRasterCommon.h"
+
+namespace {
+
+// A DC coefficient c renders as 0.5 + kShC0 * c.
+using splat_raster::kShC0;
+
+// Interleaves the bits of a 21-bit coordinate with two zero bits each.
+uint64_t spreadBits(uint64_t v) {
+  v &= 0x1fffff;
+  v = (v | v << 32) & 0x1f00000000ffffULL;
+  v = (v | v << 16) & 0x1f0000ff0000ffULL;
+  v = (v | v << 8) & 0x100f00f00f00f00fULL;
+  v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+  v = (v | v << 2) & 0x1249249249249249ULL;
+  return v;
+}
+
+// `value` as one of 2^21 cells across [lo, hi].
+uint64_t gridCell(float value, float lo, float hi) {
+  constexpr float kMaxCell = static_cast<float>((1u << 21) - 1);
+  const float t = hi > lo ? (value - lo) / (hi - lo) : 0.0f;
+  return static_cast<uint64_t>(
+      std::lround(std::clamp(t, 0.0f, 1.0f) * kMaxCell));
+}
+
+// Copies `stride` floats per splat from `src` into `dst`, in `order`.
+void gather(const std::vector<float>& src, size_t stride,
+            const std::vector<uint32_t>& order, std::vector<float>& dst) {
+  dst.resize(src.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    std::copy_n(src.begin() + static_cast<ptrdiff_t>(order[i] * stride),
+                stride, dst.begin() + static_cast<ptrdiff_t>(i * stride));
+  }
+}
+
+}  // namespace
+
+void SplatCloud::resize(size_t splatCount, int degree) {
+  if (degree < 0 || degree > kMaxShDegree) {
+    throw std::invalid_argument("SH degree must be in [0, 3]");
+  }
+  count = splatCount;
+  shDegree = degree;
+  positions.resize(count * 3);
+  scales.resize(count * 3);
+  rotations.resize(count * 4);
+  opacities.resize(count);
+  sh.resize(count * shCoefficients() * 3);
+}
+
+void SplatCloud::reorder(const std::vector<uint32_t>& order) {
+  if (order.size() != count) {
+    throw std::invalid_argument("Splat order must cover every splat");
+  }
+  std::vector<float> scratch;
+  const auto apply = [&](std::vector<float>& attribute, size_t stride) {
+    gather(attribute, stride, order, scratch);
+    attribute.swap(scratch);
+  };
+  apply(positions, 3);
+  apply(scales, 3);
+  apply(rotations, 4);
+  apply(opacities, 1);
+  apply(sh, shCoefficients() * 3);
+}
+
+SplatCloudView SplatCloud::view() const {
+  return {
+      .count = count,
+      .shDegree = shDegree,
+      .positions = positions,
+      .scales = scales,
+      .rotations = rotations,
+      .opacities = opacities,
+      .sh = sh,
+  };
+}
+
+std::vector<uint32_t> mortonOrder(const SplatCloud& cloud) {
+  std::array<float, 3> lo{};
+  std::array<float, 3> hi{};
+  lo.fill(std::numeric_limits<float>::max());
+  hi.fill(std::numeric_limits<float>::lowest());
+  for (size_t i = 0; i < cloud.count; ++i) {
+    for (size_t c = 0; c < 3; ++c) {
+      lo[c] = std::min(lo[c], cloud.positions[i * 3 + c]);
+      hi[c] = std::max(hi[c], cloud.positions[i * 3 + c]);
+    }
+  }
+
+  std::vector<std::pair<uint64_t, uint32_t>> keyed(cloud.count);
+  for (size_t i = 0; i < cloud.count; ++i) {
+    uint64_t key = 0;
+    for (size_t c = 0; c < 3; ++c) {
+      key |= spreadBits(gridCell(cloud.positions[i * 3 + c], lo[c], hi[c]))
+             << (2 - c);
+    }
+    keyed[i] = {key, static_cast<uint32_t>(i)};
+  }
+  std::sort(keyed.begin(), keyed.end());
+
+  std::vector<uint32_t> order(cloud.count);
+  for (size_t i = 0; i < cloud.count; ++i) {
+    order[i] = keyed[i].second;
+  }
+  return order;
+}
+
+SplatCloud makeSyntheticSplatCloud(size_t count, uint32_t seed) {
+  SplatCloud cloud;
+  cloud.resize(count, 0);
+
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::normal_distribution<float> gauss(0.0f, 1.0f);
+  constexpr float kTwoPi = 2.0f * std::numbers::pi_v<float>;
+
+  // Fewer, larger splats for small clouds so the shells still look solid.
+  const float baseScale =
+      0.6f / std::sqrt(static_cast<float>(std::max<size_t>(count, 1)));
+
+  for (size_t i = 0; i < count; ++i) {
+    // Uniform direction on the sphere, radius picked from three shells.
+    const float z = (2.0f * unit(rng)) - 1.0f;
+    const float phi = kTwoPi * unit(rng);
+    const float r = std::sqrt(1.0f - (z * z));
+    const float shell = 1.0f + (0.5f * static_cast<float>(rng() % 3));
+    const float radius = shell * (1.0f + (0.02f * gauss(rng)));
+    cloud.positions[i * 3] = r * std::cos(phi) * radius;
+    cloud.positions[(i * 3) + 1] = r * std::sin(phi) * radius;
+    cloud.positions[(i * 3) + 2] = z * radius;
+
+    // Flattened along the radius, like surface splats.
+    const float size = baseScale * shell * (0.5f + unit(rng));
+    cloud.scales[i * 3] = size;
+    cloud.scales[(i * 3) + 1] = size;
+    cloud.scales[(i * 3) + 2] = size * 0.2f;
+
+    // Normalised 4D Gaussian samples are uniformly distributed rotations.
+    std::array<float, 4> q = {gauss(rng), gauss(rng), gauss(rng), gauss(rng)};
+    float norm = 0.0f;
+    for (const float v : q) {
+      norm += v * v;
+    }
+    norm = std::sqrt(norm);
+    if (norm == 0.0f) {
+      q = {1.0f, 0.0f, 0.0f, 0.0f};
+      norm = 1.0f;
+    }
+    for (size_t c = 0; c < 4; ++c) {
+      cloud.rotations[(i * 4) + c] = q[c] / norm;
+    }
+
+    cloud.opacities[i] = 0.5f + (0.5f * unit(rng));
+
+    // Hue follows longitude; stored as DC coefficients.
+    for (size_t c = 0; c < 3; ++c) {
+      const float hue = phi + (static_cast<float>(c) * kTwoPi / 3.0f);
+      cloud.sh[(i * 3) + c] = 0.45f * std::cos(hue) / kShC0;
+    }
+  }
+  return cloud;
+}
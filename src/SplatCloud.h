@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+struct SplatCloudView;
+
+// Host-side 3D Gaussians in structure-of-arrays form, one array per
+// attribute so each maps onto its own GPU storage buffer. Attributes are
+// stored activated, ready to render:
+//   positions  xyz per splat
+//   scales     per-axis standard deviations (not log-scales)
+//   rotations  unit quaternions, w x y z
+//   opacities  in [0, 1] (past the sigmoid)
+//   sh         shCoefficients() RGB triplets per splat, band-major:
+//              [splat][coefficient][channel]. Coefficient 0 is the DC term.
+struct SplatCloud {
+  static constexpr int kMaxShDegree = 3;
+
+  size_t count = 0;
+  int shDegree = 0;
+  std::vector<float> positions;
+  std::vector<float> scales;
+  std::vector<float> rotations;
+  std::vector<float> opacities;
+  std::vector<float> sh;
+
+  // Coefficients per color channel: (degree + 1)^2.
+  static constexpr size_t shCoefficients(int degree) {
+    return static_cast<size_t>(degree + 1) * static_cast<size_t>(degree + 1);
+  }
+  [[nodiscard]] size_t shCoefficients() const {
+    return shCoefficients(shDegree);
+  }
+
+  // Sizes every attribute array for `splatCount` splats.
+  void resize(size_t splatCount, int degree);
+  // Permutes the splats so that splat i becomes the old splat order[i].
+  void reorder(const std::vector<uint32_t>& order);
+
+  [[nodiscard]] SplatCloudView view() const;
+};
+
+// Read-only attribute arrays laid out like SplatCloud's, wherever they live
+// (a SplatCloud, or sections of a mapped file).
+struct SplatCloudView {
+  size_t count = 0;
+  int shDegree = 0;
+  std::span<const float> positions;
+  std::span<const float> scales;
+  std::span<const float> rotations;
+  std::span<const float> opacities;
+  std::span<const float> sh;
+
+  [[nodiscard]] size_t shCoefficients() const {
+    return SplatCloud::shCoefficients(shDegree);
+  }
+};
+
+// Splat indices sorted along a Z-order curve over the cloud's bounds, so
+// that runs of consecutive splats are spatially compact.
+std::vector<uint32_t> mortonOrder(const SplatCloud& cloud);
+
+// A deterministic test scene: `count` splats scattered over a few shells
+// around the origin with smoothly varying colors and sizes.
+SplatCloud makeSyntheticSplatCloud(size_t count, uint32_t seed = 1);
@@ -0,0 +1,256 @@
+#include "SplatIndex.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+#include "SplatRasterCommon.h"
+
+namespace {
+
+using splat_raster::kNearPlane;
+// Splats reach a little past their three-sigma extent on screen: the
+// low-pass filter widens them and the radius is rounded up. Pixels.
+constexpr float kMarginPixels = 4.0f;
+// A splat's bounds reach this many standard deviations, as its quad does.
+constexpr float kSigmas = 3.0f;
+
+// Offsets within CompactSplatFile's per-chunk floats.
+constexpr size_t kPosMin = 0;
+constexpr size_t kPosMax = 3;
+constexpr size_t kLogScaleMax = 9;
+
+Vec3 min(Vec3 a, Vec3 b) {
+  return {std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)};
+}
+
+Vec3 max(Vec3 a, Vec3 b) {
+  return {std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)};
+}
+
+// Bounds that contain nothing, and stay unchanged when merged with others.
+constexpr Vec3 kEmptyLo{std::numeric_limits<float>::max(),
+                        std::numeric_limits<float>::max(),
+                        std::numeric_limits<float>::max()};
+constexpr Vec3 kEmptyHi{std::numeric_limits<float>::lowest(),
+                        std::numeric_limits<float>::lowest(),
+                        std::numeric_limits<float>::lowest()};
+
+}  // namespace
+
+SplatIndex::SplatIndex(const SplatCloud& cloud) : splatCount_(cloud.count) {
+  if (cloud.count == 0) {
+    throw std::invalid_argument("Cannot index an empty splat cloud");
+  }
+  chunks_.resize((cloud.count + kChunkSplats - 1) / kChunkSplats);
+  for (uint32_t chunk = 0; chunk < chunkCount(); ++chunk) {
+    Bounds bounds{kEmptyLo, kEmptyHi};
+    const size_t begin = size_t{chunk} * kChunkSplats;
+    const size_t end = begin + chunkSplats(chunk);
+    for (size_t i = begin; i < end; ++i) {
+      const Vec3 p{cloud.positions[i * 3], cloud.positions[i * 3 + 1],
+                   cloud.positions[i * 3 + 2]};
+      // The largest axis bounds the splat whatever its rotation.
+      const float r =
+          kSigmas * std::max({cloud.scales[i * 3], cloud.scales[i * 3 + 1],
+                              cloud.scales[i * 3 + 2]});
+      bounds.lo = min(bounds.lo, p - Vec3{r, r, r});
+      bounds.hi = max(bounds.hi, p + Vec3{r, r, r});
+    }
+    chunks_[chunk] = bounds;
+  }
+  nodes_.resize(1);
+  build(0, 0, chunkCount());
+}
+
+SplatIndex::SplatIndex(const CompactSplatFile& file)
+    : splatCount_(file.count()) {
+  if (file.count() == 0) {
+    throw std::invalid_argument("Cannot index an empty splat cloud");
+  }
+  const std::span<const uint8_t> section =
+      file.section(CompactSplatFile::kChunks);
+  chunks_.resize(file.chunkCount());
+  for (uint32_t chunk = 0; chunk < chunkCount(); ++chunk) {
+    std::array<float, CompactSplatFile::kChunkFloats> floats{};
+    std::memcpy(floats.data(), section.data() + chunk * sizeof(floats),
+                sizeof(floats));
+    const float r =
+        kSigmas * std::exp(std::max({floats[kLogScaleMax],
+                                     floats[kLogScaleMax + 1],
+                                     floats[kLogScaleMax + 2]}));
+    chunks_[chunk] = Bounds{
+        .lo = Vec3{floats[kPosMin] - r, floats[kPosMin + 1] - r,
+                   floats[kPosMin + 2] - r},
+        .hi = Vec3{floats[kPosMax] + r, floats[kPosMax + 1] + r,
+                   floats[kPosMax + 2] + r},
+    };
+  }
+  nodes_.resize(1);
+  build(0, 0, chunkCount());
+}
+
+SplatIndex::SplatIndex(size_t capacity)
+    : chunks_(std::max<size_t>((capacity + kChunkSplats - 1) / kChunkSplats,
+                               1),
+              Bounds{kEmptyLo, kEmptyHi}) {
+  nodes_.resize(1);
+  build(0, 0, chunkCount());
+}
+
+void SplatIndex::refit(std::span<const float> positions,
+                       std::span<const float> radii, size_t splatCount,
+                       std::span<const uint32_t> chunks) {
+  if (splatCount > size_t{chunkCount()} * kChunkSplats ||
+      positions.size() < splatCount * 3 || radii.size() < splatCount) {
+    throw std::invalid_argument("SplatIndex: refit past its capacity");
+  }
+  splatCount_ = splatCount;
+  for (const uint32_t chunk : chunks) {
+    Bounds bounds{kEmptyLo, kEmptyHi};
+    const size_t begin = size_t{chunk} * kChunkSplats;
+    const size_t end = std::min(begin + kChunkSplats, splatCount);
+    for (size_t i = begin; i < end; ++i) {
+      const float r = radii[i];
+      if (r < 0.0f) {
+        continue;
+      }
+      const Vec3 p{positions[i * 3], positions[i * 3 + 1],
+                   positions[i * 3 + 2]};
+      bounds.lo = min(bounds.lo, p - Vec3{r, r, r});
+      bounds.hi = max(bounds.hi, p + Vec3{r, r, r});
+    }
+    chunks_[chunk] = bounds;
+  }
+  refitNodes();
+}
+
+void SplatIndex::refitNodes() {
+  // Children always come after their parent.
+  for (size_t i = nodes_.size(); i-- > 0;) {
+    Node& node = nodes_[i];
+    if (node.children == 0) {
+      node.bounds = chunks_[node.firstChunk];
+    } else {
+      const Bounds& left = nodes_[node.children].bounds;
+      const Bounds& right = nodes_[node.children + 1].bounds;
+      node.bounds = {min(left.lo, right.lo), max(left.hi, right.hi)};
+    }
+  }
+}
+
+uint32_t SplatIndex::chunkSplats(uint32_t chunk) const {
+  const size_t begin = size_t{chunk} * kChunkSplats;
+  return static_cast<uint32_t>(
+      std::min<size_t>(kChunkSplats, splatCount_ - begin));
+}
+
+void SplatIndex::build(uint32_t node, uint32_t firstChunk,
+                       uint32_t chunkCount) {
+  nodes_[node].firstChunk = firstChunk;
+  nodes_[node].chunkCount = chunkCount;
+  if (chunkCount == 1) {
+    nodes_[node].bounds = chunks_[firstChunk];
+    return;
+  }
+
+  // Children sit next to each other; nodes_ may reallocate below, so only
+  // indices are held across the recursion.
+  const auto children = static_cast<uint32_t>(nodes_.size());
+  nodes_[node].children = children;
+  nodes_.resize(nodes_.size() + 2);
+  const uint32_t half = chunkCount / 2;
+  build(children, firstChunk, half);
+  build(children + 1, firstChunk + half, chunkCount - half);
+  const Bounds& left = nodes_[children].bounds;
+  const Bounds& right = nodes_[children + 1].bounds;
+  nodes_[node].bounds = {min(left.lo, right.lo), max(left.hi, right.hi)};
+}
+
+uint32_t SplatIndex::cull(const Camera& camera, VkExtent2D extent,
+                          const Culling& culling,
+                          std::vector<uint32_t>& chunks) const {
+  chunks.clear();
+  if (!culling.enabled) {
+    chunks.resize(activeChunkCount());
+    std::iota(chunks.begin(), chunks.end(), 0u);
+    return static_cast<uint32_t>(splatCount_);
+  }
+
+  const std::array<Plane, 5> planes =
+      camera.frustum(extent, kNearPlane, kMarginPixels);
+  const float focal = camera.focalLength(extent);
+
+  const Vec3 eye = camera.position();
+  const Vec3 forward = camera.forward();
+  // Upper bound on the bounds' diameter on screen, in pixels: their
+  // bounding sphere at its nearest depth, stretched by the angle off axis.
+  const auto projectedSize = [&](const Bounds& b) {
+    const Vec3 center = (b.lo + b.hi) * 0.5f;
+    const float radius = length(b.hi - center);
+    const Vec3 offset = center - eye;
+    const float depth = dot(offset, forward);
+    if (depth - radius <= kNearPlane) {
+      return std::numeric_limits<float>::max();
+    }
+    return 2.0f * radius * focal * length(offset) /
+           ((depth - radius) * depth);
+  };
+
+  uint32_t visible = 0;
+  // Nodes to visit, and whether their parent was wholly inside the frustum.
+  std::vector<std::pair<uint32_t, bool>> stack{{0u, false}};
+  while (!stack.empty()) {
+    const auto [index, parentInside] = stack.back();
+    stack.pop_back();
+    const Node& node = nodes_[index];
+    // Past the last splat, or with no splats in it at all.
+    if (node.firstChunk >= activeChunkCount() ||
+        node.bounds.lo.x > node.bounds.hi.x) {
+      continue;
+    }
+
+    bool inside = parentInside;
+    if (!inside) {
+      const Vec3 center = (node.bounds.lo + node.bounds.hi) * 0.5f;
+      const Vec3 half = node.bounds.hi - center;
+      inside = true;
+      bool outside = false;
+      for (const Plane& plane : planes) {
+        const float distance = dot(plane.normal, center) + plane.offset;
+        const float reach = std::abs(plane.normal.x) * half.x +
+                            std::abs(plane.normal.y) * half.y +
+                            std::abs(plane.normal.z) * half.z;
+        if (distance - reach > 0.0f) {
+          outside = true;
+          break;
+        }
+        inside = inside && distance + reach <= 0.0f;
+      }
+      if (outside) {
+        continue;
+      }
+    }
+    // Children's bounds lie within their parent's, so a node that is too
+    // small stands for its whole subtree.
+    if (projectedSize(node.bounds) < culling.minPixels) {
+      continue;
+    }
+
+    if (node.children == 0) {
+      chunks.push_back(node.firstChunk);
+      visible += chunkSplats(node.firstChunk);
+    } else {
+      // Right first, so the left subtree is listed first.
+      stack.emplace_back(node.children + 1, inside);
+      stack.emplace_back(node.children, inside);
+    }
+  }
+  return visible;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Camera.h"
+#include "CompactSplats.h"
+#include "Math.h"
+#include "SplatCloud.h"
+
+// A bounding-volume hierarchy over chunks of kChunkSplats consecutive
+// splats, built at load time so that each frame can reject whole chunks
+// that are off screen or too small to matter before any per-splat work.
+//
+// Chunks are only spatially compact if the splats are in Morton order:
+// .csplat files always are, and a SplatCloud can be put in it with
+// cloud.reorder(mortonOrder(cloud)). Any order still culls correctly, just
+// less. The tree is implicit: each node halves its parent's chunk range, so
+// with Morton-ordered chunks it behaves like an octree.
+class SplatIndex {
+ public:
+  // Matches the .csplat chunk, so compact clouds reuse their bounds.
+  static constexpr uint32_t kChunkSplats = CompactSplatFile::kChunkSplats;
+
+  struct Culling {
+    bool enabled = true;
+    // Chunks whose bounds project smaller than this many pixels across are
+    // dropped. 0 keeps everything in view.
+    float minPixels = 1.0f;
+  };
+
+  // Bounds each splat by its three-sigma box.
+  explicit SplatIndex(const SplatCloud& cloud);
+  // Uses the quantization bounds stored per chunk.
+  explicit SplatIndex(const CompactSplatFile& file);
+  // Room for `capacity` splats, none of them present yet; see refit().
+  explicit SplatIndex(size_t capacity);
+
+  // For clouds whose splats change in place: recomputes the bounds of
+  // `chunks` from `positions` (xyz per splat) and `radii` (three-sigma
+  // extent per splat), and of every node above them. Only the first
+  // `splatCount` splats exist from now on, and of those, none with a
+  // negative radius.
+  void refit(std::span<const float> positions, std::span<const float> radii,
+             size_t splatCount, std::span<const uint32_t> chunks);
+
+  [[nodiscard]] size_t splatCount() const { return splatCount_; }
+  [[nodiscard]] uint32_t chunkCount() const {
+    return static_cast<uint32_t>(chunks_.size());
+  }
+  // Centre of `chunk`'s bounds.
+  [[nodiscard]] Vec3 chunkCenter(uint32_t chunk) const {
+    return (chunks_[chunk].lo + chunks_[chunk].hi) * 0.5f;
+  }
+
+  // Fills `chunks` with the chunks `camera` may see at `extent`, in
+  // ascending order, so the only partial chunk (the last one) comes last.
+  // Returns the number of splats they hold: a dense range of that many
+  // indices maps onto them through chunk = chunks[i / kChunkSplats]. With
+  // culling disabled every chunk is listed.
+  uint32_t cull(const Camera& camera, VkExtent2D extent,
+                const Culling& culling, std::vector<uint32_t>& chunks) const;
+
+ private:
+  struct Bounds {
+    Vec3 lo;
+    Vec3 hi;
+  };
+
+  struct Node {
+    Bounds bounds;
+    uint32_t firstChunk = 0;
+    uint32_t chunkCount = 0;
+    // Index of the first of two children; 0 for a leaf (the root is never
+    // anyone's child).
+    uint32_t children = 0;
+  };
+
+  // Fills in nodes_[node] and its subtree over the given chunks.
+  void build(uint32_t node, uint32_t firstChunk, uint32_t chunkCount);
+  // Recomputes every node's bounds from chunks_.
+  void refitNodes();
+  [[nodiscard]] uint32_t activeChunkCount() const {
+    return static_cast<uint32_t>((splatCount_ + kChunkSplats - 1) /
+                                 kChunkSplats);
+  }
+  [[nodiscard]] uint32_t chunkSplats(uint32_t chunk) const;
+
+  size_t splatCount_ = 0;
+  std::vector<Bounds> chunks_;
+  std::vector<Node> nodes_;
+};
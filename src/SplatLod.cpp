@@ -0,0 +1,471 @@
+#include "SplatLod.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+
+namespace {
+
+using Section = SplatLodFile::Section;
+using Mat3 = std::array<std::array<double, 3>, 3>;
+
+constexpr std::array<char, 4> kMagic = {'S', 'L', 'O', 'D'};
+constexpr uint32_t kFileVersion = 1;
+// A splat's bounding sphere reaches this many standard deviations, as its
+// quad does.
+constexpr float kSigmas = 3.0f;
+// Parents fitted per worker task.
+constexpr size_t kParentsPerTask = 1024;
+
+static_assert(sizeof(SplatLodNode) == 32 &&
+              std::is_trivially_copyable_v<SplatLodNode>);
+
+struct FileHeader {
+  std::array<char, 4> magic = kMagic;
+  uint32_t fileVersion = kFileVersion;
+  uint64_t count = 0;
+  uint64_t leafCount = 0;
+  uint32_t shDegree = 0;
+  uint32_t reserved = 0;
+  std::array<uint64_t, Section::kSectionCount> offsets{};
+  std::array<uint64_t, Section::kSectionCount> sizes{};
+};
+
+size_t alignUp(size_t value) {
+  constexpr size_t kAlign = SplatLodFile::kSectionAlignment;
+  return (value + kAlign - 1) / kAlign * kAlign;
+}
+
+// Bytes in each section for `count` nodes of SH `degree`.
+std::array<size_t, Section::kSectionCount> sectionSizes(size_t count,
+                                                        int degree) {
+  return {
+      count * sizeof(SplatLodNode),
+      count * 3 * sizeof(float),
+      count * 3 * sizeof(float),
+      count * 4 * sizeof(float),
+      count * sizeof(float),
+      count * SplatCloud::shCoefficients(degree) * 3 * sizeof(float),
+  };
+}
+
+// Rotation matrix of the unit quaternion q = (w, x, y, z).
+Mat3 rotationMatrix(const float* q) {
+  const double norm =
+      std::sqrt(double{q[0]} * q[0] + double{q[1]} * q[1] +
+                double{q[2]} * q[2] + double{q[3]} * q[3]);
+  const double w = norm > 0.0 ? q[0] / norm : 1.0;
+  const double x = norm > 0.0 ? q[1] / norm : 0.0;
+  const double y = norm > 0.0 ? q[2] / norm : 0.0;
+  const double z = norm > 0.0 ? q[3] / norm : 0.0;
+  return {{
+      {1.0 - 2.0 * (y * y + z * z), 2.0 * (x * y - w * z),
+       2.0 * (x * z + w * y)},
+      {2.0 * (x * y + w * z), 1.0 - 2.0 * (x * x + z * z),
+       2.0 * (y * z - w * x)},
+      {2.0 * (x * z - w * y), 2.0 * (y * z + w * x),
+       1.0 - 2.0 * (x * x + y * y)},
+  }};
+}
+
+// The unit quaternion (w, x, y, z) of rotation matrix m.
+std::array<float, 4> quaternion(const Mat3& m) {
+  std::array<double, 4> q{};
+  const double trace = m[0][0] + m[1][1] + m[2][2];
+  if (trace > 0.0) {
+    const double s = std::sqrt(trace + 1.0) * 2.0;
+    q = {0.25 * s, (m[2][1] - m[1][2]) / s, (m[0][2] - m[2][0]) / s,
+         (m[1][0] - m[0][1]) / s};
+  } else if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+    const double s = std::sqrt(1.0 + m[0][0] - m[1][1] - m[2][2]) * 2.0;
+    q = {(m[2][1] - m[1][2]) / s, 0.25 * s, (m[0][1] + m[1][0]) / s,
+         (m[0][2] + m[2][0]) / s};
+  } else if (m[1][1] > m[2][2]) {
+    const double s = std::sqrt(1.0 + m[1][1] - m[0][0] - m[2][2]) * 2.0;
+    q = {(m[0][2] - m[2][0]) / s, (m[0][1] + m[1][0]) / s, 0.25 * s,
+         (m[1][2] + m[2][1]) / s};
+  } else {
+    const double s = std::sqrt(1.0 + m[2][2] - m[0][0] - m[1][1]) * 2.0;
+    q = {(m[1][0] - m[0][1]) / s, (m[0][2] + m[2][0]) / s,
+         (m[1][2] + m[2][1]) / s, 0.25 * s};
+  }
+  return {static_cast<float>(q[0]), static_cast<float>(q[1]),
+          static_cast<float>(q[2]), static_cast<float>(q[3])};
+}
+
+// Diagonalizes the symmetric matrix `a` with Jacobi rotations: on return
+// its diagonal holds the eigenvalues and `vectors`' columns the matching
+// eigenvectors, as a proper rotation.
+void eigenDecompose(Mat3& a, Mat3& vectors) {
+  vectors = {{{1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}}};
+  constexpr int kMaxSweeps = 32;
+  for (int sweep = 0; sweep < kMaxSweeps; ++sweep) {
+    const double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] +
+                       a[1][2] * a[1][2];
+    const double diagonal = a[0][0] * a[0][0] + a[1][1] * a[1][1] +
+                            a[2][2] * a[2][2];
+    if (off <= 1e-24 * diagonal || off == 0.0) {
+      break;
+    }
+    for (size_t p = 0; p < 2; ++p) {
+      for (size_t q = p + 1; q < 3; ++q) {
+        if (a[p][q] == 0.0) {
+          continue;
+        }
+        const double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+        const double t = (theta >= 0.0 ? 1.0 : -1.0) /
+                         (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+        const double c = 1.0 / std::sqrt(t * t + 1.0);
+        const double s = t * c;
+        for (size_t k = 0; k < 3; ++k) {
+          const double kp = a[k][p];
+          const double kq = a[k][q];
+          a[k][p] = c * kp - s * kq;
+          a[k][q] = s * kp + c * kq;
+        }
+        for (size_t k = 0; k < 3; ++k) {
+          const double pk = a[p][k];
+          const double qk = a[q][k];
+          a[p][k] = c * pk - s * qk;
+          a[q][k] = s * pk + c * qk;
+        }
+        for (size_t k = 0; k < 3; ++k) {
+          const double kp = vectors[k][p];
+          const double kq = vectors[k][q];
+          vectors[k][p] = c * kp - s * kq;
+          vectors[k][q] = s * kp + c * kq;
+        }
+      }
+    }
+  }
+
+  const Mat3& v = vectors;
+  const double det = v[0][0] * (v[1][1] * v[2][2] - v[1][2] * v[2][1]) -
+                     v[0][1] * (v[1][0] * v[2][2] - v[1][2] * v[2][0]) +
+                     v[0][2] * (v[1][0] * v[2][1] - v[1][1] * v[2][0]);
+  if (det < 0.0) {
+    for (size_t k = 0; k < 3; ++k) {
+      vectors[k][2] = -vectors[k][2];
+    }
+  }
+}
+
+// Area-like footprint of a splat with standard deviations `s`, which
+// weighs its share of a merged splat along with its opacity.
+double footprint(const float* s) {
+  return std::cbrt(double{s[0]} * s[1] * s[2] * s[0] * s[1] * s[2]);
+}
+
+// Fits splat `parent` of `out` to its children: moment matching of the
+// opacity- and footprint-weighted Gaussians, whose mean and covariance
+// become the parent's position and shape, and a weighted mean of their SH.
+// The parent keeps their combined footprint-opacity product, so it covers
+// about as much of the screen as they do together.
+void fitParent(SplatCloud& out, std::vector<SplatLodNode>& nodes,
+               uint32_t parent) {
+  SplatLodNode& node = nodes[parent];
+  const size_t coeffs = out.shCoefficients();
+  const uint32_t first = node.firstChild;
+  const uint32_t end = first + node.childCount;
+
+  std::vector<double> weights(node.childCount);
+  double total = 0.0;
+  for (uint32_t c = first; c < end; ++c) {
+    weights[c - first] = out.opacities[c] * footprint(&out.scales[c * 3]);
+    total += weights[c - first];
+  }
+  // Entirely transparent children still need a shape to stand in for.
+  const bool transparent = total <= 0.0;
+  if (transparent) {
+    std::fill(weights.begin(), weights.end(), 1.0);
+    total = static_cast<double>(node.childCount);
+  }
+
+  std::array<double, 3> mean{};
+  for (uint32_t c = first; c < end; ++c) {
+    for (size_t k = 0; k < 3; ++k) {
+      mean[k] += weights[c - first] * out.positions[c * 3 + k];
+    }
+  }
+  for (double& m : mean) {
+    m /= total;
+  }
+
+  Mat3 covariance{};
+  std::vector<double> sh(coeffs * 3, 0.0);
+  for (uint32_t c = first; c < end; ++c) {
+    const double w = weights[c - first] / total;
+    const Mat3 r = rotationMatrix(&out.rotations[c * 4]);
+    std::array<double, 3> d{};
+    for (size_t k = 0; k < 3; ++k) {
+      d[k] = out.positions[c * 3 + k] - mean[k];
+    }
+    for (size_t i = 0; i < 3; ++i) {
+      for (size_t j = 0; j < 3; ++j) {
+        // (R S S^T R^T)_ij + d_i d_j.
+        double sigma = d[i] * d[j];
+        for (size_t k = 0; k < 3; ++k) {
+          const double s = out.scales[c * 3 + k];
+          sigma += r[i][k] * r[j][k] * s * s;
+        }
+        covariance[i][j] += w * sigma;
+      }
+    }
+    for (size_t k = 0; k < coeffs * 3; ++k) {
+      sh[k] += w * out.sh[c * coeffs * 3 + k];
+    }
+  }
+
+  Mat3 rotation{};
+  eigenDecompose(covariance, rotation);
+  const std::array<float, 4> q = quaternion(rotation);
+  std::array<float, 3> scale{};
+  for (size_t k = 0; k < 3; ++k) {
+    scale[k] =
+        static_cast<float>(std::sqrt(std::max(covariance[k][k], 1e-12)));
+    out.positions[parent * 3 + k] = static_cast<float>(mean[k]);
+    out.scales[parent * 3 + k] = scale[k];
+  }
+  std::copy(q.begin(), q.end(), out.rotations.begin() + parent * 4);
+  const double opacity =
+      transparent ? 0.0 : total / footprint(scale.data());
+  out.opacities[parent] = static_cast<float>(std::clamp(opacity, 0.0, 1.0));
+  for (size_t k = 0; k < coeffs * 3; ++k) {
+    out.sh[parent * coeffs * 3 + k] = static_cast<float>(sh[k]);
+  }
+
+  node.center = {out.positions[parent * 3], out.positions[parent * 3 + 1],
+                 out.positions[parent * 3 + 2]};
+  node.radius = kSigmas * std::max({scale[0], scale[1], scale[2]});
+  for (uint32_t c = first; c < end; ++c) {
+    const SplatLodNode& child = nodes[c];
+    const float dx = child.center[0] - node.center[0];
+    const float dy = child.center[1] - node.center[1];
+    const float dz = child.center[2] - node.center[2];
+    node.radius = std::max(
+        node.radius, std::sqrt(dx * dx + dy * dy + dz * dz) + child.radius);
+  }
+}
+
+// Views `bytes` as an array of T; sections are aligned for any T.
+template <typename T>
+std::span<const T> sectionAs(std::span<const uint8_t> bytes) {
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  return {reinterpret_cast<const T*>(bytes.data()), bytes.size() / sizeof(T)};
+}
+
+}  // namespace
+
+SplatLod buildSplatLod(const SplatCloud& cloud, size_t threadCount) {
+  if (cloud.count == 0) {
+    throw std::invalid_argument("Cannot build LOD for an empty splat cloud");
+  }
+
+  // Levels as [begin, end) node ranges, leaves first.
+  std::vector<std::pair<size_t, size_t>> levels{{0, cloud.count}};
+  while (levels.back().second - levels.back().first > 1) {
+    const auto [begin, end] = levels.back();
+    const size_t parents =
+        (end - begin + SplatLod::kBranching - 1) / SplatLod::kBranching;
+    levels.emplace_back(end, end + parents);
+  }
+  const size_t nodeCount = levels.back().second;
+
+  SplatLod lod;
+  lod.leafCount = cloud.count;
+  lod.splats.resize(nodeCount, cloud.shDegree);
+  lod.nodes.resize(nodeCount);
+
+  const std::vector<uint32_t> order = mortonOrder(cloud);
+  const size_t coeffs = cloud.shCoefficients();
+  for (size_t i = 0; i < cloud.count; ++i) {
+    const size_t src = order[i];
+    std::copy_n(cloud.positions.begin() + src * 3, 3,
+                lod.splats.positions.begin() + i * 3);
+    std::copy_n(cloud.scales.begin() + src * 3, 3,
+                lod.splats.scales.begin() + i * 3);
+    std::copy_n(cloud.rotations.begin() + src * 4, 4,
+                lod.splats.rotations.begin() + i * 4);
+    lod.splats.opacities[i] = cloud.opacities[src];
+    std::copy_n(cloud.sh.begin() + src * coeffs * 3, coeffs * 3,
+                lod.splats.sh.begin() + i * coeffs * 3);
+
+    SplatLodNode& leaf = lod.nodes[i];
+    leaf.center = {cloud.positions[src * 3], cloud.positions[src * 3 + 1],
+                   cloud.positions[src * 3 + 2]};
+    leaf.radius =
+        kSigmas * std::max({cloud.scales[src * 3], cloud.scales[src * 3 + 1],
+                            cloud.scales[src * 3 + 2]});
+  }
+
+  ThreadPool pool(threadCount);
+  for (size_t level = 1; level < levels.size(); ++level) {
+    const auto [childBegin, childEnd] = levels[level - 1];
+    const auto [begin, end] = levels[level];
+    for (size_t parent = begin; parent < end; ++parent) {
+      const size_t first =
+          childBegin + (parent - begin) * SplatLod::kBranching;
+      SplatLodNode& node = lod.nodes[parent];
+      node.firstChild = static_cast<uint32_t>(first);
+      node.childCount = static_cast<uint32_t>(
+          std::min(SplatLod::kBranching, childEnd - first));
+      for (size_t child = first; child < first + node.childCount; ++child) {
+        lod.nodes[child].parent = static_cast<uint32_t>(parent);
+      }
+    }
+
+    // Parents of one level only read the level below, so they fit
+    // independently.
+    std::vector<std::future<void>> tasks;
+    for (size_t taskBegin = begin; taskBegin < end;
+         taskBegin += kParentsPerTask) {
+      const size_t taskEnd = std::min(taskBegin + kParentsPerTask, end);
+      tasks.push_back(pool.submit([&lod, taskBegin, taskEnd]() {
+        for (size_t parent = taskBegin; parent < taskEnd; ++parent) {
+          fitParent(lod.splats, lod.nodes, static_cast<uint32_t>(parent));
+        }
+      }));
+    }
+    for (std::future<void>& task : tasks) {
+      task.get();
+    }
+  }
+  return lod;
+}
+
+SplatLodFile::SplatLodFile(const std::filesystem::path& path) : file_(path) {
+  const auto fail = [&](std::string_view what) {
+    return std::runtime_error(fmt::format("Invalid splat LOD file: {} ({})",
+                                          path.string(), what));
+  };
+
+  const std::span<const uint8_t> bytes = file_.bytes();
+  FileHeader header;
+  if (bytes.size() < sizeof(header)) {
+    throw fail("too short");
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (header.magic != kMagic) {
+    throw fail("bad magic");
+  }
+  if (header.fileVersion != kFileVersion) {
+    throw fail(fmt::format("unsupported version {}", header.fileVersion));
+  }
+  if (header.count == 0 || header.leafCount == 0 ||
+      header.leafCount > header.count ||
+      header.count > SplatLodNode::kNone ||
+      header.shDegree > SplatCloud::kMaxShDegree) {
+    throw fail("unsupported layout");
+  }
+
+  const size_t count = header.count;
+  const auto degree = static_cast<int>(header.shDegree);
+  const std::array<size_t, kSectionCount> expected =
+      sectionSizes(count, degree);
+  std::array<std::span<const uint8_t>, kSectionCount> sections;
+  for (size_t s = 0; s < kSectionCount; ++s) {
+    if (header.sizes[s] != expected[s] ||
+        header.offsets[s] % kSectionAlignment != 0 ||
+        header.offsets[s] > bytes.size() ||
+        bytes.size() - header.offsets[s] < header.sizes[s]) {
+      throw fail("truncated or inconsistent sections");
+    }
+    sections[s] = bytes.subspan(header.offsets[s], header.sizes[s]);
+  }
+
+  leafCount_ = header.leafCount;
+  nodes_ = sectionAs<SplatLodNode>(sections[kNodes]);
+  splats_ = SplatCloudView{
+      .count = count,
+      .shDegree = degree,
+      .positions = sectionAs<float>(sections[kPositions]),
+      .scales = sectionAs<float>(sections[kScales]),
+      .rotations = sectionAs<float>(sections[kRotations]),
+      .opacities = sectionAs<float>(sections[kOpacities]),
+      .sh = sectionAs<float>(sections[kSh]),
+  };
+
+  // SplatLodCut walks the links without checking them.
+  if (nodes_.back().parent != SplatLodNode::kNone) {
+    throw fail("the last node is not the root");
+  }
+  for (size_t i = 0; i < count; ++i) {
+    const SplatLodNode& node = nodes_[i];
+    if ((i < leafCount_) != (node.childCount == 0) ||
+        node.firstChild > i || i - node.firstChild < node.childCount) {
+      throw fail("inconsistent hierarchy");
+    }
+    for (uint32_t c = 0; c < node.childCount; ++c) {
+      if (nodes_[node.firstChild + c].parent != i) {
+        throw fail("inconsistent hierarchy");
+      }
+    }
+    // Every node but the root must also be one of its parent's children,
+    // which the check above only covers for nodes that some node claims.
+    if (i + 1 < count) {
+      if (node.parent >= count || node.parent <= i) {
+        throw fail("inconsistent hierarchy");
+      }
+      const SplatLodNode& parent = nodes_[node.parent];
+      if (i < parent.firstChild ||
+          i - parent.firstChild >= parent.childCount) {
+        throw fail("inconsistent hierarchy");
+      }
+    }
+  }
+}
+
+void writeSplatLod(const std::filesystem::path& path, const SplatLod& lod) {
+  const SplatCloud& splats = lod.splats;
+  FileHeader header{
+      .count = splats.count,
+      .leafCount = lod.leafCount,
+      .shDegree = static_cast<uint32_t>(splats.shDegree),
+  };
+  header.sizes = sectionSizes(splats.count, splats.shDegree);
+  size_t offset = alignUp(sizeof(header));
+  for (size_t s = 0; s < Section::kSectionCount; ++s) {
+    header.offsets[s] = offset;
+    offset = alignUp(offset + header.sizes[s]);
+  }
+
+  std::vector<uint8_t> image(offset);
+  std::memcpy(image.data(), &header, sizeof(header));
+  const auto copy = [&](Section s, const void* data) {
+    std::memcpy(image.data() + header.offsets[s], data, header.sizes[s]);
+  };
+  copy(Section::kNodes, lod.nodes.data());
+  copy(Section::kPositions, splats.positions.data());
+  copy(Section::kScales, splats.scales.data());
+  copy(Section::kRotations, splats.rotations.data());
+  copy(Section::kOpacities, splats.opacities.data());
+  copy(Section::kSh, splats.sh.data());
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  out.write(reinterpret_cast<const char*>(image.data()),
+            static_cast<std::streamsize>(image.size()));
+  if (!out) {
+    throw std::runtime_error("Failed to write splat LOD: " + path.string());
+  }
+}
+
+bool isSplatLodFile(const std::filesystem::path& path) {
+  std::string ext = path.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return ext == ".splod";
+}
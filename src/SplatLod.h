@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include "MappedFile.h"
+#include "SplatCloud.h"
+
+// A level-of-detail hierarchy over a splat cloud: the original splats are
+// the leaves, and every interior node is one splat standing in for its
+// children, fitted to match their combined shape and colour. Rendering a
+// cut through the tree (see SplatLodCut) bounds the splat count however
+// large the scene is, trading detail where it would not be seen.
+//
+// Node i is splat i of the hierarchy's cloud. Leaves come first, in Morton
+// order; each further level groups kBranching consecutive nodes of the one
+// below, and the root is the last node.
+struct SplatLodNode {
+  static constexpr uint32_t kNone = 0xffffffff;
+
+  // Bounding sphere of everything the node stands for.
+  std::array<float, 3> center{};
+  float radius = 0.0f;
+  uint32_t parent = kNone;
+  // Children are consecutive nodes; none for a leaf.
+  uint32_t firstChild = 0;
+  uint32_t childCount = 0;
+  uint32_t reserved = 0;
+};
+
+struct SplatLod {
+  static constexpr size_t kBranching = 8;
+
+  SplatCloud splats;
+  std::vector<SplatLodNode> nodes;
+  size_t leafCount = 0;
+};
+
+// Builds the hierarchy over `cloud` with `threadCount` workers
+// (0 = hardware concurrency). Throws std::invalid_argument for an empty
+// cloud.
+SplatLod buildSplatLod(const SplatCloud& cloud, size_t threadCount = 0);
+
+// The hierarchy on disk (.splod), read by mapping the file. All values are
+// little-endian, and every section starts on a kSectionAlignment boundary:
+//
+//   nodes      SplatLodNode per node
+//   positions, scales, rotations, opacities, sh
+//              SplatCloud's float arrays over every node
+class SplatLodFile {
+ public:
+  enum Section : uint8_t {
+    kNodes,
+    kPositions,
+    kScales,
+    kRotations,
+    kOpacities,
+    kSh,
+    kSectionCount,
+  };
+
+  static constexpr size_t kSectionAlignment = 256;
+
+  // Maps and validates `path`; throws std::runtime_error if it is not a
+  // well-formed .splod file.
+  explicit SplatLodFile(const std::filesystem::path& path);
+
+  // Nodes, and so splats, in the whole hierarchy.
+  [[nodiscard]] size_t count() const { return nodes_.size(); }
+  [[nodiscard]] size_t leafCount() const { return leafCount_; }
+  [[nodiscard]] int shDegree() const { return splats_.shDegree; }
+  [[nodiscard]] uint32_t root() const {
+    return static_cast<uint32_t>(nodes_.size() - 1);
+  }
+  [[nodiscard]] std::span<const SplatLodNode> nodes() const { return nodes_; }
+  // Straight from the mapping; pages are read as nodes are first used.
+  [[nodiscard]] const SplatCloudView& splats() const { return splats_; }
+
+ private:
+  MappedFile file_;
+  size_t leafCount_ = 0;
+  std::span<const SplatLodNode> nodes_;
+  SplatCloudView splats_;
+};
+
+// Throws std::runtime_error if the file cannot be written.
+void writeSplatLod(const std::filesystem::path& path, const SplatLod& lod);
+
+// True for paths with a .splod extension.
+bool isSplatLodFile(const std::filesystem::path& path);
@@ -0,0 +1,225 @@
+#include "SplatLodCut.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+#include "SplatRasterCommon.h"
+
+namespace {
+
+using splat_raster::kNearPlane;
+
+}  // namespace
+
+SplatLodCut::SplatLodCut(const Renderer::Context& ctx,
+                         std::shared_ptr<const SplatLodFile> file,
+                         const Options& options)
+    : file_(std::move(file)),
+      pool_(std::make_shared<SplatBuffers>(
+          ctx, std::min(options.budget, file_->count()), file_->shDegree(),
+          options.maxUploadsPerFrame)),
+      options_(options),
+      nodeSlot_(file_->count(), kNone) {
+  // Splits need room for a whole family at once.
+  if (options.budget < SplatLod::kBranching ||
+      options.maxUploadsPerFrame < SplatLod::kBranching) {
+    throw std::invalid_argument("SplatLodCut: budget or quota too small");
+  }
+  options_.budget = pool_->capacity();
+  place(file_->root(), takeSlot());
+  pool_->setCount(slotNode_.size());
+  stats_.cutSize = 1;
+}
+
+void SplatLodCut::setBudget(size_t budget) {
+  options_.budget = std::min(std::max<size_t>(budget, SplatLod::kBranching),
+                             pool_->capacity());
+}
+
+void SplatLodCut::place(uint32_t node, uint32_t slot) {
+  pool_->write(slot, file_->splats(), node);
+  nodeSlot_[node] = slot;
+  slotNode_[slot] = node;
+  ++stats_.uploads;
+}
+
+uint32_t SplatLodCut::takeSlot() {
+  if (!holes_.empty()) {
+    const uint32_t slot = holes_.back();
+    holes_.pop_back();
+    return slot;
+  }
+  slotNode_.push_back(kNone);
+  return static_cast<uint32_t>(slotNode_.size() - 1);
+}
+
+void SplatLodCut::merge(uint32_t parent) {
+  const SplatLodNode& node = file_->nodes()[parent];
+  // The parent takes its first child's slot; the others become holes.
+  const uint32_t slot = nodeSlot_[node.firstChild];
+  for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount;
+       ++c) {
+    if (c != node.firstChild) {
+      slotNode_[nodeSlot_[c]] = kNone;
+      holes_.push_back(nodeSlot_[c]);
+    }
+    nodeSlot_[c] = kNone;
+  }
+  place(parent, slot);
+  stats_.cutSize -= node.childCount - 1;
+  ++stats_.merges;
+}
+
+void SplatLodCut::split(uint32_t parent) {
+  const SplatLodNode& node = file_->nodes()[parent];
+  const uint32_t slot = nodeSlot_[parent];
+  nodeSlot_[parent] = kNone;
+  place(node.firstChild, slot);
+  for (uint32_t c = node.firstChild + 1;
+       c < node.firstChild + node.childCount; ++c) {
+    place(c, takeSlot());
+  }
+  stats_.cutSize += node.childCount - 1;
+  ++stats_.splits;
+}
+
+void SplatLodCut::compact() {
+  // Holes [low, high) are still open; the last slot, when it is one, is
+  // always holes_[high - 1] and is simply dropped.
+  std::sort(holes_.begin(), holes_.end());
+  size_t low = 0;
+  size_t high = holes_.size();
+  while (low < high) {
+    const uint32_t node = slotNode_.back();
+    slotNode_.pop_back();
+    if (node == kNone) {
+      --high;
+    } else {
+      place(node, holes_[low++]);
+    }
+  }
+  holes_.clear();
+}
+
+void SplatLodCut::update(VkCommandBuffer cmd, const Camera& camera,
+                         VkExtent2D extent, uint32_t frameSlot) {
+  const std::span<const SplatLodNode> nodes = file_->nodes();
+  std::array<Plane, 5> planes = camera.frustum(extent, kNearPlane, 0.0f);
+  for (Plane& plane : planes) {
+    const float scale = 1.0f / length(plane.normal);
+    plane.normal = plane.normal * scale;
+    plane.offset *= scale;
+  }
+  const float focal = camera.focalLength(extent);
+  const Vec3 eye = camera.position();
+  // Pixels across the node's bounding sphere on screen, or zero if it is out
+  // of view; infinite if it reaches the near plane.
+  const auto error = [&](uint32_t index) {
+    const SplatLodNode& node = nodes[index];
+    const Vec3 center{node.center[0], node.center[1], node.center[2]};
+    for (const Plane& plane : planes) {
+      if (dot(plane.normal, center) + plane.offset > node.radius) {
+        return 0.0f;
+      }
+    }
+    const float distance = length(center - eye) - node.radius;
+    if (distance <= kNearPlane) {
+      return std::numeric_limits<float>::infinity();
+    }
+    return 2.0f * node.radius * focal / distance;
+  };
+
+  stats_.splits = 0;
+  stats_.merges = 0;
+  stats_.uploads = 0;
+  // Every merge or split uploads at most a family's worth of splats,
+  // counting the moves compact() makes to fill the holes a merge leaves.
+  uint32_t quota = options_.maxUploadsPerFrame - pool_->stagedWrites();
+  const auto spend = [&](uint32_t children) {
+    if (children > quota) {
+      return false;
+    }
+    quota -= children;
+    return true;
+  };
+
+  // Merge families that are all in the cut, cheapest first.
+  candidates_.clear();
+  for (const uint32_t node : slotNode_) {
+    if (node == kNone || node == file_->root()) {
+      continue;
+    }
+    const uint32_t parent = nodes[node].parent;
+    const SplatLodNode& family = nodes[parent];
+    if (node != family.firstChild) {
+      continue;
+    }
+    bool complete = true;
+    for (uint32_t c = family.firstChild + 1;
+         c < family.firstChild + family.childCount && complete; ++c) {
+      complete = nodeSlot_[c] != kNone;
+    }
+    if (complete) {
+      candidates_.emplace_back(error(parent), parent);
+    }
+  }
+  std::sort(candidates_.begin(), candidates_.end());
+  merged_.clear();
+  for (const auto& [parentError, parent] : candidates_) {
+    if (parentError > options_.maxErrorPixels &&
+        stats_.cutSize <= options_.budget) {
+      break;
+    }
+    if (!spend(nodes[parent].childCount)) {
+      break;
+    }
+    merge(parent);
+    merged_.push_back(parent);
+  }
+  std::sort(merged_.begin(), merged_.end());
+
+  // Split the largest errors first, and the children they reveal in turn.
+  candidates_.clear();
+  for (const uint32_t node : slotNode_) {
+    if (node == kNone || nodes[node].childCount == 0 ||
+        std::binary_search(merged_.begin(), merged_.end(), node)) {
+      continue;
+    }
+    const float nodeError = error(node);
+    if (nodeError > options_.maxErrorPixels) {
+      candidates_.emplace_back(nodeError, node);
+    }
+  }
+  std::make_heap(candidates_.begin(), candidates_.end());
+  while (!candidates_.empty()) {
+    std::pop_heap(candidates_.begin(), candidates_.end());
+    const uint32_t node = candidates_.back().second;
+    candidates_.pop_back();
+    const SplatLodNode& family = nodes[node];
+    if (stats_.cutSize + family.childCount - 1 > options_.budget) {
+      // A smaller family may still fit.
+      continue;
+    }
+    if (!spend(family.childCount)) {
+      break;
+    }
+    split(node);
+    for (uint32_t c = family.firstChild;
+         c < family.firstChild + family.childCount; ++c) {
+      const float childError = error(c);
+      if (nodes[c].childCount != 0 && childError > options_.maxErrorPixels) {
+        candidates_.emplace_back(childError, c);
+        std::push_heap(candidates_.begin(), candidates_.end());
+      }
+    }
+  }
+
+  compact();
+  pool_->setCount(slotNode_.size());
+  pool_->recordWrites(cmd, frameSlot);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Camera.h"
+#include "Renderer.h"
+#include "SplatBuffers.h"
+#include "SplatLod.h"
+
+// Renders a SplatLodFile by keeping a cut through its hierarchy resident in
+// a dynamic SplatBuffers pool: the set of nodes, one per root-to-leaf path,
+// that are drawn in place of everything below them. Layers draw the pool
+// like any other cloud.
+//
+// Each update() refines the previous cut instead of rebuilding it. A node's
+// error is the size its bounding sphere projects to, in pixels, and is zero
+// off screen. Parents whose children are all in the cut are merged back
+// when their error is within maxErrorPixels, or while the cut is over
+// budget; then the nodes with the largest error are split until the budget
+// or the frame's upload quota runs out. Only the splats that changed are
+// copied to the GPU, so the cut adapts over a few frames as the camera
+// moves rather than stalling on one.
+class SplatLodCut {
+ public:
+  struct Options {
+    // Splats in the pool, which the cut never exceeds.
+    size_t budget = size_t{1} << 21;
+    float maxErrorPixels = 2.0f;
+    // Splats uploaded per frame at most.
+    uint32_t maxUploadsPerFrame = 1u << 16;
+  };
+
+  struct Stats {
+    size_t cutSize = 0;
+    uint32_t splits = 0;
+    uint32_t merges = 0;
+    uint32_t uploads = 0;
+  };
+
+  // Starts from the root alone.
+  SplatLodCut(const Renderer::Context& ctx,
+              std::shared_ptr<const SplatLodFile> file, const Options& options);
+
+  // The pool the cut lives in, for the layers to draw.
+  [[nodiscard]] std::shared_ptr<const SplatBuffers> splats() const {
+    return pool_;
+  }
+  [[nodiscard]] const SplatLodFile& file() const { return *file_; }
+
+  // Call from Renderer::renderFrame's prepare callback with
+  // Renderer::frameSlot(), before the layers' prepare(). Refines the cut
+  // for `camera` at `extent` and records the pool's uploads.
+  void update(VkCommandBuffer cmd, const Camera& camera, VkExtent2D extent,
+              uint32_t frameSlot);
+
+  // Clamped to the pool's capacity.
+  void setBudget(size_t budget);
+  [[nodiscard]] size_t budget() const { return options_.budget; }
+  [[nodiscard]] size_t capacity() const { return pool_->capacity(); }
+  void setMaxError(float pixels) { options_.maxErrorPixels = pixels; }
+
+  // Counters of the last update().
+  [[nodiscard]] const Stats& stats() const { return stats_; }
+
+ private:
+  static constexpr uint32_t kNone = SplatLodNode::kNone;
+
+  // Puts `node` into `slot` and stages its upload.
+  void place(uint32_t node, uint32_t slot);
+  // A free slot: a hole left by a merge if there is one, else a new one at
+  // the end.
+  uint32_t takeSlot();
+  void merge(uint32_t parent);
+  void split(uint32_t node);
+  // Moves nodes from the end of the pool into holes until the cut is
+  // slots [0, cut size) again.
+  void compact();
+
+  std::shared_ptr<const SplatLodFile> file_;
+  std::shared_ptr<SplatBuffers> pool_;
+  Options options_;
+  Stats stats_;
+
+  // Slot of each node in the cut, kNone for the rest.
+  std::vector<uint32_t> nodeSlot_;
+  // Node in each slot, kNone for holes.
+  std::vector<uint32_t> slotNode_;
+  std::vector<uint32_t> holes_;
+
+  // Scratch for update(), kept to avoid reallocating every frame.
+  std::vector<std::pair<float, uint32_t>> candidates_;
+  std::vector<uint32_t> merged_;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Shared by CpuSplatRasterizer and DifferentiableSplatRasterizer, whose
+// forward passes must agree exactly, and by the CPU culling in SplatIndex
+// and SplatLodCut. The constants match splat_project.glsl, tile_common.glsl
+// and tile_raster.comp.
+namespace splat_raster {
+
+inline constexpr uint32_t kTileSize = 16;
+inline constexpr float kNearPlane = 0.2f;
+inline constexpr float kMinAlpha = 1.0f / 255.0f;
+inline constexpr float kMaxAlpha = 0.99f;
+inline constexpr float kMinTransmittance = 1.0f / 10000.0f;
+// Added to the projected covariance's diagonal, so every splat covers at
+// least about a pixel.
+inline constexpr float kLowPass = 0.3f;
+
+inline constexpr float kShC0 = 0.28209479177387814f;
+inline constexpr float kShC1 = 0.4886025119029199f;
+inline constexpr std::array<float, 5> kShC2 = {
+    1.0925484305920792f, -1.0925484305920792f, 0.31539156525252005f,
+    -1.0925484305920792f, 0.5462742152960396f};
+inline constexpr std::array<float, 7> kShC3 = {
+    -0.5900435899266435f, 2.890611442640554f, -0.4570457994644658f,
+    0.3731763325901154f,  -0.4570457994644658f, 1.445305721320277f,
+    -0.5900435899266435f};
+
+using Mat3 = std::array<std::array<float, 3>, 3>;  // [row][column]
+
+inline Mat3 multiply(const Mat3& a, const Mat3& b) {
+  Mat3 r{};
+  for (size_t i = 0; i < 3; ++i) {
+    for (size_t j = 0; j < 3; ++j) {
+      r[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j];
+    }
+  }
+  return r;
+}
+
+inline Mat3 transpose(const Mat3& a) {
+  Mat3 r{};
+  for (size_t i = 0; i < 3; ++i) {
+    for (size_t j = 0; j < 3; ++j) {
+      r[i][j] = a[j][i];
+    }
+  }
+  return r;
+}
+
+}  // namespace splat_raster
@@ -0,0 +1,220 @@
+#include "SplatStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+SplatStreamer::SplatStreamer(const Renderer::Context& ctx,
+                             std::shared_ptr<const CompactSplatFile> file,
+                             const Options& options)
+    : file_(std::move(file)),
+      pool_(std::make_shared<SplatBuffers>(
+          ctx,
+          std::min((options.poolSplats + SplatIndex::kChunkSplats - 1) /
+                       SplatIndex::kChunkSplats,
+                   file_->chunkCount()) *
+              SplatIndex::kChunkSplats,
+          file_->shDegree(), options.maxUploadsPerFrame)),
+      fileIndex_(*file_),
+      options_(options),
+      chunkSlot_(file_->chunkCount(), kAbsent),
+      chunkWanted_(file_->chunkCount(), 0),
+      slotChunk_(pool_->index().chunkCount(), kAbsent),
+      windowStart_(std::chrono::steady_clock::now()),
+      workers_(options.threadCount) {
+  if (options.maxUploadsPerFrame < SplatIndex::kChunkSplats) {
+    throw std::invalid_argument(
+        "SplatStreamer: the upload quota must hold a chunk");
+  }
+  slotLru_.reserve(slotChunk_.size());
+  for (uint32_t slot = 0; slot < slotChunk_.size(); ++slot) {
+    slotLru_.push_back(lru_.insert(lru_.end(), slot));
+  }
+}
+
+SplatStreamer::~SplatStreamer() { stopping_ = true; }
+
+bool SplatStreamer::request(uint32_t chunk) {
+  // Enough to fill two frames' quota, so installs never wait on a worker
+  // while decoding stays close to what the camera wants now.
+  const uint32_t maxLoading =
+      2 * options_.maxUploadsPerFrame / SplatIndex::kChunkSplats;
+  if (loading_ >= maxLoading || loading_ >= room_) {
+    return false;
+  }
+  chunkSlot_[chunk] = kLoading;
+  ++loading_;
+  workers_.submit([this, chunk]() {
+    if (stopping_) {
+      return;
+    }
+    Decoded decoded{.chunk = chunk, .splats = file_->decodeChunk(chunk)};
+    const std::lock_guard<std::mutex> lock(readyMutex_);
+    readyPagedBytes_ += file_->chunkBytes(chunk);
+    ready_.push_back(std::move(decoded));
+  });
+  return true;
+}
+
+void SplatStreamer::install(Decoded& decoded) {
+  uint32_t slot = kAbsent;
+  if (filledSlots_ < slotChunk_.size()) {
+    slot = filledSlots_++;
+  } else {
+    // The least recently visible chunk, unless even that one is visible
+    // now: then the pool is too small for the view and the chunk waits.
+    const uint32_t victim = lru_.back();
+    if (chunkWanted_[slotChunk_[victim]] == frame_) {
+      chunkSlot_[decoded.chunk] = kAbsent;
+      return;
+    }
+    chunkSlot_[slotChunk_[victim]] = kAbsent;
+    slot = victim;
+    ++stats_.evictions;
+  }
+
+  const SplatCloudView splats = decoded.splats.view();
+  const uint32_t first = slot * SplatIndex::kChunkSplats;
+  for (uint32_t i = 0; i < SplatIndex::kChunkSplats; ++i) {
+    if (i < splats.count) {
+      pool_->write(first + i, splats, i);
+    } else {
+      pool_->hide(first + i);
+    }
+  }
+  slotChunk_[slot] = decoded.chunk;
+  chunkSlot_[decoded.chunk] = slot;
+  lru_.splice(lru_.begin(), lru_, slotLru_[slot]);
+
+  const size_t coeffs = decoded.splats.shCoefficients();
+  const uint64_t bytes =
+      uint64_t{SplatIndex::kChunkSplats} * (3 + 3 + 4 + 1 + coeffs * 3) *
+      sizeof(float);
+  stats_.uploadedBytes += bytes;
+  windowUploaded_ += bytes;
+}
+
+void SplatStreamer::updateRates() {
+  constexpr double kWindowSeconds = 0.5;
+  const auto now = std::chrono::steady_clock::now();
+  const double seconds =
+      std::chrono::duration<double>(now - windowStart_).count();
+  if (seconds < kWindowSeconds) {
+    return;
+  }
+  stats_.pagedBytesPerSecond = static_cast<double>(windowPaged_) / seconds;
+  stats_.uploadedBytesPerSecond =
+      static_cast<double>(windowUploaded_) / seconds;
+  windowPaged_ = 0;
+  windowUploaded_ = 0;
+  windowStart_ = now;
+}
+
+void SplatStreamer::update(VkCommandBuffer cmd, const Camera& camera,
+                           VkExtent2D extent, uint32_t frameSlot) {
+  ++frame_;
+  stats_.hits = 0;
+  stats_.misses = 0;
+  stats_.prefetches = 0;
+  stats_.evictions = 0;
+  SplatIndex::Culling culling = culling_;
+  culling.enabled = true;
+
+  const auto sortNearestFirst = [&](std::vector<uint32_t>& chunks, Vec3 eye) {
+    std::sort(chunks.begin(), chunks.end(), [&](uint32_t a, uint32_t b) {
+      const Vec3 da = fileIndex_.chunkCenter(a) - eye;
+      const Vec3 db = fileIndex_.chunkCenter(b) - eye;
+      return dot(da, da) < dot(db, db);
+    });
+  };
+
+  // Visible chunks, nearest first, as many as the pool holds: the resident
+  // ones are touched and the rest queued. When the view needs more, the
+  // farthest go without, and their slots may be taken by nearer ones.
+  fileIndex_.cull(camera, extent, culling, visible_);
+  sortNearestFirst(visible_, camera.position());
+  const size_t slotCount = slotChunk_.size();
+  uint32_t wantedResident = 0;
+  missing_.clear();
+  for (size_t i = 0; i < visible_.size(); ++i) {
+    const uint32_t chunk = visible_[i];
+    const uint32_t slot = chunkSlot_[chunk];
+    const bool resident = slot != kAbsent && slot != kLoading;
+    ++(resident ? stats_.hits : stats_.misses);
+    if (i >= slotCount) {
+      continue;
+    }
+    chunkWanted_[chunk] = frame_;
+    if (resident) {
+      ++wantedResident;
+      lru_.splice(lru_.begin(), lru_, slotLru_[slot]);
+    } else if (slot == kAbsent) {
+      missing_.push_back(chunk);
+    }
+  }
+  // Loads beyond this would have to evict a wanted chunk.
+  room_ = static_cast<uint32_t>(slotCount) - wantedResident;
+  bool queueFull = false;
+  for (const uint32_t chunk : missing_) {
+    if (!request(chunk)) {
+      queueFull = true;
+      break;
+    }
+  }
+
+  // Then whatever comes into view if the camera keeps moving as it has.
+  if (haveLastCamera_ && !queueFull) {
+    const float ahead = options_.lookaheadFrames;
+    Camera predicted = camera;
+    predicted.target =
+        camera.target + (camera.target - lastCamera_.target) * ahead;
+    predicted.yaw += (camera.yaw - lastCamera_.yaw) * ahead;
+    predicted.pitch += (camera.pitch - lastCamera_.pitch) * ahead;
+    predicted.distance *=
+        std::pow(camera.distance / lastCamera_.distance, ahead);
+    fileIndex_.cull(predicted, extent, culling, missing_);
+    std::erase_if(missing_, [&](uint32_t chunk) {
+      return chunkSlot_[chunk] != kAbsent;
+    });
+    sortNearestFirst(missing_, predicted.position());
+    for (const uint32_t chunk : missing_) {
+      if (!request(chunk)) {
+        break;
+      }
+      ++stats_.prefetches;
+    }
+  }
+  lastCamera_ = camera;
+  haveLastCamera_ = true;
+
+  // Install what the workers have finished, up to the upload quota; the
+  // rest waits for the next frame.
+  installing_.clear();
+  {
+    const std::lock_guard<std::mutex> lock(readyMutex_);
+    const auto take = static_cast<ptrdiff_t>(
+        std::min<size_t>(options_.maxUploadsPerFrame /
+                             SplatIndex::kChunkSplats,
+                         ready_.size()));
+    std::move(ready_.begin(), ready_.begin() + take,
+              std::back_inserter(installing_));
+    ready_.erase(ready_.begin(), ready_.begin() + take);
+    stats_.pagedBytes += readyPagedBytes_;
+    windowPaged_ += readyPagedBytes_;
+    readyPagedBytes_ = 0;
+  }
+  for (Decoded& chunk : installing_) {
+    --loading_;
+    install(chunk);
+  }
+  pool_->setCount(size_t{filledSlots_} * SplatIndex::kChunkSplats);
+  pool_->recordWrites(cmd, frameSlot);
+
+  stats_.residentChunks = filledSlots_;
+  stats_.loadingChunks = loading_;
+  stats_.totalHits += stats_.hits;
+  stats_.totalMisses += stats_.misses;
+  updateRates();
+}
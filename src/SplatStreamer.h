@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Camera.h"
+#include "CompactSplats.h"
+#include "Renderer.h"
+#include "SplatBuffers.h"
+#include "SplatIndex.h"
+#include "ThreadPool.h"
+
+// Views a .csplat scene too large to upload whole by keeping only the
+// chunks the camera needs in a fixed-size GPU pool: a dynamic SplatBuffers
+// that layers draw like any other cloud.
+//
+// Each update() culls the file's chunks with a SplatIndex over their stored
+// bounds. Visible chunks already in the pool are hits and move to the front
+// of an LRU list; the rest are misses, queued nearest first for background
+// workers that decode them straight from the mapping (faulting in only
+// their pages). If more are visible than the pool holds, only the nearest
+// are kept. Chunks the camera is heading towards, extrapolated from its
+// recent motion, are queued behind them. Decoded chunks are installed into
+// free pool chunks, or over the least recently used ones that are not
+// wanted, within a per-frame upload quota. A chunk's pool slot lines up
+// with the pool's own SplatIndex chunk, so culling carries over.
+class SplatStreamer {
+ public:
+  struct Options {
+    // Splats the pool holds, rounded up to whole chunks.
+    size_t poolSplats = size_t{1} << 21;
+    // Splats uploaded per frame at most; at least a chunk.
+    uint32_t maxUploadsPerFrame = 1u << 16;
+    // Background decoders (0 = hardware concurrency).
+    size_t threadCount = 2;
+    // Frames of camera motion extrapolated when prefetching.
+    float lookaheadFrames = 10.0f;
+  };
+
+  struct Stats {
+    // Of the last update(): visible chunks found in the pool or not, chunks
+    // queued ahead of the camera, and chunks replaced.
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t prefetches = 0;
+    uint32_t evictions = 0;
+    uint32_t residentChunks = 0;
+    uint32_t loadingChunks = 0;
+    // Since construction.
+    uint64_t totalHits = 0;
+    uint64_t totalMisses = 0;
+    uint64_t pagedBytes = 0;
+    uint64_t uploadedBytes = 0;
+    // Averaged over the last half second or so: file bytes the workers
+    // decoded, and bytes copied to the GPU.
+    double pagedBytesPerSecond = 0.0;
+    double uploadedBytesPerSecond = 0.0;
+  };
+
+  SplatStreamer(const Renderer::Context& ctx,
+                std::shared_ptr<const CompactSplatFile> file,
+                const Options& options);
+  // Discards queued loads and waits for the running ones.
+  ~SplatStreamer();
+
+  SplatStreamer(const SplatStreamer&) = delete;
+  SplatStreamer& operator=(const SplatStreamer&) = delete;
+  SplatStreamer(SplatStreamer&&) = delete;
+  SplatStreamer& operator=(SplatStreamer&&) = delete;
+
+  // The pool, for the layers to draw.
+  [[nodiscard]] std::shared_ptr<const SplatBuffers> splats() const {
+    return pool_;
+  }
+  [[nodiscard]] const CompactSplatFile& file() const { return *file_; }
+  // Bounds of the file's chunks, resident or not.
+  [[nodiscard]] const SplatIndex& fileIndex() const { return fileIndex_; }
+
+  // Chunks smaller than culling.minPixels are not streamed in. Culling is
+  // always on for residency, whatever culling.enabled says: the scene does
+  // not fit otherwise.
+  void setCulling(const SplatIndex::Culling& culling) { culling_ = culling; }
+
+  // Call from Renderer::renderFrame's prepare callback with
+  // Renderer::frameSlot(), before the layers' prepare(). Queues the chunks
+  // `camera` needs at `extent`, installs the ones that have been decoded
+  // and records their uploads.
+  void update(VkCommandBuffer cmd, const Camera& camera, VkExtent2D extent,
+              uint32_t frameSlot);
+
+  [[nodiscard]] const Stats& stats() const { return stats_; }
+
+ private:
+  // chunkSlot_ values for chunks that are not in the pool.
+  static constexpr uint32_t kAbsent = 0xffffffff;
+  static constexpr uint32_t kLoading = 0xfffffffe;
+
+  struct Decoded {
+    uint32_t chunk = 0;
+    SplatCloud splats;
+  };
+
+  // Queues `chunk` for a worker, unless too many loads are in flight.
+  bool request(uint32_t chunk);
+  // Copies a decoded chunk into the pool, if there is a slot for it.
+  void install(Decoded& decoded);
+  void updateRates();
+
+  std::shared_ptr<const CompactSplatFile> file_;
+  std::shared_ptr<SplatBuffers> pool_;
+  SplatIndex fileIndex_;
+  Options options_;
+  SplatIndex::Culling culling_;
+  Stats stats_;
+  uint64_t frame_ = 0;
+
+  // Per file chunk: pool chunk, kLoading or kAbsent; and the last frame it
+  // was visible in.
+  std::vector<uint32_t> chunkSlot_;
+  std::vector<uint64_t> chunkWanted_;
+  // Per pool chunk: file chunk, or kAbsent if never filled; and its place
+  // in lru_, which runs from most to least recently visible.
+  std::vector<uint32_t> slotChunk_;
+  std::vector<std::list<uint32_t>::iterator> slotLru_;
+  std::list<uint32_t> lru_;
+  uint32_t filledSlots_ = 0;
+  uint32_t loading_ = 0;
+  // Loads in flight the pool has room for this frame.
+  uint32_t room_ = 0;
+
+  // The camera at the last update(), for prefetching along its motion.
+  Camera lastCamera_;
+  bool haveLastCamera_ = false;
+
+  // Scratch for update().
+  std::vector<uint32_t> visible_;
+  std::vector<uint32_t> missing_;
+  std::vector<Decoded> installing_;
+
+  // Rate window.
+  std::chrono::steady_clock::time_point windowStart_;
+  uint64_t windowPaged_ = 0;
+  uint64_t windowUploaded_ = 0;
+
+  // Filled by the workers.
+  std::mutex readyMutex_;
+  std::vector<Decoded> ready_;
+  uint64_t readyPagedBytes_ = 0;
+  std::atomic<bool> stopping_ = false;
+  // Last, so it is joined before anything its tasks touch goes away.
+  ThreadPool workers_;
+};
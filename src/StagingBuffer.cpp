@@ -0,0 +1,13 @@
+#include "StagingBuffer.h"
+
+StagingBuffer::StagingBuffer(GpuAllocator& allocator, VkDeviceSize size)
+    : buffer_(allocator.device(),
+              VkBufferCreateInfo{
+                  .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                  .size = size,
+                  .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+              }),
+      memory_(allocator.allocate(buffer_.get(),
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)),
+      size_(size) {}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+#include "GpuAllocator.h"
+#include "VulkanHandles.h"
+
+// Host-visible, host-coherent transfer source that stays mapped for its whole
+// lifetime, so producers (e.g. an image decoder) can write into it directly.
+class StagingBuffer {
+ public:
+  StagingBuffer() = default;
+  StagingBuffer(GpuAllocator& allocator, VkDeviceSize size);
+
+  [[nodiscard]] uint8_t* data() const { return memory_.mapped(); }
+  [[nodiscard]] VkDeviceSize size() const { return size_; }
+  [[nodiscard]] VkBuffer buffer() const { return buffer_.get(); }
+
+ private:
+  Buffer buffer_;
+  GpuAllocation memory_;
+  VkDeviceSize size_ = 0;
+};
@@ -0,0 +1,482 @@
+#include "TextureMips.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include "BlockCompression.h"
+#include "ThreadPool.h"
+
+namespace {
+
+constexpr CacheFormat kCacheFormat{.magic = {'S', 'S', 'T', 'X'}, .version = 2};
+
+// Every level starts on UploadManager's copy alignment.
+constexpr VkDeviceSize kLevelAlignment = 16;
+
+// Leads the cache payload, followed by the levels and then the texels.
+struct CacheHeader {
+  uint32_t format = 0;
+  uint32_t levelCount = 0;
+  uint64_t dataSize = 0;
+};
+static_assert(sizeof(CacheHeader) == 16);
+
+struct CachedLevel {
+  uint32_t width;
+  uint32_t height;
+  uint64_t offset;
+};
+static_assert(sizeof(CachedLevel) == 16);
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Texels per block side and bytes per block; 1x1 blocks for plain formats.
+struct FormatLayout {
+  uint32_t blockSize = 1;
+  VkDeviceSize blockBytes = 0;
+};
+
+std::optional<FormatLayout> formatLayout(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+      return FormatLayout{1, 4};
+    case VK_FORMAT_R16G16B16A16_UNORM:
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+      return FormatLayout{1, 8};
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+      return FormatLayout{1, 16};
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+      return FormatLayout{4, kBc1BlockBytes};
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+      return FormatLayout{4, kBc7BlockBytes};
+    default:
+      return std::nullopt;
+  }
+}
+
+VkDeviceSize levelBytes(const FormatLayout& layout, VkExtent3D extent) {
+  const auto blocks = [&](uint32_t texels) {
+    return VkDeviceSize{(texels + layout.blockSize - 1) / layout.blockSize};
+  };
+  return blocks(extent.width) * blocks(extent.height) * layout.blockBytes;
+}
+
+// ---------------------------------------------------------------------------
+// Box filter.
+
+using Vec4 = std::array<float, 4>;
+
+float halfToFloat(uint16_t half) {
+  const uint32_t sign = uint32_t{half & 0x8000u} << 16;
+  const uint32_t exponent = (half >> 10) & 0x1fu;
+  const uint32_t mantissa = half & 0x3ffu;
+  if (exponent == 0) {
+    const float value = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign != 0 ? -value : value;
+  }
+  if (exponent == 31) {
+    return std::bit_cast<float>(sign | 0x7f800000u | mantissa << 13);
+  }
+  return std::bit_cast<float>(sign | (exponent + 112) << 23 | mantissa << 13);
+}
+
+// Rounds to nearest even.
+uint16_t floatToHalf(float value) {
+  const uint32_t bits = std::bit_cast<uint32_t>(value);
+  const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+  const float magnitude = std::abs(value);
+  if (std::isnan(value)) {
+    return static_cast<uint16_t>(sign | 0x7e00u);
+  }
+  if (magnitude >= 65520.0f) {
+    return static_cast<uint16_t>(sign | 0x7c00u);
+  }
+  if (magnitude < 6.103515625e-05f) {
+    // Subnormal: units of 2^-24. Rounding up to 1024 yields the smallest
+    // normal, which is also its correct encoding.
+    return static_cast<uint16_t>(sign |
+                                 std::lrint(magnitude * 16777216.0f));
+  }
+  const uint32_t abs = std::bit_cast<uint32_t>(magnitude);
+  const uint32_t rounded = abs + 0xfffu + ((abs >> 13) & 1u);
+  return static_cast<uint16_t>(sign | ((rounded - (112u << 23)) >> 13));
+}
+
+struct Rgba8Texel {
+  static constexpr size_t kBytes = 4;
+  static Vec4 load(const uint8_t* src) {
+    return {static_cast<float>(src[0]), static_cast<float>(src[1]),
+            static_cast<float>(src[2]), static_cast<float>(src[3])};
+  }
+  static void store(const Vec4& texel, uint8_t* dst) {
+    for (size_t c = 0; c < 4; ++c) {
+      dst[c] = static_cast<uint8_t>(std::lround(texel[c]));
+    }
+  }
+};
+
+struct Rgba16Texel {
+  static constexpr size_t kBytes = 8;
+  static Vec4 load(const uint8_t* src) {
+    std::array<uint16_t, 4> texel{};
+    std::memcpy(texel.data(), src, kBytes);
+    return {static_cast<float>(texel[0]), static_cast<float>(texel[1]),
+            static_cast<float>(texel[2]), static_cast<float>(texel[3])};
+  }
+  static void store(const Vec4& texel, uint8_t* dst) {
+    std::array<uint16_t, 4> out{};
+    for (size_t c = 0; c < 4; ++c) {
+      out[c] = static_cast<uint16_t>(std::lround(texel[c]));
+    }
+    std::memcpy(dst, out.data(), kBytes);
+  }
+};
+
+struct Rgba16FloatTexel {
+  static constexpr size_t kBytes = 8;
+  static Vec4 load(const uint8_t* src) {
+    std::array<uint16_t, 4> texel{};
+    std::memcpy(texel.data(), src, kBytes);
+    return {halfToFloat(texel[0]), halfToFloat(texel[1]),
+            halfToFloat(texel[2]), halfToFloat(texel[3])};
+  }
+  static void store(const Vec4& texel, uint8_t* dst) {
+    std::array<uint16_t, 4> out{};
+    for (size_t c = 0; c < 4; ++c) {
+      out[c] = floatToHalf(texel[c]);
+    }
+    std::memcpy(dst, out.data(), kBytes);
+  }
+};
+
+struct Rgba32FloatTexel {
+  static constexpr size_t kBytes = 16;
+  static Vec4 load(const uint8_t* src) {
+    Vec4 texel{};
+    std::memcpy(texel.data(), src, kBytes);
+    return texel;
+  }
+  static void store(const Vec4& texel, uint8_t* dst) {
+    std::memcpy(dst, texel.data(), kBytes);
+  }
+};
+
+// A2B10G10R10: red in the low bits.
+struct Rgb10A2Texel {
+  static constexpr size_t kBytes = 4;
+  static Vec4 load(const uint8_t* src) {
+    uint32_t packed = 0;
+    std::memcpy(&packed, src, kBytes);
+    return {static_cast<float>(packed & 0x3ffu),
+            static_cast<float>((packed >> 10) & 0x3ffu),
+            static_cast<float>((packed >> 20) & 0x3ffu),
+            static_cast<float>(packed >> 30)};
+  }
+  static void store(const Vec4& texel, uint8_t* dst) {
+    const auto channel = [&](size_t c) {
+      return static_cast<uint32_t>(std::lround(texel[c]));
+    };
+    const uint32_t packed =
+        channel(0) | channel(1) << 10 | channel(2) << 20 | channel(3) << 30;
+    std::memcpy(dst, &packed, kBytes);
+  }
+};
+
+template <typename Texel>
+void downsample(std::span<const uint8_t> src, VkExtent3D srcExtent,
+                std::vector<uint8_t>& dst, VkExtent3D dstExtent) {
+  dst.resize(size_t{dstExtent.width} * dstExtent.height * Texel::kBytes);
+  const auto at = [&](uint32_t x, uint32_t y) {
+    return Texel::load(src.data() +
+                       (size_t{y} * srcExtent.width + x) * Texel::kBytes);
+  };
+  for (uint32_t y = 0; y < dstExtent.height; ++y) {
+    const uint32_t y0 = std::min(2 * y, srcExtent.height - 1);
+    const uint32_t y1 = std::min(2 * y + 1, srcExtent.height - 1);
+    for (uint32_t x = 0; x < dstExtent.width; ++x) {
+      const uint32_t x0 = std::min(2 * x, srcExtent.width - 1);
+      const uint32_t x1 = std::min(2 * x + 1, srcExtent.width - 1);
+      const Vec4 a = at(x0, y0);
+      const Vec4 b = at(x1, y0);
+      const Vec4 c = at(x0, y1);
+      const Vec4 d = at(x1, y1);
+      Vec4 mean{};
+      for (size_t k = 0; k < 4; ++k) {
+        mean[k] = 0.25f * (a[k] + b[k] + c[k] + d[k]);
+      }
+      Texel::store(mean, dst.data() + (size_t{y} * dstExtent.width + x) *
+                                          Texel::kBytes);
+    }
+  }
+}
+
+void downsample(PixelFormat format, std::span<const uint8_t> src,
+                VkExtent3D srcExtent, std::vector<uint8_t>& dst,
+                VkExtent3D dstExtent) {
+  switch (format) {
+    case PixelFormat::kRgba8Unorm:
+      return downsample<Rgba8Texel>(src, srcExtent, dst, dstExtent);
+    case PixelFormat::kRgba16Unorm:
+      return downsample<Rgba16Texel>(src, srcExtent, dst, dstExtent);
+    case PixelFormat::kRgba16Sfloat:
+      return downsample<Rgba16FloatTexel>(src, srcExtent, dst, dstExtent);
+    case PixelFormat::kRgba32Sfloat:
+      return downsample<Rgba32FloatTexel>(src, srcExtent, dst, dstExtent);
+    case PixelFormat::kRgb10A2Unorm:
+      return downsample<Rgb10A2Texel>(src, srcExtent, dst, dstExtent);
+  }
+  throw std::logic_error("Unhandled PixelFormat");
+}
+
+// ---------------------------------------------------------------------------
+// Block compression.
+
+// Encodes an RGBA8 level a band of block rows per task. Blocks hanging off
+// the right or bottom edge repeat the last column or row.
+void compressLevel(std::span<const uint8_t> texels, VkExtent3D extent,
+                   TextureCompression compression, uint8_t* dst,
+                   ThreadPool& pool) {
+  const uint32_t blocksX = (extent.width + 3) / 4;
+  const uint32_t blocksY = (extent.height + 3) / 4;
+  const size_t blockBytes =
+      compression == TextureCompression::kBc1 ? kBc1BlockBytes
+                                              : kBc7BlockBytes;
+
+  const auto encodeRows = [=](uint32_t firstRow, uint32_t lastRow) {
+    std::array<uint8_t, 64> block{};
+    for (uint32_t by = firstRow; by < lastRow; ++by) {
+      for (uint32_t bx = 0; bx < blocksX; ++bx) {
+        for (uint32_t i = 0; i < 16; ++i) {
+          const uint32_t x = std::min(4 * bx + i % 4, extent.width - 1);
+          const uint32_t y = std::min(4 * by + i / 4, extent.height - 1);
+          std::memcpy(block.data() + 4 * size_t{i},
+                      texels.data() + 4 * (size_t{y} * extent.width + x), 4);
+        }
+        uint8_t* out = dst + (size_t{by} * blocksX + bx) * blockBytes;
+        if (compression == TextureCompression::kBc1) {
+          encodeBc1Block(block, std::span<uint8_t, kBc1BlockBytes>(
+                                    out, kBc1BlockBytes));
+        } else {
+          encodeBc7Block(block, std::span<uint8_t, kBc7BlockBytes>(
+                                    out, kBc7BlockBytes));
+        }
+      }
+    }
+  };
+
+  // A few bands per worker evens out the load; tiny levels run inline.
+  const uint32_t bands = std::min<uint32_t>(
+      blocksY, static_cast<uint32_t>(pool.size()) * 4);
+  if (bands <= 1) {
+    encodeRows(0, blocksY);
+    return;
+  }
+  std::vector<std::future<void>> done;
+  done.reserve(bands);
+  for (uint32_t band = 0; band < bands; ++band) {
+    const uint32_t first = blocksY * band / bands;
+    const uint32_t last = blocksY * (band + 1) / bands;
+    done.push_back(pool.submit([=] { encodeRows(first, last); }));
+  }
+  for (std::future<void>& future : done) {
+    future.get();
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Cache.
+
+std::optional<MipChain> readCache(const std::filesystem::path& cacheDir,
+                                  uint64_t key) {
+  const std::optional<std::vector<uint8_t>> payload =
+      readCacheFile(cacheDir, kCacheFormat, key);
+  if (!payload) {
+    return std::nullopt;
+  }
+  CachePayloadReader reader(*payload);
+  CacheHeader header;
+  if (!reader.read(header) || header.levelCount == 0 ||
+      header.levelCount > 32 ||
+      payload->size() != sizeof(header) +
+                              header.levelCount * sizeof(CachedLevel) +
+                              header.dataSize) {
+    return std::nullopt;
+  }
+  MipChain chain;
+  chain.format = static_cast<VkFormat>(header.format);
+  const std::optional<FormatLayout> layout = formatLayout(chain.format);
+  if (!layout) {
+    return std::nullopt;
+  }
+
+  std::vector<CachedLevel> cached(header.levelCount);
+  chain.data.resize(header.dataSize);
+  if (!reader.read(cached) || !reader.read(chain.data)) {
+    return std::nullopt;
+  }
+
+  for (const CachedLevel& level : cached) {
+    const VkExtent3D extent{level.width, level.height, 1};
+    if (level.offset % kLevelAlignment != 0 ||
+        level.offset + levelBytes(*layout, extent) > header.dataSize) {
+      return std::nullopt;
+    }
+    chain.levels.push_back({.extent = extent, .offset = level.offset});
+  }
+  chain.fromCache = true;
+  return chain;
+}
+
+void writeCache(const std::filesystem::path& cacheDir, uint64_t key,
+                const MipChain& chain) {
+  std::vector<CachedLevel> cached;
+  for (const UploadManager::ImageLevel& level : chain.levels) {
+    cached.push_back({
+        .width = level.extent.width,
+        .height = level.extent.height,
+        .offset = level.offset,
+    });
+  }
+  const CacheHeader header{
+      .format = static_cast<uint32_t>(chain.format),
+      .levelCount = static_cast<uint32_t>(cached.size()),
+      .dataSize = chain.data.size(),
+  };
+  writeCacheFile(cacheDir, kCacheFormat, key,
+                 {cacheBytes(header), cacheBytes(cached),
+                  cacheBytes(chain.data)});
+}
+
+// Keyed by the options that shape the result as well as the source.
+CacheKey optionsKey(const TextureOptions& options) {
+  CacheKey key(kCacheFormat);
+  key.add(fmt::format("mips{} bc{}", options.mipmaps,
+                      static_cast<int>(options.compression)));
+  return key;
+}
+
+template <typename Build>
+MipChain cachedMipChain(const std::filesystem::path& cacheDir, uint64_t key,
+                        const Build& build) {
+  if (std::optional<MipChain> cached = readCache(cacheDir, key)) {
+    return std::move(*cached);
+  }
+  MipChain chain = build();
+  writeCache(cacheDir, key, chain);
+  return chain;
+}
+
+}  // namespace
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height) {
+  return static_cast<uint32_t>(std::bit_width(std::max({width, height, 1u})));
+}
+
+MipChain buildMipChain(const ImageData& image, const TextureOptions& options) {
+  if (image.width <= 0 || image.height <= 0) {
+    throw std::invalid_argument(fmt::format("Invalid texture size {}x{}",
+                                            image.width, image.height));
+  }
+  const bool compress = options.compression != TextureCompression::kNone &&
+                        image.format == PixelFormat::kRgba8Unorm;
+  MipChain chain;
+  chain.format = !compress ? toVkFormat(image.format)
+                 : options.compression == TextureCompression::kBc1
+                     ? VK_FORMAT_BC1_RGB_UNORM_BLOCK
+                     : VK_FORMAT_BC7_UNORM_BLOCK;
+  const FormatLayout layout = *formatLayout(chain.format);
+
+  const auto width = static_cast<uint32_t>(image.width);
+  const auto height = static_cast<uint32_t>(image.height);
+  const uint32_t levelCount = options.mipmaps ? mipLevelCount(width, height)
+                                              : 1;
+  VkDeviceSize size = 0;
+  for (uint32_t i = 0; i < levelCount; ++i) {
+    const VkExtent3D extent{std::max(width >> i, 1u),
+                            std::max(height >> i, 1u), 1};
+    chain.levels.push_back({.extent = extent, .offset = size});
+    size = alignUp(size + levelBytes(layout, extent), kLevelAlignment);
+  }
+  chain.data.resize(size);
+
+  std::optional<ThreadPool> pool;
+  if (compress) {
+    pool.emplace();
+  }
+  // Level i's texels, filtered from level i - 1's.
+  std::span<const uint8_t> texels = image.pixels;
+  std::vector<uint8_t> current;
+  std::vector<uint8_t> next;
+  for (uint32_t i = 0; i < levelCount; ++i) {
+    const UploadManager::ImageLevel& level = chain.levels[i];
+    if (i > 0) {
+      downsample(image.format, texels, chain.levels[i - 1].extent, next,
+                 level.extent);
+      std::swap(current, next);
+      texels = current;
+    }
+    uint8_t* dst = chain.data.data() + level.offset;
+    if (compress) {
+      compressLevel(texels, level.extent, options.compression, dst, *pool);
+    } else {
+      std::memcpy(dst, texels.data(), texels.size());
+    }
+  }
+  return chain;
+}
+
+MipChain loadMipChain(const std::filesystem::path& imagePath,
+                      std::optional<PixelFormat> format,
+                      const TextureOptions& options,
+                      const std::filesystem::path& cacheDir) {
+  const auto build = [&] {
+    return buildMipChain(loadImage(imagePath, format), options);
+  };
+  if (options.compression == TextureCompression::kNone) {
+    return build();
+  }
+
+  // Trusting the file's size and timestamp instead of hashing its contents
+  // is what lets a hit skip the decode.
+  std::error_code ec;
+  const std::filesystem::path absolute =
+      std::filesystem::absolute(imagePath, ec);
+  const uintmax_t fileSize = std::filesystem::file_size(absolute, ec);
+  const auto modified = std::filesystem::last_write_time(absolute, ec);
+  if (ec) {
+    // Let the decoder report the unreadable file.
+    return build();
+  }
+  CacheKey key = optionsKey(options);
+  key.add(fmt::format(
+      "{} {} {} {}", absolute.generic_string(), fileSize,
+      modified.time_since_epoch().count(),
+      format ? static_cast<int>(*format) : -1));
+  return cachedMipChain(cacheDir, key.value(), build);
+}
+
+MipChain loadMipChain(const ImageData& image, const TextureOptions& options,
+                      const std::filesystem::path& cacheDir) {
+  if (options.compression == TextureCompression::kNone) {
+    return buildMipChain(image, options);
+  }
+  CacheKey key = optionsKey(options);
+  key.add(fmt::format("{}x{} {}", image.width, image.height,
+                      static_cast<int>(image.format)));
+  key.add(image.pixels);
+  return cachedMipChain(cacheDir, key.value(),
+                        [&] { return buildMipChain(image, options); });
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include "DiskCache.h"
+#include "ImageIO.h"
+#include "UploadManager.h"
+
+// Block compression applied to a texture's mip levels (see
+// BlockCompression.h). Only 8-bit sources are compressed; deeper formats
+// keep their precision.
+enum class TextureCompression : uint8_t {
+  kNone,
+  kBc1,  // 0.5 bytes per texel, opaque
+  kBc7,  // 1 byte per texel
+};
+
+struct TextureOptions {
+  // A full chain down to 1x1, so minified textures do not alias.
+  bool mipmaps = true;
+  TextureCompression compression = TextureCompression::kNone;
+};
+
+// A texture's mip levels, packed into one allocation the way
+// UploadManager::uploadImage() takes them.
+struct MipChain {
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  std::vector<UploadManager::ImageLevel> levels;
+  std::vector<uint8_t> data;
+  // True when this load skipped decoding and encoding.
+  bool fromCache = false;
+
+  [[nodiscard]] uint32_t width() const { return levels[0].extent.width; }
+  [[nodiscard]] uint32_t height() const { return levels[0].extent.height; }
+};
+
+// floor(log2(max(width, height))) + 1.
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+// Each level is a 2x2 box filter of the one above (the last row or column
+// of an odd level is dropped, as with vkCmdBlitImage). Compression runs on
+// all cores.
+MipChain buildMipChain(const ImageData& image, const TextureOptions& options);
+
+// As buildMipChain(), but compressed chains go through an on-disk cache:
+// keyed by the file's path, size and modification time, so a hit skips
+// decoding as well. Failing to read or write the cache is not an error.
+MipChain loadMipChain(const std::filesystem::path& imagePath,
+                      std::optional<PixelFormat> format,
+                      const TextureOptions& options,
+                      const std::filesystem::path& cacheDir =
+                          cacheDirectory() / "textures");
+// Keyed by a hash of the pixels, for images that never were a file.
+MipChain loadMipChain(const ImageData& image, const TextureOptions& options,
+                      const std::filesystem::path& cacheDir =
+                          cacheDirectory() / "textures");
@@ -0,0 +1,639 @@
+#include "TileSplatLayer.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#include "VulkanCompute.h"
+#include "VulkanErrors.h"
+#include "VulkanShaders.h"
+
+#ifndef SHADER_DIR
+#define SHADER_DIR "shaders"
+#endif
+
+namespace {
+
+// Matches shaders/tile_common.glsl.
+constexpr uint32_t kTileSize = 16;
+constexpr VkDeviceSize kProjectedSplatSize = 32;
+// local_size_x of tile_project.comp and tile_ranges.comp.
+constexpr uint32_t kWorkgroupSize = 256;
+constexpr VkFormat kTargetFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+// Beside the attributes (see SplatBuffers::shaderBinding).
+constexpr uint32_t kProjectedBinding = 5;
+constexpr uint32_t kKeysBinding = 7;
+constexpr uint32_t kValuesBinding = 8;
+constexpr uint32_t kCountBinding = 9;
+
+// Matches PushConstants in tile_project.comp.
+struct ProjectPushConstants {
+  Mat4 view;
+  std::array<float, 4> cameraPos;
+  std::array<float, 2> focal;
+  std::array<float, 2> viewport;
+  std::array<float, 2> tanHalfFov;
+  std::array<uint32_t, 2> tiles;
+  uint32_t capacity;
+  uint32_t count;
+};
+static_assert(sizeof(ProjectPushConstants) == 120);
+
+// Matches the constant_ids in splat_project.glsl.
+struct ShSpecialization {
+  uint32_t degree;
+  uint32_t coeffs;
+};
+
+// Matches PushConstants in tile_ranges.comp.
+struct RangesPushConstants {
+  uint32_t capacity;
+};
+
+// Matches PushConstants in tile_raster.comp.
+struct RasterPushConstants {
+  std::array<uint32_t, 2> viewport;
+  uint32_t tilesX;
+};
+
+}  // namespace
+
+TileSplatLayer::TileSplatLayer(const Renderer::Context& ctx,
+                               std::shared_ptr<const SplatBuffers> splats)
+    : TileSplatLayer(ctx, std::move(splats), Options{}) {}
+
+TileSplatLayer::TileSplatLayer(const Renderer::Context& ctx,
+                               std::shared_ptr<const SplatBuffers> splats,
+                               const Options& options)
+    : PipelineLayerBase(ctx),
+      allocator_(ctx.allocator),
+      splats_(std::move(splats)),
+      sort_(ctx,
+            options.maxInstances != 0
+                ? options.maxInstances
+                : defaultMaxInstances(splats_->capacity()),
+            2) {
+  projected_ =
+      Buffer(device_, VkBufferCreateInfo{
+                          .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                          .size = splats_->capacity() * kProjectedSplatSize,
+                          .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      });
+  projectedMemory_ = allocator_->allocate(projected_.get(),
+                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  targets_.resize(ctx.framesInFlight);
+  for (Target& target : targets_) {
+    target.stats =
+        Buffer(device_, VkBufferCreateInfo{
+                            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                            .size = sizeof(uint32_t),
+                            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                        });
+    target.statsMemory = allocator_->allocate(
+        target.stats.get(), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    target.visible = Buffer(
+        device_,
+        VkBufferCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = splats_->index().chunkCount() * sizeof(uint32_t),
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        });
+    // Written by the CPU every frame; device-local when the heap is
+    // mappable.
+    target.visibleMemory = allocator_->allocate(
+        target.visible.get(),
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+
+  createDescriptors();
+  createPipelines(ctx.swapchainFormat);
+}
+
+uint32_t TileSplatLayer::defaultMaxInstances(size_t splatCount) {
+  constexpr uint64_t kMin = uint64_t{1} << 20;
+  constexpr uint64_t kMax = uint64_t{1} << 25;
+  return static_cast<uint32_t>(
+      std::clamp<uint64_t>(uint64_t{splatCount} * 4, kMin, kMax));
+}
+
+void TileSplatLayer::createDescriptors() {
+  constexpr VkDescriptorType kBuffer = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  constexpr VkDescriptorType kImage = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  constexpr VkShaderStageFlags kCompute = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  std::vector<VkDescriptorSetLayoutBinding> projectBindings =
+      splats_->layoutBindings(kCompute);
+  for (const uint32_t binding :
+       {kProjectedBinding, kKeysBinding, kValuesBinding, kCountBinding,
+        SplatBuffers::kVisibleChunksBinding}) {
+    projectBindings.push_back(layoutBinding(binding, kBuffer, kCompute));
+  }
+  projectSetLayout_ = DescriptorSetLayout(device_, projectBindings);
+
+  // keys, count, ranges.
+  const std::array<VkDescriptorSetLayoutBinding, 3> rangesBindings{
+      layoutBinding(0, kBuffer, kCompute),
+      layoutBinding(1, kBuffer, kCompute),
+      layoutBinding(2, kBuffer, kCompute),
+  };
+  rangesSetLayout_ = DescriptorSetLayout(device_, rangesBindings);
+
+  // values, ranges, projected, target.
+  const std::array<VkDescriptorSetLayoutBinding, 4> rasterBindings{
+      layoutBinding(0, kBuffer, kCompute),
+      layoutBinding(1, kBuffer, kCompute),
+      layoutBinding(2, kBuffer, kCompute),
+      layoutBinding(3, kImage, kCompute),
+  };
+  rasterSetLayout_ = DescriptorSetLayout(device_, rasterBindings);
+
+  compositeSetLayout_ = DescriptorSetLayout(
+      device_, layoutBinding(0, kImage, VK_SHADER_STAGE_FRAGMENT_BIT));
+
+  // Projection, ranges, raster and composite sets per target.
+  const auto targetCount = static_cast<uint32_t>(targets_.size());
+  const uint32_t setCount = 4 * targetCount;
+  const std::array<VkDescriptorPoolSize, 2> poolSizes{{
+      {
+          .type = kBuffer,
+          .descriptorCount =
+              targetCount * static_cast<uint32_t>(projectBindings.size() +
+                                                  rangesBindings.size() +
+                                                  rasterBindings.size() - 1),
+      },
+      {
+          .type = kImage,
+          .descriptorCount = 2 * targetCount,
+      },
+  }};
+  descriptorPool_ = DescriptorPool(device_, setCount, poolSizes);
+
+  std::vector<VkDescriptorSetLayout> layouts;
+  for (uint32_t i = 0; i < targetCount; ++i) {
+    layouts.push_back(projectSetLayout_.get());
+    layouts.push_back(rangesSetLayout_.get());
+    layouts.push_back(rasterSetLayout_.get());
+    layouts.push_back(compositeSetLayout_.get());
+  }
+  std::vector<VkDescriptorSet> sets(setCount);
+  const VkDescriptorSetAllocateInfo dsai{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = descriptorPool_.get(),
+      .descriptorSetCount = setCount,
+      .pSetLayouts = layouts.data(),
+  };
+  VK_CHECK(vkAllocateDescriptorSets(device_, &dsai, sets.data()));
+  for (uint32_t i = 0; i < targetCount; ++i) {
+    targets_[i].projectSet = sets[4 * i];
+    targets_[i].rangesSet = sets[1 + 4 * i];
+    targets_[i].rasterSet = sets[2 + 4 * i];
+    targets_[i].compositeSet = sets[3 + 4 * i];
+  }
+
+  std::vector<VkDescriptorBufferInfo> infos;
+  for (uint32_t i = 0; i < splats_->attributeCount(); ++i) {
+    infos.push_back(
+        splats_->descriptor(static_cast<SplatBuffers::Attribute>(i)));
+  }
+  infos.push_back({.buffer = projected_.get(), .range = VK_WHOLE_SIZE});
+  infos.push_back(sort_.keys());
+  infos.push_back(sort_.values());
+  infos.push_back(sort_.countBuffer());
+  infos.emplace_back();
+
+  for (const Target& target : targets_) {
+    infos.back() = {.buffer = target.visible.get(), .range = VK_WHOLE_SIZE};
+    std::vector<VkWriteDescriptorSet> writes(projectBindings.size());
+    for (uint32_t i = 0; i < writes.size(); ++i) {
+      writes[i] = {
+          .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+          .dstSet = target.projectSet,
+          .dstBinding = projectBindings[i].binding,
+          .descriptorCount = 1,
+          .descriptorType = kBuffer,
+          .pBufferInfo = &infos[i],
+      };
+    }
+    vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()),
+                           writes.data(), 0, nullptr);
+  }
+}
+
+void TileSplatLayer::updateTargetDescriptors(const Target& target) {
+  const std::array<VkDescriptorBufferInfo, 5> buffers{{
+      sort_.keys(),
+      sort_.countBuffer(),
+      {.buffer = target.ranges.get(), .range = VK_WHOLE_SIZE},
+      sort_.values(),
+      {.buffer = projected_.get(), .range = VK_WHOLE_SIZE},
+  }};
+  const VkDescriptorImageInfo image{
+      .imageView = target.view.get(),
+      .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+  };
+
+  const auto bufferWrite = [](VkDescriptorSet set, uint32_t binding,
+                              const VkDescriptorBufferInfo& info) {
+    return VkWriteDescriptorSet{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set,
+        .dstBinding = binding,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &info,
+    };
+  };
+  const auto imageWrite = [&](VkDescriptorSet set, uint32_t binding) {
+    return VkWriteDescriptorSet{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set,
+        .dstBinding = binding,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        .pImageInfo = &image,
+    };
+  };
+  const std::array<VkWriteDescriptorSet, 8> writes{
+      bufferWrite(target.rangesSet, 0, buffers[0]),
+      bufferWrite(target.rangesSet, 1, buffers[1]),
+      bufferWrite(target.rangesSet, 2, buffers[2]),
+      bufferWrite(target.rasterSet, 0, buffers[3]),
+      bufferWrite(target.rasterSet, 1, buffers[2]),
+      bufferWrite(target.rasterSet, 2, buffers[4]),
+      imageWrite(target.rasterSet, 3),
+      imageWrite(target.compositeSet, 0),
+  };
+  vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()),
+                         writes.data(), 0, nullptr);
+}
+
+void TileSplatLayer::createPipelines(VkFormat swapchainFormat) {
+  const auto makeLayout = [&](const DescriptorSetLayout& setLayout,
+                              VkShaderStageFlags stages,
+                              uint32_t pushConstantSize) {
+    const VkDescriptorSetLayout handle = setLayout.get();
+    const VkPushConstantRange pcRange{
+        .stageFlags = stages,
+        .size = pushConstantSize,
+    };
+    return PipelineLayout(
+        device_, VkPipelineLayoutCreateInfo{
+                     .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                     .setLayoutCount = 1,
+                     .pSetLayouts = &handle,
+                     .pushConstantRangeCount = pushConstantSize > 0 ? 1u : 0u,
+                     .pPushConstantRanges = &pcRange,
+                 });
+  };
+  const auto makeCompute = [&](const char* path, const PipelineLayout& layout,
+                               const VkSpecializationInfo* specInfo =
+                                   nullptr) {
+    const ShaderModule module(device_, path);
+    return Pipeline(
+        device_,
+        VkComputePipelineCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage =
+                {
+                    .sType =
+                        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = module.get(),
+                    .pName = "main",
+                    .pSpecializationInfo = specInfo,
+                },
+            .layout = layout.get(),
+        },
+        pipelineCache_);
+  };
+
+  projectLayout_ = makeLayout(projectSetLayout_, VK_SHADER_STAGE_COMPUTE_BIT,
+                              sizeof(ProjectPushConstants));
+  rangesLayout_ = makeLayout(rangesSetLayout_, VK_SHADER_STAGE_COMPUTE_BIT,
+                             sizeof(RangesPushConstants));
+  rasterLayout_ = makeLayout(rasterSetLayout_, VK_SHADER_STAGE_COMPUTE_BIT,
+                             sizeof(RasterPushConstants));
+  // One projection variant per SH degree the cloud has.
+  const std::array<VkSpecializationMapEntry, 2> specEntries{{
+      {0, offsetof(ShSpecialization, degree), sizeof(uint32_t)},
+      {1, offsetof(ShSpecialization, coeffs), sizeof(uint32_t)},
+  }};
+  for (int degree = 0; degree <= splats_->shDegree(); ++degree) {
+    const ShSpecialization specData{
+        .degree = static_cast<uint32_t>(degree),
+        .coeffs = static_cast<uint32_t>(
+            SplatCloud::shCoefficients(splats_->shDegree())),
+    };
+    const VkSpecializationInfo specInfo{
+        .mapEntryCount = static_cast<uint32_t>(specEntries.size()),
+        .pMapEntries = specEntries.data(),
+        .dataSize = sizeof(specData),
+        .pData = &specData,
+    };
+    project_[static_cast<size_t>(degree)] = makeCompute(
+        splats_->encoding() == SplatBuffers::Encoding::kCompact
+            ? SHADER_DIR "/tile_project_compact.comp.spv"
+            : SHADER_DIR "/tile_project.comp.spv",
+        projectLayout_, &specInfo);
+  }
+  ranges_ = makeCompute(SHADER_DIR "/tile_ranges.comp.spv", rangesLayout_);
+  raster_ = makeCompute(SHADER_DIR "/tile_raster.comp.spv", rasterLayout_);
+
+  // Composite: one full-screen triangle, blended like GaussianSplatLayer.
+  pipelineLayout_ = makeLayout(compositeSetLayout_, 0, 0);
+  const ShaderModule vertModule(device_, SHADER_DIR "/tile_composite.vert.spv");
+  const ShaderModule fragModule(device_, SHADER_DIR "/tile_composite.frag.spv");
+  const std::array<VkPipelineShaderStageCreateInfo, 2> stages{{
+      {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .stage = VK_SHADER_STAGE_VERTEX_BIT,
+          .module = vertModule.get(),
+          .pName = "main",
+      },
+      {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+          .module = fragModule.get(),
+          .pName = "main",
+      },
+  }};
+
+  const VkPipelineVertexInputStateCreateInfo vertexInput{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+  };
+  const VkPipelineInputAssemblyStateCreateInfo inputAssembly{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+      .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+  };
+  const VkPipelineViewportStateCreateInfo viewportState{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+      .viewportCount = 1,
+      .scissorCount = 1,
+  };
+  const VkPipelineRasterizationStateCreateInfo rasterizer{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+      .polygonMode = VK_POLYGON_MODE_FILL,
+      .cullMode = VK_CULL_MODE_NONE,
+      .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+      .lineWidth = 1.0f,
+  };
+  const VkPipelineMultisampleStateCreateInfo multisample{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+      .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+  };
+  // Premultiplied "over".
+  const VkPipelineColorBlendAttachmentState colorBlendAttachment{
+      .blendEnable = VK_TRUE,
+      .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+      .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+      .colorBlendOp = VK_BLEND_OP_ADD,
+      .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+      .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+      .alphaBlendOp = VK_BLEND_OP_ADD,
+      .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+  };
+  const VkPipelineColorBlendStateCreateInfo colorBlend{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+      .attachmentCount = 1,
+      .pAttachments = &colorBlendAttachment,
+  };
+  const std::array<VkDynamicState, 2> dynamicStates = {
+      VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+  const VkPipelineDynamicStateCreateInfo dynamicState{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .dynamicStateCount = 2,
+      .pDynamicStates = dynamicStates.data(),
+  };
+  const VkPipelineRenderingCreateInfo renderingCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+      .colorAttachmentCount = 1,
+      .pColorAttachmentFormats = &swapchainFormat,
+  };
+  const VkGraphicsPipelineCreateInfo pipelineCI{
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .pNext = &renderingCI,
+      .stageCount = 2,
+      .pStages = stages.data(),
+      .pVertexInputState = &vertexInput,
+      .pInputAssemblyState = &inputAssembly,
+      .pViewportState = &viewportState,
+      .pRasterizationState = &rasterizer,
+      .pMultisampleState = &multisample,
+      .pColorBlendState = &colorBlend,
+      .pDynamicState = &dynamicState,
+      .layout = pipelineLayout_.get(),
+  };
+  pipeline_ = Pipeline(device_, pipelineCI, pipelineCache_);
+}
+
+void TileSplatLayer::resize(Target& target, VkExtent2D extent) {
+  target.view = ImageView();
+  target.image =
+      Image(device_, VkImageCreateInfo{
+                         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                         .imageType = VK_IMAGE_TYPE_2D,
+                         .format = kTargetFormat,
+                         .extent = {extent.width, extent.height, 1},
+                         .mipLevels = 1,
+                         .arrayLayers = 1,
+                         .samples = VK_SAMPLE_COUNT_1_BIT,
+                         .tiling = VK_IMAGE_TILING_OPTIMAL,
+                         .usage = VK_IMAGE_USAGE_STORAGE_BIT,
+                         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                     });
+  target.memory = allocator_->allocate(target.image.get(),
+                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  target.view =
+      ImageView(device_, VkImageViewCreateInfo{
+                             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                             .image = target.image.get(),
+                             .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                             .format = kTargetFormat,
+                             .subresourceRange =
+                                 {
+                                     .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                     .levelCount = 1,
+                                     .layerCount = 1,
+                                 },
+                         });
+  target.extent = extent;
+  target.initialized = false;
+
+  const uint32_t tileCount = divideRoundingUp(extent.width, kTileSize) *
+                             divideRoundingUp(extent.height, kTileSize);
+  if (tileCount > target.tileCapacity) {
+    target.ranges = Buffer(
+        device_, VkBufferCreateInfo{
+                     .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                     .size = VkDeviceSize{tileCount} * 2 * sizeof(uint32_t),
+                     .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 });
+    target.rangesMemory = allocator_->allocate(
+        target.ranges.get(), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    target.tileCapacity = tileCount;
+  }
+  updateTargetDescriptors(target);
+}
+
+void TileSplatLayer::prepare(VkCommandBuffer cmd, const Camera& camera,
+                             VkExtent2D extent, uint32_t frameSlot) {
+  // This slot's last frame has completed, so its resources are free to
+  // rewrite and its instance count has landed.
+  Target& target = targets_[frameSlot];
+  if (target.statsPending) {
+    std::memcpy(&lastInstanceCount_, target.statsMemory.mapped(),
+                sizeof(uint32_t));
+    target.statsPending = false;
+  }
+  target.drawn = false;
+  if (!splats_->ready() || extent.width == 0 || extent.height == 0) {
+    return;
+  }
+  if (extent.width != target.extent.width ||
+      extent.height != target.extent.height) {
+    resize(target, extent);
+  }
+
+  const std::array<uint32_t, 2> tiles{divideRoundingUp(extent.width, kTileSize),
+                                      divideRoundingUp(extent.height, kTileSize)};
+  const uint32_t tileCount = tiles[0] * tiles[1];
+  const uint32_t capacity = sort_.maxCount();
+  visibleCount_ =
+      splats_->index().cull(camera, extent, culling_, visibleChunks_);
+  std::memcpy(target.visibleMemory.mapped(), visibleChunks_.data(),
+              visibleChunks_.size() * sizeof(uint32_t));
+  const uint32_t count = visibleCount_;
+
+  // Earlier frames' passes may still be reading the shared buffers that
+  // are about to be rewritten.
+  memoryBarrier(cmd,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0);
+  const VkDescriptorBufferInfo countInfo = sort_.countBuffer();
+  vkCmdFillBuffer(cmd, countInfo.buffer, 0, sizeof(uint32_t), 0);
+  vkCmdFillBuffer(cmd, target.ranges.get(), 0, VK_WHOLE_SIZE, 0);
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+  if (!target.initialized) {
+    const VkImageMemoryBarrier toGeneral{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = target.image.get(),
+        .subresourceRange =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .levelCount = 1,
+                .layerCount = 1,
+            },
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &toGeneral);
+    target.initialized = true;
+  }
+
+  // 1. Project and emit the tile instances.
+  const float focal = camera.focalLength(extent);
+  const Vec3 eye = camera.position();
+  const ProjectPushConstants projectPc{
+      .view = camera.view(),
+      .cameraPos = {eye.x, eye.y, eye.z, 1.0f},
+      .focal = {focal, focal},
+      .viewport = {static_cast<float>(extent.width),
+                   static_cast<float>(extent.height)},
+      .tanHalfFov = {0.5f * static_cast<float>(extent.width) / focal,
+                     0.5f * static_cast<float>(extent.height) / focal},
+      .tiles = tiles,
+      .capacity = capacity,
+      .count = count,
+  };
+  const auto degree =
+      static_cast<size_t>(std::clamp(shDegree_, 0, splats_->shDegree()));
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    project_[degree].get());
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          projectLayout_.get(), 0, 1, &target.projectSet, 0,
+                          nullptr);
+  vkCmdPushConstants(cmd, projectLayout_.get(), VK_SHADER_STAGE_COMPUTE_BIT,
+                     0, sizeof(projectPc), &projectPc);
+  vkCmdDispatch(cmd, divideRoundingUp(count, kWorkgroupSize), 1, 1);
+
+  // 2. Sort by tile, then depth. Only the tile bits in use are visited.
+  const auto tileBits =
+      static_cast<uint32_t>(std::bit_width(std::max(tileCount, 1u) - 1));
+  sort_.recordIndirect(cmd, 32 + tileBits,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+  // 3. Per-tile ranges.
+  const RangesPushConstants rangesPc{.capacity = capacity};
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, ranges_.get());
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          rangesLayout_.get(), 0, 1, &target.rangesSet, 0,
+                          nullptr);
+  vkCmdPushConstants(cmd, rangesLayout_.get(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(rangesPc), &rangesPc);
+  vkCmdDispatch(cmd, divideRoundingUp(capacity, kWorkgroupSize), 1, 1);
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT);
+
+  // 4. Blend each tile.
+  const RasterPushConstants rasterPc{
+      .viewport = {extent.width, extent.height},
+      .tilesX = tiles[0],
+  };
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, raster_.get());
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          rasterLayout_.get(), 0, 1, &target.rasterSet, 0,
+                          nullptr);
+  vkCmdPushConstants(cmd, rasterLayout_.get(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(rasterPc), &rasterPc);
+  vkCmdDispatch(cmd, tiles[0], tiles[1], 1);
+
+  // The composite reads the image; the host reads the instance count.
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+  const VkBufferCopy statsRegion{.size = sizeof(uint32_t)};
+  vkCmdCopyBuffer(cmd, countInfo.buffer, target.stats.get(), 1, &statsRegion);
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                VK_ACCESS_HOST_READ_BIT);
+  target.statsPending = true;
+  target.drawn = true;
+}
+
+void TileSplatLayer::render(VkCommandBuffer cmd, uint32_t frameSlot) const {
+  const Target& target = targets_[frameSlot];
+  if (!target.drawn) {
+    return;
+  }
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_.get());
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipelineLayout_.get(), 0, 1, &target.compositeSet, 0,
+                          nullptr);
+  vkCmdDraw(cmd, 3, 1, 0, 0);
+}
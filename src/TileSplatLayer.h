@@ -0,0 +1,136 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Camera.h"
+#include "GpuAllocator.h"
+#include "GpuRadixSort.h"
+#include "LayerBase.h"
+#include "SplatBuffers.h"
+#include "SplatIndex.h"
+
+// Draws a SplatBuffers cloud with a compute tile rasterizer instead of
+// instanced quads, so large splats cost one blend per covered pixel rather
+// than heavy overdraw. Each frame:
+//
+//   1. the cloud's SplatIndex culls chunks that are off screen or too
+//      small, and tile_project.comp projects the splats in the rest and
+//      emits one (tile, depth) key per 16x16 screen tile each touches;
+//   2. a GpuRadixSort orders the keys by tile, then front to back;
+//   3. tile_ranges.comp finds each tile's run of sorted keys;
+//   4. tile_raster.comp blends each tile front to back into a storage
+//      image, stopping per pixel once it is opaque;
+//
+// and render() composites that image over the frame. Needs the same
+// subgroup support as GpuRadixSort.
+class TileSplatLayer : public PipelineLayerBase {
+ public:
+  struct Options {
+    // Tile instances (splat-tile overlaps) per frame; each costs 24 bytes of
+    // sort buffers. Instances past it are dropped. 0 picks four per splat,
+    // within [2^20, 2^25].
+    uint32_t maxInstances = 0;
+  };
+
+  static bool isSupported(VkPhysicalDevice physicalDevice) {
+    return GpuRadixSort::isSupported(physicalDevice);
+  }
+
+  TileSplatLayer(const Renderer::Context& ctx,
+                 std::shared_ptr<const SplatBuffers> splats);
+  TileSplatLayer(const Renderer::Context& ctx,
+                 std::shared_ptr<const SplatBuffers> splats,
+                 const Options& options);
+
+  // Call from Renderer::renderFrame's prepare callback with
+  // Renderer::frameSlot(). Rasterizes the splats at `extent`; does nothing
+  // until the splat upload has landed.
+  void prepare(VkCommandBuffer cmd, const Camera& camera, VkExtent2D extent,
+               uint32_t frameSlot);
+  // Call from inside Renderer::renderFrame after prepare().
+  void render(VkCommandBuffer cmd, uint32_t frameSlot) const;
+
+  // Highest SH degree evaluated; clamped to the cloud's own degree. Each
+  // degree has its own specialized projection pipeline, so changing it
+  // costs nothing.
+  void setShDegree(int degree) { shDegree_ = degree; }
+
+  void setCulling(const SplatIndex::Culling& culling) { culling_ = culling; }
+  // Splats that survived culling in the last prepare().
+  [[nodiscard]] uint32_t visibleCount() const { return visibleCount_; }
+
+  // Tile instances emitted by the last completed frame, which may exceed
+  // instanceCapacity().
+  [[nodiscard]] uint32_t lastInstanceCount() const {
+    return lastInstanceCount_;
+  }
+  [[nodiscard]] uint32_t instanceCapacity() const {
+    return sort_.maxCount();
+  }
+
+ private:
+  // Per frame in flight: the output image, the tile ranges and the visible
+  // chunk list, which the slot's previous frame may still be reading when
+  // the next one records.
+  struct Target {
+    Image image;
+    GpuAllocation memory;
+    ImageView view;
+    VkExtent2D extent{};
+    bool initialized = false;
+    bool drawn = false;
+    Buffer ranges;
+    GpuAllocation rangesMemory;
+    uint32_t tileCapacity = 0;
+    // Host copy of the instance count.
+    Buffer stats;
+    GpuAllocation statsMemory;
+    bool statsPending = false;
+    Buffer visible;
+    GpuAllocation visibleMemory;
+    VkDescriptorSet projectSet = VK_NULL_HANDLE;
+    VkDescriptorSet rangesSet = VK_NULL_HANDLE;
+    VkDescriptorSet rasterSet = VK_NULL_HANDLE;
+    VkDescriptorSet compositeSet = VK_NULL_HANDLE;
+  };
+
+  static uint32_t defaultMaxInstances(size_t splatCount);
+
+  void createDescriptors();
+  void createPipelines(VkFormat swapchainFormat);
+  void resize(Target& target, VkExtent2D extent);
+  void updateTargetDescriptors(const Target& target);
+
+  GpuAllocator* allocator_ = nullptr;
+  std::shared_ptr<const SplatBuffers> splats_;
+  int shDegree_ = SplatCloud::kMaxShDegree;
+  SplatIndex::Culling culling_;
+  std::vector<uint32_t> visibleChunks_;
+  uint32_t visibleCount_ = 0;
+  uint32_t lastInstanceCount_ = 0;
+
+  GpuRadixSort sort_;
+  Buffer projected_;
+  GpuAllocation projectedMemory_;
+  std::vector<Target> targets_;
+
+  DescriptorSetLayout projectSetLayout_;
+  DescriptorSetLayout rangesSetLayout_;
+  DescriptorSetLayout rasterSetLayout_;
+  DescriptorSetLayout compositeSetLayout_;
+  DescriptorPool descriptorPool_;
+
+  PipelineLayout projectLayout_;
+  PipelineLayout rangesLayout_;
+  PipelineLayout rasterLayout_;
+  // Indexed by SH degree, up to the cloud's.
+  std::array<Pipeline, SplatCloud::kMaxShDegree + 1> project_;
+  Pipeline ranges_;
+  Pipeline raster_;
+  // The composite pipeline is PipelineLayerBase's.
+};
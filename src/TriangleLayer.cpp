@@ -101,7 +101,7 @@ TriangleLayer::TriangleLayer(const Renderer::Context& ctx)
       .layout = pipelineLayout_.get(),
   };
 
-  pipeline_ = Pipeline(device_, pipelineCI);
+  pipeline_ = Pipeline(device_, pipelineCI, pipelineCache_);
 }
 
 void TriangleLayer::render(VkCommandBuffer cmd) const {
@@ -0,0 +1,311 @@
+#include "UploadManager.h"
+
+#include <stdexcept>
+#include <utility>
+
+#include "VulkanErrors.h"
+
+namespace {
+
+// Satisfies vkCmdCopyBufferToImage's offset rules for every texel size we
+// upload (up to 16-byte RGBA32F) as well as the 4-byte rule for buffers.
+constexpr VkDeviceSize kCopyAlignment = 16;
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+UploadManager::UploadManager(GpuAllocator& allocator, VkQueue queue,
+                             uint32_t queueFamily, uint32_t graphicsQueueFamily,
+                             VkDeviceSize ringSize)
+    : allocator_(allocator),
+      device_(allocator.device()),
+      queue_(queue),
+      ring_(allocator, ringSize),
+      commandPool_(device_,
+                   VkCommandPoolCreateInfo{
+                       .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                       .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                       .queueFamilyIndex = queueFamily,
+                   }) {
+  queueFamilies_.push_back(queueFamily);
+  if (graphicsQueueFamily != queueFamily) {
+    queueFamilies_.push_back(graphicsQueueFamily);
+  }
+
+  const VkSemaphoreTypeCreateInfo typeInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+      .initialValue = 0,
+  };
+  timeline_ =
+      Semaphore(device_, VkSemaphoreCreateInfo{
+                             .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+                             .pNext = &typeInfo,
+                         });
+}
+
+UploadManager::~UploadManager() {
+  // Staging memory and command buffers must outlive the copies reading them.
+  if (lastSubmitted_ > 0) {
+    const VkSemaphore semaphore = timeline_.get();
+    const VkSemaphoreWaitInfo waitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &semaphore,
+        .pValues = &lastSubmitted_,
+    };
+    vkWaitSemaphores(device_, &waitInfo, UINT64_MAX);
+  }
+}
+
+uint64_t UploadManager::uploadImage(VkImage image, VkExtent3D extent,
+                                    VkDeviceSize size, const FillFn& fill) {
+  const ImageLevel level{.extent = extent};
+  return uploadImage(image, std::span(&level, 1), size, fill);
+}
+
+uint64_t UploadManager::uploadImage(VkImage image,
+                                    std::span<const ImageLevel> levels,
+                                    VkDeviceSize size, const FillFn& fill) {
+  const Span span = reserve(size);
+  fill(span.data);
+
+  VkCommandBuffer cmd = recordingCommandBuffer();
+
+  const VkImageSubresourceRange range{
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .levelCount = static_cast<uint32_t>(levels.size()),
+      .layerCount = 1,
+  };
+
+  const VkImageMemoryBarrier toTransfer{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = image,
+      .subresourceRange = range,
+  };
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &toTransfer);
+
+  std::vector<VkBufferImageCopy> regions;
+  regions.reserve(levels.size());
+  for (size_t i = 0; i < levels.size(); ++i) {
+    regions.push_back({
+        .bufferOffset = span.offset + levels[i].offset,
+        .imageSubresource =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = static_cast<uint32_t>(i),
+                .layerCount = 1,
+            },
+        .imageExtent = levels[i].extent,
+    });
+  }
+  vkCmdCopyBufferToImage(cmd, span.buffer, image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(regions.size()),
+                         regions.data());
+
+  // A transfer-only queue cannot name shader stages; the consumer's wait on
+  // the timeline semaphore makes the copy visible to them instead.
+  const VkImageMemoryBarrier toShader{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = image,
+      .subresourceRange = range,
+  };
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &toShader);
+
+  return lastSubmitted_ + 1;
+}
+
+uint64_t UploadManager::uploadBuffer(VkBuffer buffer, VkDeviceSize offset,
+                                     VkDeviceSize size, const FillFn& fill) {
+  const Span span = reserve(size);
+  fill(span.data);
+
+  const VkBufferCopy region{
+      .srcOffset = span.offset,
+      .dstOffset = offset,
+      .size = size,
+  };
+  vkCmdCopyBuffer(recordingCommandBuffer(), span.buffer, buffer, 1, &region);
+
+  return lastSubmitted_ + 1;
+}
+
+uint64_t UploadManager::flush() {
+  if (pending_.cmd == VK_NULL_HANDLE) {
+    return lastSubmitted_;
+  }
+
+  VK_CHECK(vkEndCommandBuffer(pending_.cmd));
+
+  const uint64_t value = lastSubmitted_ + 1;
+  const VkTimelineSemaphoreSubmitInfo timelineInfo{
+      .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+      .signalSemaphoreValueCount = 1,
+      .pSignalSemaphoreValues = &value,
+  };
+  const VkSemaphore semaphore = timeline_.get();
+  const VkSubmitInfo si{
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = &timelineInfo,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &pending_.cmd,
+      .signalSemaphoreCount = 1,
+      .pSignalSemaphores = &semaphore,
+  };
+  VK_CHECK(vkQueueSubmit(queue_, 1, &si, VK_NULL_HANDLE));
+
+  lastSubmitted_ = value;
+  pending_.value = value;
+  pending_.ringEnd = head_;
+  batches_.push_back(std::move(pending_));
+  pending_ = Batch{};
+  return value;
+}
+
+bool UploadManager::isComplete(uint64_t ticket) {
+  return ticket <= completedValue();
+}
+
+void UploadManager::wait(uint64_t ticket) {
+  if (ticket > lastSubmitted_) {
+    flush();
+  }
+  waitValue(ticket);
+  collect();
+}
+
+uint64_t UploadManager::completedValue() {
+  return collect();
+}
+
+uint64_t UploadManager::collect() {
+  uint64_t completed = 0;
+  VK_CHECK(vkGetSemaphoreCounterValue(device_, timeline_.get(), &completed));
+
+  // One queue executes the batches, so they retire in submission order.
+  while (!batches_.empty() && batches_.front().value <= completed) {
+    Batch& batch = batches_.front();
+    tail_ = batch.ringEnd;
+    ringUsed_ -= batch.ringBytes;
+    freeCommandBuffers_.push_back(batch.cmd);
+    batches_.pop_front();
+  }
+  return completed;
+}
+
+UploadManager::Span UploadManager::reserve(VkDeviceSize size) {
+  if (size == 0) {
+    throw std::invalid_argument("Empty upload");
+  }
+
+  collect();
+
+  if (size > ring_.size()) {
+    const StagingBuffer& staging =
+        pending_.oversized.emplace_back(allocator_, size);
+    return {staging.buffer(), 0, staging.data()};
+  }
+
+  VkDeviceSize offset = 0;
+  while (!tryReserveRing(size, offset)) {
+    if (batches_.empty()) {
+      // Only the unsubmitted batch holds ring space: send it on its way.
+      flush();
+    } else {
+      waitValue(batches_.front().value);
+      collect();
+    }
+  }
+  return {ring_.buffer(), offset, ring_.data() + offset};
+}
+
+bool UploadManager::tryReserveRing(VkDeviceSize size, VkDeviceSize& offset) {
+  const VkDeviceSize capacity = ring_.size();
+  if (ringUsed_ == 0) {
+    head_ = 0;
+    tail_ = 0;
+  }
+
+  const VkDeviceSize aligned = alignUp(head_, kCopyAlignment);
+  if (ringUsed_ == 0 || head_ > tail_) {
+    // Free space is [head_, capacity) followed by [0, tail_).
+    if (aligned + size <= capacity) {
+      offset = aligned;
+    } else if (size <= tail_) {
+      offset = 0;
+    } else {
+      return false;
+    }
+  } else if (head_ < tail_) {
+    if (aligned + size > tail_) {
+      return false;
+    }
+    offset = aligned;
+  } else {
+    return false;
+  }
+
+  // Alignment padding and any skipped tail stay with this batch, so they are
+  // released together with it.
+  const VkDeviceSize end = offset + size;
+  const VkDeviceSize consumed =
+      offset >= head_ ? end - head_ : (capacity - head_) + end;
+  ringUsed_ += consumed;
+  pending_.ringBytes += consumed;
+  head_ = end;
+  return true;
+}
+
+VkCommandBuffer UploadManager::recordingCommandBuffer() {
+  if (pending_.cmd != VK_NULL_HANDLE) {
+    return pending_.cmd;
+  }
+
+  if (freeCommandBuffers_.empty()) {
+    const VkCommandBufferAllocateInfo cbai{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = commandPool_.get(),
+        .commandBufferCount = 1,
+    };
+    VK_CHECK(vkAllocateCommandBuffers(device_, &cbai, &pending_.cmd));
+  } else {
+    pending_.cmd = freeCommandBuffers_.back();
+    freeCommandBuffers_.pop_back();
+    VK_CHECK(vkResetCommandBuffer(pending_.cmd, 0));
+  }
+
+  const VkCommandBufferBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  VK_CHECK(vkBeginCommandBuffer(pending_.cmd, &beginInfo));
+  return pending_.cmd;
+}
+
+void UploadManager::waitValue(uint64_t value) const {
+  const VkSemaphore semaphore = timeline_.get();
+  const VkSemaphoreWaitInfo waitInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+      .semaphoreCount = 1,
+      .pSemaphores = &semaphore,
+      .pValues = &value,
+  };
+  VK_CHECK(vkWaitSemaphores(device_, &waitInfo, UINT64_MAX));
+}
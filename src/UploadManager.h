@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "GpuAllocator.h"
+#include "StagingBuffer.h"
+#include "VulkanHandles.h"
+
+// Streams host data into device-local buffers and images through one
+// persistent staging ring. Copies are recorded into batches that are
+// submitted to the upload queue (a dedicated transfer queue when the device
+// has one) and tracked by a timeline semaphore, so nothing ever waits for a
+// whole queue to go idle: callers get a ticket per upload and can poll or
+// wait for exactly that value.
+//
+// Ring space is reclaimed as batches retire. When the ring is full the
+// oldest in-flight batch is waited on; requests larger than the whole ring
+// get a dedicated staging buffer that lives until its batch retires.
+//
+// Not thread-safe; drive it from the render thread.
+class UploadManager {
+ public:
+  using FillFn = std::function<void(uint8_t* dst)>;
+
+  // One mip level of an image upload: its extent and where its texels start
+  // in the filled data. Offsets must be multiples of the texel (or block)
+  // size.
+  struct ImageLevel {
+    VkExtent3D extent{};
+    VkDeviceSize offset = 0;
+  };
+
+  static constexpr VkDeviceSize kDefaultRingSize = VkDeviceSize{64} << 20;
+
+  UploadManager(GpuAllocator& allocator, VkQueue queue, uint32_t queueFamily,
+                uint32_t graphicsQueueFamily,
+                VkDeviceSize ringSize = kDefaultRingSize);
+  ~UploadManager();
+
+  UploadManager(const UploadManager&) = delete;
+  UploadManager& operator=(const UploadManager&) = delete;
+  UploadManager(UploadManager&&) = delete;
+  UploadManager& operator=(UploadManager&&) = delete;
+
+  // Reserves `size` bytes of staging memory, lets `fill` write the source
+  // data into it and records the copy. The image goes from UNDEFINED to
+  // SHADER_READ_ONLY_OPTIMAL. Returns the ticket the upload completes with;
+  // the copy is submitted on the next flush().
+  uint64_t uploadImage(VkImage image, VkExtent3D extent, VkDeviceSize size,
+                       const FillFn& fill);
+  // As above for mip levels 0..levels.size()-1, filled and copied at once.
+  uint64_t uploadImage(VkImage image, std::span<const ImageLevel> levels,
+                       VkDeviceSize size, const FillFn& fill);
+  uint64_t uploadBuffer(VkBuffer buffer, VkDeviceSize offset,
+                        VkDeviceSize size, const FillFn& fill);
+
+  // Submits everything recorded since the last flush. Never blocks.
+  uint64_t flush();
+
+  [[nodiscard]] bool isComplete(uint64_t ticket);
+  // Blocks until `ticket` has completed, flushing first if needed.
+  void wait(uint64_t ticket);
+  // Highest ticket known to have completed; retires finished batches.
+  [[nodiscard]] uint64_t completedValue();
+
+  [[nodiscard]] VkSemaphore timeline() const { return timeline_.get(); }
+
+  // Queue families that access uploaded resources. Resources shared between
+  // more than one family must be created with VK_SHARING_MODE_CONCURRENT.
+  [[nodiscard]] const std::vector<uint32_t>& queueFamilies() const {
+    return queueFamilies_;
+  }
+
+ private:
+  struct Batch {
+    uint64_t value = 0;
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    VkDeviceSize ringEnd = 0;
+    VkDeviceSize ringBytes = 0;
+    std::vector<StagingBuffer> oversized;
+  };
+
+  struct Span {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    uint8_t* data = nullptr;
+  };
+
+  // Polls the timeline and returns finished batches' resources.
+  uint64_t collect();
+  Span reserve(VkDeviceSize size);
+  bool tryReserveRing(VkDeviceSize size, VkDeviceSize& offset);
+  VkCommandBuffer recordingCommandBuffer();
+  void waitValue(uint64_t value) const;
+
+  GpuAllocator& allocator_;
+  VkDevice device_ = VK_NULL_HANDLE;
+  VkQueue queue_ = VK_NULL_HANDLE;
+  std::vector<uint32_t> queueFamilies_;
+
+  StagingBuffer ring_;
+  VkDeviceSize head_ = 0;
+  VkDeviceSize tail_ = 0;
+  VkDeviceSize ringUsed_ = 0;
+
+  CommandPool commandPool_;
+  std::vector<VkCommandBuffer> freeCommandBuffers_;
+  Semaphore timeline_;
+  uint64_t lastSubmitted_ = 0;
+
+  Batch pending_;
+  std::deque<Batch> batches_;
+};
@@ -0,0 +1,48 @@
+#include "VulkanCompute.h"
+
+uint32_t divideRoundingUp(uint32_t value, uint32_t divisor) {
+  return (value + divisor - 1) / divisor;
+}
+
+VkDescriptorSetLayoutBinding layoutBinding(uint32_t binding,
+                                           VkDescriptorType type,
+                                           VkShaderStageFlags stages) {
+  return {
+      .binding = binding,
+      .descriptorType = type,
+      .descriptorCount = 1,
+      .stageFlags = stages,
+  };
+}
+
+void memoryBarrier(VkCommandBuffer cmd, VkPipelineStageFlags srcStages,
+                   VkAccessFlags srcAccess, VkPipelineStageFlags dstStages,
+                   VkAccessFlags dstAccess) {
+  const VkMemoryBarrier barrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = srcAccess,
+      .dstAccessMask = dstAccess,
+  };
+  vkCmdPipelineBarrier(cmd, srcStages, dstStages, 0, 1, &barrier, 0, nullptr,
+                       0, nullptr);
+}
+
+void computeBarrier(VkCommandBuffer cmd) {
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+VkPhysicalDeviceSubgroupProperties subgroupProperties(
+    VkPhysicalDevice physicalDevice) {
+  VkPhysicalDeviceSubgroupProperties subgroup{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,
+  };
+  VkPhysicalDeviceProperties2 props{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext = &subgroup,
+  };
+  vkGetPhysicalDeviceProperties2(physicalDevice, &props);
+  return subgroup;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// Helpers shared by the compute passes (GpuRadixSort, TileSplatLayer,
+// GpuSplatTrainer).
+
+uint32_t divideRoundingUp(uint32_t value, uint32_t divisor);
+
+// A single descriptor at `binding`.
+VkDescriptorSetLayoutBinding layoutBinding(uint32_t binding,
+                                           VkDescriptorType type,
+                                           VkShaderStageFlags stages);
+
+// A global memory dependency.
+void memoryBarrier(VkCommandBuffer cmd, VkPipelineStageFlags srcStages,
+                   VkAccessFlags srcAccess, VkPipelineStageFlags dstStages,
+                   VkAccessFlags dstAccess);
+// Compute-to-compute dependency between consecutive passes.
+void computeBarrier(VkCommandBuffer cmd);
+
+VkPhysicalDeviceSubgroupProperties subgroupProperties(
+    VkPhysicalDevice physicalDevice);
@@ -1,5 +1,7 @@
 #include "VulkanHandles.h"
 
+#include <stdexcept>
+
 #include "VulkanErrors.h"
 
 Buffer::Buffer(VkDevice device, const VkBufferCreateInfo& ci) {
@@ -13,24 +15,33 @@ CommandPool::CommandPool(VkDevice device, const VkCommandPoolCreateInfo& ci) {
 }
 
 DescriptorPool::DescriptorPool(VkDevice device, uint32_t maxSets,
-                               const VkDescriptorPoolSize& poolSize) {
+                               const VkDescriptorPoolSize& poolSize)
+    : DescriptorPool(device, maxSets, std::span(&poolSize, 1)) {}
+
+DescriptorPool::DescriptorPool(
+    VkDevice device, uint32_t maxSets,
+    std::span<const VkDescriptorPoolSize> poolSizes) {
   device_ = device;
   const VkDescriptorPoolCreateInfo ci{
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
       .maxSets = maxSets,
-      .poolSizeCount = 1,
-      .pPoolSizes = &poolSize,
+      .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+      .pPoolSizes = poolSizes.data(),
   };
   VK_CHECK(vkCreateDescriptorPool(device_, &ci, nullptr, &handle_));
 }
 
 DescriptorSetLayout::DescriptorSetLayout(
-    VkDevice device, const VkDescriptorSetLayoutBinding& binding) {
+    VkDevice device, const VkDescriptorSetLayoutBinding& binding)
+    : DescriptorSetLayout(device, std::span(&binding, 1)) {}
+
+DescriptorSetLayout::DescriptorSetLayout(
+    VkDevice device, std::span<const VkDescriptorSetLayoutBinding> bindings) {
   device_ = device;
   const VkDescriptorSetLayoutCreateInfo ci{
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-      .bindingCount = 1,
-      .pBindings = &binding,
+      .bindingCount = static_cast<uint32_t>(bindings.size()),
+      .pBindings = bindings.data(),
   };
   VK_CHECK(vkCreateDescriptorSetLayout(device_, &ci, nullptr, &handle_));
 }
@@ -40,6 +51,17 @@ DeviceMemory::DeviceMemory(VkDevice device, const VkMemoryAllocateInfo& ai) {
   VK_CHECK(vkAllocateMemory(device_, &ai, nullptr, &handle_));
 }
 
+uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties& memProps,
+                        uint32_t typeBits, VkMemoryPropertyFlags required) {
+  for (uint32_t i = 0; i < memProps.memoryTypeCount; ++i) {
+    if (((typeBits & (1u << i)) != 0) &&
+        (memProps.memoryTypes[i].propertyFlags & required) == required) {
+      return i;
+    }
+  }
+  throw std::runtime_error("No suitable Vulkan memory type found");
+}
+
 Image::Image(VkDevice device, const VkImageCreateInfo& ci) {
   device_ = device;
   VK_CHECK(vkCreateImage(device_, &ci, nullptr, &handle_));
@@ -61,8 +83,37 @@ PipelineLayout::PipelineLayout(VkDevice device,
   VK_CHECK(vkCreatePipelineLayout(device_, &ci, nullptr, &handle_));
 }
 
-Pipeline::Pipeline(VkDevice device, const VkGraphicsPipelineCreateInfo& ci) {
+Semaphore::Semaphore(VkDevice device, const VkSemaphoreCreateInfo& ci) {
+  device_ = device;
+  VK_CHECK(vkCreateSemaphore(device_, &ci, nullptr, &handle_));
+}
+
+Fence::Fence(VkDevice device, const VkFenceCreateInfo& ci) {
+  device_ = device;
+  VK_CHECK(vkCreateFence(device_, &ci, nullptr, &handle_));
+}
+
+PipelineCache::PipelineCache(VkDevice device,
+                             const VkPipelineCacheCreateInfo& ci) {
+  device_ = device;
+  VK_CHECK(vkCreatePipelineCache(device_, &ci, nullptr, &handle_));
+}
+
+QueryPool::QueryPool(VkDevice device, const VkQueryPoolCreateInfo& ci) {
+  device_ = device;
+  VK_CHECK(vkCreateQueryPool(device_, &ci, nullptr, &handle_));
+}
+
+Pipeline::Pipeline(VkDevice device, const VkGraphicsPipelineCreateInfo& ci,
+                   VkPipelineCache cache) {
+  device_ = device;
+  VK_CHECK(
+      vkCreateGraphicsPipelines(device_, cache, 1, &ci, nullptr, &handle_));
+}
+
+Pipeline::Pipeline(VkDevice device, const VkComputePipelineCreateInfo& ci,
+                   VkPipelineCache cache) {
   device_ = device;
-  VK_CHECK(vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &ci, nullptr,
-                                     &handle_));
+  VK_CHECK(
+      vkCreateComputePipelines(device_, cache, 1, &ci, nullptr, &handle_));
 }
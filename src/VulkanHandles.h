@@ -2,6 +2,9 @@
 
 #include <vulkan/vulkan.h>
 
+#include <cstdint>
+#include <span>
+
 template <typename Handle, auto DestroyFn>
 class VulkanHandle {
  public:
@@ -60,6 +63,8 @@ class DescriptorPool
   DescriptorPool() = default;
   DescriptorPool(VkDevice device, uint32_t maxSets,
                  const VkDescriptorPoolSize& poolSize);
+  DescriptorPool(VkDevice device, uint32_t maxSets,
+                 std::span<const VkDescriptorPoolSize> poolSizes);
 };
 
 class DescriptorSetLayout
@@ -69,6 +74,8 @@ class DescriptorSetLayout
   DescriptorSetLayout() = default;
   DescriptorSetLayout(VkDevice device,
                       const VkDescriptorSetLayoutBinding& binding);
+  DescriptorSetLayout(VkDevice device,
+                      std::span<const VkDescriptorSetLayoutBinding> bindings);
 };
 
 class DeviceMemory : public VulkanHandle<VkDeviceMemory, vkFreeMemory> {
@@ -77,6 +84,9 @@ class DeviceMemory : public VulkanHandle<VkDeviceMemory, vkFreeMemory> {
   DeviceMemory(VkDevice device, const VkMemoryAllocateInfo& ai);
 };
 
+uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties& memProps,
+                        uint32_t typeBits, VkMemoryPropertyFlags required);
+
 class Image : public VulkanHandle<VkImage, vkDestroyImage> {
  public:
   Image() = default;
@@ -102,8 +112,36 @@ class PipelineLayout
   PipelineLayout(VkDevice device, const VkPipelineLayoutCreateInfo& ci);
 };
 
+class Semaphore : public VulkanHandle<VkSemaphore, vkDestroySemaphore> {
+ public:
+  Semaphore() = default;
+  Semaphore(VkDevice device, const VkSemaphoreCreateInfo& ci);
+};
+
+class Fence : public VulkanHandle<VkFence, vkDestroyFence> {
+ public:
+  Fence() = default;
+  Fence(VkDevice device, const VkFenceCreateInfo& ci);
+};
+
+class PipelineCache
+    : public VulkanHandle<VkPipelineCache, vkDestroyPipelineCache> {
+ public:
+  PipelineCache() = default;
+  PipelineCache(VkDevice device, const VkPipelineCacheCreateInfo& ci);
+};
+
+class QueryPool : public VulkanHandle<VkQueryPool, vkDestroyQueryPool> {
+ public:
+  QueryPool() = default;
+  QueryPool(VkDevice device, const VkQueryPoolCreateInfo& ci);
+};
+
 class Pipeline : public VulkanHandle<VkPipeline, vkDestroyPipeline> {
  public:
   Pipeline() = default;
-  Pipeline(VkDevice device, const VkGraphicsPipelineCreateInfo& ci);
+  Pipeline(VkDevice device, const VkGraphicsPipelineCreateInfo& ci,
+           VkPipelineCache cache = VK_NULL_HANDLE);
+  Pipeline(VkDevice device, const VkComputePipelineCreateInfo& ci,
+           VkPipelineCache cache = VK_NULL_HANDLE);
 };
@@ -1,28 +1,488 @@
+#include <fmt/core.h>
 #include <imgui.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <filesystem>
 #include <iostream>
+#include <memory>
 #include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "App.h"
+#include "Camera.h"
+#include "CameraDataset.h"
+#include "CompactSplats.h"
+#include "CpuSplatRasterizer.h"
+#include "DatasetLoader.h"
+#include "FrameProfiler.h"
+#include "GaussianSplatLayer.h"
+#include "GpuAllocator.h"
 #include "ImGuiLayer.h"
 #include "ImageLayer.h"
+#include "PlyLoader.h"
 #include "Renderer.h"
+#include "SplatBuffers.h"
+#include "SplatCloud.h"
+#include "SplatIndex.h"
+#include "SplatLod.h"
+#include "SplatLodCut.h"
+#include "SplatStreamer.h"
+#include "TileSplatLayer.h"
 #include "TriangleLayer.h"
 
+namespace {
+
+constexpr size_t kSyntheticSplatCount = 200'000;
+
+// The viewer's photos: mipmapped and BC7-compressed (a quarter of RGBA8's
+// memory), cached on disk after the first load. Headless output stays
+// uncompressed.
+constexpr TextureOptions kViewerTextures{
+    .compression = TextureCompression::kBc7,
+};
+
+// Orbits around the cloud's centroid from far enough out to see most of it.
+void frameCloud(Camera& camera, std::span<const float> positions) {
+  const size_t count = positions.size() / 3;
+  if (count == 0) {
+    return;
+  }
+  const auto position = [&](size_t i) {
+    return Vec3{positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]};
+  };
+  const float invCount = 1.0f / static_cast<float>(count);
+
+  Vec3 sum;
+  for (size_t i = 0; i < count; ++i) {
+    sum = sum + position(i);
+  }
+  const Vec3 centroid = sum * invCount;
+  float spread = 0.0f;
+  for (size_t i = 0; i < count; ++i) {
+    const Vec3 offset = position(i) - centroid;
+    spread += dot(offset, offset);
+  }
+  camera.target = centroid;
+  camera.distance = std::max(2.0f * std::sqrt(spread * invCount), 1e-3f);
+}
+
+bool isSplatSource(const std::filesystem::path& path) {
+  return isSplatPly(path) || isCompactSplatFile(path) || isSplatLodFile(path);
+}
+
+// True for an image sequence, with or without camera poses.
+bool isViewSource(const std::filesystem::path& path) {
+  return isCameraDataset(path) || DatasetLoader::isDatasetSource(path);
+}
+
+// Loads an image sequence. A posed capture (see CameraDataset) yields its
+// images in frame order, so view i is taken by frame i's camera.
+std::vector<ImageData> loadViews(const std::filesystem::path& source) {
+  if (!isCameraDataset(source)) {
+    return DatasetLoader(source).loadAll();
+  }
+  const CameraDataset cameras = loadCameraDataset(source);
+  std::cout << "Loaded " << cameras.frames.size() << " camera poses"
+            << (cameras.fromCache ? " from the cache" : "") << " and "
+            << cameras.pointPositions.size() / 3 << " sparse points\n";
+  return DatasetLoader(cameras.imagePaths(), DatasetLoader::Options{})
+      .loadAll();
+}
+
+// Sorts a float cloud along a Morton curve so SplatIndex's chunks are
+// spatially compact; .csplat files are written in that order already.
+SplatCloud inMortonOrder(SplatCloud cloud) {
+  cloud.reorder(mortonOrder(cloud));
+  return cloud;
+}
+
+// The splats to draw, and whatever keeps them up to date when they are only
+// part of the scene.
+struct SplatScene {
+  std::shared_ptr<const SplatBuffers> splats;
+  std::unique_ptr<SplatLodCut> lodCut;
+  std::unique_ptr<SplatStreamer> streamer;
+};
+
+// Uploads the scene in `source` (.ply, .csplat or .splod), or the synthetic
+// cloud without one, and points `camera` at it. A .splod hierarchy is drawn
+// through a SplatLodCut, and a .csplat scene larger than the streaming pool
+// through a SplatStreamer.
+SplatScene loadSplats(const Renderer::Context& ctx, const char* source,
+                      Camera& camera) {
+  SplatScene scene;
+  if (source == nullptr) {
+    scene.splats = std::make_shared<SplatBuffers>(
+        ctx, inMortonOrder(makeSyntheticSplatCloud(kSyntheticSplatCount)));
+    return scene;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  size_t count = 0;
+  if (isSplatLodFile(source)) {
+    scene.lodCut = std::make_unique<SplatLodCut>(
+        ctx, std::make_shared<const SplatLodFile>(source),
+        SplatLodCut::Options{});
+    scene.splats = scene.lodCut->splats();
+    count = scene.lodCut->file().leafCount();
+  } else if (isCompactSplatFile(source)) {
+    auto file = std::make_shared<const CompactSplatFile>(source);
+    count = file->count();
+    if (count > SplatStreamer::Options{}.poolSplats) {
+      scene.streamer = std::make_unique<SplatStreamer>(
+          ctx, std::move(file), SplatStreamer::Options{});
+      scene.splats = scene.streamer->splats();
+    } else {
+      scene.splats = std::make_shared<SplatBuffers>(ctx, *file);
+    }
+  } else {
+    scene.splats = std::make_shared<SplatBuffers>(
+        ctx, inMortonOrder(loadSplatPly(source)));
+    count = scene.splats->count();
+  }
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "Loaded " << count << " splats (SH degree "
+            << scene.splats->shDegree() << ") from " << source << " in "
+            << fmt::format("{:.0f}", elapsed.count()) << " ms"
+            << (scene.streamer ? ", streaming" : "") << "\n";
+
+  // Trained scenes come out of COLMAP, whose world is y-down.
+  camera.worldUp = Vec3{0.0f, -1.0f, 0.0f};
+  if (scene.lodCut) {
+    frameCloud(camera,
+               scene.lodCut->file().splats().positions.first(count * 3));
+  } else if (scene.streamer) {
+    // Nothing is resident yet; the chunk centres stand in for the splats.
+    const SplatIndex& index = scene.streamer->fileIndex();
+    std::vector<float> centers;
+    for (uint32_t chunk = 0; chunk < index.chunkCount(); ++chunk) {
+      const Vec3 c = index.chunkCenter(chunk);
+      centers.insert(centers.end(), {c.x, c.y, c.z});
+    }
+    frameCloud(camera, centers);
+  } else {
+    frameCloud(camera, scene.splats->hostPositions());
+  }
+  return scene;
+}
+
+// Quantizes a .ply scene into a .csplat file.
+int convertToCompact(const std::filesystem::path& input,
+                     const std::filesystem::path& output) {
+  const SplatCloud cloud = loadSplatPly(input);
+  writeCompactSplats(output, cloud);
+  const auto inSize = std::filesystem::file_size(input);
+  const auto outSize = std::filesystem::file_size(output);
+  std::cout << fmt::format(
+      "Wrote {} splats to {}: {:.1f} MiB ({:.1f} bytes per splat, {:.1f}x "
+      "smaller)\n",
+      cloud.count, output.string(), static_cast<double>(outSize) / (1 << 20),
+      static_cast<double>(outSize) / static_cast<double>(cloud.count),
+      static_cast<double>(inSize) / static_cast<double>(outSize));
+  return 0;
+}
+
+// Builds the level-of-detail hierarchy of a .ply scene into a .splod file.
+int buildLod(const std::filesystem::path& input,
+             const std::filesystem::path& output) {
+  const SplatCloud cloud = loadSplatPly(input);
+  const auto start = std::chrono::steady_clock::now();
+  const SplatLod lod = buildSplatLod(cloud);
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  writeSplatLod(output, lod);
+  std::cout << fmt::format(
+      "Built {} nodes over {} splats in {:.0f} ms; wrote {} ({:.1f} MiB)\n",
+      lod.nodes.size(), lod.leafCount, elapsed.count(), output.string(),
+      static_cast<double>(std::filesystem::file_size(output)) / (1 << 20));
+  return 0;
+}
+
+// Renders the .ply scene in `source`, or the synthetic cloud without one, on
+// the CPU at the headless resolution and writes it to `output`. Colours are
+// premultiplied, as EXR expects; PNG writers unpremultiply them.
+int runCpuRender(const std::filesystem::path& output, const char* source) {
+  const SplatCloud cloud =
+      inMortonOrder(source != nullptr
+                        ? loadSplatPly(source)
+                        : makeSyntheticSplatCloud(kSyntheticSplatCount));
+  const SplatIndex index(cloud);
+  Camera camera;
+  if (source != nullptr) {
+    camera.worldUp = Vec3{0.0f, -1.0f, 0.0f};
+  }
+  frameCloud(camera, cloud.positions);
+
+  CpuSplatRasterizer rasterizer;
+  const auto start = std::chrono::steady_clock::now();
+  const ImageData image =
+      rasterizer.render(cloud, index, SplatIndex::Culling{}, camera,
+                        Renderer::HeadlessConfig{}.extent);
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  writeImage(output, image);
+  std::cout << fmt::format(
+      "Rendered {} of {} splats ({} tile instances) on {} threads ({}) in "
+      "{:.0f} ms to {}\n",
+      rasterizer.lastVisibleCount(), cloud.count,
+      rasterizer.lastInstanceCount(), rasterizer.threadCount(),
+      CpuSplatRasterizer::isa(), elapsed.count(), output.string());
+  return 0;
+}
+
+struct AdaptiveShState {
+  bool enabled = false;
+  float budgetMs = 8.0f;
+  int degree = SplatCloud::kMaxShDegree;
+  // Frames left before the next change.
+  int settling = 0;
+};
+
+// Returns the SH degree to evaluate, at most `maxDegree`. When enabled, the
+// degree drops while the splat passes' recent GPU time exceeds the budget
+// and rises again once they fit with room to spare, trading view-dependent
+// colour for frame rate in heavy views. After each change it waits for the
+// timings to reflect it.
+int updateAdaptiveSh(AdaptiveShState& state, double splatMs, int maxDegree) {
+  constexpr int kSettleFrames = 30;
+  // A higher degree reads more coefficients, so it is only raised with a
+  // margin, or it would flip back and forth.
+  constexpr double kRaiseFraction = 0.7;
+  if (!state.enabled) {
+    state.degree = maxDegree;
+    state.settling = 0;
+    return state.degree;
+  }
+  state.degree = std::min(state.degree, maxDegree);
+  if (state.settling > 0) {
+    --state.settling;
+  } else if (splatMs > state.budgetMs && state.degree > 0) {
+    --state.degree;
+    state.settling = kSettleFrames;
+  } else if (splatMs < kRaiseFraction * state.budgetMs &&
+             state.degree < maxDegree) {
+    ++state.degree;
+    state.settling = kSettleFrames;
+  }
+  return state.degree;
+}
+
+// Mean of the last few GPU samples of `name`, or zero if there are none.
+double recentGpuMilliseconds(const FrameProfiler& profiler,
+                             std::string_view name) {
+  constexpr size_t kWindow = 8;
+  const std::vector<float> history =
+      profiler.samples(name, FrameProfiler::Source::kGpu);
+  const size_t count = std::min(history.size(), kWindow);
+  if (count == 0) {
+    return 0.0;
+  }
+  double sum = 0.0;
+  for (size_t i = history.size() - count; i < history.size(); ++i) {
+    sum += history[i];
+  }
+  return sum / static_cast<double>(count);
+}
+
+struct ProfilerPanelState {
+  size_t selected = 0;
+  std::string status;
+};
+
+// Percentile table of every metric, plus a rolling histogram of the selected
+// one.
+void drawProfilerPanel(const FrameProfiler& profiler,
+                       ProfilerPanelState& state) {
+  ImGui::SetNextWindowPos(ImVec2(5, 180), ImGuiCond_FirstUseEver);
+  ImGui::Begin("Profiler");
+  if (!profiler.gpuTimingSupported()) {
+    ImGui::TextUnformatted("GPU timestamps are not supported on this queue");
+  }
+
+  const std::vector<FrameProfiler::Summary> summaries = profiler.summaries();
+  if (state.selected < summaries.size()) {
+    const FrameProfiler::Summary& s = summaries[state.selected];
+    const std::vector<float> history = profiler.samples(s.name, s.source);
+    const std::string overlay = fmt::format(
+        "p50 {:.2f}  p95 {:.2f}  p99 {:.2f} ms", s.p50, s.p95, s.p99);
+    ImGui::PlotHistogram("##history", history.data(),
+                         static_cast<int>(history.size()), 0, overlay.c_str(),
+                         0.0f, static_cast<float>(s.max) * 1.1f,
+                         ImVec2(0, 80));
+  }
+
+  if (ImGui::BeginTable("timings", 5,
+                        ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+    ImGui::TableSetupColumn("Metric");
+    ImGui::TableSetupColumn("p50 ms");
+    ImGui::TableSetupColumn("p95 ms");
+    ImGui::TableSetupColumn("p99 ms");
+    ImGui::TableSetupColumn("max ms");
+    ImGui::TableHeadersRow();
+    for (size_t i = 0; i < summaries.size(); ++i) {
+      const FrameProfiler::Summary& s = summaries[i];
+      const std::string label = fmt::format(
+          "{} {}", s.source == FrameProfiler::Source::kGpu ? "GPU" : "CPU",
+          s.name);
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      if (ImGui::Selectable(label.c_str(), i == state.selected,
+                            ImGuiSelectableFlags_SpanAllColumns)) {
+        state.selected = i;
+      }
+      for (const double value : {s.p50, s.p95, s.p99, s.max}) {
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", value);
+      }
+    }
+    ImGui::EndTable();
+  }
+
+  const auto exportTo = [&](const char* path, auto write) {
+    try {
+      (profiler.*write)(path);
+      state.status = fmt::format("Wrote {}", path);
+    } catch (const std::exception& e) {
+      state.status = e.what();
+    }
+  };
+  if (ImGui::Button("Export CSV")) {
+    exportTo("profile.csv", &FrameProfiler::writeCsv);
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Export JSON")) {
+    exportTo("profile.json", &FrameProfiler::writeJson);
+  }
+  if (!state.status.empty()) {
+    ImGui::TextUnformatted(state.status.c_str());
+  }
+  ImGui::End();
+}
+
+// Renders each view of `source` (or one frame of the default scene without
+// a source) offscreen and writes frame_NNNN.png files into `outputDir`,
+// along with profile.csv and profile.json frame timings.
+int runHeadless(const std::filesystem::path& outputDir, const char* source) {
+  Renderer renderer(Renderer::HeadlessConfig{});
+  std::filesystem::create_directories(outputDir);
+  renderer.setReadbackCallback([&](uint64_t frame, const ImageData& image) {
+    writeImage(outputDir / fmt::format("frame_{:04}.png", frame), image);
+  });
+
+  std::vector<ImageData> views;
+  if (source != nullptr) {
+    if (isViewSource(source)) {
+      views = loadViews(source);
+    } else {
+      views.push_back(loadImage(source));
+    }
+  }
+
+  const TriangleLayer triangleLayer(renderer.getContext());
+  FrameProfiler* profiler = renderer.getContext().profiler;
+  const size_t frameCount = std::max<size_t>(views.size(), 1);
+  for (size_t i = 0; i < frameCount; ++i) {
+    std::unique_ptr<ImageLayer> imageLayer;
+    if (!views.empty()) {
+      imageLayer =
+          std::make_unique<ImageLayer>(renderer.getContext(), views[i]);
+      // Offline output must not skip the image while its upload is in flight.
+      renderer.getContext().uploads->wait(imageLayer->uploadTicket());
+    }
+
+    renderer.renderFrame([&](VkCommandBuffer cmd) {
+      if (imageLayer) {
+        const FrameProfiler::GpuScope scope(profiler, cmd, "image");
+        imageLayer->render(cmd, renderer.getSwapchainExtent());
+      } else {
+        const FrameProfiler::GpuScope scope(profiler, cmd, "triangle");
+        triangleLayer.render(cmd);
+      }
+    });
+    renderer.retire(std::move(imageLayer));
+  }
+  renderer.finish();
+  profiler->writeCsv(outputDir / "profile.csv");
+  profiler->writeJson(outputDir / "profile.json");
+
+  std::cout << "Rendered " << frameCount << " frames to "
+            << outputDir.string() << "\n";
+  return 0;
+}
+
+}  // namespace
+
 int main(int argc, char* argv[]) {
+  if (argc > 2 && std::strcmp(argv[1], "--headless") == 0) {
+    return runHeadless(argv[2], argc > 3 ? argv[3] : nullptr);
+  }
+  if (argc > 3 && std::strcmp(argv[1], "--compact") == 0) {
+    return convertToCompact(argv[2], argv[3]);
+  }
+  if (argc > 3 && std::strcmp(argv[1], "--lod") == 0) {
+    return buildLod(argv[2], argv[3]);
+  }
+  if (argc > 2 && std::strcmp(argv[1], "--cpu-render") == 0) {
+    return runCpuRender(argv[2], argc > 3 ? argv[3] : nullptr);
+  }
+
   App app;
   Renderer renderer(app.getWindow());
 
-  std::optional<ImageLayer> imageLayer;
-  if (argc > 1) {
-    imageLayer.emplace(renderer.getContext(), argv[1]);
+  std::unique_ptr<ImageLayer> imageLayer;
+  std::vector<ImageData> views;
+  Camera camera;
+  const bool splatSource = argc > 1 && isSplatSource(argv[1]);
+  const SplatScene scene = loadSplats(
+      renderer.getContext(), splatSource ? argv[1] : nullptr, camera);
+  const std::shared_ptr<const SplatBuffers>& splats = scene.splats;
+  SplatLodCut* lodCut = scene.lodCut.get();
+  SplatStreamer* streamer = scene.streamer.get();
+  GaussianSplatLayer splatLayer(renderer.getContext(), splats);
+  // Created on first use: its sort buffers are sized for the whole cloud.
+  std::unique_ptr<TileSplatLayer> tileLayer;
+  const bool tilesSupported =
+      TileSplatLayer::isSupported(renderer.getContext().physicalDevice);
+  if (argc > 1 && !splatSource) {
+    if (isViewSource(argv[1])) {
+      views = loadViews(argv[1]);
+      std::cout << "Loaded " << views.size() << " views from " << argv[1]
+                << " (" << pixelFormatName(views.front().format) << ")\n";
+      imageLayer = std::make_unique<ImageLayer>(
+          renderer.getContext(), views.front(), kViewerTextures);
+    } else {
+      imageLayer = std::make_unique<ImageLayer>(
+          renderer.getContext(), argv[1], std::nullopt, kViewerTextures);
+    }
   }
 
   TriangleLayer triangleLayer(renderer.getContext());
   ImGuiLayer imguiLayer(app.getWindow(), renderer.getContext());
+  FrameProfiler* profiler = renderer.getContext().profiler;
+  ProfilerPanelState profilerPanel;
+
+  int shDegree = SplatCloud::kMaxShDegree;
+  AdaptiveShState adaptiveSh;
+  int evaluatedShDegree = shDegree;
+  bool gpuSort = splatLayer.gpuSortSupported();
+  bool tiled = false;
+  SplatIndex::Culling culling;
+  int lodBudget = lodCut ? static_cast<int>(lodCut->budget()) : 0;
+  float lodError = SplatLodCut::Options{}.maxErrorPixels;
 
   bool showTriangle = true;
   bool showImage = true;
+  bool showSplats = true;
+  int currentView = 0;
+  int shownView = 0;
 
   bool running = true;
   while (running) {
@@ -36,28 +496,174 @@ int main(int argc, char* argv[]) {
         ImGui::GetIO().DisplaySize = ImVec2(static_cast<float>(e.window.data1),
                                           static_cast<float>(e.window.data2));
       }
+
+      if (ImGui::GetIO().WantCaptureMouse) {
+        return;
+      }
+      // Drag to orbit, scroll to zoom.
+      if (e.type == SDL_EVENT_MOUSE_MOTION &&
+          (e.motion.state & SDL_BUTTON_LMASK) != 0) {
+        camera.orbit(e.motion.xrel * 0.005f, e.motion.yrel * 0.005f);
+      } else if (e.type == SDL_EVENT_MOUSE_WHEEL) {
+        camera.zoom(std::pow(0.9f, e.wheel.y));
+      }
     });
 
-    renderer.renderFrame([&](VkCommandBuffer cmd) {
-      if (imageLayer.has_value() && showImage) {
+    const double splatMs =
+        recentGpuMilliseconds(*profiler, tiled ? "splat tiles" : "splat sort") +
+        recentGpuMilliseconds(*profiler, "splats");
+    evaluatedShDegree = updateAdaptiveSh(
+        adaptiveSh, splatMs, std::min(shDegree, splats->shDegree()));
+
+    const auto prepare = [&](VkCommandBuffer cmd) {
+      if (showSplats && streamer) {
+        const FrameProfiler::GpuScope scope(profiler, cmd, "splat streaming");
+        streamer->setCulling(culling);
+        streamer->update(cmd, camera, renderer.getSwapchainExtent(),
+                         renderer.frameSlot());
+      }
+      if (showSplats && lodCut) {
+        const FrameProfiler::GpuScope scope(profiler, cmd, "splat lod");
+        lodCut->setBudget(static_cast<size_t>(lodBudget));
+        lodCut->setMaxError(lodError);
+        lodCut->update(cmd, camera, renderer.getSwapchainExtent(),
+                       renderer.frameSlot());
+      }
+      if (showSplats && tiled) {
+        if (!tileLayer) {
+          tileLayer =
+              std::make_unique<TileSplatLayer>(renderer.getContext(), splats);
+        }
+        const FrameProfiler::GpuScope scope(profiler, cmd, "splat tiles");
+        tileLayer->setShDegree(evaluatedShDegree);
+        tileLayer->setCulling(culling);
+        tileLayer->prepare(cmd, camera, renderer.getSwapchainExtent(),
+                           renderer.frameSlot());
+      } else if (showSplats) {
+        const FrameProfiler::GpuScope scope(profiler, cmd, "splat sort");
+        splatLayer.setShDegree(evaluatedShDegree);
+        splatLayer.setGpuSort(gpuSort);
+        splatLayer.setCulling(culling);
+        splatLayer.prepare(cmd, camera, renderer.getSwapchainExtent(),
+                           renderer.frameSlot());
+      }
+    };
+    const auto draw = [&](VkCommandBuffer cmd) {
+      if (imageLayer && showImage) {
+        const FrameProfiler::GpuScope scope(profiler, cmd, "image");
         imageLayer->render(cmd, renderer.getSwapchainExtent());
       }
 
+      if (showSplats && tiled && tileLayer) {
+        const FrameProfiler::GpuScope scope(profiler, cmd, "splats");
+        tileLayer->render(cmd, renderer.frameSlot());
+      } else if (showSplats) {
+        const FrameProfiler::GpuScope scope(profiler, cmd, "splats");
+        splatLayer.render(cmd, camera, renderer.getSwapchainExtent(),
+                          renderer.frameSlot());
+      }
+
       if (showTriangle) {
+        const FrameProfiler::GpuScope scope(profiler, cmd, "triangle");
         triangleLayer.render(cmd);
       }
 
+      const FrameProfiler::GpuScope scope(profiler, cmd, "imgui");
       imguiLayer.render(cmd, [&]() {
         ImGui::SetNextWindowPos(ImVec2(5, 5), ImGuiCond_FirstUseEver);
         ImGui::Begin("Layers");
         ImGui::Checkbox("Triangle", &showTriangle);
-        if (imageLayer.has_value()) {
+        if (imageLayer) {
           ImGui::Checkbox("Image", &showImage);
         }
+        ImGui::Checkbox("Splats", &showSplats);
+        ImGui::SliderInt("SH degree", &shDegree, 0, SplatCloud::kMaxShDegree);
+        ImGui::Checkbox("Adaptive SH", &adaptiveSh.enabled);
+        if (adaptiveSh.enabled) {
+          ImGui::SliderFloat("Splat budget (ms)", &adaptiveSh.budgetMs, 1.0f,
+                             33.0f);
+          ImGui::Text("Evaluating SH degree %d", evaluatedShDegree);
+        }
+        if (splatLayer.gpuSortSupported()) {
+          ImGui::Checkbox("GPU sort", &gpuSort);
+        }
+        ImGui::Checkbox("Culling", &culling.enabled);
+        if (culling.enabled) {
+          ImGui::SliderFloat("Min size (px)", &culling.minPixels, 0.0f, 16.0f);
+        }
+        ImGui::Text("Visible splats %u / %zu",
+                    tiled && tileLayer ? tileLayer->visibleCount()
+                                       : splatLayer.visibleCount(),
+                    splats->count());
+        if (lodCut) {
+          const SplatLodCut::Stats& lod = lodCut->stats();
+          ImGui::SliderInt("LOD budget", &lodBudget,
+                           static_cast<int>(SplatLod::kBranching),
+                           static_cast<int>(lodCut->capacity()));
+          ImGui::SliderFloat("LOD error (px)", &lodError, 0.5f, 16.0f);
+          ImGui::Text("Cut %zu of %zu nodes", lod.cutSize,
+                      lodCut->file().count());
+          ImGui::Text("%u splits, %u merges, %u uploads", lod.splits,
+                      lod.merges, lod.uploads);
+        }
+        if (streamer) {
+          const SplatStreamer::Stats& stream = streamer->stats();
+          const auto hits = static_cast<double>(stream.totalHits);
+          const double lookups =
+              hits + static_cast<double>(stream.totalMisses);
+          constexpr double kMiBytes = 1024.0 * 1024.0;
+          ImGui::Text("Chunks: %u resident, %u loading", stream.residentChunks,
+                      stream.loadingChunks);
+          ImGui::Text("%u hits, %u misses, %u prefetched, %u evicted",
+                      stream.hits, stream.misses, stream.prefetches,
+                      stream.evictions);
+          ImGui::Text("Hit rate %.1f%%",
+                      lookups == 0.0 ? 100.0 : 100.0 * hits / lookups);
+          ImGui::Text("Paged %.1f MiB/s, uploaded %.1f MiB/s",
+                      stream.pagedBytesPerSecond / kMiBytes,
+                      stream.uploadedBytesPerSecond / kMiBytes);
+        }
+        if (tilesSupported) {
+          ImGui::Checkbox("Tile rasterizer", &tiled);
+          if (tiled && tileLayer) {
+            ImGui::Text("Tile instances %u / %u",
+                        tileLayer->lastInstanceCount(),
+                        tileLayer->instanceCapacity());
+          }
+        }
+        if (views.size() > 1) {
+          ImGui::SliderInt("View", &currentView, 0,
+                           static_cast<int>(views.size()) - 1);
+        }
+
+        const GpuAllocator::Stats mem =
+            renderer.getContext().allocator->stats();
+        constexpr float kMiB = 1024.0f * 1024.0f;
+        ImGui::Separator();
+        ImGui::Text("GPU memory %.1f / %.1f MiB",
+                    static_cast<float>(mem.bytesInUse) / kMiB,
+                    static_cast<float>(mem.bytesReserved) / kMiB);
+        ImGui::Text("%zu allocations in %zu blocks, %.0f%% fragmented",
+                    mem.allocationCount, mem.blockCount,
+                    mem.fragmentation * 100.0f);
         ImGui::End();
+
+        drawProfilerPanel(*profiler, profilerPanel);
       });
-    });
+    };
+    renderer.renderFrame(draw, prepare);
+
+    if (shownView != currentView) {
+      // Frames still in flight may sample the old texture.
+      renderer.retire(std::move(imageLayer));
+      imageLayer = std::make_unique<ImageLayer>(
+          renderer.getContext(), views[static_cast<size_t>(currentView)],
+          kViewerTextures);
+      shownView = currentView;
+    }
   }
 
+  // The layers are destroyed before the renderer; let their frames finish.
+  renderer.finish();
   return 0;
 }
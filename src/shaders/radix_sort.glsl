@@ -0,0 +1,32 @@
+// Shared by the GpuRadixSort passes. Each pass handles one 8-bit digit of
+// the keys; the workgroup size and the elements per invocation are
+// specialization constants so they can be tuned per device.
+
+layout(local_size_x_id = 0) in;
+layout(constant_id = 1) const uint kItemsPerThread = 16u;
+
+// Matches GpuRadixSort's PushConstants.
+layout(push_constant) uniform PushConstants {
+    uint count;       // elements (or scan entries)
+    uint shift;       // bit offset of the digit within its key word
+    uint keyWord;     // 32-bit word of the key holding the digit
+    uint keyWords;    // 32-bit words per key, low word first
+    uint blockCount;  // workgroups in the histogram and scatter passes
+    uint indirect;    // nonzero: sort min(indirectCount, count) elements
+} pc;
+
+// GpuRadixSort::countBuffer(); bound for the histogram and scatter passes.
+layout(std430, set = 0, binding = 5) readonly buffer IndirectCount {
+    uint indirectCount;
+};
+
+const uint kRadix = 256u;
+
+uint blockSize() {
+    return gl_WorkGroupSize.x * kItemsPerThread;
+}
+
+// Elements to sort. Not for the scan passes, which have no count binding.
+uint elementCount() {
+    return pc.indirect != 0u ? min(indirectCount, pc.count) : pc.count;
+}
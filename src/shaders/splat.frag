@@ -0,0 +1,24 @@
+#version 450
+
+layout(location = 0) in vec2 inOffset;
+layout(location = 1) flat in vec3 inConic;
+layout(location = 2) flat in vec4 inColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec2 d = inOffset;
+    float power = -0.5 * (inConic.x * d.x * d.x + inConic.z * d.y * d.y) -
+                  inConic.y * d.x * d.y;
+    if (power > 0.0) {
+        discard;
+    }
+
+    float alpha = min(0.99, inColor.a * exp(power));
+    if (alpha < 1.0 / 255.0) {
+        discard;
+    }
+
+    // Premultiplied, for ONE / ONE_MINUS_SRC_ALPHA blending back to front.
+    outColor = vec4(inColor.rgb * alpha, alpha);
+}
@@ -0,0 +1,51 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// One instanced quad per splat, drawn back to front in the order given by
+// `order`, and sized to three standard deviations of the projected Gaussian.
+// Colours come from splat_color.comp, run earlier in the frame.
+
+#include "splat_data.glsl"
+#include "splat_project.glsl"
+
+layout(std430, set = 0, binding = 5) readonly buffer Order {
+    uint order[];
+};
+layout(std430, set = 0, binding = 11) readonly buffer ShadedColors {
+    uvec2 shadedColors[];  // half rg, half b + opacity
+};
+
+layout(push_constant) uniform PushConstants {
+    mat4 view;          // world -> camera, +x right, +y down, +z forward
+    vec2 focal;         // pixels
+    vec2 viewport;      // pixels
+    vec2 tanHalfFov;
+} pc;
+
+layout(location = 0) out vec2 outOffset;  // pixels from the splat centre
+layout(location = 1) flat out vec3 outConic;
+layout(location = 2) flat out vec4 outColor;  // rgb, opacity
+
+// Outside the clip volume, so the whole quad is dropped.
+const vec4 kCulled = vec4(0.0, 0.0, 2.0, 1.0);
+
+void main() {
+    uint id = order[gl_InstanceIndex];
+    ScreenSplat screen;
+    if (!projectSplat(id, pc.view, pc.focal, pc.viewport, pc.tanHalfFov,
+                      screen)) {
+        gl_Position = kCulled;
+        return;
+    }
+
+    // Triangle strip: (-1,-1), (1,-1), (-1,1), (1,1).
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1) * 2.0 - 1.0;
+    vec2 offset = corner * screen.radius;
+    gl_Position =
+        vec4((screen.center + offset) / pc.viewport * 2.0 - 1.0, 0.0, 1.0);
+
+    outOffset = offset;
+    outConic = screen.conic;
+    uvec2 color = shadedColors[id];
+    outColor = vec4(unpackHalf2x16(color.x), unpackHalf2x16(color.y));
+}
@@ -0,0 +1,132 @@
+// Splat attribute storage shared by every shader that reads a SplatBuffers
+// cloud. Compiled with SPLAT_COMPACT defined for clouds loaded from .csplat
+// files (see CompactSplats.h), which are decoded here on the fly; otherwise
+// the buffers hold SplatCloud's float arrays as they are.
+//
+// Bindings 0..4 hold the attributes, in SplatBuffers::Attribute order, and
+// binding 6 the compact chunk bounds. Binding 5 is left to the includer.
+
+#ifdef SPLAT_COMPACT
+
+layout(std430, set = 0, binding = 0) readonly buffer Positions {
+    uint positions[];  // x:11 y:10 z:11 within the chunk bounds
+};
+layout(std430, set = 0, binding = 1) readonly buffer Scales {
+    uint scales[];  // log-scales, packed like positions
+};
+layout(std430, set = 0, binding = 2) readonly buffer Rotations {
+    uint rotations[];  // smallest three
+};
+layout(std430, set = 0, binding = 3) readonly buffer Colors {
+    uint colors[];  // DC r, g, b bytes within the chunk bounds; opacity
+};
+layout(std430, set = 0, binding = 4) readonly buffer ShRest {
+    uint shRest[];  // signed bytes scaled by the chunk's shRestRange
+};
+layout(std430, set = 0, binding = 6) readonly buffer Chunks {
+    float chunks[];  // CompactSplatFile::kChunkFloats per chunk
+};
+
+const uint kChunkShift = 8u;  // 256 splats per chunk
+const uint kChunkFloats = 20u;
+
+vec3 chunkVec3(uint id, uint offset) {
+    uint base = (id >> kChunkShift) * kChunkFloats + offset;
+    return vec3(chunks[base], chunks[base + 1u], chunks[base + 2u]);
+}
+
+vec3 unpack111011(uint v) {
+    return vec3(float(v >> 21), float((v >> 11) & 1023u), float(v & 2047u)) /
+           vec3(2047.0, 1023.0, 2047.0);
+}
+
+vec3 splatPosition(uint id) {
+    return mix(chunkVec3(id, 0u), chunkVec3(id, 3u),
+               unpack111011(positions[id]));
+}
+
+vec3 splatScale(uint id) {
+    return exp(mix(chunkVec3(id, 6u), chunkVec3(id, 9u),
+                   unpack111011(scales[id])));
+}
+
+vec4 splatRotation(uint id) {
+    uint bits = rotations[id];
+    uint largest = bits >> 30;
+    vec3 codes = vec3((bits >> 20) & 1023u, (bits >> 10) & 1023u,
+                      bits & 1023u);
+    vec3 others = (codes / 1023.0 * 2.0 - 1.0) * 0.7071067811865476;
+    float dropped = sqrt(max(0.0, 1.0 - dot(others, others)));
+    if (largest == 0u) {
+        return vec4(dropped, others);
+    } else if (largest == 1u) {
+        return vec4(others.x, dropped, others.yz);
+    } else if (largest == 2u) {
+        return vec4(others.xy, dropped, others.z);
+    }
+    return vec4(others, dropped);
+}
+
+float splatOpacity(uint id) {
+    return float(colors[id] >> 24) / 255.0;
+}
+
+// Coefficient k of `coeffs` per channel, as rgb.
+vec3 splatSh(uint id, uint k, uint coeffs) {
+    if (k == 0u) {
+        return mix(chunkVec3(id, 12u), chunkVec3(id, 15u),
+                   unpackUnorm4x8(colors[id]).rgb);
+    }
+    uint wordsPerSplat = ((coeffs - 1u) * 3u + 3u) / 4u;
+    float range = chunks[(id >> kChunkShift) * kChunkFloats + 18u];
+    uint byteIndex = (k - 1u) * 3u;
+    vec3 result;
+    for (uint c = 0u; c < 3u; ++c) {
+        uint b = byteIndex + c;
+        uint word = shRest[id * wordsPerSplat + (b >> 2)];
+        result[c] = float(int((word >> ((b & 3u) * 8u)) & 255u) - 128) / 127.0;
+    }
+    return result * range;
+}
+
+#else
+
+layout(std430, set = 0, binding = 0) readonly buffer Positions {
+    float positions[];
+};
+layout(std430, set = 0, binding = 1) readonly buffer Scales {
+    float scales[];
+};
+layout(std430, set = 0, binding = 2) readonly buffer Rotations {
+    vec4 rotations[];  // w, x, y, z
+};
+layout(std430, set = 0, binding = 3) readonly buffer Opacities {
+    float opacities[];
+};
+layout(std430, set = 0, binding = 4) readonly buffer Sh {
+    float sh[];  // [splat][coefficient][channel]
+};
+
+vec3 splatPosition(uint id) {
+    return vec3(positions[3u * id], positions[3u * id + 1u],
+                positions[3u * id + 2u]);
+}
+
+vec3 splatScale(uint id) {
+    return vec3(scales[3u * id], scales[3u * id + 1u], scales[3u * id + 2u]);
+}
+
+vec4 splatRotation(uint id) {
+    return rotations[id];
+}
+
+float splatOpacity(uint id) {
+    return opacities[id];
+}
+
+vec3 splatSh(uint id, uint k, uint coeffs) {
+    uint i = (id * coeffs + k) * 3u;
+    return vec3(sh[i], sh[i + 1u], sh[i + 2u]);
+}
+
+#endif
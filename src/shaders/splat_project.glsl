@@ -0,0 +1,127 @@
+// Screen-space projection of a splat, shared by the instanced-quad and tile
+// rasterizers: the 3D covariance is projected to screen space (EWA
+// splatting, as in 3D Gaussian Splatting) and the view-dependent colour
+// evaluated from the spherical harmonics, once per visible splat and frame
+// (in splat_color.comp for the quads). Include after splat_data.glsl.
+
+const float kNearPlane = 0.2;
+
+const float kShC0 = 0.28209479177387814;
+const float kShC1 = 0.4886025119029199;
+const float kShC2[5] = float[](1.0925484305920792, -1.0925484305920792,
+                               0.31539156525252005, -1.0925484305920792,
+                               0.5462742152960396);
+const float kShC3[7] = float[](-0.5900435899266435, 2.890611442640554,
+                               -0.4570457994644658, 0.3731763325901154,
+                               -0.4570457994644658, 1.445305721320277,
+                               -0.5900435899266435);
+
+// SH degree evaluated and coefficients stored per channel. Specialized per
+// pipeline, so evalSh() compiles down to just the bands in use and the
+// coefficient addressing folds to constants.
+layout(constant_id = 0) const uint kShDegree = 3u;
+layout(constant_id = 1) const uint kShCoeffs = 16u;
+
+// Colour seen along `dir`, from the first kShDegree bands.
+vec3 evalSh(uint id, vec3 dir) {
+    uint coeffs = kShCoeffs;
+    vec3 result = kShC0 * splatSh(id, 0u, coeffs);
+    if (kShDegree > 0u) {
+        float x = dir.x;
+        float y = dir.y;
+        float z = dir.z;
+        result += kShC1 * (-y * splatSh(id, 1u, coeffs) +
+                           z * splatSh(id, 2u, coeffs) -
+                           x * splatSh(id, 3u, coeffs));
+        if (kShDegree > 1u) {
+            float xx = x * x;
+            float yy = y * y;
+            float zz = z * z;
+            result += kShC2[0] * x * y * splatSh(id, 4u, coeffs) +
+                      kShC2[1] * y * z * splatSh(id, 5u, coeffs) +
+                      kShC2[2] * (2.0 * zz - xx - yy) *
+                          splatSh(id, 6u, coeffs) +
+                      kShC2[3] * x * z * splatSh(id, 7u, coeffs) +
+                      kShC2[4] * (xx - yy) * splatSh(id, 8u, coeffs);
+            if (kShDegree > 2u) {
+                result +=
+                    kShC3[0] * y * (3.0 * xx - yy) * splatSh(id, 9u, coeffs) +
+                    kShC3[1] * x * y * z * splatSh(id, 10u, coeffs) +
+                    kShC3[2] * y * (4.0 * zz - xx - yy) *
+                        splatSh(id, 11u, coeffs) +
+                    kShC3[3] * z * (2.0 * zz - 3.0 * xx - 3.0 * yy) *
+                        splatSh(id, 12u, coeffs) +
+                    kShC3[4] * x * (4.0 * zz - xx - yy) *
+                        splatSh(id, 13u, coeffs) +
+                    kShC3[5] * z * (xx - yy) * splatSh(id, 14u, coeffs) +
+                    kShC3[6] * x * (xx - 3.0 * yy) * splatSh(id, 15u, coeffs);
+            }
+        }
+    }
+    return max(result + 0.5, 0.0);
+}
+
+struct ScreenSplat {
+    vec2 center;   // pixels
+    vec3 conic;    // inverse 2D covariance: xx, xy, yy
+    float radius;  // pixels, three standard deviations
+    float depth;   // camera-space z
+};
+
+// Projects splat `id` for a camera with the given world -> camera `view`
+// (+x right, +y down, +z forward). False if it is behind the near plane,
+// degenerate or entirely off screen.
+bool projectSplat(uint id, mat4 view, vec2 focal, vec2 viewport,
+                  vec2 tanHalfFov, out ScreenSplat s) {
+    vec3 t = (view * vec4(splatPosition(id), 1.0)).xyz;
+    if (t.z < kNearPlane) {
+        return false;
+    }
+
+    // Sigma = R S S^T R^T
+    vec4 q = splatRotation(id);
+    float r = q.x;
+    float x = q.y;
+    float y = q.z;
+    float z = q.w;
+    mat3 R = mat3(
+        1.0 - 2.0 * (y * y + z * z), 2.0 * (x * y + r * z), 2.0 * (x * z - r * y),
+        2.0 * (x * y - r * z), 1.0 - 2.0 * (x * x + z * z), 2.0 * (y * z + r * x),
+        2.0 * (x * z + r * y), 2.0 * (y * z - r * x), 1.0 - 2.0 * (x * x + y * y));
+    vec3 scale = splatScale(id);
+    mat3 M = R * mat3(scale.x, 0.0, 0.0, 0.0, scale.y, 0.0, 0.0, 0.0, scale.z);
+    mat3 sigma = M * transpose(M);
+
+    // Jacobian of the perspective projection. The centre is clamped just
+    // outside the view so splats at grazing angles don't explode.
+    vec2 limit = 1.3 * tanHalfFov;
+    vec2 txy = clamp(t.xy / t.z, -limit, limit) * t.z;
+    float invZ = 1.0 / t.z;
+    mat3 J = mat3(
+        focal.x * invZ, 0.0, 0.0,
+        0.0, focal.y * invZ, 0.0,
+        -focal.x * txy.x * invZ * invZ, -focal.y * txy.y * invZ * invZ, 0.0);
+    mat3 T = J * mat3(view);
+    mat3 cov = T * sigma * transpose(T);
+
+    // Low-pass filter: every splat covers at least about a pixel.
+    float a = cov[0][0] + 0.3;
+    float b = cov[0][1];
+    float c = cov[1][1] + 0.3;
+    float det = a * c - b * b;
+    if (det <= 0.0) {
+        return false;
+    }
+
+    float mid = 0.5 * (a + c);
+    float lambda = mid + sqrt(max(0.1, mid * mid - det));
+    s.radius = ceil(3.0 * sqrt(lambda));
+    s.center = focal * t.xy * invZ + 0.5 * viewport;
+    if (any(lessThan(s.center + s.radius, vec2(0.0))) ||
+        any(greaterThan(s.center - s.radius, viewport))) {
+        return false;
+    }
+    s.conic = vec3(c, -b, a) / det;
+    s.depth = t.z;
+    return true;
+}
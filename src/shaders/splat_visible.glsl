@@ -0,0 +1,14 @@
+// The chunks of splats SplatIndex::cull() kept this frame, in ascending
+// order. Passes over the visible splats run one invocation per visible splat
+// and map it back to the cloud with visibleSplat().
+
+layout(std430, set = 0, binding = 10) readonly buffer VisibleChunks {
+    uint visibleChunks[];
+};
+
+const uint kVisibleChunkSplats = 256u;  // SplatIndex::kChunkSplats
+
+uint visibleSplat(uint i) {
+    return visibleChunks[i / kVisibleChunkSplats] * kVisibleChunkSplats +
+           i % kVisibleChunkSplats;
+}
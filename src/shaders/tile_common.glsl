@@ -0,0 +1,13 @@
+// Shared by the tile rasterizer passes (see TileSplatLayer).
+
+const uint kTileSize = 16u;
+// Contributions fainter than this are skipped, as in splat.frag.
+const float kMinAlpha = 1.0 / 255.0;
+
+// A splat as projected for the current view.
+struct ProjectedSplat {
+    vec2 center;         // pixels
+    uint colorRG;        // packHalf2x16
+    uint colorBOpacity;  // packHalf2x16
+    vec4 conic;          // xyz: inverse 2D covariance
+};
@@ -0,0 +1,11 @@
+#version 450
+
+// Composites the tile rasterizer's premultiplied output over the frame.
+
+layout(set = 0, binding = 0, rgba16f) uniform readonly image2D source;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = imageLoad(source, ivec2(gl_FragCoord.xy));
+}
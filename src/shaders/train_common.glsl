@@ -0,0 +1,47 @@
+// Shared by the GpuSplatTrainer passes. Include after tile_common.glsl.
+
+// A splat as projected for the iteration's view. Culled splats have no
+// instances.
+struct TrainSplat {
+    vec2 center;         // pixels
+    uint firstInstance;  // instance slots [first, first + count)
+    uint instanceCount;
+    vec4 conicOpacity;   // inverse 2D covariance xx xy yy, opacity
+    vec4 colorDepth;     // colour after the clamp at zero, camera-space z
+};
+
+// Per pixel, from the forward blend: the transmittance left, and how many of
+// its tile's instances were visited up to and including the last blended.
+struct PixelState {
+    float transmittance;
+    uint visited;
+};
+
+// Gradients per instance: centre x y, conic xx xy yy, opacity, colour r g b.
+const uint kScreenGradients = 9u;
+
+// Contributions are cut off as in tile_raster.comp.
+const float kMaxAlpha = 0.99;
+const float kMinTransmittance = 1.0 / 10000.0;
+
+// Matches GpuSplatTrainer's IterationUniforms; one copy per iteration in
+// flight.
+layout(std140, set = 1, binding = 0) uniform Iteration {
+    mat4 view;        // world -> camera, +x right, +y down, +z forward
+    vec4 cameraPos;   // xyz
+    vec2 focal;       // pixels
+    vec2 viewport;    // pixels
+    vec2 tanHalfFov;
+    uvec2 tiles;      // tile grid size
+    uint capacity;    // instance slots
+    uint count;       // splats
+    float ssimWeight;
+    float lossScale;  // 1 / (3 * pixels): the losses are channel means
+    vec4 rates;       // position, log-scale, rotation, opacity logit
+    vec2 shRates;     // DC, higher orders
+    float beta1;
+    float beta2;
+    float epsilon;
+    float correction1;  // Adam bias corrections, 1 - beta^step
+    float correction2;
+} iteration;
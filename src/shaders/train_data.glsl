@@ -0,0 +1,50 @@
+// Trainable splat parameters (see GpuSplatTrainer), bound where
+// splat_data.glsl binds a float cloud's attributes but stored the way 3DGS
+// optimizes them: log-scales, opacity logits and unnormalized quaternions.
+// The accessors apply the activations, so splat_project.glsl works on them
+// unchanged. Shaders that update the parameters define TRAIN_WRITABLE.
+
+#ifdef TRAIN_WRITABLE
+#define TRAIN_ACCESS
+#else
+#define TRAIN_ACCESS readonly
+#endif
+
+layout(std430, set = 0, binding = 0) TRAIN_ACCESS buffer Positions {
+    float positions[];
+};
+layout(std430, set = 0, binding = 1) TRAIN_ACCESS buffer LogScales {
+    float logScales[];
+};
+layout(std430, set = 0, binding = 2) TRAIN_ACCESS buffer Rotations {
+    vec4 rotations[];  // w, x, y, z; any length
+};
+layout(std430, set = 0, binding = 3) TRAIN_ACCESS buffer OpacityLogits {
+    float opacityLogits[];
+};
+layout(std430, set = 0, binding = 4) TRAIN_ACCESS buffer Sh {
+    float sh[];  // [splat][coefficient][channel]
+};
+
+vec3 splatPosition(uint id) {
+    return vec3(positions[3u * id], positions[3u * id + 1u],
+                positions[3u * id + 2u]);
+}
+
+vec3 splatScale(uint id) {
+    return exp(vec3(logScales[3u * id], logScales[3u * id + 1u],
+                    logScales[3u * id + 2u]));
+}
+
+vec4 splatRotation(uint id) {
+    return normalize(rotations[id]);
+}
+
+float splatOpacity(uint id) {
+    return 1.0 / (1.0 + exp(-opacityLogits[id]));
+}
+
+vec3 splatSh(uint id, uint k, uint coeffs) {
+    uint i = (id * coeffs + k) * 3u;
+    return vec3(sh[i], sh[i + 1u], sh[i + 2u]);
+}
@@ -0,0 +1,39 @@
+// Shared by train_densify_mark.comp and train_densify_scatter.comp, which
+// must agree on every splat's fate. Include after train_data.glsl.
+
+// Matches GpuSplatTrainer's DensifyPushConstants.
+layout(push_constant) uniform PushConstants {
+    uint count;               // splats before densification
+    uint shFloats;            // SH floats per splat
+    uint seed;                // for the split samples
+    float gradientThreshold;  // mean view-space centre gradient
+    float scaleThreshold;     // world units: larger splats split, smaller clone
+    float minOpacity;         // fainter splats are pruned
+} pc;
+
+layout(std430, set = 0, binding = 5) readonly buffer DensifyStats {
+    vec2 densifyStats[];  // summed view-space gradient norm, views seen
+};
+
+const uint kPrune = 0u;
+const uint kKeep = 1u;
+const uint kClone = 2u;
+const uint kSplit = 3u;
+
+uint densifyAction(uint id) {
+    if (splatOpacity(id) < pc.minOpacity) {
+        return kPrune;
+    }
+    vec2 stats = densifyStats[id];
+    if (stats.y == 0.0 || stats.x / stats.y < pc.gradientThreshold) {
+        return kKeep;
+    }
+    vec3 scale = splatScale(id);
+    return max(scale.x, max(scale.y, scale.z)) > pc.scaleThreshold ? kSplit
+                                                                   : kClone;
+}
+
+// Splats written for `action`: a split replaces the splat with two.
+uint densifyOutputs(uint action) {
+    return action == kPrune ? 0u : action == kKeep ? 1u : 2u;
+}
@@ -0,0 +1,17 @@
+// SSIM window shared by train_loss.comp and train_loss_grad.comp.
+
+const int kSsimRadius = 5;
+const float kSsimC1 = 0.01 * 0.01;
+const float kSsimC2 = 0.03 * 0.03;
+// dSSIM/dmuX, dSSIM/dvarX, dSSIM/dcovXY, muX, muY; three channels each.
+const uint kSsimTermFloats = 15u;
+
+// Normalized 1D Gaussian, sigma 1.5.
+const float kSsimKernel[11] = float[](
+    0.001028380, 0.007598758, 0.036000772, 0.109360690, 0.213005538,
+    0.266011725, 0.213005538, 0.109360690, 0.036000772, 0.007598758,
+    0.001028380);
+
+float ssimWeight(int dx, int dy) {
+    return kSsimKernel[dx + kSsimRadius] * kSsimKernel[dy + kSsimRadius];
+}